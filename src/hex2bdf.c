@@ -0,0 +1,334 @@
+/**
+   @file hex2bdf.c
+
+   @brief hex2bdf - Convert a GNU Unifont .hex file into a BDF font
+
+   @author Roman Czyborra, Paul Hardy
+
+   @copyright Copyright (C) 1998, 2013 Roman Czyborra, Paul Hardy
+
+   This program reads glyphs in Unifont .hex format from the files
+   named on the command line, or from stdin if none are named, and
+   writes a BDF font to stdout.  It replaces the Perl script of the
+   same name and produces the same output for Unifont's own .hex files.
+
+   Synopsis: hex2bdf [--font name] [--rows n] [--version string]
+                     [--copyright string] [input.hex ...] > output.bdf
+
+   The input is read into memory once and indexed.  Glyphs that are
+   already in ascending code point order are written in that order;
+   otherwise the index is radix sorted by code point first.  If a code
+   point appears more than once, the glyph read last is used, as in
+   the Perl version.  BDF records are formatted into a large output
+   buffer, copying each bitmap row straight from the input.
+
+   A single .ufb file from hex2ufb, including an overlay, can be read
+   instead of .hex files.  Its glyphs are then written one at a time
+   straight from the mapped file, without reading the font into memory.
+*/
+/*
+   LICENSE:
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 2 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "unihex.h"
+#include "ufb.h"
+
+#define OUTBUF (1 << 18)  ///< Size of the output buffer, in bytes.
+#define MAXREC 1024       ///< Longest BDF record for one glyph row, plus room.
+#define MAXLINE 4096      ///< Longest .hex line read from a .ufb file.
+
+
+char outbuf[OUTBUF];   ///< Output buffer for BDF records.
+size_t outlen = 0;     ///< Number of bytes in outbuf.
+
+
+/**
+   @brief The main function.
+
+   @param[in] argc The count of command line arguments.
+   @param[in] argv Pointer to array of command line arguments.
+   @return This program exits with status EXIT_SUCCESS or EXIT_FAILURE.
+*/
+int
+main (int argc, char *argv[])
+{
+   char *font_name = "Unifont";   /* XLFD FAMILY_NAME                  */
+   char *copyright = "";          /* COPYRIGHT property                */
+   char *version   = "1.0";       /* FONT_VERSION property             */
+   int   vpixels   = 16;          /* XLFD PIXEL_SIZE; vertical pixels  */
+   char *text;                    /* all input, read into memory       */
+   size_t textlen;                /* number of bytes in text           */
+   struct Glyph *glyphs;          /* index of glyphs in text           */
+   unsigned long nglyphs;         /* number of glyphs in the index     */
+   struct Ufb *ufb;               /* input, if it is one .ufb file     */
+   struct Glyph glyph;            /* current glyph from the .ufb file  */
+   char  line[MAXLINE];           /* current glyph as a .hex line      */
+   unsigned long n;               /* glyph number                      */
+   int   nfiles = 0;              /* number of input files named       */
+   int   i;                       /* loop variable                     */
+   char *arg, *value;             /* current option and its value      */
+
+   void write_header (unsigned long nglyphs, char *font_name,
+                      char *copyright, char *version, int vpixels);
+   void write_glyph (struct Glyph *glyph, int vpixels);
+   void write_end (void);
+
+   /*
+      Options are accepted as "--name value", "--name=value",
+      "-n value", or "-n=value", like the Perl version's Getopt::Long.
+      File names are moved to the front of argv.
+   */
+   for (i = 1; i < argc; i++) {
+      arg = argv[i];
+      if (arg[0] != '-' || arg[1] == '\0') {
+         argv[nfiles++] = arg;
+         continue;
+      }
+      if (arg[1] == '-')
+         arg += 2;
+      else
+         arg += 1;
+      value = strchr (arg, '=');
+      if (value != NULL)
+         *value++ = '\0';
+      else if (i + 1 < argc)
+         value = argv[++i];
+      if (value == NULL) {
+         fprintf (stderr, "hex2bdf: option %s needs a value.\n", argv[i]);
+         exit (EXIT_FAILURE);
+      }
+      if      (strcmp (arg, "font") == 0 || strcmp (arg, "f") == 0)
+         font_name = value;
+      else if (strcmp (arg, "copyright") == 0 || strcmp (arg, "c") == 0)
+         copyright = value;
+      else if (strcmp (arg, "version") == 0 || strcmp (arg, "v") == 0)
+         version = value;
+      else if (strcmp (arg, "rows") == 0 || strcmp (arg, "r") == 0) {
+         vpixels = atoi (value);
+         if (vpixels <= 0 || vpixels % 4 != 0) {
+            fprintf (stderr, "hex2bdf: invalid number of rows: %s\n", value);
+            exit (EXIT_FAILURE);
+         }
+      }
+      else {
+         fprintf (stderr, "\nSyntax:\n\n");
+         fprintf (stderr, "   hex2bdf [--font name] [--rows n] ");
+         fprintf (stderr, "[--version string] [--copyright string]\n");
+         fprintf (stderr, "           [input.hex ...] > output.bdf\n\n");
+         exit (EXIT_FAILURE);
+      }
+   }
+
+   if (nfiles == 1 && (ufb = ufb_open (argv[0])) != NULL) {
+      write_header (ufb->nglyphs, font_name, copyright, version, vpixels);
+      while (ufb_gets (ufb, line, sizeof (line))) {
+         glyph.key    = line;
+         glyph.keylen = strchr (line, ':') - line;
+         glyph.codept = strtoul (line, NULL, 16);
+         glyph.bitmap = line + glyph.keylen + 1;
+         glyph.bitlen = strlen (glyph.bitmap) - 1;
+         write_glyph (&glyph, vpixels);
+      }
+      ufb_close (ufb);
+   }
+   else {
+      text   = read_input ("hex2bdf", argv, nfiles, &textlen);
+      glyphs = index_glyphs ("hex2bdf", text, textlen, &nglyphs);
+      write_header (nglyphs, font_name, copyright, version, vpixels);
+      for (n = 0; n < nglyphs; n++)
+         write_glyph (&glyphs[n], vpixels);
+   }
+   write_end ();
+
+   exit (EXIT_SUCCESS);
+}
+
+
+/**
+   @brief Write the output buffer to stdout and empty it.
+*/
+void
+flush_output (void)
+{
+   if (outlen > 0 && fwrite (outbuf, 1, outlen, stdout) != outlen) {
+      fprintf (stderr, "Cannot print to stdout.\n");
+      exit (EXIT_FAILURE);
+   }
+   outlen = 0;
+}
+
+
+/**
+   @brief Append bytes to the output buffer.
+
+   The caller must ensure that the bytes fit; see flush_output.
+
+   @param[in] s The bytes to append.
+   @param[in] len The number of bytes.
+*/
+void
+put_bytes (const char *s, size_t len)
+{
+   memcpy (outbuf + outlen, s, len);
+   outlen += len;
+}
+
+
+/**
+   @brief Append an unsigned decimal number to the output buffer.
+
+   @param[in] value The number to append.
+*/
+void
+put_decimal (unsigned long value)
+{
+   char digits[24];
+   int  n = sizeof (digits);
+
+   do {
+      digits[--n] = '0' + value % 10;
+      value /= 10;
+   } while (value > 0);
+   put_bytes (digits + n, sizeof (digits) - n);
+}
+
+
+/**
+   @brief Write the BDF header to stdout.
+
+   The properties are those the Perl version of hex2bdf wrote.
+
+   @param[in] nglyphs The number of glyphs that will follow.
+   @param[in] font_name The XLFD FAMILY_NAME.
+   @param[in] copyright The COPYRIGHT property.
+   @param[in] version The FONT_VERSION property.
+   @param[in] vpixels The glyph height in pixels.
+*/
+void
+write_header (unsigned long nglyphs, char *font_name, char *copyright,
+              char *version, int vpixels)
+{
+   printf ("STARTFONT 2.1\n");
+   printf ("FONT -gnu-%s-Medium-R-Normal-Sans-%d-%d-75-75-c-80-iso10646-1\n",
+           font_name, vpixels, 10 * vpixels);
+   printf ("SIZE %d 75 75\n", vpixels);
+   printf ("FONTBOUNDINGBOX %d %d 0 -2\n", vpixels, vpixels);
+   printf ("STARTPROPERTIES 24\n");
+   printf ("COPYRIGHT \"%s\"\n", copyright);
+   printf ("FONT_VERSION \"%s\"\n", version);
+   printf ("FONT_TYPE \"Bitmap\"\n");
+   printf ("FOUNDRY \"GNU\"\n");
+   printf ("FAMILY_NAME \"%s\"\n", font_name);
+   printf ("WEIGHT_NAME \"Medium\"\n");
+   printf ("SLANT \"R\"\n");
+   printf ("SETWIDTH_NAME \"Normal\"\n");
+   printf ("ADD_STYLE_NAME \"Sans Serif\"\n");
+   printf ("PIXEL_SIZE %d\n", vpixels);
+   printf ("POINT_SIZE %d\n", 10 * vpixels);
+   printf ("RESOLUTION_X 75\n");
+   printf ("RESOLUTION_Y 75\n");
+   printf ("SPACING \"C\"\n");
+   printf ("AVERAGE_WIDTH 80\n");
+   printf ("CHARSET_REGISTRY \"ISO10646\"\n");
+   printf ("CHARSET_ENCODING \"1\"\n");
+   printf ("UNDERLINE_POSITION -2\n");
+   printf ("UNDERLINE_THICKNESS 1\n");
+   printf ("CAP_HEIGHT 10\n");
+   printf ("X_HEIGHT 8\n");
+   printf ("FONT_ASCENT 14\n");
+   printf ("FONT_DESCENT 2\n");
+   printf ("DEFAULT_CHAR 65533\n");
+   printf ("ENDPROPERTIES\n");
+   printf ("CHARS %lu\n", nglyphs);
+   if (fflush (stdout) != 0) {
+      fprintf (stderr, "Cannot print to stdout.\n");
+      exit (EXIT_FAILURE);
+   }
+}
+
+
+/**
+   @brief Add the BDF record for one glyph to the output buffer.
+
+   @param[in] glyph The glyph to write.
+   @param[in] vpixels The glyph height in pixels.
+*/
+void
+write_glyph (struct Glyph *glyph, int vpixels)
+{
+   int width;      /* hex digits per row                              */
+   int dwidth;     /* device width, in pixels; 1 digit = 4 pixels     */
+   int swidth;     /* scalable width, 1/1000ths of a full-width glyph */
+   int row;
+   char *bits;
+
+   if (glyph->bitlen % vpixels != 0) {
+      fprintf (stderr, "hex2bdf: glyph %.*s is not %d rows high.\n",
+               glyph->keylen, glyph->key, vpixels);
+      exit (EXIT_FAILURE);
+   }
+   width  = glyph->bitlen / vpixels;
+   dwidth = width * 4;
+   swidth = (4000 * width + vpixels / 2) / vpixels;
+
+   if (OUTBUF - outlen < (size_t)(MAXREC + glyph->keylen))
+      flush_output ();
+   put_bytes ("STARTCHAR U+", 12);
+   put_bytes (glyph->key, glyph->keylen);
+   put_bytes ("\nENCODING ", 10);
+   put_decimal (glyph->codept);
+   put_bytes ("\nSWIDTH ", 8);
+   put_decimal (swidth);
+   put_bytes (" 0\nDWIDTH ", 10);
+   put_decimal (dwidth);
+   put_bytes (" 0\nBBX ", 7);
+   put_decimal (dwidth);
+   put_bytes (" ", 1);
+   put_decimal (vpixels);
+   put_bytes (" 0 -2\nBITMAP \n", 14);
+   bits = glyph->bitmap;
+   for (row = 0; row < vpixels; row++) {
+      if (OUTBUF - outlen < (size_t)(width + 1))
+         flush_output ();
+      put_bytes (bits, width);
+      outbuf[outlen++] = '\n';
+      bits += width;
+   }
+   if (OUTBUF - outlen < MAXREC)
+      flush_output ();
+   put_bytes ("ENDCHAR\n", 8);
+}
+
+
+/**
+   @brief Write the end of the BDF font and flush the output.
+*/
+void
+write_end (void)
+{
+   if (OUTBUF - outlen < MAXREC)
+      flush_output ();
+   put_bytes ("ENDFONT\n", 8);
+   flush_output ();
+   if (fflush (stdout) != 0) {
+      fprintf (stderr, "Cannot print to stdout.\n");
+      exit (EXIT_FAILURE);
+   }
+}
@@ -0,0 +1,158 @@
+/**
+    @file hex2otf-outline.h
+
+    @brief hex2otf-outline.h - Outline tracer template for hex2otf.c
+
+    hex2otf.c includes this file once for each supported glyph height,
+    after defining these macros:
+
+        OUTLINE_FUNCTION  Name of the function to define.
+        OUTLINE_HEIGHT    Glyph height and maximum glyph width, in pixels.
+        OUTLINE_ROW_T     Unsigned type with at least OUTLINE_HEIGHT + 1 bits.
+
+    The macros are undefined again at the end of this file.
+
+    @copyright Copyright © 2022 何志翔 (He Zhixiang)
+
+    @author 何志翔 (He Zhixiang)
+*/
+
+/*
+    LICENSE:
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+/**
+    @brief Build a glyph outline for OUTLINE_HEIGHT-row glyphs.
+
+    This function builds a glyph outline from a Unifont glyph bitmap.
+    The row count and row type are compile-time constants, so that
+    the compiler can unroll the row loops for each supported height.
+
+    @param[out] result The resulting glyph outline.
+    @param[in] bitmap A bitmap array.
+    @param[in] byteCount the number of bytes in the input bitmap array.
+    @param[in] fillSide Enumerated indicator to fill left or right side.
+*/
+void
+OUTLINE_FUNCTION (Buffer *result, const byte bitmap[], const size_t byteCount,
+    const enum FillSide fillSide)
+{
+    enum Direction {RIGHT, LEFT, DOWN, UP}; // order is significant
+
+    // respective coordinate deltas
+    const pixels_t dx[] = {1, -1, 0, 0}, dy[] = {0, 0, -1, 1};
+
+    assert (byteCount % OUTLINE_HEIGHT == 0);
+    const uint_fast8_t bytesPerRow = byteCount / OUTLINE_HEIGHT;
+    const pixels_t glyphWidth = bytesPerRow * 8;
+    assert (glyphWidth <= OUTLINE_HEIGHT);
+
+    // must hold one row plus the column to its left
+    typedef OUTLINE_ROW_T row_t;
+
+    row_t pixels[OUTLINE_HEIGHT + 2] = {0};
+    for (pixels_t row = OUTLINE_HEIGHT; row > 0; row--)
+        for (pixels_t b = 0; b < bytesPerRow; b++)
+            pixels[row] = pixels[row] << 8 | *bitmap++;
+    typedef row_t graph_t[OUTLINE_HEIGHT + 1];
+    graph_t vectors[4];
+    const row_t *lower = pixels, *upper = pixels + 1;
+    for (pixels_t row = 0; row <= OUTLINE_HEIGHT; row++)
+    {
+        const row_t m = (fillSide == FILL_RIGHT) - 1;
+        vectors[RIGHT][row] = (m ^ (*lower << 1)) & (~m ^ (*upper << 1));
+        vectors[LEFT ][row] = (m ^ (*upper     )) & (~m ^ (*lower     ));
+        vectors[DOWN ][row] = (m ^ (*lower     )) & (~m ^ (*lower << 1));
+        vectors[UP   ][row] = (m ^ (*upper << 1)) & (~m ^ (*upper     ));
+        lower++;
+        upper++;
+    }
+    graph_t selection = {0};
+    const row_t x0 = (row_t)1 << glyphWidth;
+
+    /// Get the value of a given bit that is in a given row.
+    #define getRowBit(rows, x, y)  ((rows)[(y)] &  x0 >> (x))
+
+    /// Invert the value of a given bit that is in a given row.
+    #define flipRowBit(rows, x, y) ((rows)[(y)] ^= x0 >> (x))
+
+    for (pixels_t y = OUTLINE_HEIGHT; y >= 0; y--)
+    {
+        for (pixels_t x = 0; x <= glyphWidth; x++)
+        {
+            assert (!getRowBit (vectors[LEFT], x, y));
+            assert (!getRowBit (vectors[UP], x, y));
+            enum Direction initial;
+
+            if (getRowBit (vectors[RIGHT], x, y))
+                initial = RIGHT;
+            else if (getRowBit (vectors[DOWN], x, y))
+                initial = DOWN;
+            else
+                continue;
+
+            static_assert ((OUTLINE_HEIGHT + 1) * (OUTLINE_HEIGHT + 1) * 2 <=
+                U16MAX, "potential overflow");
+
+            uint_fast16_t lastPointCount = 0;
+            for (bool converged = false;;)
+            {
+                uint_fast16_t pointCount = 0;
+                enum Direction heading = initial;
+                for (pixels_t tx = x, ty = y;;)
+                {
+                    if (converged)
+                    {
+                        storePixels (result, OP_POINT);
+                        storePixels (result, tx);
+                        storePixels (result, ty);
+                    }
+                    do
+                    {
+                        if (converged)
+                            flipRowBit (vectors[heading], tx, ty);
+                        tx += dx[heading];
+                        ty += dy[heading];
+                    } while (getRowBit (vectors[heading], tx, ty));
+                    if (tx == x && ty == y)
+                        break;
+                    static_assert ((UP ^ DOWN) == 1 && (LEFT ^ RIGHT) == 1,
+                        "wrong enums");
+                    heading = (heading & 2) ^ 2;
+                    heading |= !!getRowBit (selection, tx, ty);
+                    heading ^= !getRowBit (vectors[heading], tx, ty);
+                    assert (getRowBit (vectors[heading], tx, ty));
+                    flipRowBit (selection, tx, ty);
+                    pointCount++;
+                }
+                if (converged)
+                    break;
+                converged = pointCount == lastPointCount;
+                lastPointCount = pointCount;
+            }
+
+            storePixels (result, OP_CLOSE);
+        }
+    }
+    #undef getRowBit
+    #undef flipRowBit
+}
+
+#undef OUTLINE_FUNCTION
+#undef OUTLINE_HEIGHT
+#undef OUTLINE_ROW_T
@@ -36,6 +36,8 @@
     for creators of new or modified glyphs.
 */
 
+#define _POSIX_C_SOURCE 199309L ///< For clock_gettime, used by --stats.
+
 #include <assert.h>
 #include <ctype.h>
 #include <inttypes.h>
@@ -45,8 +47,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "hex2otf.h"
+#include "hangul.h"
+#include "ufb.h"
+#include "unizio.h"
+
+// hangul.h defines MAX_GLYPHS for its PUA glyph range; OpenType's is below.
+#undef MAX_GLYPHS
 
 #define VERSION "1.0.1"  ///< Program version, for "--version" option.
 
@@ -66,20 +75,25 @@
 #define B0(shift) BX((shift), 0)	///< Clear a given bit in a word.
 #define B1(shift) BX((shift), 1)	///< Set   a given bit in a word.
 
-#define GLYPH_MAX_WIDTH 16	///< Maximum glyph width, in pixels.
-#define GLYPH_HEIGHT 16		///< Maximum glyph height, in pixels.
+#define GLYPH_LIMIT 32	///< Largest supported glyph height and width.
+
+#define GLYPH_MAX_WIDTH (geometry.maxWidth)	///< Maximum glyph width, in pixels.
+#define GLYPH_HEIGHT (geometry.height)		///< Glyph height, in pixels.
 
 /// Number of bytes to represent one bitmap glyph as a binary array.
-#define GLYPH_MAX_BYTE_COUNT (GLYPH_HEIGHT * GLYPH_MAX_WIDTH / 8)
+#define GLYPH_MAX_BYTE_COUNT (GLYPH_LIMIT * GLYPH_LIMIT / 8)
 
 /// Count of pixels below baseline.
-#define DESCENDER 2
+#define DESCENDER (geometry.descender)
 
 /// Count of pixels above baseline.
 #define ASCENDER (GLYPH_HEIGHT - DESCENDER)
 
+/// Font units per pixel.
+#define FUPP 4
+
 /// Font units per em.
-#define FUPEM 64
+#define FUPEM (GLYPH_HEIGHT * FUPP)
 
 /// An OpenType font has at most 65536 glyphs.
 #define MAX_GLYPHS 65536
@@ -88,7 +102,10 @@
 #define MAX_NAME_IDS 256
 
 /// Convert pixels to font units.
-#define FU(x) ((x) * FUPEM / GLYPH_HEIGHT)
+#define FU(x) ((x) * FUPP)
+
+/// Convert pixels of a 16-row glyph to font units at the current height.
+#define FU16(x) FU ((x) * GLYPH_HEIGHT / 16)
 
 /// Convert glyph byte count to pixel width.
 #define PW(x) ((x) / (GLYPH_HEIGHT / 8))
@@ -99,6 +116,32 @@ typedef unsigned char byte;
 /// This type must be able to represent max(GLYPH_MAX_WIDTH, GLYPH_HEIGHT).
 typedef int_least8_t pixels_t;
 
+/**
+    @brief Glyph geometry for one supported glyph height.
+
+    Unifont glyphs are 16 rows high; 24- and 32-row fonts use the
+    same .hex format with longer bitmaps.  Glyphs are at most as
+    wide as they are high.
+*/
+typedef struct Geometry
+{
+    pixels_t height;     ///< glyph height, in pixels
+    pixels_t maxWidth;   ///< maximum glyph width, in pixels
+    pixels_t descender;  ///< count of pixels below baseline
+    byte fontMatrix[5];  ///< 1 / FUPEM as a CFF real number operand
+} Geometry;
+
+/// Supported glyph geometries; the first one is the default.
+static const Geometry geometries[] =
+{
+    {16, 16, 2, {0x1e, 0x15, 0x62, 0x5c, 0x6f}}, // 15625e-6 = 1/64
+    {24, 24, 3, {0x1e, 0x10, 0x41, 0x7c, 0x6f}}, // 10417e-6 ~ 1/96
+    {32, 32, 4, {0x1e, 0x78, 0x12, 0x5c, 0x7f}}, // 78125e-7 = 1/128
+};
+
+/// Geometry of the glyphs being converted.
+Geometry geometry;
+
 /**
     @brief Print an error message on stderr, then exit.
 
@@ -134,17 +177,32 @@ typedef struct Buffer
 {
     size_t capacity; // = 0 iff this buffer is free
     byte *begin, *next, *end;
+    size_t initialCapacity; // as requested from newBuffer
+    size_t growCount, copiedBytes; // reallocations, and bytes they moved
 } Buffer;
 
-Buffer *allBuffers; ///< Initial allocation of empty array of buffer pointers.
+/**
+    @brief Allocation totals over all buffers, printed by "--stats".
+
+    Only buffer growth updates these, so counting is always on.
+*/
+struct BufferStats
+{
+    size_t heapBytes;     ///< capacity of all buffers in use
+    size_t peakHeapBytes; ///< largest heapBytes so far
+    size_t growCount;     ///< reallocations of all buffers
+    size_t copiedBytes;   ///< bytes moved by reallocations that moved
+} bufferStats;
+
+Buffer **allBuffers; ///< Initial allocation of empty array of buffer pointers.
 size_t bufferCount;	///< Number of buffers in a Buffer * array.
 size_t nextBufferIndex; ///< Index number to tail element of Buffer * array.
 
 /**
     @brief Initialize an array of buffer pointers to all zeroes.
 
-    This function initializes the "allBuffers" array of buffer
-    pointers to all zeroes.
+    This function initializes the "allBuffers" array with pointers
+    to empty buffers.
 
     @param[in] count The number of buffer array pointers to allocate.
 */
@@ -156,6 +214,9 @@ initBuffers (size_t count)
     allBuffers = calloc (count, sizeof *allBuffers);
     if (!allBuffers)
         fail ("Failed to initialize buffers.");
+    for (size_t i = 0; i < count; i++)
+        if (!(allBuffers[i] = calloc (1, sizeof **allBuffers)))
+            fail ("Failed to initialize buffers.");
     bufferCount = count;
     nextBufferIndex = 0;
 }
@@ -170,8 +231,11 @@ void
 cleanBuffers ()
 {
     for (size_t i = 0; i < bufferCount; i++)
-        if (allBuffers[i].capacity)
-            free (allBuffers[i].begin);
+    {
+        if (allBuffers[i]->capacity)
+            free (allBuffers[i]->begin);
+        free (allBuffers[i]);
+    }
     free (allBuffers);
     bufferCount = 0;
 }
@@ -194,30 +258,37 @@ newBuffer (size_t initialCapacity)
     {
         if (nextBufferIndex == bufferCount)
             nextBufferIndex = 0;
-        if (allBuffers[nextBufferIndex].capacity == 0)
+        if (allBuffers[nextBufferIndex]->capacity == 0)
         {
-            buf = &allBuffers[nextBufferIndex++];
+            buf = allBuffers[nextBufferIndex++];
             break;
         }
     } while (++nextBufferIndex != sentinel);
     if (!buf) // no existing buffer available
     {
-        size_t newSize = sizeof (Buffer) * bufferCount * 2;
+        // Only the array of pointers moves; Buffer pointers stay valid.
+        size_t newSize = sizeof *allBuffers * bufferCount * 2;
         void *extended = realloc (allBuffers, newSize);
         if (!extended)
             fail ("Failed to create new buffers.");
         allBuffers = extended;
-        memset (allBuffers + bufferCount, 0, sizeof (Buffer) * bufferCount);
-        buf = &allBuffers[bufferCount];
+        for (size_t i = bufferCount; i < bufferCount * 2; i++)
+            if (!(allBuffers[i] = calloc (1, sizeof **allBuffers)))
+                fail ("Failed to create new buffers.");
+        buf = allBuffers[bufferCount];
         nextBufferIndex = bufferCount + 1;
         bufferCount *= 2;
     }
     buf->begin = malloc (initialCapacity);
     if (!buf->begin)
         fail ("Failed to allocate %zu bytes of memory.", initialCapacity);
-    buf->capacity = initialCapacity;
+    buf->capacity = buf->initialCapacity = initialCapacity;
     buf->next = buf->begin;
     buf->end = buf->begin + initialCapacity;
+    buf->growCount = buf->copiedBytes = 0;
+    bufferStats.heapBytes += initialCapacity;
+    if (bufferStats.heapBytes > bufferStats.peakHeapBytes)
+        bufferStats.peakHeapBytes = bufferStats.heapBytes;
     return buf;
 }
 
@@ -244,13 +315,25 @@ ensureBuffer (Buffer *buf, size_t needed)
     size_t required = occupied + needed;
     if (required < needed) // overflow
         fail ("Cannot allocate %zu + %zu bytes of memory.", occupied, needed);
+    const size_t oldCapacity = buf->capacity;
     if (required > SIZE_MAX / 2)
         buf->capacity = required;
     else while (buf->capacity < required)
         buf->capacity *= 2;
+    const uintptr_t oldBegin = (uintptr_t)buf->begin;
     void *extended = realloc (buf->begin, buf->capacity);
     if (!extended)
         fail ("Failed to allocate %zu bytes of memory.", buf->capacity);
+    buf->growCount++;
+    bufferStats.growCount++;
+    if ((uintptr_t)extended != oldBegin) // realloc moved the contents
+    {
+        buf->copiedBytes += occupied;
+        bufferStats.copiedBytes += occupied;
+    }
+    bufferStats.heapBytes += buf->capacity - oldCapacity;
+    if (bufferStats.heapBytes > bufferStats.peakHeapBytes)
+        bufferStats.peakHeapBytes = bufferStats.heapBytes;
     buf->begin = extended;
     buf->next = buf->begin + occupied;
     buf->end = buf->begin + buf->capacity;
@@ -337,6 +420,7 @@ void
 freeBuffer (Buffer *buf)
 {
     free (buf->begin);
+    bufferStats.heapBytes -= buf->capacity;
     buf->capacity = 0;
 }
 
@@ -478,7 +562,7 @@ cacheCFFOperand (Buffer *buf, int_fast32_t value)
     }
     else
         assert (false); // other encodings are not used and omitted
-    static_assert (GLYPH_MAX_WIDTH <= 107, "More encodings are needed.");
+    static_assert (FU (GLYPH_LIMIT) <= 1131, "More encodings are needed.");
 }
 
 /**
@@ -630,6 +714,7 @@ typedef struct Font
     Buffer *tables;
     Buffer *glyphs;
     uint_fast32_t glyphCount;
+    uint_fast32_t encodedCount; ///< glyphs from this index on are unencoded
     pixels_t maxWidth;
 } Font;
 
@@ -776,7 +861,8 @@ byTableTag (const void *a, const void *b)
    @brief Write OpenType font to output file.
 
    This function writes the constructed OpenType font to the
-   output file named "filename".
+   output file named "filename", or to standard output if it is "-".
+   A file name ending in ".gz" or ".zst" gives a compressed file.
 
    @param[in] font Pointer to the font, of type Font *.
    @param[in] isCFF Boolean indicating whether the font has CFF data.
@@ -785,7 +871,8 @@ byTableTag (const void *a, const void *b)
 void
 writeFont (Font *font, bool isCFF, const char *fileName)
 {
-    FILE *file = fopen (fileName, "wb");
+    const bool isStdout = strcmp (fileName, "-") == 0;
+    FILE *file = isStdout ? stdout : zio_open (fileName, "wb");
     if (!file)
         fail ("Failed to open file '%s'.", fileName);
     const Table *const tables = getBufferHead (font->tables);
@@ -827,9 +914,8 @@ writeFont (Font *font, bool isCFF, const char *fileName)
             addByte (0)
         }
         #undef addByte
-        cacheZeros (tables[i].content, (~length + 1U) & 3U);
         record->offset = offset;
-        offset += countBufferedBytes (tables[i].content);
+        offset += length + ((~length + 1U) & 3U);
         totalChecksum += record->checksum;
     }
     struct TableRecord *records = getBufferHead (tableRecords);
@@ -874,9 +960,13 @@ writeFont (Font *font, bool isCFF, const char *fileName)
             writeBytes (begin, 8, file);
             writeU32 (0xb1b0afbaU - totalChecksum, file); // checksumAdjustment
             writeBytes (begin + 12, end - (begin + 12), file);
-            continue;
         }
-        writeBuffer (table->content, file);
+        else
+            writeBuffer (table->content, file);
+        // Pad here rather than in the buffer, which may be full.
+        const byte zeros[3] = {0};
+        writeBytes (zeros, (~countBufferedBytes (table->content) + 1U) & 3U,
+            file);
     }
     fclose (file);
 }
@@ -943,6 +1033,42 @@ readCodePoint (uint_fast32_t *codePoint, const char *fileName, FILE *file)
     }
 }
 
+/**
+    @brief Read glyph definitions from a Unifont binary glyph store.
+
+    The glyphs of a .ufb file made by hex2ufb are already packed into
+    bytes, so they are copied without parsing.  They are stored in
+    ascending code point order.
+
+    @param[in,out] font The font data structure to update with new glyphs.
+    @param[in] ufb The mapped .ufb file.
+    @param[in] byteLimit The maximum number of bytes in a glyph.
+*/
+void
+readUfbGlyphs (Font *font, struct Ufb *ufb, uint_fast8_t byteLimit)
+{
+    for (uint_fast32_t codePoint = ufb_next (ufb, 0); codePoint < UFB_END;
+        codePoint = ufb_next (ufb, codePoint + 1))
+    {
+        int digits;
+        const unsigned char *bits = ufb_glyph (ufb, codePoint, &digits);
+        if (!bits)
+            continue;
+        if (digits % 2 != 0 || digits / 2 > byteLimit)
+            fail ("Hex stream of "PRI_CP" is too long.", codePoint);
+        Glyph *glyph = getBufferSlot (font->glyphs, sizeof (Glyph));
+        glyph->codePoint = codePoint;
+        glyph->byteCount = digits / 2;
+        glyph->combining = false;
+        glyph->pos = 0;
+        glyph->lsb = 0;
+        memcpy (glyph->bitmap, bits, glyph->byteCount);
+        if (glyph->byteCount % GLYPH_HEIGHT != 0)
+            fail ("Hex length of "PRI_CP" is indivisible by glyph height %d.",
+                codePoint, GLYPH_HEIGHT);
+    }
+}
+
 /**
     @brief Read glyph definitions from a Unifont .hex format file.
 
@@ -959,37 +1085,60 @@ readCodePoint (uint_fast32_t *codePoint, const char *fileName, FILE *file)
     16 pixels high, and 64 hexadecimal digits long for a glyph that
     is 16 pixels wide by 16 pixels high.
 
+    Glyphs are appended to those read from earlier files; the .notdef
+    glyph is added before the glyphs of the first file.  A file name
+    of "-" reads standard input.  A .ufb file made by hex2ufb can be
+    read in place of a .hex file, and a .hex file can be gzip or zstd
+    compressed.  sortGlyphs must be called after the
+    last file has been read.
+
     @param[in,out] font The font data structure to update with new glyphs.
     @param[in] fileName The name of the Unifont .hex format input file.
+    @return true if the code points in the file are in ascending order.
 */
-void
+bool
 readGlyphs (Font *font, const char *fileName)
 {
-    FILE *file = fopen (fileName, "r");
+    const bool isStdin = strcmp (fileName, "-") == 0;
+    FILE *file = isStdin ? stdin : fopen (fileName, "r");
     if (!file)
         fail ("Failed to open file '%s'.", fileName);
-    uint_fast32_t glyphCount = 1; // for glyph 0
-    uint_fast8_t maxByteCount = 0;
-    { // Hard code the .notdef glyph.
+    if (isStdin)
+        fileName = "<stdin>";
+    const uint_fast8_t byteLimit = GLYPH_HEIGHT * GLYPH_MAX_WIDTH / 8;
+    if (countBufferedBytes (font->glyphs) == 0)
+    { // Hard code the .notdef glyph, centered vertically in taller glyphs.
         const byte bitmap[] = "\0\0\0~fZZzvv~vv~\0\0"; // same as U+FFFD
-        const size_t byteCount = sizeof bitmap - 1;
-        assert (byteCount <= GLYPH_MAX_BYTE_COUNT);
-        assert (byteCount % GLYPH_HEIGHT == 0);
+        const size_t rowCount = sizeof bitmap - 1;
+        assert (rowCount <= (size_t)GLYPH_HEIGHT);
         Glyph *notdef = getBufferSlot (font->glyphs, sizeof (Glyph));
-        memcpy (notdef->bitmap, bitmap, byteCount);
-        notdef->byteCount = maxByteCount = byteCount;
+        memset (notdef->bitmap, 0, GLYPH_HEIGHT);
+        memcpy (notdef->bitmap + (GLYPH_HEIGHT - rowCount) / 2, bitmap,
+            rowCount);
+        notdef->byteCount = GLYPH_HEIGHT;
         notdef->combining = false;
         notdef->pos = 0;
         notdef->lsb = 0;
     }
+    struct Ufb *ufb = ufb_fdopen (fileno (file), fileName);
+    if (ufb)
+    {
+        readUfbGlyphs (font, ufb, byteLimit);
+        ufb_close (ufb);
+        if (!isStdin)
+            fclose (file);
+        return true;
+    }
+    file = zio_wrap (file, fileName);
+    bool sorted = true;
+    uint_fast32_t previous = 0;
     for (;;)
     {
         uint_fast32_t codePoint;
         if (readCodePoint (&codePoint, fileName, file))
             break;
-        if (++glyphCount > MAX_GLYPHS)
-            fail ("OpenType does not support more than %lu glyphs.",
-                MAX_GLYPHS);
+        sorted = sorted && codePoint >= previous;
+        previous = codePoint;
         Glyph *glyph = getBufferSlot (font->glyphs, sizeof (Glyph));
         glyph->codePoint = codePoint;
         glyph->byteCount = 0;
@@ -1001,7 +1150,7 @@ readGlyphs (Font *font, const char *fileName)
             int h, l;
             if (isxdigit (h = getc (file)) && isxdigit (l = getc (file)))
             {
-                if (++glyph->byteCount > GLYPH_MAX_BYTE_COUNT)
+                if (++glyph->byteCount > byteLimit)
                     fail ("Hex stream of "PRI_CP" is too long.", codePoint);
                 *p = nibbleValue (h) << 4 | nibbleValue (l);
             }
@@ -1015,14 +1164,10 @@ readGlyphs (Font *font, const char *fileName)
         if (glyph->byteCount % GLYPH_HEIGHT != 0)
             fail ("Hex length of "PRI_CP" is indivisible by glyph height %d.",
                 codePoint, GLYPH_HEIGHT);
-        if (glyph->byteCount > maxByteCount)
-            maxByteCount = glyph->byteCount;
     }
-    if (glyphCount == 1)
-        fail ("No glyph is specified.");
-    font->glyphCount = glyphCount;
-    font->maxWidth = PW (maxByteCount);
-    fclose (file);
+    if (file != stdin)
+        fclose (file);
+    return sorted;
 }
 
 /**
@@ -1061,7 +1206,7 @@ void
 positionGlyphs (Font *font, const char *fileName, pixels_t *xMin)
 {
     *xMin = 0;
-    FILE *file = fopen (fileName, "r");
+    FILE *file = zio_open (fileName, "r");
     if (!file)
         fail ("Failed to open file '%s'.", fileName);
     Glyph *glyphs = getBufferHead (font->glyphs);
@@ -1106,28 +1251,350 @@ positionGlyphs (Font *font, const char *fileName, pixels_t *xMin)
     fclose (file);
 }
 
+/**
+    @brief What to do with glyphs that have the same code point.
+*/
+enum DuplicatePolicy
+{
+    DUPLICATES_ERROR, ///< Fail with an error message.
+    DUPLICATES_FIRST, ///< Keep the glyph that was read first.
+    DUPLICATES_LAST   ///< Keep the glyph that was read last.
+};
+
+/**
+    @brief Merge sorted runs of glyphs by code point.
+
+    Each input file forms one run.  Runs are few, so the run with the
+    smallest next code point is found by a linear scan.  Ties go to
+    the earlier run, so glyphs keep the order in which they were read.
+
+    @param[in] font The font with glyphs to merge.
+    @param[in] ends Glyph index after each run; the first run starts at 1.
+    @param[in] runCount The number of runs.
+    @param[out] order Receives glyph indices in merged order.
+*/
+void
+mergeGlyphRuns (const Font *font, const size_t ends[], size_t runCount,
+    Buffer *order)
+{
+    const Glyph *const glyphs = getBufferHead (font->glyphs);
+    Buffer *headBuffer = newBuffer (sizeof (size_t) * runCount);
+    size_t *heads = getBufferSlot (headBuffer, sizeof (size_t) * runCount);
+    for (size_t r = 0; r < runCount; r++)
+        heads[r] = r > 0 ? ends[r - 1] : 1;
+    for (;;)
+    {
+        size_t best = runCount;
+        for (size_t r = 0; r < runCount; r++)
+            if (heads[r] < ends[r] && (best == runCount ||
+                glyphs[heads[r]].codePoint < glyphs[heads[best]].codePoint))
+                best = r;
+        if (best == runCount)
+            break;
+        storeU32 (order, heads[best]++);
+    }
+    freeBuffer (headBuffer);
+}
+
+/**
+    @brief Sort glyphs by code point with a stable radix sort.
+
+    Each key holds a code point above a glyph index, and is sorted
+    8 bits at a time over the 24 bits a code point can have.  Passes
+    in which every code point has the same digit are skipped, so
+    Plane 0 fonts take two passes.
+
+    @param[in] font The font with glyphs to sort.
+    @param[out] order Receives glyph indices in sorted order.
+*/
+void
+radixSortGlyphs (const Font *font, Buffer *order)
+{
+    const Glyph *const glyphs = getBufferHead (font->glyphs);
+    const size_t count = countBufferedBytes (font->glyphs) / sizeof *glyphs;
+    const size_t keyCount = count - 1; // glyph 0 is not sorted
+    Buffer *keyBuffer = newBuffer (sizeof (uint_least64_t) * keyCount * 2);
+    uint_least64_t *keys =
+        getBufferSlot (keyBuffer, sizeof (uint_least64_t) * keyCount * 2);
+    uint_least64_t *sorted = keys + keyCount;
+    for (size_t i = 0; i < keyCount; i++)
+        keys[i] = (uint_least64_t)glyphs[i + 1].codePoint << 32 | (i + 1);
+    for (int shift = 32; shift < 56; shift += 8)
+    {
+        size_t starts[257] = {0};
+        for (size_t i = 0; i < keyCount; i++)
+            starts[(keys[i] >> shift & 0xff) + 1]++;
+        bool trivial = false;
+        for (int d = 1; d <= 256; d++)
+            trivial = trivial || starts[d] == keyCount;
+        if (trivial)
+            continue;
+        for (int d = 1; d <= 256; d++)
+            starts[d] += starts[d - 1];
+        for (size_t i = 0; i < keyCount; i++)
+            sorted[starts[keys[i] >> shift & 0xff]++] = keys[i];
+        uint_least64_t *t = keys;
+        keys = sorted;
+        sorted = t;
+    }
+    for (size_t i = 0; i < keyCount; i++)
+        storeU32 (order, keys[i] & U32MAX);
+    freeBuffer (keyBuffer);
+}
+
 /**
     @brief Sort the glyphs in a font by Unicode code point.
 
-    This function reads in an array of glyphs and sorts them
-    by Unicode code point.  If a duplicate code point is encountered,
-    that will result in a fatal error with an error message to stderr.
+    Glyphs read from each input file form one run after glyph 0.
+    If every run is sorted, the runs are merged; a single sorted run
+    is left in place.  Otherwise, all glyphs are radix sorted.  Both
+    keep glyphs with the same code point in the order they were read,
+    so that all but the first or the last of them can be dropped.
 
     @param[in,out] font Pointer to a Font structure with glyphs to sort.
+    @param[in] runEnds Glyph index after each input file, as size_t.
+    @param[in] sorted Whether the glyphs of every input file are sorted.
+    @param[in] duplicates What to do with glyphs of the same code point.
 */
 void
-sortGlyphs (Font *font)
+sortGlyphs (Font *font, const Buffer *runEnds, bool sorted,
+    enum DuplicatePolicy duplicates)
 {
-    Glyph *glyphs = getBufferHead (font->glyphs);
+    const size_t count = countBufferedBytes (font->glyphs) / sizeof (Glyph);
+    const size_t *const ends = getBufferHead (runEnds);
+    const size_t runCount = countBufferedBytes (runEnds) / sizeof *ends;
+    if (count > 2 && !(sorted && runCount == 1))
+    {
+        Buffer *order = newBuffer (sizeof (uint_least32_t) * count);
+        if (sorted)
+            mergeGlyphRuns (font, ends, runCount, order);
+        else
+            radixSortGlyphs (font, order);
+        const Glyph *const glyphs = getBufferHead (font->glyphs);
+        Buffer *sortedGlyphs = newBuffer (sizeof (Glyph) * count);
+        *(Glyph *)getBufferSlot (sortedGlyphs, sizeof (Glyph)) = glyphs[0];
+        const uint_least32_t *const indicesEnd = getBufferTail (order);
+        for (const uint_least32_t *i = getBufferHead (order);
+            i < indicesEnd; i++)
+            *(Glyph *)getBufferSlot (sortedGlyphs, sizeof (Glyph)) =
+                glyphs[*i];
+        freeBuffer (order);
+        freeBuffer (font->glyphs);
+        font->glyphs = sortedGlyphs;
+    }
+    Glyph *const glyphs = getBufferHead (font->glyphs);
     const Glyph *const glyphsEnd = getBufferTail (font->glyphs);
-    glyphs++; // glyph 0 does not need sorting
-    qsort (glyphs, glyphsEnd - glyphs, sizeof *glyphs, byCodePoint);
-    for (const Glyph *glyph = glyphs; glyph < glyphsEnd - 1; glyph++)
+    Glyph *kept = glyphs; // last glyph kept so far
+    uint_fast8_t maxByteCount = glyphs[0].byteCount;
+    for (const Glyph *glyph = glyphs + 1; glyph < glyphsEnd; glyph++)
+    {
+        if (kept > glyphs && glyph->codePoint == kept->codePoint)
+        {
+            if (duplicates == DUPLICATES_ERROR)
+                fail ("Duplicate code point: "PRI_CP".", glyph->codePoint);
+            if (duplicates == DUPLICATES_LAST)
+                *kept = *glyph;
+            continue;
+        }
+        assert (kept == glyphs || kept->codePoint < glyph->codePoint);
+        if (++kept != glyph)
+            *kept = *glyph;
+    }
+    const uint_fast32_t glyphCount = kept + 1 - glyphs;
+    if (glyphCount == 1)
+        fail ("No glyph is specified.");
+    if (glyphCount > MAX_GLYPHS)
+        fail ("OpenType does not support more than %lu glyphs.", MAX_GLYPHS);
+    font->glyphs->next = (byte *)(kept + 1); // drop duplicates
+    for (const Glyph *glyph = glyphs; glyph <= kept; glyph++)
+        if (glyph->byteCount > maxByteCount)
+            maxByteCount = glyph->byteCount;
+    font->glyphCount = font->encodedCount = glyphCount;
+    font->maxWidth = PW (maxByteCount);
+}
+
+/**
+    @brief Position of a conjoining jamo within a Hangul syllable.
+*/
+enum JamoPosition {
+    JAMO_CHO,    ///< Initial consonant (choseong), feature 'ljmo'.
+    JAMO_JUNG,   ///< Medial vowel (jungseong), feature 'vjmo'.
+    JAMO_JONG,   ///< Final consonant (jongseong), feature 'tjmo'.
+    JAMO_NONE    ///< Not a conjoining jamo.
+};
+
+/**
+    @brief Data structure for one encoded jamo and its variant glyphs.
+
+    Each conjoining jamo in the font gets a set of unencoded glyphs,
+    one for each Johab 6/3/1 variation in hangul-base.hex.  A jongseong
+    has two: its jong_variation glyph and the same glyph shifted right
+    by one column, for vowels with a wide right vertical stroke.
+*/
+typedef struct Jamo
+{
+    uint_least16_t glyph; ///< glyph index of the encoded jamo
+    int_least16_t letter; ///< letter number, as used by hangul.h
+    uint_least16_t variants[CHO_VARIATIONS]; ///< variant glyph indices
+} Jamo;
+
+/**
+    @brief Conjoining jamo in a font, grouped by syllable position.
+
+    Each buffer is an array of Jamo sorted by glyph index.
+*/
+typedef struct JamoSet
+{
+    Buffer *positions[JAMO_NONE];
+} JamoSet;
+
+/**
+    @brief Find the syllable position and letter number of a jamo.
+
+    Letter numbers count the Hangul Jamo block first and then the
+    Hangul Jamo Extended-A or Extended-B letters, as in hangul.h.
+
+    @param[in] codePoint The Unicode code point to classify.
+    @param[out] letter The letter number, if a conjoining jamo.
+    @return The syllable position, or JAMO_NONE.
+*/
+enum JamoPosition
+jamoPosition (uint_fast32_t codePoint, int *letter)
+{
+    if (codePoint >= CHO_UNICODE_START && codePoint <= CHO_UNICODE_END)
+        *letter = codePoint - CHO_UNICODE_START;
+    else if (codePoint >= CHO_EXTA_UNICODE_START &&
+             codePoint <= CHO_EXTA_UNICODE_END)
+        *letter = codePoint - CHO_EXTA_UNICODE_START +
+                  NCHO_MODERN + NCHO_ANCIENT;
+    else if (codePoint >= JUNG_UNICODE_START && codePoint <= JUNG_UNICODE_END)
+    {
+        *letter = codePoint - JUNG_UNICODE_START;
+        return JAMO_JUNG;
+    }
+    else if (codePoint >= JUNG_EXTB_UNICODE_START &&
+             codePoint <= JUNG_EXTB_UNICODE_END)
+    {
+        *letter = codePoint - JUNG_EXTB_UNICODE_START +
+                  NJUNG_MODERN + NJUNG_ANCIENT;
+        return JAMO_JUNG;
+    }
+    else if (codePoint >= JONG_UNICODE_START && codePoint <= JONG_UNICODE_END)
+    {
+        *letter = codePoint - JONG_UNICODE_START;
+        return JAMO_JONG;
+    }
+    else if (codePoint >= JONG_EXTB_UNICODE_START &&
+             codePoint <= JONG_EXTB_UNICODE_END)
+    {
+        *letter = codePoint - JONG_EXTB_UNICODE_START +
+                  NJONG_MODERN + NJONG_ANCIENT;
+        return JAMO_JONG;
+    }
+    else
+        return JAMO_NONE;
+    return JAMO_CHO;
+}
+
+/**
+    @brief Append one unencoded jamo variant glyph to a font.
+
+    Choseong variants advance by a full cell.  Jungseong and jongseong
+    variants have zero advance and are moved left by a full cell, so
+    that they are drawn over the preceding choseong.
+
+    @param[in,out] font The font to which the glyph is appended.
+    @param[in] rows The 16 rows of the 16-pixel-wide variant glyph.
+    @param[in] overlay true for jungseong and jongseong variants.
+    @return The glyph index of the new glyph.
+*/
+uint_fast16_t
+addJamoVariant (Font *font, const unsigned rows[16], bool overlay)
+{
+    if (font->glyphCount >= MAX_GLYPHS)
+        fail ("OpenType does not support more than %lu glyphs.", MAX_GLYPHS);
+    Glyph *glyph = getBufferSlot (font->glyphs, sizeof (Glyph));
+    glyph->codePoint = 0; // unencoded
+    glyph->byteCount = 2 * GLYPH_HEIGHT;
+    for (int i = 0; i < GLYPH_HEIGHT; i++)
     {
-        if (glyph[0].codePoint == glyph[1].codePoint)
-            fail ("Duplicate code point: "PRI_CP".", glyph[0].codePoint);
-        assert (glyph[0].codePoint < glyph[1].codePoint);
+        glyph->bitmap[2 * i] = rows[i] >> 8 & 0xff;
+        glyph->bitmap[2 * i + 1] = rows[i] & 0xff;
     }
+    glyph->combining = overlay;
+    glyph->pos = overlay ? -GLYPH_MAX_WIDTH : 0;
+    glyph->lsb = glyph->pos;
+    return font->glyphCount++;
+}
+
+/**
+    @brief Add conjoining jamo variant glyphs from a Hangul base file.
+
+    For every Hangul jamo in the font, this function reads all of its
+    Johab 6/3/1 variations from a hangul-base.hex file and appends them
+    to the font as unencoded glyphs.  The 'ljmo', 'vjmo' and 'tjmo'
+    features in the GSUB table later select among them, so that Old
+    Hangul syllables are composed at layout time instead of being
+    precomposed.
+
+    N.B.: Glyphs must be sorted and positioned before calling this function.
+
+    @param[in,out] font The font to which variant glyphs are added.
+    @param[in] fileName Name of the hangul-base.hex file.
+    @param[in,out] xMin Minimum x-axis value (for left side bearing).
+    @param[out] jamo The jamo found in the font, with their variants.
+*/
+void
+addJamoGlyphs (Font *font, const char *fileName, pixels_t *xMin,
+    JamoSet *jamo)
+{
+    FILE *file = zio_open (fileName, "r");
+    if (!file)
+        fail ("Failed to open file '%s'.", fileName);
+    unsigned (*base)[16] = calloc (PUA_END - PUA_START + 1, sizeof *base);
+    if (!base)
+        fail ("Failed to allocate memory for Hangul base glyphs.");
+    hangul_read_base16 (file, base);
+    fclose (file);
+    for (int i = 0; i < JAMO_NONE; i++)
+        jamo->positions[i] = newBuffer (sizeof (Jamo) * 128);
+    const uint_fast32_t encodedCount = font->glyphCount;
+    for (uint_fast32_t i = 1; i < encodedCount; i++)
+    {
+        const Glyph *glyphs = getBufferHead (font->glyphs);
+        int letter;
+        const enum JamoPosition position =
+            jamoPosition (glyphs[i].codePoint, &letter);
+        if (position == JAMO_NONE)
+            continue;
+        Jamo *j = getBufferSlot (jamo->positions[position], sizeof (Jamo));
+        j->glyph = i;
+        j->letter = letter;
+        if (position == JAMO_CHO)
+            for (int v = 0; v < CHO_VARIATIONS; v++)
+                j->variants[v] = addJamoVariant (font,
+                    base[CHO_HEX + letter * CHO_VARIATIONS + v], false);
+        else if (position == JAMO_JUNG)
+            for (int v = 0; v < JUNG_VARIATIONS; v++)
+                j->variants[v] = addJamoVariant (font,
+                    base[JUNG_HEX + letter * JUNG_VARIATIONS + v], true);
+        else
+        {
+            const unsigned *rows = base[JONG_HEX + letter * JONG_VARIATIONS +
+                                        jong_variation (0, 0, letter)];
+            unsigned shifted[16];
+            for (int k = 0; k < 16; k++)
+                shifted[k] = rows[k] >> 1;
+            j->variants[0] = addJamoVariant (font, rows, true);
+            j->variants[1] = addJamoVariant (font, shifted, true);
+        }
+    }
+    free (base);
+    if (font->glyphCount > encodedCount && font->maxWidth < GLYPH_MAX_WIDTH)
+        font->maxWidth = GLYPH_MAX_WIDTH;
+    if (countBufferedBytes (jamo->positions[JAMO_JUNG]) +
+        countBufferedBytes (jamo->positions[JAMO_JONG]) > 0)
+        *xMin = -GLYPH_MAX_WIDTH;
 }
 
 /**
@@ -1146,10 +1613,26 @@ enum FillSide {
     FILL_RIGHT    ///< Draw outline clockwise (TrueType).
 };
 
+#define OUTLINE_FUNCTION buildOutline16
+#define OUTLINE_HEIGHT 16
+#define OUTLINE_ROW_T uint_fast32_t
+#include "hex2otf-outline.h"
+
+#define OUTLINE_FUNCTION buildOutline24
+#define OUTLINE_HEIGHT 24
+#define OUTLINE_ROW_T uint_fast32_t
+#include "hex2otf-outline.h"
+
+#define OUTLINE_FUNCTION buildOutline32
+#define OUTLINE_HEIGHT 32
+#define OUTLINE_ROW_T uint_fast64_t
+#include "hex2otf-outline.h"
+
 /**
     @brief Build a glyph outline.
 
-    This function builds a glyph outline from a Unifont glyph bitmap.
+    This function builds a glyph outline from a Unifont glyph bitmap,
+    using the tracer specialised for the current glyph height.
 
     @param[out] result The resulting glyph outline.
     @param[in] bitmap A bitmap array.
@@ -1160,110 +1643,20 @@ void
 buildOutline (Buffer *result, const byte bitmap[], const size_t byteCount,
     const enum FillSide fillSide)
 {
-    enum Direction {RIGHT, LEFT, DOWN, UP}; // order is significant
-
-    // respective coordinate deltas
-    const pixels_t dx[] = {1, -1, 0, 0}, dy[] = {0, 0, -1, 1};
-
-    assert (byteCount % GLYPH_HEIGHT == 0);
-    const uint_fast8_t bytesPerRow = byteCount / GLYPH_HEIGHT;
-    const pixels_t glyphWidth = bytesPerRow * 8;
-    assert (glyphWidth <= GLYPH_MAX_WIDTH);
-
-    #if GLYPH_MAX_WIDTH < 32
-        typedef uint_fast32_t row_t;
-    #elif GLYPH_MAX_WIDTH < 64
-        typedef uint_fast64_t row_t;
-    #else
-        #error GLYPH_MAX_WIDTH is too large.
-    #endif
-
-    row_t pixels[GLYPH_HEIGHT + 2] = {0};
-    for (pixels_t row = GLYPH_HEIGHT; row > 0; row--)
-        for (pixels_t b = 0; b < bytesPerRow; b++)
-            pixels[row] = pixels[row] << 8 | *bitmap++;
-    typedef row_t graph_t[GLYPH_HEIGHT + 1];
-    graph_t vectors[4];
-    const row_t *lower = pixels, *upper = pixels + 1;
-    for (pixels_t row = 0; row <= GLYPH_HEIGHT; row++)
+    switch (GLYPH_HEIGHT)
     {
-        const row_t m = (fillSide == FILL_RIGHT) - 1;
-        vectors[RIGHT][row] = (m ^ (*lower << 1)) & (~m ^ (*upper << 1));
-        vectors[LEFT ][row] = (m ^ (*upper     )) & (~m ^ (*lower     ));
-        vectors[DOWN ][row] = (m ^ (*lower     )) & (~m ^ (*lower << 1));
-        vectors[UP   ][row] = (m ^ (*upper << 1)) & (~m ^ (*upper     ));
-        lower++;
-        upper++;
-    }
-    graph_t selection = {0};
-    const row_t x0 = (row_t)1 << glyphWidth;
-
-    /// Get the value of a given bit that is in a given row.
-    #define getRowBit(rows, x, y)  ((rows)[(y)] &  x0 >> (x))
-
-    /// Invert the value of a given bit that is in a given row.
-    #define flipRowBit(rows, x, y) ((rows)[(y)] ^= x0 >> (x))
-
-    for (pixels_t y = GLYPH_HEIGHT; y >= 0; y--)
-    {
-        for (pixels_t x = 0; x <= glyphWidth; x++)
-        {
-            assert (!getRowBit (vectors[LEFT], x, y));
-            assert (!getRowBit (vectors[UP], x, y));
-            enum Direction initial;
-
-            if (getRowBit (vectors[RIGHT], x, y))
-                initial = RIGHT;
-            else if (getRowBit (vectors[DOWN], x, y))
-                initial = DOWN;
-            else
-                continue;
-
-            static_assert ((GLYPH_MAX_WIDTH + 1) * (GLYPH_HEIGHT + 1) * 2 <=
-                U16MAX, "potential overflow");
-
-            uint_fast16_t lastPointCount = 0;
-            for (bool converged = false;;)
-            {
-                uint_fast16_t pointCount = 0;
-                enum Direction heading = initial;
-                for (pixels_t tx = x, ty = y;;)
-                {
-                    if (converged)
-                    {
-                        storePixels (result, OP_POINT);
-                        storePixels (result, tx);
-                        storePixels (result, ty);
-                    }
-                    do
-                    {
-                        if (converged)
-                            flipRowBit (vectors[heading], tx, ty);
-                        tx += dx[heading];
-                        ty += dy[heading];
-                    } while (getRowBit (vectors[heading], tx, ty));
-                    if (tx == x && ty == y)
-                        break;
-                    static_assert ((UP ^ DOWN) == 1 && (LEFT ^ RIGHT) == 1,
-                        "wrong enums");
-                    heading = (heading & 2) ^ 2;
-                    heading |= !!getRowBit (selection, tx, ty);
-                    heading ^= !getRowBit (vectors[heading], tx, ty);
-                    assert (getRowBit (vectors[heading], tx, ty));
-                    flipRowBit (selection, tx, ty);
-                    pointCount++;
-                }
-                if (converged)
-                    break;
-                converged = pointCount == lastPointCount;
-                lastPointCount = pointCount;
-            }
-
-            storePixels (result, OP_CLOSE);
-        }
+        case 16:
+            buildOutline16 (result, bitmap, byteCount, fillSide);
+            break;
+        case 24:
+            buildOutline24 (result, bitmap, byteCount, fillSide);
+            break;
+        case 32:
+            buildOutline32 (result, bitmap, byteCount, fillSide);
+            break;
+        default:
+            assert (false);
     }
-    #undef getRowBit
-    #undef flipRowBit
 }
 
 /**
@@ -1336,8 +1729,8 @@ fillCFF (Font *font, int version, const NameStrings names)
     /// Use fixed width integer for variables to simplify offset calculation.
     #define cacheCFF32(buf, x) (cacheU8 ((buf), 29), cacheU32 ((buf), (x)))
 
-    // In Unifont, 16px glyphs are more common. This is used by CFF1 only.
-    const pixels_t defaultWidth = 16, nominalWidth = 8;
+    // In Unifont, full-width glyphs are more common. This is used by CFF1 only.
+    const pixels_t defaultWidth = GLYPH_HEIGHT, nominalWidth = GLYPH_HEIGHT / 2;
     if (version == 1)
     {
         Buffer *strings = prepareStringIndex (names);
@@ -1346,8 +1739,13 @@ fillCFF (Font *font, int version, const NameStrings names)
         assert (cffName);
         size_t nameLength = strlen (cffName);
         size_t namesSize = nameLength + 5;
+        // Width operands take 1 byte up to 107 and 2 bytes up to 1131.
+        static_assert (FU (GLYPH_LIMIT) <= 1131, "wrong Private size");
+        size_t privateSize = 2 + (FU (defaultWidth) > 107 ? 2 : 1)
+                               + (FU (nominalWidth) > 107 ? 2 : 1);
         // These sizes must be updated together with the data below.
-        size_t offsets[] = {4, namesSize, 45, stringsSize, 2, 5, 8, 32, 4, 0};
+        size_t offsets[] =
+            {4, namesSize, 45, stringsSize, 2, 5, 8, 32, privateSize, 0};
         prepareOffsets (offsets);
         { // Header
             cacheU8 (cff, 1); // major
@@ -1418,11 +1816,11 @@ fillCFF (Font *font, int version, const NameStrings names)
             cacheCFFOperand (cff, 393);
             cacheBytes (cff, (byte[]){12, 38}, 2); // FontName
             // Windows requires FontMatrix in Font DICT.
-            const byte unit[] = {0x1e,0x15,0x62,0x5c,0x6f}; // 1/64 (0.015625)
-            cacheBytes (cff, unit, sizeof unit);
+            const byte *unit = geometry.fontMatrix; // 1 / FUPEM
+            cacheBytes (cff, unit, sizeof geometry.fontMatrix);
             cacheCFFOperand (cff, 0);
             cacheCFFOperand (cff, 0);
-            cacheBytes (cff, unit, sizeof unit);
+            cacheBytes (cff, unit, sizeof geometry.fontMatrix);
             cacheCFFOperand (cff, 0);
             cacheCFFOperand (cff, 0);
             cacheBytes (cff, (byte[]){12, 7}, 2); // FontMatrix
@@ -1453,11 +1851,11 @@ fillCFF (Font *font, int version, const NameStrings names)
         }
         assert (countBufferedBytes (cff) == offsets[0]);
         { // Top DICT
-            const byte unit[] = {0x1e,0x15,0x62,0x5c,0x6f}; // 1/64 (0.015625)
-            cacheBytes (cff, unit, sizeof unit);
+            const byte *unit = geometry.fontMatrix; // 1 / FUPEM
+            cacheBytes (cff, unit, sizeof geometry.fontMatrix);
             cacheCFFOperand (cff, 0);
             cacheCFFOperand (cff, 0);
-            cacheBytes (cff, unit, sizeof unit);
+            cacheBytes (cff, unit, sizeof geometry.fontMatrix);
             cacheCFFOperand (cff, 0);
             cacheCFFOperand (cff, 0);
             cacheBytes (cff, (byte[]){12, 7}, 2); // FontMatrix
@@ -1713,6 +2111,70 @@ fillBlankOutline (Font *font)
         cacheU16 (loca, countBufferedBytes (glyf) / 2); // offsets[i]
 }
 
+/**
+    @brief Find glyphs whose bitmaps duplicate an earlier glyph's bitmap.
+
+    Bitmaps are hashed into an open-addressing table, so that every
+    glyph is compared only against glyphs with the same hash.
+
+    @param[in] font Pointer to a Font struct with the glyphs to examine.
+    @return A buffer with one uint_least16_t per glyph: the index of the
+            first glyph with an identical bitmap (itself, if unique).
+*/
+Buffer *
+findDuplicateBitmaps (const Font *font)
+{
+    const Glyph *const glyphs = getBufferHead (font->glyphs);
+    Buffer *canonical = newBuffer (2 * font->glyphCount);
+    size_t slotCount = 1;
+    while (slotCount < 2 * font->glyphCount)
+        slotCount <<= 1;
+    uint_least32_t *slots = calloc (slotCount, sizeof *slots); // index + 1
+    if (!slots)
+        fail ("Failed to allocate memory for bitmap hashes.");
+    for (uint_fast32_t i = 0; i < font->glyphCount; i++)
+    {
+        const Glyph *glyph = &glyphs[i];
+        uint_fast32_t hash = 2166136261U; // FNV-1a
+        hash = ((hash ^ glyph->byteCount) * 16777619U) & U32MAX;
+        for (uint_fast8_t k = 0; k < glyph->byteCount; k++)
+            hash = ((hash ^ glyph->bitmap[k]) * 16777619U) & U32MAX;
+        size_t slot = hash & (slotCount - 1);
+        for (; slots[slot]; slot = (slot + 1) & (slotCount - 1))
+        {
+            const Glyph *other = &glyphs[slots[slot] - 1];
+            if (other->byteCount == glyph->byteCount &&
+                memcmp (other->bitmap, glyph->bitmap, glyph->byteCount) == 0)
+                break;
+        }
+        if (!slots[slot])
+            slots[slot] = i + 1;
+        storeU16 (canonical, slots[slot] - 1);
+    }
+    free (slots);
+    return canonical;
+}
+
+/**
+    @brief Cache the big glyph metrics of a bitmap glyph.
+
+    @param[in,out] buf The buffer to which the metrics are appended.
+    @param[in] glyph The glyph whose metrics are cached.
+*/
+void
+cacheBigMetrics (Buffer *buf, const Glyph *glyph)
+{
+    cacheU8 (buf, GLYPH_HEIGHT); // height
+    const uint_fast8_t width = PW (glyph->byteCount);
+    cacheU8 (buf, width); // width
+    cacheU8 (buf, glyph->pos); // horiBearingX
+    cacheU8 (buf, ASCENDER); // horiBearingY
+    cacheU8 (buf, glyph->combining ? 0 : width); // horiAdvance
+    cacheU8 (buf, 0); // vertBearingX
+    cacheU8 (buf, 0); // vertBearingY
+    cacheU8 (buf, GLYPH_HEIGHT); // vertAdvance
+}
+
 /**
     @brief Fill OpenType bitmap data and location tables.
 
@@ -1722,6 +2184,14 @@ fillBlankOutline (Font *font)
     in OpenType fonts.  No Embedded Bitmap Scaling (EBSC) table
     is used for the bitmap glyphs, only EBDT and EBLC.
 
+    Glyphs with equal size and metrics are grouped into ranges that
+    store their bitmaps back to back (index format 2, image format 5).
+    A run of glyphs whose bitmaps already appear earlier in the font
+    is instead stored as a range of composite images (index format 3
+    or 1, image format 9), each holding only its metrics and a
+    reference to the first glyph with that bitmap.  A run is only
+    converted if that is smaller than storing its bitmaps again.
+
     @param[in,out] font Pointer to a Font struct in which to add bitmaps.
 */
 void
@@ -1729,9 +2199,41 @@ fillBitmap (Font *font)
 {
     const Glyph *const glyphs = getBufferHead (font->glyphs);
     const Glyph *const glyphsEnd = getBufferTail (font->glyphs);
+    Buffer *duplicates = findDuplicateBitmaps (font);
+    const uint_least16_t *const canonical = getBufferHead (duplicates);
+
+    /// Size of a composite image with one component (image format 9).
+    #define COMPOSITE_SIZE (8 + 2 + 4)
+
+    // Mark runs of duplicates that are cheaper to store as composites.
+    Buffer *sharedFlags = newBuffer (sizeof (bool) * font->glyphCount);
+    bool *const shared =
+        getBufferSlot (sharedFlags, sizeof (bool) * font->glyphCount);
+    memset (shared, false, sizeof (bool) * font->glyphCount);
     size_t bitmapsSize = 0;
-    for (const Glyph *glyph = glyphs; glyph < glyphsEnd; glyph++)
-        bitmapsSize += glyph->byteCount;
+    for (uint_fast32_t i = 0; i < font->glyphCount;)
+    {
+        if (canonical[i] == i)
+        {
+            bitmapsSize += glyphs[i++].byteCount;
+            continue;
+        }
+        uint_fast32_t end = i;
+        size_t saved = 0;
+        for (; end < font->glyphCount && canonical[end] != end; end++)
+            saved += glyphs[end].byteCount;
+        const uint_fast32_t n = end - i;
+        // IndexSubTableArray entry, format 3 header, offsets and padding,
+        // composite images, and the extra range after the run.
+        const size_t cost = 8 + 8 + (2 * (n + 1) + 3) / 4 * 4 +
+                            COMPOSITE_SIZE * n + 8 + 20;
+        const bool convert = saved > cost;
+        for (; i < end; i++)
+        {
+            shared[i] = convert;
+            bitmapsSize += convert ? COMPOSITE_SIZE : glyphs[i].byteCount;
+        }
+    }
     Buffer *ebdt = newBuffer (4 + bitmapsSize);
     addTable (font, "EBDT", ebdt);
     cacheU16 (ebdt, 2); // majorVersion
@@ -1739,33 +2241,83 @@ fillBitmap (Font *font)
     uint_fast8_t byteCount = 0; // unequal to any glyph
     pixels_t pos = 0;
     bool combining = false;
+    bool sharing = false;
     Buffer *rangeHeads = newBuffer (32);
     Buffer *offsets = newBuffer (64);
+    Buffer *imageOffsets = newBuffer (64); // of glyphs in composite ranges
     for (const Glyph *glyph = glyphs; glyph < glyphsEnd; glyph++)
     {
-        if (glyph->byteCount != byteCount || glyph->pos != pos ||
-            glyph->combining != combining)
+        const uint_fast32_t i = glyph - glyphs;
+        if (shared[i] != sharing || (!shared[i] &&
+            (glyph->byteCount != byteCount || glyph->pos != pos ||
+             glyph->combining != combining)))
         {
-            storeU16 (rangeHeads, glyph - glyphs);
+            storeU16 (rangeHeads, i);
             storeU32 (offsets, countBufferedBytes (ebdt));
             byteCount = glyph->byteCount;
             pos = glyph->pos;
             combining = glyph->combining;
+            sharing = shared[i];
+        }
+        if (!sharing)
+        {
+            cacheBytes (ebdt, glyph->bitmap, byteCount);
+            continue;
+        }
+        storeU32 (imageOffsets, countBufferedBytes (ebdt));
+        cacheBigMetrics (ebdt, glyph); // bigMetrics
+        cacheU16 (ebdt, 1); // numComponents
+        { // components[0]
+            cacheU16 (ebdt, canonical[i]); // glyphID
+            cacheU8 (ebdt, 0); // xOffset
+            cacheU8 (ebdt, 0); // yOffset
         }
-        cacheBytes (ebdt, glyph->bitmap, byteCount);
     }
+    #undef COMPOSITE_SIZE
     const uint_least16_t *ranges = getBufferHead (rangeHeads);
     const uint_least16_t *rangesEnd = getBufferTail (rangeHeads);
     uint_fast32_t rangeCount = rangesEnd - ranges;
     storeU16 (rangeHeads, font->glyphCount);
-    Buffer *eblc = newBuffer (4096);
+    ranges = getBufferHead (rangeHeads);
+    rangesEnd = ranges + rangeCount;
+
+    // Index format and size of each IndexSubTable.
+    Buffer *subtableFormats = newBuffer (rangeCount);
+    Buffer *subtableSizes = newBuffer (4 * rangeCount);
+    uint_fast32_t indexTablesSize = 8 * rangeCount;
+    {
+        const uint_least32_t *offset = getBufferHead (offsets);
+        for (const uint_least16_t *p = ranges; p < rangesEnd; p++, offset++)
+        {
+            uint_fast8_t format = 2;
+            uint_fast32_t size = 20;
+            if (shared[*p])
+            {
+                const uint_fast32_t n = p[1] - *p;
+                size_t span = countBufferedBytes (ebdt);
+                if (p + 1 < rangesEnd)
+                    span = offset[1];
+                span -= *offset;
+                // 16-bit offsets (format 3) if they fit, else 32-bit (format 1)
+                format = span <= U16MAX ? 3 : 1;
+                size = format == 3 ? 8 + (2 * (n + 1) + 3) / 4 * 4
+                                   : 8 + 4 * (n + 1);
+            }
+            storeU8 (subtableFormats, format);
+            storeU32 (subtableSizes, size);
+            indexTablesSize += size;
+        }
+    }
+    const uint_least8_t *formats = getBufferHead (subtableFormats);
+    const uint_least32_t *sizes = getBufferHead (subtableSizes);
+    Buffer *eblc = newBuffer (56 + indexTablesSize);
     addTable (font, "EBLC", eblc);
     cacheU16 (eblc, 2); // majorVersion
     cacheU16 (eblc, 0); // minorVersion
     cacheU32 (eblc, 1); // numSizes
     { // bitmapSizes[0]
         cacheU32 (eblc, 56); // indexSubTableArrayOffset
-        cacheU32 (eblc, (8 + 20) * rangeCount); // indexTablesSize
+        cacheU32 (eblc, indexTablesSize); // indexTablesSize
         cacheU32 (eblc, rangeCount); // numberOfIndexSubTables
         cacheU32 (eblc, 0); // colorRef
         { // hori
@@ -1798,8 +2350,8 @@ fillBitmap (Font *font)
         }
         cacheU16 (eblc, 0); // startGlyphIndex
         cacheU16 (eblc, font->glyphCount - 1); // endGlyphIndex
-        cacheU8 (eblc, 16); // ppemX
-        cacheU8 (eblc, 16); // ppemY
+        cacheU8 (eblc, GLYPH_HEIGHT); // ppemX
+        cacheU8 (eblc, GLYPH_HEIGHT); // ppemY
         cacheU8 (eblc, 1); // bitDepth
         cacheU8 (eblc, 1); // flags = Horizontal
     }
@@ -1810,33 +2362,48 @@ fillBitmap (Font *font)
             cacheU16 (eblc, *p); // firstGlyphIndex
             cacheU16 (eblc, p[1] - 1); // lastGlyphIndex
             cacheU32 (eblc, offset); // additionalOffsetToIndexSubtable
-            offset += 20;
+            offset += sizes[p - ranges];
         }
     }
     { // IndexSubTables
         const uint_least32_t *offset = getBufferHead (offsets);
-        for (const uint_least16_t *p = ranges; p < rangesEnd; p++)
+        const uint_least32_t *image = getBufferHead (imageOffsets);
+        for (const uint_least16_t *p = ranges; p < rangesEnd; p++, offset++)
         {
             const Glyph *glyph = &glyphs[*p];
-            cacheU16 (eblc, 2); // indexFormat
-            cacheU16 (eblc, 5); // imageFormat
-            cacheU32 (eblc, *offset++); // imageDataOffset
-            cacheU32 (eblc, glyph->byteCount); // imageSize
-            { // bigMetrics
-                cacheU8 (eblc, GLYPH_HEIGHT); // height
-                const uint_fast8_t width = PW (glyph->byteCount);
-                cacheU8 (eblc, width); // width
-                cacheU8 (eblc, glyph->pos); // horiBearingX
-                cacheU8 (eblc, ASCENDER); // horiBearingY
-                cacheU8 (eblc, glyph->combining ? 0 : width); // horiAdvance
-                cacheU8 (eblc, 0); // vertBearingX
-                cacheU8 (eblc, 0); // vertBearingY
-                cacheU8 (eblc, GLYPH_HEIGHT); // vertAdvance
+            const uint_fast8_t format = formats[p - ranges];
+            if (format == 2)
+            {
+                cacheU16 (eblc, 2); // indexFormat
+                cacheU16 (eblc, 5); // imageFormat
+                cacheU32 (eblc, *offset); // imageDataOffset
+                cacheU32 (eblc, glyph->byteCount); // imageSize
+                cacheBigMetrics (eblc, glyph); // bigMetrics
+                continue;
             }
+            const uint_fast32_t n = p[1] - *p;
+            const int offsetSize = format == 3 ? 2 : 4;
+            const size_t start = countBufferedBytes (eblc);
+            cacheU16 (eblc, format); // indexFormat
+            cacheU16 (eblc, 9); // imageFormat
+            cacheU32 (eblc, *offset); // imageDataOffset
+            for (uint_fast32_t k = 0; k < n; k++)
+                cacheU (eblc, image[k] - *offset, offsetSize); // offsets[k]
+            image += n;
+            const size_t end = p + 1 < rangesEnd ? offset[1]
+                                                 : countBufferedBytes (ebdt);
+            cacheU (eblc, end - *offset, offsetSize); // offsets[n]
+            cacheZeros (eblc, start + sizes[p - ranges] -
+                              countBufferedBytes (eblc)); // padding
         }
     }
     freeBuffer (rangeHeads);
     freeBuffer (offsets);
+    freeBuffer (imageOffsets);
+    freeBuffer (subtableFormats);
+    freeBuffer (subtableSizes);
+    freeBuffer (sharedFlags);
+    freeBuffer (duplicates);
 }
 
 /**
@@ -2005,16 +2572,16 @@ fillOS2Table (Font *font)
         //    10-15 reserved
     ;
     cacheU16 (os2, typeFlags); // fsType
-    cacheU16 (os2, FU (5)); // ySubscriptXSize
-    cacheU16 (os2, FU (7)); // ySubscriptYSize
+    cacheU16 (os2, FU16 (5)); // ySubscriptXSize
+    cacheU16 (os2, FU16 (7)); // ySubscriptYSize
     cacheU16 (os2, FU (0)); // ySubscriptXOffset
-    cacheU16 (os2, FU (1)); // ySubscriptYOffset
-    cacheU16 (os2, FU (5)); // ySuperscriptXSize
-    cacheU16 (os2, FU (7)); // ySuperscriptYSize
+    cacheU16 (os2, FU16 (1)); // ySubscriptYOffset
+    cacheU16 (os2, FU16 (5)); // ySuperscriptXSize
+    cacheU16 (os2, FU16 (7)); // ySuperscriptYSize
     cacheU16 (os2, FU (0)); // ySuperscriptXOffset
-    cacheU16 (os2, FU (4)); // ySuperscriptYOffset
-    cacheU16 (os2, FU (1)); // yStrikeoutSize
-    cacheU16 (os2, FU (5)); // yStrikeoutPosition
+    cacheU16 (os2, FU16 (4)); // ySuperscriptYOffset
+    cacheU16 (os2, FU16 (1)); // yStrikeoutSize
+    cacheU16 (os2, FU16 (5)); // yStrikeoutPosition
     cacheU16 (os2, 0x080a); // sFamilyClass = Sans Serif, Matrix
     const byte panose[] =
     {
@@ -2056,7 +2623,7 @@ fillOS2Table (Font *font)
     cacheU16 (os2, selection);
     const Glyph *glyphs = getBufferHead (font->glyphs);
     uint_fast32_t first = glyphs[1].codePoint;
-    uint_fast32_t last = glyphs[font->glyphCount - 1].codePoint;
+    uint_fast32_t last = glyphs[font->encodedCount - 1].codePoint;
     cacheU16 (os2, first < U16MAX ? first : U16MAX); // usFirstCharIndex
     cacheU16 (os2, last  < U16MAX ? last  : U16MAX); // usLastCharIndex
     cacheU16 (os2, FU (ASCENDER)); // sTypoAscender
@@ -2067,8 +2634,8 @@ fillOS2Table (Font *font)
     // HACK: All reasonable code pages are marked functional for convenience.
     cacheU32 (os2, 0x603f01ff); // ulCodePageRange1
     cacheU32 (os2, 0xffff0000); // ulCodePageRange2
-    cacheU16 (os2, FU (8)); // sxHeight
-    cacheU16 (os2, FU (10)); // sCapHeight
+    cacheU16 (os2, FU16 (8)); // sxHeight
+    cacheU16 (os2, FU16 (10)); // sCapHeight
     cacheU16 (os2, 0); // usDefaultChar
     cacheU16 (os2, 0x20); // usBreakChar
     cacheU16 (os2, 0); // usMaxContext
@@ -2113,7 +2680,7 @@ fillCmapTable (Font *font)
     uint_fast32_t rangeCount = 0;
     uint_fast32_t bmpRangeCount = 1; // 1 for the last 0xffff-0xffff range
     glyphs[0].codePoint = glyphs[1].codePoint; // to start a range at glyph 1
-    for (uint_fast16_t i = 1; i < font->glyphCount; i++)
+    for (uint_fast16_t i = 1; i < font->encodedCount; i++)
     {
         if (glyphs[i].codePoint != glyphs[i - 1].codePoint + 1)
         {
@@ -2125,7 +2692,7 @@ fillCmapTable (Font *font)
     Buffer *cmap = newBuffer (256);
     addTable (font, "cmap", cmap);
     // Format 4 table is always generated for compatibility.
-    bool hasFormat12 = glyphs[font->glyphCount - 1].codePoint > 0xffff;
+    bool hasFormat12 = glyphs[font->encodedCount - 1].codePoint > 0xffff;
     cacheU16 (cmap, 0); // version
     cacheU16 (cmap, 1 + hasFormat12); // numTables
     { // encodingRecords[0]
@@ -2141,7 +2708,7 @@ fillCmapTable (Font *font)
     }
     const uint_least16_t *ranges = getBufferHead (rangeHeads);
     const uint_least16_t *const rangesEnd = getBufferTail (rangeHeads);
-    storeU16 (rangeHeads, font->glyphCount);
+    storeU16 (rangeHeads, font->encodedCount);
     { // format 4 table
         cacheU16 (cmap, 4); // format
         cacheU16 (cmap, 16 + 8 * bmpRangeCount); // length
@@ -2303,6 +2870,433 @@ fillGsubTable (Font *font)
     }
 }
 
+/**
+    @brief Indices of the lookups in a jamo-shaping "GSUB" table.
+
+    The three chaining lookups are referenced by the 'ljmo', 'vjmo' and
+    'tjmo' features.  They only select a variation; the substitution
+    itself is done by a single substitution lookup for each variation.
+*/
+enum JamoLookup {
+    LOOKUP_CHO,                 ///< Chain: choseong by following jamo.
+    LOOKUP_JUNG,                ///< Chain: jungseong by following jamo.
+    LOOKUP_JONG,                ///< Chain: jongseong by preceding vowel.
+    LOOKUP_CHO_VARIANT,         ///< Single: choseong variation 0.
+    LOOKUP_JUNG_VARIANT = LOOKUP_CHO_VARIANT + CHO_VARIATIONS,
+    LOOKUP_JONG_VARIANT = LOOKUP_JUNG_VARIANT + JUNG_VARIATIONS,
+    LOOKUP_JONG_SHIFTED,        ///< Single: jongseong moved right.
+    LOOKUP_COUNT                ///< Number of lookups.
+};
+
+/**
+    @brief A chained context rule that substitutes its single input glyph.
+
+    Class 0 in 'backtrack' means no preceding context; class 0 in
+    'lookahead' ends the following context.
+*/
+typedef struct ChainRule
+{
+    uint_least16_t backtrack, lookahead[2], lookup;
+} ChainRule;
+
+/**
+    @brief Compare glyph and class pairs by glyph index.
+
+    @param[in] a Pointer to the first pair.
+    @param[in] b Pointer to the second pair.
+    @return 1 if the glyph in "a" is greater, -1 if less, 0 if equal.
+*/
+int
+byGlyphIndex (const void *a, const void *b)
+{
+    const uint_least16_t *const pa = a, *const pb = b;
+    int gt = pa[0] > pb[0];
+    int lt = pa[0] < pb[0];
+    return gt - lt;
+}
+
+/**
+    @brief Cache a class definition table from glyph and class pairs.
+
+    @param[in,out] buf The buffer to which the ClassDef table is appended.
+    @param[in,out] pairs Glyph index and class pairs; sorted in place.
+*/
+void
+cacheClassDef (Buffer *buf, Buffer *pairs)
+{
+    Buffer *ranges = newBuffer (256);
+    uint_least16_t *range = NULL;
+    uint_least16_t *p = getBufferHead (pairs);
+    const uint_least16_t *const end = getBufferTail (pairs);
+    qsort (p, (end - p) / 2, 2 * sizeof *p, byGlyphIndex);
+    for (; p < end; p += 2)
+    {
+        if (p[1] == 0)
+            continue;
+        if (range && p[0] == range[1] + 1 && p[1] == range[2])
+        {
+            range[1] = p[0];
+            continue;
+        }
+        range = getBufferSlot (ranges, 3 * sizeof *range);
+        range[0] = range[1] = p[0];
+        range[2] = p[1];
+    }
+    const uint_least16_t *r = getBufferHead (ranges);
+    const uint_least16_t *const rEnd = getBufferTail (ranges);
+    cacheU16 (buf, 2); // classFormat
+    cacheU16 (buf, (rEnd - r) / 3); // classRangeCount
+    for (; r < rEnd; r++)
+        cacheU16 (buf, *r); // classRangeRecords[]
+    freeBuffer (ranges);
+}
+
+/**
+    @brief Store glyph and class pairs for every encoded glyph of a jamo set.
+
+    @param[in,out] pairs The buffer of pairs to append to.
+    @param[in] jamos The array of Jamo to classify.
+    @param[in] classOf Function returning the class of a letter number.
+*/
+void
+storeJamoClasses (Buffer *pairs, const Buffer *jamos, int (*classOf) (int))
+{
+    const Jamo *j = getBufferHead (jamos);
+    const Jamo *const end = getBufferTail (jamos);
+    for (; j < end; j++)
+    {
+        storeU16 (pairs, j->glyph);
+        storeU16 (pairs, classOf (j->letter));
+    }
+}
+
+/**
+    @brief Cache a Lookup table with one single substitution subtable.
+
+    Every encoded jamo in the set is replaced by one of its variants.
+
+    @param[in,out] buf The buffer to which the Lookup table is appended.
+    @param[in] jamos The array of Jamo to substitute.
+    @param[in] variant The index into the 'variants' array of each Jamo.
+*/
+void
+cacheJamoSubstLookup (Buffer *buf, const Buffer *jamos, int variant)
+{
+    const Jamo *const begin = getBufferHead (jamos);
+    const Jamo *const end = getBufferTail (jamos);
+    const uint_fast16_t count = end - begin;
+    cacheU16 (buf, 1); // lookupType = Single Substitution
+    cacheU16 (buf, 0); // lookupFlag
+    cacheU16 (buf, 1); // subTableCount
+    cacheU16 (buf, 8); // subtableOffsets[0]
+    { // Single Substitution Format 2
+        cacheU16 (buf, 2); // substFormat
+        cacheU16 (buf, 6 + 2 * count); // coverageOffset
+        cacheU16 (buf, count); // glyphCount
+        for (const Jamo *j = begin; j < end; j++)
+            cacheU16 (buf, j->variants[variant]); // substituteGlyphIDs[]
+    }
+    { // Coverage Format 1
+        cacheU16 (buf, 1); // coverageFormat
+        cacheU16 (buf, count); // glyphCount
+        for (const Jamo *j = begin; j < end; j++)
+            cacheU16 (buf, j->glyph); // glyphArray[]
+    }
+}
+
+/**
+    @brief Cache a Lookup table with one chained contexts subtable.
+
+    The subtable uses class-based contexts (format 2).  All encoded
+    jamo of the given set form input class 1, and the rules of that
+    class are tried in order.
+
+    @param[in,out] buf The buffer to which the Lookup table is appended.
+    @param[in] jamos The array of Jamo to substitute.
+    @param[in] backtrack Glyph and class pairs for preceding glyphs.
+    @param[in] lookahead Glyph and class pairs for following glyphs.
+    @param[in] rules The rules for input class 1.
+    @param[in] ruleCount The number of rules.
+*/
+void
+cacheJamoChainLookup (Buffer *buf, const Buffer *jamos,
+    Buffer *backtrack, Buffer *lookahead,
+    const ChainRule rules[], size_t ruleCount)
+{
+    Buffer *classes = newBuffer (256);
+    Buffer *input = newBuffer (1024);
+    const Jamo *const begin = getBufferHead (jamos);
+    const Jamo *const end = getBufferTail (jamos);
+    for (const Jamo *j = begin; j < end; j++)
+    {
+        storeU16 (input, j->glyph);
+        storeU16 (input, 1);
+    }
+    { // ChainSubClassSet for class 1
+        cacheU16 (classes, ruleCount); // chainSubClassRuleCount
+        size_t offset = 2 + 2 * ruleCount;
+        for (size_t i = 0; i < ruleCount; i++)
+        {
+            cacheU16 (classes, offset); // chainSubClassRuleOffsets[i]
+            offset += 12 + 2 * !!rules[i].backtrack
+                          + 2 * !!rules[i].lookahead[0]
+                          + 2 * !!rules[i].lookahead[1];
+        }
+        for (size_t i = 0; i < ruleCount; i++)
+        { // ChainSubClassRule
+            const ChainRule *r = &rules[i];
+            cacheU16 (classes, !!r->backtrack); // backtrackGlyphCount
+            if (r->backtrack)
+                cacheU16 (classes, r->backtrack); // backtrackSequence[0]
+            cacheU16 (classes, 1); // inputGlyphCount
+            int n = !!r->lookahead[0] + !!r->lookahead[1];
+            cacheU16 (classes, n); // lookaheadGlyphCount
+            for (int k = 0; k < n; k++)
+                cacheU16 (classes, r->lookahead[k]); // lookaheadSequence[k]
+            cacheU16 (classes, 1); // seqLookupCount
+            cacheU16 (classes, 0); // sequenceIndex
+            cacheU16 (classes, r->lookup); // lookupListIndex
+        }
+    }
+    Buffer *coverage = newBuffer (256);
+    cacheU16 (coverage, 1); // coverageFormat
+    cacheU16 (coverage, end - begin); // glyphCount
+    for (const Jamo *j = begin; j < end; j++)
+        cacheU16 (coverage, j->glyph); // glyphArray[]
+    Buffer *classDefs[3];
+    Buffer *pairs[3] = {backtrack, input, lookahead};
+    for (int i = 0; i < 3; i++)
+    {
+        classDefs[i] = newBuffer (256);
+        cacheClassDef (classDefs[i], pairs[i]);
+    }
+    cacheU16 (buf, 6); // lookupType = Chained Contexts Substitution
+    cacheU16 (buf, 0); // lookupFlag
+    cacheU16 (buf, 1); // subTableCount
+    cacheU16 (buf, 8); // subtableOffsets[0]
+    { // Chained Contexts Substitution Format 2
+        size_t offset = 16 + countBufferedBytes (classes);
+        cacheU16 (buf, 2); // format
+        cacheU16 (buf, offset); // coverageOffset
+        offset += countBufferedBytes (coverage);
+        for (int i = 0; i < 3; i++)
+        {
+            // backtrackClassDefOffset, inputClassDefOffset,
+            // lookaheadClassDefOffset
+            cacheU16 (buf, offset);
+            offset += countBufferedBytes (classDefs[i]);
+        }
+        if (offset > U16MAX)
+            fail ("Too many jamo in 'GSUB' table.");
+        cacheU16 (buf, 2); // chainSubClassSetCount
+        cacheU16 (buf, 0); // chainSubClassSetOffsets[0] (no rules)
+        cacheU16 (buf, 16); // chainSubClassSetOffsets[1]
+        cacheBuffer (buf, classes);
+        cacheBuffer (buf, coverage);
+        for (int i = 0; i < 3; i++)
+        {
+            cacheBuffer (buf, classDefs[i]);
+            freeBuffer (classDefs[i]);
+        }
+    }
+    freeBuffer (classes);
+    freeBuffer (input);
+    freeBuffer (coverage);
+}
+
+/// Lookahead class of a jungseong: its choseong variation, plus 1.
+static int
+choClassOfJung (int jung)
+{
+    return 1 + cho_variation (0, jung, -1);
+}
+
+/// Lookahead class of a jongseong: its jungseong variation, plus 1.
+static int
+jungClassOfJong (int jong)
+{
+    return 1 + jung_variation (0, 0, jong);
+}
+
+/// Backtrack class of a jungseong: 1 if its right stroke is wide.
+static int
+wideClassOfJung (int jung)
+{
+    return is_wide_vowel (jung);
+}
+
+/// Lookahead class that is given to every jongseong in the choseong lookup.
+#define JONG_CLASS (1 + CHO_VARIATIONS)
+
+/**
+    @brief Fill a "GSUB" font table for conjoining jamo shaping.
+
+    The table has the same scripts as the one from fillGsubTable,
+    plus "hang", and the 'ljmo', 'vjmo' and 'tjmo' features.  These
+    pick the jamo variants added by addJamoGlyphs exactly as
+    cho_variation, jung_variation and jong_variation do when Hangul
+    syllables are precomposed:
+
+        - A choseong takes the variation for the following jungseong,
+          and the "with jongseong" variation if a jongseong follows that.
+        - A jungseong takes variation 2 before jongseong nieun,
+          1 before any other jongseong, and 0 otherwise.
+        - A jongseong is moved right by one column after a vowel
+          with a wide right vertical stroke.
+
+    Lookups run in order, so the jongseong lookup sees the substituted
+    jungseong; its backtrack classes cover the jungseong variants too.
+
+    @param[in,out] font The Font struct to which to add the table.
+    @param[in] jamo The jamo and their variants, from addJamoGlyphs.
+*/
+void
+fillJamoGsubTable (Font *font, const JamoSet *jamo)
+{
+    const Buffer *cho = jamo->positions[JAMO_CHO];
+    const Buffer *jung = jamo->positions[JAMO_JUNG];
+    const Buffer *jong = jamo->positions[JAMO_JONG];
+    Buffer *lookups[LOOKUP_COUNT];
+    for (int i = 0; i < LOOKUP_COUNT; i++)
+        lookups[i] = newBuffer (1024);
+    { // choseong by the following jungseong and jongseong
+        Buffer *lookahead = newBuffer (1024);
+        storeJamoClasses (lookahead, jung, choClassOfJung);
+        const Jamo *j = getBufferHead (jong);
+        for (const Jamo *end = getBufferTail (jong); j < end; j++)
+        {
+            storeU16 (lookahead, j->glyph);
+            storeU16 (lookahead, JONG_CLASS);
+        }
+        ChainRule rules[2 * CHO_VARIATIONS];
+        size_t ruleCount = 0;
+        for (int c = 1; c <= CHO_VARIATIONS; c++)
+        {
+            const Jamo *v = getBufferHead (jung);
+            const Jamo *const vEnd = getBufferTail (jung);
+            while (v < vEnd && choClassOfJung (v->letter) != c)
+                v++;
+            if (v == vEnd)
+                continue; // no vowel in the font needs this class
+            rules[ruleCount++] = (ChainRule){0, {c, JONG_CLASS},
+                LOOKUP_CHO_VARIANT + cho_variation (0, v->letter, 0)};
+            rules[ruleCount++] = (ChainRule){0, {c, 0},
+                LOOKUP_CHO_VARIANT + cho_variation (0, v->letter, -1)};
+        }
+        cacheJamoChainLookup (lookups[LOOKUP_CHO], cho, lookahead, lookahead,
+            rules, ruleCount);
+        freeBuffer (lookahead);
+    }
+    { // jungseong by the following jongseong
+        Buffer *lookahead = newBuffer (1024);
+        storeJamoClasses (lookahead, jong, jungClassOfJong);
+        ChainRule rules[JUNG_VARIATIONS + 1];
+        size_t ruleCount = 0;
+        for (int c = 1; c <= JUNG_VARIATIONS; c++)
+        {
+            const Jamo *t = getBufferHead (jong);
+            const Jamo *const tEnd = getBufferTail (jong);
+            while (t < tEnd && jungClassOfJong (t->letter) != c)
+                t++;
+            if (t == tEnd)
+                continue;
+            rules[ruleCount++] = (ChainRule){0, {c, 0},
+                LOOKUP_JUNG_VARIANT + jung_variation (0, 0, t->letter)};
+        }
+        rules[ruleCount++] = (ChainRule){0, {0, 0},
+            LOOKUP_JUNG_VARIANT + jung_variation (0, 0, -1)};
+        cacheJamoChainLookup (lookups[LOOKUP_JUNG], jung, lookahead, lookahead,
+            rules, ruleCount);
+        freeBuffer (lookahead);
+    }
+    { // jongseong by the preceding (already substituted) jungseong
+        Buffer *backtrack = newBuffer (1024);
+        storeJamoClasses (backtrack, jung, wideClassOfJung);
+        const Jamo *j = getBufferHead (jung);
+        for (const Jamo *end = getBufferTail (jung); j < end; j++)
+            for (int v = 0; v < JUNG_VARIATIONS; v++)
+            {
+                storeU16 (backtrack, j->variants[v]);
+                storeU16 (backtrack, wideClassOfJung (j->letter));
+            }
+        const ChainRule rules[] =
+        {
+            {1, {0, 0}, LOOKUP_JONG_SHIFTED},
+            {0, {0, 0}, LOOKUP_JONG_VARIANT},
+        };
+        cacheJamoChainLookup (lookups[LOOKUP_JONG], jong, backtrack, backtrack,
+            rules, sizeof rules / sizeof *rules);
+        freeBuffer (backtrack);
+    }
+    for (int v = 0; v < CHO_VARIATIONS; v++)
+        cacheJamoSubstLookup (lookups[LOOKUP_CHO_VARIANT + v], cho, v);
+    for (int v = 0; v < JUNG_VARIATIONS; v++)
+        cacheJamoSubstLookup (lookups[LOOKUP_JUNG_VARIANT + v], jung, v);
+    cacheJamoSubstLookup (lookups[LOOKUP_JONG_VARIANT], jong, 0);
+    cacheJamoSubstLookup (lookups[LOOKUP_JONG_SHIFTED], jong, 1);
+
+    Buffer *gsub = newBuffer (65536);
+    addTable (font, "GSUB", gsub);
+    cacheU16 (gsub, 1); // majorVersion
+    cacheU16 (gsub, 0); // minorVersion
+    cacheU16 (gsub, 10); // scriptListOffset
+    cacheU16 (gsub, 46); // featureListOffset
+    cacheU16 (gsub, 84); // lookupListOffset
+    { // ScriptList table
+        cacheU16 (gsub, 3); // scriptCount
+        const char *const scripts[] = {"DFLT", "hang", "thai"};
+        for (int i = 0; i < 3; i++)
+        { // scriptRecords[i]
+            cacheBytes (gsub, scripts[i], 4); // scriptTag
+            cacheU16 (gsub, 20); // scriptOffset
+        }
+        { // Script table
+            cacheU16 (gsub, 4); // defaultLangSysOffset
+            cacheU16 (gsub, 0); // langSysCount
+            { // Default Language System table
+                cacheU16 (gsub, 0); // lookupOrderOffset
+                cacheU16 (gsub, 0xffff); // requiredFeatureIndex = none
+                cacheU16 (gsub, 3); // featureIndexCount
+                for (int i = 0; i < 3; i++)
+                    cacheU16 (gsub, i); // featureIndices[i]
+            }
+        }
+    }
+    { // Feature List table (sorted by tag)
+        const char *const tags[] = {"ljmo", "tjmo", "vjmo"};
+        const uint_fast16_t indices[] = {LOOKUP_CHO, LOOKUP_JONG, LOOKUP_JUNG};
+        cacheU16 (gsub, 3); // featureCount
+        for (int i = 0; i < 3; i++)
+        { // featureRecords[i]
+            cacheBytes (gsub, tags[i], 4); // featureTag
+            cacheU16 (gsub, 20 + 6 * i); // featureOffset
+        }
+        for (int i = 0; i < 3; i++)
+        { // Feature table
+            cacheU16 (gsub, 0); // featureParamsOffset
+            cacheU16 (gsub, 1); // lookupIndexCount
+            cacheU16 (gsub, indices[i]); // lookupListIndices[0]
+        }
+    }
+    { // Lookup List table
+        assert (countBufferedBytes (gsub) == 84);
+        cacheU16 (gsub, LOOKUP_COUNT); // lookupCount
+        size_t offset = 2 + 2 * LOOKUP_COUNT;
+        for (int i = 0; i < LOOKUP_COUNT; i++)
+        {
+            if (offset > U16MAX)
+                fail ("Too many jamo in 'GSUB' table.");
+            cacheU16 (gsub, offset); // lookupOffsets[i]
+            offset += countBufferedBytes (lookups[i]);
+        }
+        for (int i = 0; i < LOOKUP_COUNT; i++)
+        {
+            cacheBuffer (gsub, lookups[i]);
+            freeBuffer (lookups[i]);
+        }
+    }
+}
+
 /**
     @brief Cache a string as a big-ending UTF-16 surrogate pair.
 
@@ -2397,6 +3391,153 @@ fillNameTable (Font *font, NameStrings nameStrings)
     freeBuffer (stringData);
 }
 
+/**
+    @brief Time spent in one phase of the conversion.
+
+    Phases are only recorded if "--stats" or "trace=" is given.
+*/
+typedef struct Phase
+{
+    const char *name; ///< phase name, usually the function called
+    double start;     ///< wall clock time at start, in microseconds
+    double wall;      ///< wall clock time spent, in microseconds
+    double cpu;       ///< processor time spent, in microseconds
+} Phase;
+
+Buffer *phases; ///< Phase records, or NULL if phases are not timed.
+
+/**
+    @brief Read the monotonic wall clock.
+
+    @return Time in microseconds since an unspecified starting point.
+*/
+double
+wallMicroseconds ()
+{
+    struct timespec t;
+    if (clock_gettime (CLOCK_MONOTONIC, &t) != 0)
+        return 0;
+    return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+/**
+    @brief Read the processor time used by this process.
+
+    @return Processor time in microseconds.
+*/
+double
+cpuMicroseconds ()
+{
+    return clock () * (1e6 / CLOCKS_PER_SEC);
+}
+
+/**
+    @brief Start timing a phase, if phases are timed.
+
+    @param[in] name Name of the phase; must outlive the phase records.
+*/
+void
+beginPhase (const char *name)
+{
+    if (!phases)
+        return;
+    Phase *phase = getBufferSlot (phases, sizeof (Phase));
+    phase->name = name;
+    phase->cpu = cpuMicroseconds ();
+    phase->start = wallMicroseconds ();
+}
+
+/**
+    @brief Stop timing the phase started last, if phases are timed.
+*/
+void
+endPhase ()
+{
+    if (!phases)
+        return;
+    Phase *phase = (Phase *)getBufferTail (phases) - 1;
+    phase->wall = wallMicroseconds () - phase->start;
+    phase->cpu = cpuMicroseconds () - phase->cpu;
+}
+
+/// Run a statement as a named phase for "--stats" and "trace=".
+#define timePhase(name, statement) \
+    do { beginPhase (name); statement; endPhase (); } while (0)
+
+/**
+    @brief Print phase times and table sizes on stderr.
+
+    Table sizes exclude the padding added by writeFont.  For each table,
+    the capacity of its buffer (its peak, since buffers never shrink)
+    is shown beside the capacity requested initially, with the number
+    of reallocations and the bytes they moved.  Totals over all buffers,
+    including freed ones, follow.
+
+    @param[in] font The font that has been written.
+*/
+void
+printStats (const Font *font)
+{
+    const Phase *const begin = getBufferHead (phases);
+    const Phase *const end = getBufferTail (phases);
+    double wall = 0, cpu = 0;
+    fprintf (stderr, "%-20s %12s %12s\n", "Phase", "Wall (ms)", "CPU (ms)");
+    for (const Phase *p = begin; p < end; p++)
+    {
+        fprintf (stderr, "%-20s %12.3f %12.3f\n",
+            p->name, p->wall / 1e3, p->cpu / 1e3);
+        wall += p->wall;
+        cpu += p->cpu;
+    }
+    fprintf (stderr, "%-20s %12.3f %12.3f\n\n", "total", wall / 1e3, cpu / 1e3);
+    fprintf (stderr, "%-20s %12s %12s %12s %8s %12s\n",
+        "Table", "Bytes", "Capacity", "Initial", "Grown", "Copied");
+    size_t total = 0;
+    const Table *const tablesEnd = getBufferTail (font->tables);
+    for (const Table *t = getBufferHead (font->tables); t < tablesEnd; t++)
+    {
+        const Buffer *buf = t->content;
+        size_t size = countBufferedBytes (buf);
+        fprintf (stderr, "%c%c%c%c%16s %12zu %12zu %12zu %8zu %12zu\n",
+            (char)(t->tag >> 24), (char)(t->tag >> 16),
+            (char)(t->tag >> 8), (char)t->tag, "", size, buf->capacity,
+            buf->initialCapacity, buf->growCount, buf->copiedBytes);
+        total += size;
+    }
+    fprintf (stderr, "%-20s %12zu\n\n", "total", total);
+    fprintf (stderr, "Buffers: %zu reallocations moved %zu bytes; "
+        "peak heap %zu bytes.\n", bufferStats.growCount,
+        bufferStats.copiedBytes, bufferStats.peakHeapBytes);
+}
+
+/**
+    @brief Write phase times as Chrome trace event JSON.
+
+    The file can be loaded in chrome://tracing or Perfetto.
+    Each phase becomes one complete ("X") event.
+
+    @param[in] fileName Name of the trace file to write.
+*/
+void
+writeTrace (const char *fileName)
+{
+    FILE *file = fopen (fileName, "w");
+    if (!file)
+        fail ("Failed to open file '%s'.", fileName);
+    const Phase *const begin = getBufferHead (phases);
+    const Phase *const end = getBufferTail (phases);
+    const double origin = begin < end ? begin->start : 0;
+    fprintf (file, "{\"traceEvents\":[");
+    for (const Phase *p = begin; p < end; p++)
+        fprintf (file, "%s\n{\"name\":\"%s\",\"cat\":\"hex2otf\","
+            "\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,"
+            "\"args\":{\"cpu_us\":%.3f}}", p > begin ? "," : "",
+            p->name, p->start - origin, p->wall, p->cpu);
+    fprintf (file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    if (ferror (file) || fclose (file) != 0)
+        fail ("Failed to write file '%s'.", fileName);
+}
+
 /**
     @brief Print program version string on stdout.
 
@@ -2425,9 +3566,16 @@ printVersion () {
 void
 printHelp () {
     printf ("Synopsis: hex2otf <options>:\n\n");
-    printf ("    hex=<filename>        Specify Unifont .hex input file.\n");
+    printf ("    hex=<filename>        Specify Unifont .hex input file;\n");
+    printf ("                          repeat to merge files, - for stdin.\n");
+    printf ("    dups=<policy>         Duplicate code points: error (default),\n");
+    printf ("                          first, or last.\n");
     printf ("    pos=<filename>        Specify combining file. (Optional)\n");
-    printf ("    out=<filename>        Specify output font file.\n");
+    printf ("    jamo=<filename>       Specify Hangul base file for jamo\n");
+    printf ("                          shaping in GSUB. (Optional)\n");
+    printf ("    out=<filename>        Specify output font file, - for stdout.\n");
+    printf ("    rows=<16|24|32>       Specify glyph height. (Default: 16)\n");
+    printf ("    trace=<filename>      Write phase times as Chrome trace JSON.\n");
     printf ("    format=<f1>,<f2>,...  Specify font format(s); values:\n");
     printf ("                             cff\n");
     printf ("                             cff2\n");
@@ -2436,6 +3584,7 @@ printHelp () {
     printf ("                             bitmap\n");
     printf ("                             gpos\n");
     printf ("                             gsub\n");
+    printf ("    --stats               Print phase times and table sizes.\n");
     printf ("\nExample:\n\n");
     printf ("    hex2otf hex=Myfont.hex out=Myfont.otf format=cff\n\n");
     printf ("For more information, consult the hex2otf(1) man page.\n\n");
@@ -2452,9 +3601,12 @@ printHelp () {
 */
 typedef struct Options
 {
-    bool truetype, blankOutline, bitmap, gpos, gsub;
+    bool truetype, blankOutline, bitmap, gpos, gsub, stats;
     int cff; // 0 = no CFF outline; 1 = use 'CFF' table; 2 = use 'CFF2' table
-    const char *hex, *pos, *out; // file names
+    const char *pos, *jamo, *out, *trace; // file names
+    Buffer *hexFiles; // names of .hex files, as const char *
+    enum DuplicatePolicy duplicates;
+    const Geometry *geometry; // glyph height and derived metrics
     NameStrings nameStrings; // indexed directly by Name IDs
 } Options;
 
@@ -2487,10 +3639,15 @@ matchToken (const char *operand, const char *key, char delimiter)
         bitmap         bool           Generate embedded bitmap
         gpos           bool           Generate a dummy GPOS table
         gsub           bool           Generate a dummy GSUB table
+        stats          bool           Print phase times and table sizes
         cff            int            Generate CFF 1 or CFF 2 outlines
-        hex            const char *   Name of Unifont .hex file
+        hexFiles       Buffer *       Names of Unifont .hex files
+        duplicates     enum           What to do with duplicate glyphs
         pos            const char *   Name of Unifont combining data file
+        jamo           const char *   Name of Hangul base .hex file
         out            const char *   Name of output font file
+        trace          const char *   Name of trace event output file
+        geometry       Geometry *     Glyph height: 16, 24 or 32 rows
         nameStrings    NameStrings    Array of TrueType font Name IDs
 
     @param[in] argv Pointer to array of command line options.
@@ -2500,17 +3657,20 @@ Options
 parseOptions (char *const argv[const])
 {
     Options opt = {0}; // all options default to 0, false and NULL
-    const char *format = NULL;
+    const char *format = NULL, *rows = NULL, *dups = NULL;
     struct StringArg
     {
         const char *const key;
         const char **const value;
     } strArgs[] =
     {
-        {"hex", &opt.hex},
         {"pos", &opt.pos},
+        {"jamo", &opt.jamo},
         {"out", &opt.out},
         {"format", &format},
+        {"rows", &rows},
+        {"dups", &dups},
+        {"trace", &opt.trace},
         {NULL, NULL} // sentinel
     };
     for (char *const *argp = argv + 1; *argp; argp++)
@@ -2522,6 +3682,20 @@ parseOptions (char *const argv[const])
             printHelp ();
         if (strcmp (arg, "--version") == 0)
             printVersion ();
+        if (strcmp (arg, "--stats") == 0)
+        {
+            opt.stats = true;
+            continue;
+        }
+        if ((value = matchToken (arg, "hex", '=')))
+        {
+            if (!*value)
+                fail ("Empty argument: 'hex'.");
+            if (!opt.hexFiles)
+                opt.hexFiles = newBuffer (sizeof value * 4);
+            *(const char **)getBufferSlot (opt.hexFiles, sizeof value) = value;
+            continue;
+        }
         for (p = strArgs; p->key; p++)
             if ((value = matchToken (arg, p->key, '=')))
                 break;
@@ -2545,12 +3719,39 @@ parseOptions (char *const argv[const])
             opt.nameStrings[id] = endptr;
         }
     }
-    if (!opt.hex)
+    if (!opt.hexFiles)
         fail ("Hex file is not specified.");
+    if (dups)
+    {
+        if (strcmp (dups, "first") == 0)
+            opt.duplicates = DUPLICATES_FIRST;
+        else if (strcmp (dups, "last") == 0)
+            opt.duplicates = DUPLICATES_LAST;
+        else if (strcmp (dups, "error") != 0)
+            fail ("Invalid duplicate policy: '%s'.", dups);
+    }
     if (opt.pos && opt.pos[0] == '\0')
         opt.pos = NULL; // Position file is optional. Empty path means none.
     if (!opt.out)
         fail ("Output file is not specified.");
+    opt.geometry = geometries;
+    if (rows)
+    {
+        const size_t count = sizeof geometries / sizeof *geometries;
+        char *endptr;
+        long height = strtol (rows, &endptr, 10);
+        while (opt.geometry < geometries + count &&
+               (*endptr || opt.geometry->height != height))
+            opt.geometry++;
+        if (opt.geometry == geometries + count)
+            fail ("Unsupported glyph height: '%s'.", rows);
+    }
+    if (opt.jamo)
+    {
+        if (opt.geometry->height != 16)
+            fail ("Jamo shaping requires 16-row glyphs.");
+        opt.gsub = true; // jamo variants are only reachable through GSUB
+    }
     if (!format)
         fail ("Format is not specified.");
     for (const NamePair *p = defaultNames; p->str; p++)
@@ -2605,37 +3806,65 @@ main (int argc, char *argv[])
     initBuffers (16);
     atexit (cleanBuffers);
     Options opt = parseOptions (argv);
+    geometry = *opt.geometry;
+    if (opt.stats || opt.trace)
+        phases = newBuffer (sizeof (Phase) * 32);
     Font font;
     font.tables = newBuffer (sizeof (Table) * 16);
     font.glyphs = newBuffer (sizeof (Glyph) * MAX_GLYPHS);
-    readGlyphs (&font, opt.hex);
-    sortGlyphs (&font);
+    const char *const *hexFiles = getBufferHead (opt.hexFiles);
+    const char *const *const hexFilesEnd = getBufferTail (opt.hexFiles);
+    Buffer *runEnds = newBuffer (sizeof (size_t) * (hexFilesEnd - hexFiles));
+    bool sorted = true;
+    beginPhase ("readGlyphs");
+    for (const char *const *name = hexFiles; name < hexFilesEnd; name++)
+    {
+        sorted = readGlyphs (&font, *name) && sorted;
+        size_t *end = getBufferSlot (runEnds, sizeof *end);
+        *end = countBufferedBytes (font.glyphs) / sizeof (Glyph);
+    }
+    endPhase ();
+    timePhase ("sortGlyphs",
+        sortGlyphs (&font, runEnds, sorted, opt.duplicates));
+    freeBuffer (runEnds);
     enum LocaFormat loca = LOCA_OFFSET16;
     uint_fast16_t maxPoints = 0, maxContours = 0;
     pixels_t xMin = 0;
+    JamoSet jamo;
     if (opt.pos)
-        positionGlyphs (&font, opt.pos, &xMin);
+        timePhase ("positionGlyphs", positionGlyphs (&font, opt.pos, &xMin));
+    if (opt.jamo)
+        timePhase ("addJamoGlyphs",
+            addJamoGlyphs (&font, opt.jamo, &xMin, &jamo));
     if (opt.gpos)
-        fillGposTable (&font);
-    if (opt.gsub)
-        fillGsubTable (&font);
+        timePhase ("fillGposTable", fillGposTable (&font));
+    if (opt.gsub && opt.jamo)
+        timePhase ("fillJamoGsubTable", fillJamoGsubTable (&font, &jamo));
+    else if (opt.gsub)
+        timePhase ("fillGsubTable", fillGsubTable (&font));
     if (opt.cff)
-        fillCFF (&font, opt.cff, opt.nameStrings);
+        timePhase ("fillCFF", fillCFF (&font, opt.cff, opt.nameStrings));
     if (opt.truetype)
-        fillTrueType (&font, &loca, &maxPoints, &maxContours);
+        timePhase ("fillTrueType",
+            fillTrueType (&font, &loca, &maxPoints, &maxContours));
     if (opt.blankOutline)
-        fillBlankOutline (&font);
+        timePhase ("fillBlankOutline", fillBlankOutline (&font));
     if (opt.bitmap)
-        fillBitmap (&font);
-    fillHeadTable (&font, loca, xMin);
-    fillHheaTable (&font, xMin);
-    fillMaxpTable (&font, opt.cff, maxPoints, maxContours);
-    fillOS2Table (&font);
-    fillNameTable (&font, opt.nameStrings);
-    fillHmtxTable (&font);
-    fillCmapTable (&font);
-    fillPostTable (&font);
-    organizeTables (&font, opt.cff);
-    writeFont (&font, opt.cff, opt.out);
+        timePhase ("fillBitmap", fillBitmap (&font));
+    timePhase ("fillHeadTable", fillHeadTable (&font, loca, xMin));
+    timePhase ("fillHheaTable", fillHheaTable (&font, xMin));
+    timePhase ("fillMaxpTable",
+        fillMaxpTable (&font, opt.cff, maxPoints, maxContours));
+    timePhase ("fillOS2Table", fillOS2Table (&font));
+    timePhase ("fillNameTable", fillNameTable (&font, opt.nameStrings));
+    timePhase ("fillHmtxTable", fillHmtxTable (&font));
+    timePhase ("fillCmapTable", fillCmapTable (&font));
+    timePhase ("fillPostTable", fillPostTable (&font));
+    timePhase ("organizeTables", organizeTables (&font, opt.cff));
+    timePhase ("writeFont", writeFont (&font, opt.cff, opt.out));
+    if (opt.stats)
+        printStats (&font);
+    if (opt.trace)
+        writeTrace (opt.trace);
     return EXIT_SUCCESS;
 }
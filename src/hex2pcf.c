@@ -0,0 +1,940 @@
+/**
+   @file hex2pcf.c
+
+   @brief hex2pcf - Convert a GNU Unifont .hex file into an X11 PCF font
+
+   @author Paul Hardy
+
+   @copyright Copyright (C) 2023 Paul Hardy
+
+   This program reads glyphs in Unifont .hex format from the files
+   named on the command line, or from stdin if none are named, and
+   writes an X11 Portable Compiled Format (PCF) font, optionally
+   compressed with gzip.  It takes the place of running hex2bdf and
+   then bdftopcf.
+
+   Synopsis: hex2pcf [--font name] [--rows n] [--version string]
+                     [--copyright string] [--pad n] [--unit n]
+                     [--bit-order msb|lsb] [--byte-order msb|lsb]
+                     [--gzip] [--output file] [input.hex ...]
+
+   The font has the properties that hex2bdf writes, and the tables that
+   bdftopcf writes: properties, accelerators, metrics, bitmaps, BDF
+   encodings, scalable widths, glyph names, and BDF accelerators.  An
+   ink metrics table is added, giving the bounding box of the pixels
+   that are set in each glyph.  The PCF encodings table only holds
+   16-bit code points, so glyphs above Plane 0 are not written.
+*/
+/*
+   LICENSE:
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 2 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "unihex.h"
+
+#define MAXROWS   256   ///< Tallest glyph allowed, in pixels.
+#define MAXCOLS   256   ///< Widest glyph allowed, in pixels.
+#define NPROPS     24   ///< Number of font properties written.
+
+/* PCF table types, in the order they appear in a file. */
+#define PCF_PROPERTIES        (1 << 0)
+#define PCF_ACCELERATORS      (1 << 1)
+#define PCF_METRICS           (1 << 2)
+#define PCF_BITMAPS           (1 << 3)
+#define PCF_INK_METRICS       (1 << 4)
+#define PCF_BDF_ENCODINGS     (1 << 5)
+#define PCF_SWIDTHS           (1 << 6)
+#define PCF_GLYPH_NAMES       (1 << 7)
+#define PCF_BDF_ACCELERATORS  (1 << 8)
+#define NTABLES                  9
+
+/* PCF table format bits. */
+#define PCF_ACCEL_W_INKBOUNDS  0x100  ///< Accelerators include ink bounds.
+#define PCF_COMPRESSED_METRICS 0x100  ///< Metrics are stored in bytes.
+#define PCF_BYTE_MSB           (1 << 2)  ///< Most significant byte first.
+#define PCF_BIT_MSB            (1 << 3)  ///< Most significant bit first.
+
+
+/**
+   @brief Metrics of one glyph, as stored in a PCF file.
+*/
+struct Metrics {
+   int lsb;       ///< Left side bearing.
+   int rsb;       ///< Right side bearing.
+   int width;     ///< Advance width.
+   int ascent;    ///< Rows above the baseline.
+   int descent;   ///< Rows below the baseline.
+};
+
+
+unsigned char *out = NULL;   ///< The PCF file, built in memory.
+size_t outlen  = 0;          ///< Number of bytes in out.
+size_t outroom = 0;          ///< Number of bytes allocated for out.
+int    msbyte  = 1;          ///< Write numbers most significant byte first.
+long   toc[NTABLES][4];      ///< Type, format, size, and offset of each table.
+int    ntables = 0;          ///< Number of tables in toc.
+
+
+/**
+   @brief The main function.
+
+   @param[in] argc The count of command line arguments.
+   @param[in] argv Pointer to array of command line arguments.
+   @return This program exits with status EXIT_SUCCESS or EXIT_FAILURE.
+*/
+int
+main (int argc, char *argv[])
+{
+   char *font_name = "Unifont";   /* XLFD FAMILY_NAME                  */
+   char *copyright = "";          /* COPYRIGHT property                */
+   char *version   = "1.0";       /* FONT_VERSION property             */
+   int   vpixels   = 16;          /* XLFD PIXEL_SIZE; vertical pixels  */
+   int   pad       = 4;           /* bytes to pad each bitmap row to   */
+   int   unit      = 1;           /* bytes per bitmap scan unit        */
+   int   bitmsb    = 1;           /* bitmaps store leftmost pixel in MSB */
+   int   gzip      = 0;           /* compress output with gzip         */
+   char *outname   = NULL;        /* output file name; NULL for stdout */
+   char *text;                    /* all input, read into memory       */
+   size_t textlen;                /* number of bytes in text           */
+   struct Glyph *glyphs;          /* index of glyphs in text           */
+   unsigned long nglyphs;         /* number of glyphs in the index     */
+   int   nfiles = 0;              /* number of input files named       */
+   int   i;                       /* loop variable                     */
+   char *arg, *value;             /* current option and its value      */
+
+   void build_font (struct Glyph *glyphs, unsigned long nglyphs,
+                    char *font_name, char *copyright, char *version,
+                    int vpixels, int pad, int unit, int bitmsb);
+   void write_output (char *outname, int gzip);
+
+   /*
+      Options are accepted as "--name value", "--name=value",
+      "-n value", or "-n=value", as in hex2bdf.  File names are
+      moved to the front of argv.
+   */
+   for (i = 1; i < argc; i++) {
+      arg = argv[i];
+      if (arg[0] != '-' || arg[1] == '\0') {
+         argv[nfiles++] = arg;
+         continue;
+      }
+      if (arg[1] == '-')
+         arg += 2;
+      else
+         arg += 1;
+      if (strcmp (arg, "gzip") == 0 || strcmp (arg, "z") == 0) {
+         gzip = 1;
+         continue;
+      }
+      value = strchr (arg, '=');
+      if (value != NULL)
+         *value++ = '\0';
+      else if (i + 1 < argc)
+         value = argv[++i];
+      if (value == NULL) {
+         fprintf (stderr, "hex2pcf: option %s needs a value.\n", argv[i]);
+         exit (EXIT_FAILURE);
+      }
+      if      (strcmp (arg, "font") == 0 || strcmp (arg, "f") == 0)
+         font_name = value;
+      else if (strcmp (arg, "copyright") == 0 || strcmp (arg, "c") == 0)
+         copyright = value;
+      else if (strcmp (arg, "version") == 0 || strcmp (arg, "v") == 0)
+         version = value;
+      else if (strcmp (arg, "output") == 0 || strcmp (arg, "o") == 0)
+         outname = value;
+      else if (strcmp (arg, "rows") == 0 || strcmp (arg, "r") == 0) {
+         vpixels = atoi (value);
+         if (vpixels <= 2 || vpixels > MAXROWS || vpixels % 4 != 0) {
+            fprintf (stderr, "hex2pcf: invalid number of rows: %s\n", value);
+            exit (EXIT_FAILURE);
+         }
+      }
+      else if (strcmp (arg, "pad") == 0 || strcmp (arg, "p") == 0) {
+         pad = atoi (value);
+         if (pad != 1 && pad != 2 && pad != 4 && pad != 8) {
+            fprintf (stderr, "hex2pcf: glyph padding must be 1, 2, 4, or 8.\n");
+            exit (EXIT_FAILURE);
+         }
+      }
+      else if (strcmp (arg, "unit") == 0 || strcmp (arg, "u") == 0) {
+         unit = atoi (value);
+         if (unit != 1 && unit != 2 && unit != 4) {
+            fprintf (stderr, "hex2pcf: scan unit must be 1, 2, or 4.\n");
+            exit (EXIT_FAILURE);
+         }
+      }
+      else if (strcmp (arg, "bit-order") == 0 &&
+               (strcmp (value, "msb") == 0 || strcmp (value, "lsb") == 0))
+         bitmsb = value[0] == 'm';
+      else if (strcmp (arg, "byte-order") == 0 &&
+               (strcmp (value, "msb") == 0 || strcmp (value, "lsb") == 0))
+         msbyte = value[0] == 'm';
+      else {
+         fprintf (stderr, "\nSyntax:\n\n");
+         fprintf (stderr, "   hex2pcf [--font name] [--rows n] ");
+         fprintf (stderr, "[--version string] [--copyright string]\n");
+         fprintf (stderr, "           [--pad 1|2|4|8] [--unit 1|2|4] ");
+         fprintf (stderr, "[--bit-order msb|lsb] [--byte-order msb|lsb]\n");
+         fprintf (stderr, "           [--gzip] [--output file] ");
+         fprintf (stderr, "[input.hex ...]\n\n");
+         exit (EXIT_FAILURE);
+      }
+   }
+   if (unit > pad) {
+      fprintf (stderr, "hex2pcf: scan unit cannot be larger than padding.\n");
+      exit (EXIT_FAILURE);
+   }
+
+   text   = read_input ("hex2pcf", argv, nfiles, &textlen);
+   glyphs = index_glyphs ("hex2pcf", text, textlen, &nglyphs);
+   build_font (glyphs, nglyphs, font_name, copyright, version,
+               vpixels, pad, unit, bitmsb);
+   write_output (outname, gzip);
+
+   exit (EXIT_SUCCESS);
+}
+
+
+/**
+   @brief Make room for more bytes at the end of the output.
+
+   @param[in] len The number of bytes about to be appended.
+*/
+void
+reserve (size_t len)
+{
+   if (outroom - outlen >= len)
+      return;
+   while (outroom - outlen < len)
+      outroom = outroom ? 2 * outroom : 1 << 22;
+   out = realloc (out, outroom);
+   if (out == NULL) {
+      fprintf (stderr, "hex2pcf: out of memory.\n");
+      exit (EXIT_FAILURE);
+   }
+}
+
+
+/**
+   @brief Append one byte to the output.
+
+   @param[in] value The byte to append.
+*/
+void
+put_byte (int value)
+{
+   reserve (1);
+   out[outlen++] = value & 0xFF;
+}
+
+
+/**
+   @brief Append a 16-bit number to the output, in the font's byte order.
+
+   @param[in] value The number to append.
+*/
+void
+put_int16 (int value)
+{
+   reserve (2);
+   if (msbyte) {
+      out[outlen++] = (value >> 8) & 0xFF;
+      out[outlen++] =  value       & 0xFF;
+   }
+   else {
+      out[outlen++] =  value       & 0xFF;
+      out[outlen++] = (value >> 8) & 0xFF;
+   }
+}
+
+
+/**
+   @brief Store a 32-bit number in the output, least significant byte first.
+
+   The file header and the first word of each table, which gives the
+   byte order of the rest, are always stored this way.
+
+   @param[in] where The offset in the output to store the number at.
+   @param[in] value The number to store.
+*/
+void
+set_lsb32 (size_t where, long value)
+{
+   out[where    ] =  value        & 0xFF;
+   out[where + 1] = (value >>  8) & 0xFF;
+   out[where + 2] = (value >> 16) & 0xFF;
+   out[where + 3] = (value >> 24) & 0xFF;
+}
+
+
+/**
+   @brief Append a 32-bit number to the output, in the font's byte order.
+
+   @param[in] value The number to append.
+*/
+void
+put_int32 (long value)
+{
+   reserve (4);
+   if (msbyte) {
+      out[outlen++] = (value >> 24) & 0xFF;
+      out[outlen++] = (value >> 16) & 0xFF;
+      out[outlen++] = (value >>  8) & 0xFF;
+      out[outlen++] =  value        & 0xFF;
+   }
+   else {
+      set_lsb32 (outlen, value);
+      outlen += 4;
+   }
+}
+
+
+/**
+   @brief Append the format word that starts a table.
+
+   @param[in] format The table format.
+*/
+void
+put_format (long format)
+{
+   reserve (4);
+   set_lsb32 (outlen, format);
+   outlen += 4;
+}
+
+
+/**
+   @brief Pad the output with zeroes to a multiple of four bytes.
+*/
+void
+put_pad (void)
+{
+   while (outlen % 4 != 0)
+      put_byte (0);
+}
+
+
+/**
+   @brief Append uncompressed glyph metrics to the output.
+
+   @param[in] m The metrics to append.
+*/
+void
+put_metrics (struct Metrics *m)
+{
+   put_int16 (m->lsb);
+   put_int16 (m->rsb);
+   put_int16 (m->width);
+   put_int16 (m->ascent);
+   put_int16 (m->descent);
+   put_int16 (0);  /* attributes */
+}
+
+
+/**
+   @brief Append a metrics or ink metrics table to the output.
+
+   The metrics are stored in one byte each if they all fit.
+
+   @param[in] metrics The metrics of each glyph.
+   @param[in] count The number of glyphs.
+   @param[in] format The format bits common to all tables.
+*/
+void
+put_metrics_table (struct Metrics *metrics, unsigned long count, long format)
+{
+   unsigned long i;
+   int compressed = count <= 0xFFFF;
+
+   for (i = 0; compressed && i < count; i++)
+      compressed = metrics[i].lsb     >= -128 && metrics[i].lsb     <= 127 &&
+                   metrics[i].rsb     >= -128 && metrics[i].rsb     <= 127 &&
+                   metrics[i].width   >= -128 && metrics[i].width   <= 127 &&
+                   metrics[i].ascent  >= -128 && metrics[i].ascent  <= 127 &&
+                   metrics[i].descent >= -128 && metrics[i].descent <= 127;
+   if (compressed) {
+      put_format (format | PCF_COMPRESSED_METRICS);
+      put_int16 (count);
+      reserve (5 * count);
+      for (i = 0; i < count; i++) {
+         out[outlen++] = metrics[i].lsb     + 0x80;
+         out[outlen++] = metrics[i].rsb     + 0x80;
+         out[outlen++] = metrics[i].width   + 0x80;
+         out[outlen++] = metrics[i].ascent  + 0x80;
+         out[outlen++] = metrics[i].descent + 0x80;
+      }
+   }
+   else {
+      put_format (format);
+      put_int32 (count);
+      for (i = 0; i < count; i++)
+         put_metrics (&metrics[i]);
+   }
+}
+
+
+/**
+   @brief Find the smallest and largest value of each field of some metrics.
+
+   @param[in] metrics The metrics of each glyph.
+   @param[in] count The number of glyphs.
+   @param[out] min The smallest value of each field.
+   @param[out] max The largest value of each field.
+*/
+void
+metrics_bounds (struct Metrics *metrics, unsigned long count,
+                struct Metrics *min, struct Metrics *max)
+{
+   unsigned long i;
+
+   memset (min, 0, sizeof (struct Metrics));
+   memset (max, 0, sizeof (struct Metrics));
+   for (i = 0; i < count; i++) {
+      if (i == 0 || metrics[i].lsb < min->lsb) min->lsb = metrics[i].lsb;
+      if (i == 0 || metrics[i].rsb < min->rsb) min->rsb = metrics[i].rsb;
+      if (i == 0 || metrics[i].width < min->width)
+         min->width = metrics[i].width;
+      if (i == 0 || metrics[i].ascent < min->ascent)
+         min->ascent = metrics[i].ascent;
+      if (i == 0 || metrics[i].descent < min->descent)
+         min->descent = metrics[i].descent;
+      if (i == 0 || metrics[i].lsb > max->lsb) max->lsb = metrics[i].lsb;
+      if (i == 0 || metrics[i].rsb > max->rsb) max->rsb = metrics[i].rsb;
+      if (i == 0 || metrics[i].width > max->width)
+         max->width = metrics[i].width;
+      if (i == 0 || metrics[i].ascent > max->ascent)
+         max->ascent = metrics[i].ascent;
+      if (i == 0 || metrics[i].descent > max->descent)
+         max->descent = metrics[i].descent;
+   }
+}
+
+
+/**
+   @brief Append an accelerators table to the output.
+
+   The flags are computed as the X server computes them for a font
+   that it loads.
+
+   @param[in] metrics The metrics of each glyph.
+   @param[in] ink The ink metrics of each glyph.
+   @param[in] count The number of glyphs.
+   @param[in] ascent The font ascent.
+   @param[in] descent The font descent.
+   @param[in] format The format bits common to all tables.
+*/
+void
+put_accelerators (struct Metrics *metrics, struct Metrics *ink,
+                  unsigned long count, int ascent, int descent, long format)
+{
+   struct Metrics min, max, inkmin, inkmax;
+   unsigned long i;
+   int overlap, max_overlap = 0;
+   int no_overlap, constant_metrics;
+
+   metrics_bounds (metrics, count, &min, &max);
+   metrics_bounds (ink, count, &inkmin, &inkmax);
+   for (i = 0; i < count; i++) {
+      overlap = metrics[i].rsb - metrics[i].width;
+      if (i == 0 || overlap > max_overlap) max_overlap = overlap;
+   }
+   no_overlap = max_overlap <= min.lsb;
+   constant_metrics = memcmp (&min, &max, sizeof (struct Metrics)) == 0;
+
+   put_format (format | PCF_ACCEL_W_INKBOUNDS);
+   put_byte (no_overlap);
+   put_byte (constant_metrics);
+   put_byte (constant_metrics && min.lsb == 0 && min.rsb == min.width &&
+             min.ascent == ascent && min.descent == descent);
+   put_byte (min.width == max.width);
+   put_byte (min.lsb >= 0 && max_overlap <= 0 &&
+             min.ascent >= -descent && max.ascent <= ascent &&
+             -min.descent <= ascent && max.descent <= descent);
+   put_byte (1);   /* ink metrics are present */
+   put_byte (0);   /* draw left to right */
+   put_byte (0);
+   put_int32 (ascent);
+   put_int32 (descent);
+   put_int32 (max_overlap);
+   put_metrics (&min);
+   put_metrics (&max);
+   put_metrics (&inkmin);
+   put_metrics (&inkmax);
+}
+
+
+/**
+   @brief Append the properties table to the output.
+
+   The properties are those hex2bdf writes, less FONT_ASCENT,
+   FONT_DESCENT, and DEFAULT_CHAR, which PCF keeps in the accelerators
+   and encodings tables.  As with bdftopcf, FONT, RESOLUTION, and
+   QUAD_WIDTH are added.
+
+   @param[in] font_name The XLFD FAMILY_NAME.
+   @param[in] copyright The COPYRIGHT property.
+   @param[in] version The FONT_VERSION property.
+   @param[in] vpixels The glyph height in pixels.
+   @param[in] quad_width The QUAD_WIDTH property.
+   @param[in] format The format bits common to all tables.
+*/
+void
+put_properties (char *font_name, char *copyright, char *version,
+                int vpixels, int quad_width, long format)
+{
+   char  xlfd[1024];
+   char  sizes[2][16];
+   char *strings[NPROPS][2];   /* name, and value if a string     */
+   long  values[NPROPS];       /* value if an integer             */
+   long  offset;
+   int   i, n = 0;
+
+   snprintf (xlfd, sizeof (xlfd),
+             "-gnu-%s-Medium-R-Normal-Sans-%d-%d-75-75-c-80-iso10646-1",
+             font_name, vpixels, 10 * vpixels);
+   snprintf (sizes[0], sizeof (sizes[0]), "%d", vpixels);
+   snprintf (sizes[1], sizeof (sizes[1]), "%d", 10 * vpixels);
+
+#define STRING_PROP(name, value) \
+   (strings[n][0] = (name), strings[n][1] = (value), values[n++] = 0)
+#define INTEGER_PROP(name, value) \
+   (strings[n][0] = (name), strings[n][1] = NULL, values[n++] = (value))
+
+   STRING_PROP  ("COPYRIGHT", copyright);
+   STRING_PROP  ("FONT_VERSION", version);
+   STRING_PROP  ("FONT_TYPE", "Bitmap");
+   STRING_PROP  ("FOUNDRY", "GNU");
+   STRING_PROP  ("FAMILY_NAME", font_name);
+   STRING_PROP  ("WEIGHT_NAME", "Medium");
+   STRING_PROP  ("SLANT", "R");
+   STRING_PROP  ("SETWIDTH_NAME", "Normal");
+   STRING_PROP  ("ADD_STYLE_NAME", "Sans Serif");
+   INTEGER_PROP ("PIXEL_SIZE", vpixels);
+   INTEGER_PROP ("POINT_SIZE", 10 * vpixels);
+   INTEGER_PROP ("RESOLUTION_X", 75);
+   INTEGER_PROP ("RESOLUTION_Y", 75);
+   STRING_PROP  ("SPACING", "C");
+   INTEGER_PROP ("AVERAGE_WIDTH", 80);
+   STRING_PROP  ("CHARSET_REGISTRY", "ISO10646");
+   STRING_PROP  ("CHARSET_ENCODING", "1");
+   INTEGER_PROP ("UNDERLINE_POSITION", -2);
+   INTEGER_PROP ("UNDERLINE_THICKNESS", 1);
+   INTEGER_PROP ("CAP_HEIGHT", 10);
+   INTEGER_PROP ("X_HEIGHT", 8);
+   STRING_PROP  ("FONT", xlfd);
+   INTEGER_PROP ("RESOLUTION", 75 * 100 * 100 / 7227);  /* 1/100ths of dpi */
+   INTEGER_PROP ("QUAD_WIDTH", quad_width);
+
+#undef STRING_PROP
+#undef INTEGER_PROP
+
+   put_format (format);
+   put_int32 (n);
+   offset = 0;
+   for (i = 0; i < n; i++) {
+      put_int32 (offset);
+      offset += strlen (strings[i][0]) + 1;
+      if (strings[i][1] != NULL) {
+         put_byte (1);
+         put_int32 (offset);
+         offset += strlen (strings[i][1]) + 1;
+      }
+      else {
+         put_byte (0);
+         put_int32 (values[i]);
+      }
+   }
+   put_pad ();
+   put_int32 (offset);
+   for (i = 0; i < n; i++) {
+      reserve (strlen (strings[i][0]) + 1);
+      memcpy (out + outlen, strings[i][0], strlen (strings[i][0]) + 1);
+      outlen += strlen (strings[i][0]) + 1;
+      if (strings[i][1] != NULL) {
+         reserve (strlen (strings[i][1]) + 1);
+         memcpy (out + outlen, strings[i][1], strlen (strings[i][1]) + 1);
+         outlen += strlen (strings[i][1]) + 1;
+      }
+   }
+}
+
+
+/**
+   @brief Convert a glyph from hexadecimal into rows of bytes.
+
+   @param[in] bitmap The hexadecimal digits of the glyph.
+   @param[in] digits The number of digits in each row.
+   @param[in] vpixels The number of rows.
+   @param[out] rows The glyph, (digits + 1) / 2 bytes per row,
+                    leftmost pixel in the most significant bit.
+*/
+void
+decode_glyph (char *bitmap, int digits, int vpixels,
+              unsigned char rows[MAXROWS][MAXCOLS / 8])
+{
+   int row, col, c, nybble;
+
+   for (row = 0; row < vpixels; row++) {
+      memset (rows[row], 0, (digits + 1) / 2);
+      for (col = 0; col < digits; col++) {
+         c = *bitmap++;
+         nybble = c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+         rows[row][col / 2] |= (col & 1) ? nybble : nybble << 4;
+      }
+   }
+}
+
+
+/**
+   @brief Find the bounding box of the pixels that are set in a glyph.
+
+   A blank glyph has an empty bounding box at the origin.
+
+   @param[in] rows The glyph, as returned by decode_glyph.
+   @param[in] width The glyph width in pixels.
+   @param[in] vpixels The number of rows.
+   @param[in] ascent The number of rows above the baseline.
+   @param[out] ink The ink metrics of the glyph.
+*/
+void
+glyph_ink (unsigned char rows[MAXROWS][MAXCOLS / 8], int width, int vpixels,
+           int ascent, struct Metrics *ink)
+{
+   int row, col;
+   int left = width, right = -1, top = -1, bottom = -1;
+
+   for (row = 0; row < vpixels; row++) {
+      for (col = 0; col < width; col++) {
+         if (rows[row][col / 8] & (0x80 >> (col % 8))) {
+            if (col < left)  left  = col;
+            if (col > right) right = col;
+            if (top < 0) top = row;
+            bottom = row;
+         }
+      }
+   }
+
+   ink->width = width;
+   if (top < 0) {
+      ink->lsb = ink->rsb = ink->ascent = ink->descent = 0;
+   }
+   else {
+      ink->lsb     = left;
+      ink->rsb     = right + 1;
+      ink->ascent  = ascent - top;
+      ink->descent = bottom + 1 - ascent;
+   }
+}
+
+
+/**
+   @brief Start a table at the end of the output.
+
+   @param[in] type The table type.
+*/
+void
+begin_table (long type)
+{
+   toc[ntables][0] = type;
+   toc[ntables][3] = outlen;
+}
+
+
+/**
+   @brief Finish the table that was started last, and pad it.
+
+   The table format is read back from the table's first word.
+*/
+void
+end_table (void)
+{
+   size_t start = toc[ntables][3];
+
+   put_pad ();
+   toc[ntables][1] = (long)out[start] | (long)out[start + 1] << 8 |
+                     (long)out[start + 2] << 16;
+   toc[ntables][2] = outlen - start;
+   ntables++;
+}
+
+
+/**
+   @brief Build the PCF font in memory.
+
+   @param[in] glyphs The glyphs to write, in order.
+   @param[in] nglyphs The number of glyphs.
+   @param[in] font_name The XLFD FAMILY_NAME.
+   @param[in] copyright The COPYRIGHT property.
+   @param[in] version The FONT_VERSION property.
+   @param[in] vpixels The glyph height in pixels.
+   @param[in] pad The number of bytes to pad each bitmap row to.
+   @param[in] unit The number of bytes in a bitmap scan unit.
+   @param[in] bitmsb 1 to store the leftmost pixel in the most
+                     significant bit of a byte, 0 for the least.
+*/
+void
+build_font (struct Glyph *glyphs, unsigned long nglyphs,
+            char *font_name, char *copyright, char *version,
+            int vpixels, int pad, int unit, int bitmsb)
+{
+   static unsigned char rows[MAXROWS][MAXCOLS / 8];
+   unsigned char reverse[256];      /* bits of each byte, reversed     */
+   unsigned short encoding[0x10000]; /* glyph index of each code point */
+   struct Metrics *metrics, *ink;
+   long   format;                   /* format bits common to all tables */
+   unsigned long i, count, names_size;
+   unsigned long bitmap_sizes[4];
+   int    ascent = vpixels - 2;
+   int    digits, rowbytes, padded, row, col, j;
+   int    min_width = 0, max_width = 0;
+   int    first_col = 0xFF, last_col = 0, first_row = 0xFF, last_row = 0;
+   unsigned char swap[8];
+
+   /* Glyphs above Plane 0 cannot be encoded; they are sorted last. */
+   for (count = 0; count < nglyphs && glyphs[count].codept <= 0xFFFF;
+        count++);
+   if (count < nglyphs)
+      fprintf (stderr, "hex2pcf: skipping %lu glyphs above U+FFFF.\n",
+               nglyphs - count);
+   if (count == 0) {
+      fprintf (stderr, "hex2pcf: no glyphs to write.\n");
+      exit (EXIT_FAILURE);
+   }
+
+   metrics = malloc (count * sizeof (struct Metrics));
+   ink     = malloc (count * sizeof (struct Metrics));
+   if (metrics == NULL || ink == NULL) {
+      fprintf (stderr, "hex2pcf: out of memory.\n");
+      exit (EXIT_FAILURE);
+   }
+
+   for (i = 0; i < 256; i++) {
+      reverse[i] = 0;
+      for (j = 0; j < 8; j++)
+         if (i & (1 << j)) reverse[i] |= 0x80 >> j;
+   }
+   for (i = 0; i < 0x10000; i++)
+      encoding[i] = 0xFFFF;
+
+   format = (unit == 4 ? 2 : unit == 2 ? 1 : 0) << 4 |
+            (bitmsb ? PCF_BIT_MSB : 0) | (msbyte ? PCF_BYTE_MSB : 0) |
+            (pad == 8 ? 3 : pad == 4 ? 2 : pad == 2 ? 1 : 0);
+
+   /* Reserve room for the header and table of contents. */
+   reserve (8 + 16 * NTABLES);
+   memset (out, 0, 8 + 16 * NTABLES);
+   outlen = 8 + 16 * NTABLES;
+
+   /* Fill in metrics first: the properties and accelerators need them. */
+   for (i = 0; i < count; i++) {
+      if (glyphs[i].bitlen % vpixels != 0 ||
+          glyphs[i].bitlen / vpixels > MAXCOLS / 4) {
+         fprintf (stderr, "hex2pcf: glyph %.*s is not %d rows high.\n",
+                  glyphs[i].keylen, glyphs[i].key, vpixels);
+         exit (EXIT_FAILURE);
+      }
+      digits = glyphs[i].bitlen / vpixels;
+      metrics[i].lsb     = 0;
+      metrics[i].rsb     = 4 * digits;
+      metrics[i].width   = 4 * digits;
+      metrics[i].ascent  = ascent;
+      metrics[i].descent = vpixels - ascent;
+      if (i == 0 || metrics[i].width < min_width) min_width = metrics[i].width;
+      if (i == 0 || metrics[i].width > max_width) max_width = metrics[i].width;
+      decode_glyph (glyphs[i].bitmap, digits, vpixels, rows);
+      glyph_ink (rows, metrics[i].width, vpixels, ascent, &ink[i]);
+
+      encoding[glyphs[i].codept] = i;
+      if ((glyphs[i].codept & 0xFF) < first_col)
+         first_col = glyphs[i].codept & 0xFF;
+      if ((glyphs[i].codept & 0xFF) > last_col)
+         last_col = glyphs[i].codept & 0xFF;
+      if ((glyphs[i].codept >> 8) < first_row)
+         first_row = glyphs[i].codept >> 8;
+      if ((glyphs[i].codept >> 8) > last_row)
+         last_row = glyphs[i].codept >> 8;
+   }
+
+   begin_table (PCF_PROPERTIES);
+   put_properties (font_name, copyright, version, vpixels,
+                   (min_width + max_width) / 2, format);
+   end_table ();
+
+   begin_table (PCF_ACCELERATORS);
+   put_accelerators (metrics, ink, count, ascent, vpixels - ascent, format);
+   end_table ();
+
+   begin_table (PCF_METRICS);
+   put_metrics_table (metrics, count, format);
+   end_table ();
+
+   /*
+      The bitmaps table holds the size the bitmaps would have with
+      each padding, but only the bitmaps with the chosen padding.
+   */
+   begin_table (PCF_BITMAPS);
+   put_format (format);
+   put_int32 (count);
+   for (j = 0; j < 4; j++)
+      bitmap_sizes[j] = 0;
+   for (i = 0; i < count; i++) {
+      put_int32 (bitmap_sizes[format & 3]);
+      rowbytes = (metrics[i].width + 7) / 8;
+      for (j = 0; j < 4; j++)
+         bitmap_sizes[j] += vpixels * (((rowbytes + (1 << j) - 1) >> j) << j);
+   }
+   for (j = 0; j < 4; j++)
+      put_int32 (bitmap_sizes[j]);
+   for (i = 0; i < count; i++) {
+      digits   = glyphs[i].bitlen / vpixels;
+      rowbytes = (digits + 1) / 2;
+      padded   = (rowbytes + pad - 1) / pad * pad;
+      decode_glyph (glyphs[i].bitmap, digits, vpixels, rows);
+      reserve (vpixels * padded);
+      for (row = 0; row < vpixels; row++) {
+         memset (rows[row] + rowbytes, 0, padded - rowbytes);
+         if (!bitmsb)
+            for (col = 0; col < padded; col++)
+               rows[row][col] = reverse[rows[row][col]];
+         /* The byte order applies within scan units if it differs from
+            the bit order. */
+         if (unit > 1 && msbyte != bitmsb) {
+            for (col = 0; col < padded; col += unit) {
+               for (j = 0; j < unit; j++)
+                  swap[j] = rows[row][col + unit - 1 - j];
+               memcpy (rows[row] + col, swap, unit);
+            }
+         }
+         memcpy (out + outlen, rows[row], padded);
+         outlen += padded;
+      }
+   }
+   end_table ();
+
+   begin_table (PCF_INK_METRICS);
+   put_metrics_table (ink, count, format);
+   end_table ();
+
+   begin_table (PCF_BDF_ENCODINGS);
+   put_format (format);
+   put_int16 (first_col);
+   put_int16 (last_col);
+   put_int16 (first_row);
+   put_int16 (last_row);
+   put_int16 (0xFFFD);   /* default character */
+   for (row = first_row; row <= last_row; row++)
+      for (col = first_col; col <= last_col; col++)
+         put_int16 (encoding[row << 8 | col]);
+   end_table ();
+
+   begin_table (PCF_SWIDTHS);
+   put_format (format);
+   put_int32 (count);
+   for (i = 0; i < count; i++)
+      put_int32 ((1000 * metrics[i].width + vpixels / 2) / vpixels);
+   end_table ();
+
+   begin_table (PCF_GLYPH_NAMES);
+   put_format (format);
+   put_int32 (count);
+   names_size = 0;
+   for (i = 0; i < count; i++) {
+      put_int32 (names_size);
+      names_size += glyphs[i].keylen + 3;   /* "U+", key, NUL */
+   }
+   put_int32 (names_size);
+   reserve (names_size);
+   for (i = 0; i < count; i++) {
+      out[outlen++] = 'U';
+      out[outlen++] = '+';
+      memcpy (out + outlen, glyphs[i].key, glyphs[i].keylen);
+      outlen += glyphs[i].keylen;
+      out[outlen++] = '\0';
+   }
+   end_table ();
+
+   begin_table (PCF_BDF_ACCELERATORS);
+   put_accelerators (metrics, ink, count, ascent, vpixels - ascent, format);
+   end_table ();
+
+   memcpy (out, "\1fcp", 4);
+   set_lsb32 (4, ntables);
+   for (j = 0; j < ntables; j++)
+      for (col = 0; col < 4; col++)
+         set_lsb32 (8 + 16 * j + 4 * col, toc[j][col]);
+
+   free (metrics);
+   free (ink);
+}
+
+
+/**
+   @brief Write the PCF font to a file or to stdout.
+
+   @param[in] outname The output file name, or NULL for stdout.
+   @param[in] gzip 1 to compress the output with gzip, 0 not to.
+*/
+void
+write_output (char *outname, int gzip)
+{
+   FILE *outfp;
+
+   if (gzip) {
+#ifdef HAVE_ZLIB
+      gzFile gz;
+
+      fflush (stdout);
+      if (outname == NULL)
+         gz = gzdopen (fileno (stdout), "wb9");
+      else
+         gz = gzopen (outname, "wb9");
+      if (gz == NULL) {
+         fprintf (stderr, "hex2pcf: can't open %s for output.\n",
+                  outname == NULL ? "stdout" : outname);
+         exit (EXIT_FAILURE);
+      }
+      if (gzwrite (gz, out, outlen) != (int)outlen || gzclose (gz) != Z_OK) {
+         fprintf (stderr, "hex2pcf: error writing compressed output.\n");
+         exit (EXIT_FAILURE);
+      }
+      return;
+#else
+      fprintf (stderr, "hex2pcf: built without zlib; can't use --gzip.\n");
+      exit (EXIT_FAILURE);
+#endif
+   }
+
+   if (outname == NULL)
+      outfp = stdout;
+   else if ((outfp = fopen (outname, "wb")) == NULL) {
+      fprintf (stderr, "hex2pcf: can't open %s for output.\n", outname);
+      exit (EXIT_FAILURE);
+   }
+   if (fwrite (out, 1, outlen, outfp) != outlen || fflush (outfp) != 0) {
+      fprintf (stderr, "hex2pcf: error writing output.\n");
+      exit (EXIT_FAILURE);
+   }
+   if (outfp != stdout)
+      fclose (outfp);
+}
@@ -0,0 +1,461 @@
+/**
+   @file hex2pf2.c
+
+   @brief hex2pf2 - Convert a GNU Unifont .hex file into a GRUB PF2 font
+
+   @author Paul Hardy
+
+   @copyright Copyright (C) 2023 Paul Hardy
+
+   This program reads glyphs in Unifont .hex format from the files
+   named on the command line, or from stdin if none are named, and
+   writes a font in the PF2 format of the GRUB boot loader.  It takes
+   the place of running grub-mkfont on a BDF or OpenType font.
+
+   Synopsis: hex2pf2 [--font name] [--rows n] [--range from-to[,...]]
+                     [--output file] [input.hex ...]
+
+   Only the glyphs in the ranges given with --range are written, so
+   that a boot font can hold just the scripts it needs.  Each glyph
+   bitmap is cropped to the pixels that are set, as grub-mkfont does.
+   The character index is sorted by code point, which GRUB relies on
+   to find glyphs with a binary search.
+*/
+/*
+   LICENSE:
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 2 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "unihex.h"
+
+#define MAXROWS    256   ///< Tallest glyph allowed, in pixels.
+#define MAXCOLS    256   ///< Widest glyph allowed, in pixels.
+#define MAXRANGES 1024   ///< Most code point ranges allowed.
+#define CHIX_ENTRY   9   ///< Bytes in each character index entry.
+
+
+/**
+   @brief A range of code points to include in the font.
+*/
+struct Range {
+   unsigned long first;   ///< First code point in the range.
+   unsigned long last;    ///< Last code point in the range.
+};
+
+
+unsigned char *out = NULL;   ///< The PF2 file, built in memory.
+size_t outlen  = 0;          ///< Number of bytes in out.
+size_t outroom = 0;          ///< Number of bytes allocated for out.
+
+
+/**
+   @brief The main function.
+
+   @param[in] argc The count of command line arguments.
+   @param[in] argv Pointer to array of command line arguments.
+   @return This program exits with status EXIT_SUCCESS or EXIT_FAILURE.
+*/
+int
+main (int argc, char *argv[])
+{
+   char *font_name = "Unifont";   /* font family name                  */
+   int   vpixels   = 16;          /* glyph height in pixels            */
+   char *outname   = NULL;        /* output file name; NULL for stdout */
+   struct Range ranges[MAXRANGES];   /* code points to include         */
+   int   nranges = 0;             /* number of ranges; 0 for all       */
+   char *text;                    /* all input, read into memory       */
+   size_t textlen;                /* number of bytes in text           */
+   struct Glyph *glyphs;          /* index of glyphs in text           */
+   unsigned long nglyphs;         /* number of glyphs in the index     */
+   unsigned long i, kept;         /* glyph indexes                     */
+   int   nfiles = 0;              /* number of input files named       */
+   int   j;                       /* loop variable                     */
+   char *arg, *value;             /* current option and its value      */
+   FILE *outfp;                   /* where to write the font           */
+
+   int  parse_ranges (char *list, struct Range *ranges, int nranges);
+   void build_font (struct Glyph *glyphs, unsigned long nglyphs,
+                    char *font_name, int vpixels);
+
+   /*
+      Options are accepted as "--name value", "--name=value",
+      "-n value", or "-n=value", as in hex2bdf.  File names are
+      moved to the front of argv.
+   */
+   for (j = 1; j < argc; j++) {
+      arg = argv[j];
+      if (arg[0] != '-' || arg[1] == '\0') {
+         argv[nfiles++] = arg;
+         continue;
+      }
+      if (arg[1] == '-')
+         arg += 2;
+      else
+         arg += 1;
+      value = strchr (arg, '=');
+      if (value != NULL)
+         *value++ = '\0';
+      else if (j + 1 < argc)
+         value = argv[++j];
+      if (value == NULL) {
+         fprintf (stderr, "hex2pf2: option %s needs a value.\n", argv[j]);
+         exit (EXIT_FAILURE);
+      }
+      if      (strcmp (arg, "font") == 0 || strcmp (arg, "f") == 0)
+         font_name = value;
+      else if (strcmp (arg, "output") == 0 || strcmp (arg, "o") == 0)
+         outname = value;
+      else if (strcmp (arg, "range") == 0 || strcmp (arg, "R") == 0)
+         nranges = parse_ranges (value, ranges, nranges);
+      else if (strcmp (arg, "rows") == 0 || strcmp (arg, "r") == 0) {
+         vpixels = atoi (value);
+         if (vpixels <= 2 || vpixels > MAXROWS) {
+            fprintf (stderr, "hex2pf2: invalid number of rows: %s\n", value);
+            exit (EXIT_FAILURE);
+         }
+      }
+      else {
+         fprintf (stderr, "\nSyntax:\n\n");
+         fprintf (stderr, "   hex2pf2 [--font name] [--rows n] ");
+         fprintf (stderr, "[--range from-to[,from-to...]]\n");
+         fprintf (stderr, "           [--output file] [input.hex ...]\n\n");
+         exit (EXIT_FAILURE);
+      }
+   }
+
+   text   = read_input ("hex2pf2", argv, nfiles, &textlen);
+   glyphs = index_glyphs ("hex2pf2", text, textlen, &nglyphs);
+
+   /* Keep only the glyphs in the ranges asked for. */
+   if (nranges > 0) {
+      kept = 0;
+      for (i = 0; i < nglyphs; i++) {
+         for (j = 0; j < nranges; j++)
+            if (glyphs[i].codept >= ranges[j].first &&
+                glyphs[i].codept <= ranges[j].last)
+               break;
+         if (j < nranges)
+            glyphs[kept++] = glyphs[i];
+      }
+      nglyphs = kept;
+   }
+   if (nglyphs == 0) {
+      fprintf (stderr, "hex2pf2: no glyphs to write.\n");
+      exit (EXIT_FAILURE);
+   }
+
+   build_font (glyphs, nglyphs, font_name, vpixels);
+
+   if (outname == NULL)
+      outfp = stdout;
+   else if ((outfp = fopen (outname, "wb")) == NULL) {
+      fprintf (stderr, "hex2pf2: can't open %s for output.\n", outname);
+      exit (EXIT_FAILURE);
+   }
+   if (fwrite (out, 1, outlen, outfp) != outlen || fflush (outfp) != 0) {
+      fprintf (stderr, "hex2pf2: error writing output.\n");
+      exit (EXIT_FAILURE);
+   }
+   if (outfp != stdout)
+      fclose (outfp);
+
+   exit (EXIT_SUCCESS);
+}
+
+
+/**
+   @brief Add the code point ranges in a list to the ranges so far.
+
+   The list has the form of grub-mkfont's --range option: ranges
+   "from-to" of hexadecimal code points, separated by commas.  A
+   range can also be one code point.  "U+" or "0x" before a code
+   point is allowed.
+
+   @param[in] list The list of ranges.
+   @param[out] ranges The array of ranges to add to.
+   @param[in] nranges The number of ranges already in the array.
+   @return The number of ranges in the array now.
+*/
+int
+parse_ranges (char *list, struct Range *ranges, int nranges)
+{
+   char *p = list, *end;
+
+   while (*p != '\0') {
+      if (nranges == MAXRANGES) {
+         fprintf (stderr, "hex2pf2: too many ranges.\n");
+         exit (EXIT_FAILURE);
+      }
+      if ((p[0] == 'U' || p[0] == 'u') && p[1] == '+') p += 2;
+      ranges[nranges].first = strtoul (p, &end, 16);
+      if (end == p) break;
+      p = end;
+      if (*p == '-') {
+         p++;
+         if ((p[0] == 'U' || p[0] == 'u') && p[1] == '+') p += 2;
+         ranges[nranges].last = strtoul (p, &end, 16);
+         if (end == p) break;
+         p = end;
+      }
+      else
+         ranges[nranges].last = ranges[nranges].first;
+      if (ranges[nranges].last < ranges[nranges].first) break;
+      nranges++;
+      if (*p == ',')
+         p++;
+      else if (*p != '\0')
+         break;
+   }
+   if (*p != '\0') {
+      fprintf (stderr, "hex2pf2: invalid range list: %s\n", list);
+      exit (EXIT_FAILURE);
+   }
+   return nranges;
+}
+
+
+/**
+   @brief Make room for more bytes at the end of the output.
+
+   @param[in] len The number of bytes about to be appended.
+*/
+void
+reserve (size_t len)
+{
+   if (outroom - outlen >= len)
+      return;
+   while (outroom - outlen < len)
+      outroom = outroom ? 2 * outroom : 1 << 20;
+   out = realloc (out, outroom);
+   if (out == NULL) {
+      fprintf (stderr, "hex2pf2: out of memory.\n");
+      exit (EXIT_FAILURE);
+   }
+}
+
+
+/**
+   @brief Append a number to the output, most significant byte first.
+
+   PF2 stores all numbers this way.
+
+   @param[in] value The number to append.
+   @param[in] nbytes The number of bytes to write it in.
+*/
+void
+put_msb (unsigned long value, int nbytes)
+{
+   reserve (nbytes);
+   while (nbytes-- > 0)
+      out[outlen++] = (value >> (8 * nbytes)) & 0xFF;
+}
+
+
+/**
+   @brief Store a 32-bit number in the output, most significant byte first.
+
+   @param[in] where The offset in the output to store the number at.
+   @param[in] value The number to store.
+*/
+void
+set_msb32 (size_t where, unsigned long value)
+{
+   out[where    ] = (value >> 24) & 0xFF;
+   out[where + 1] = (value >> 16) & 0xFF;
+   out[where + 2] = (value >>  8) & 0xFF;
+   out[where + 3] =  value        & 0xFF;
+}
+
+
+/**
+   @brief Append a section holding a string to the output.
+
+   @param[in] name The four-letter section name.
+   @param[in] value The string, which is stored with its final null.
+*/
+void
+put_string_section (const char *name, const char *value)
+{
+   size_t len = strlen (value) + 1;
+
+   reserve (8 + len);
+   memcpy (out + outlen, name, 4);
+   outlen += 4;
+   put_msb (len, 4);
+   memcpy (out + outlen, value, len);
+   outlen += len;
+}
+
+
+/**
+   @brief Append a section holding a 16-bit number to the output.
+
+   @param[in] name The four-letter section name.
+   @param[in] value The number.
+*/
+void
+put_short_section (const char *name, int value)
+{
+   reserve (4);
+   memcpy (out + outlen, name, 4);
+   outlen += 4;
+   put_msb (2, 4);
+   put_msb (value, 2);
+}
+
+
+/**
+   @brief Append the data of one glyph to the output.
+
+   The bitmap is cropped to the pixels that are set, and stored with
+   no padding between rows.
+
+   @param[in] glyph The glyph.
+   @param[in] vpixels The glyph height in pixels.
+   @param[in] ascent The number of rows above the baseline.
+   @return The advance width of the glyph.
+*/
+int
+put_glyph (struct Glyph *glyph, int vpixels, int ascent)
+{
+   static unsigned char pixels[MAXROWS][MAXCOLS];
+   int digits, width;
+   int row, col, c, nybble;
+   int left, right, top, bottom;
+   unsigned long nbits, bit;
+
+   if (glyph->bitlen % vpixels != 0 ||
+       glyph->bitlen / vpixels > MAXCOLS / 4) {
+      fprintf (stderr, "hex2pf2: glyph %.*s is not %d rows high.\n",
+               glyph->keylen, glyph->key, vpixels);
+      exit (EXIT_FAILURE);
+   }
+   digits = glyph->bitlen / vpixels;
+   width  = 4 * digits;
+
+   left = width; right = -1; top = -1; bottom = -1;
+   for (row = 0; row < vpixels; row++) {
+      for (col = 0; col < digits; col++) {
+         c = glyph->bitmap[row * digits + col];
+         nybble = c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+         for (c = 0; c < 4; c++) {
+            pixels[row][4 * col + c] = (nybble >> (3 - c)) & 1;
+            if (pixels[row][4 * col + c]) {
+               if (4 * col + c < left)  left  = 4 * col + c;
+               if (4 * col + c > right) right = 4 * col + c;
+               if (top < 0) top = row;
+               bottom = row;
+            }
+         }
+      }
+   }
+
+   if (top < 0) {  /* a blank glyph has an empty bitmap */
+      put_msb (0, 2);
+      put_msb (0, 2);
+      put_msb (0, 2);
+      put_msb (0, 2);
+      put_msb (width, 2);
+      return width;
+   }
+
+   put_msb (right - left + 1, 2);       /* bitmap width              */
+   put_msb (bottom - top + 1, 2);       /* bitmap height             */
+   put_msb (left, 2);                   /* x offset                  */
+   put_msb ((ascent - bottom - 1) & 0xFFFF, 2);  /* y offset of bottom */
+   put_msb (width, 2);                  /* device width              */
+
+   nbits = (unsigned long)(right - left + 1) * (bottom - top + 1);
+   reserve ((nbits + 7) / 8);
+   memset (out + outlen, 0, (nbits + 7) / 8);
+   bit = 0;
+   for (row = top; row <= bottom; row++) {
+      for (col = left; col <= right; col++, bit++)
+         if (pixels[row][col])
+            out[outlen + bit / 8] |= 0x80 >> (bit % 8);
+   }
+   outlen += (nbits + 7) / 8;
+   return width;
+}
+
+
+/**
+   @brief Build the PF2 font in memory.
+
+   The sections are those that grub-mkfont writes, in the same order.
+
+   @param[in] glyphs The glyphs to write, in ascending code point order.
+   @param[in] nglyphs The number of glyphs.
+   @param[in] font_name The font family name.
+   @param[in] vpixels The glyph height in pixels.
+*/
+void
+build_font (struct Glyph *glyphs, unsigned long nglyphs,
+            char *font_name, int vpixels)
+{
+   char   full_name[1024];
+   int    ascent = vpixels - 2;
+   int    width, max_width = 0;
+   size_t maxw_at, chix_at;
+   unsigned long i;
+
+   snprintf (full_name, sizeof (full_name), "%s Regular %d",
+             font_name, vpixels);
+
+   reserve (12);
+   memcpy (out + outlen, "FILE", 4);
+   outlen += 4;
+   put_msb (4, 4);
+   memcpy (out + outlen, "PFF2", 4);
+   outlen += 4;
+   put_string_section ("NAME", full_name);
+   put_string_section ("FAMI", font_name);
+   put_string_section ("WEIG", "normal");
+   put_string_section ("SLAN", "normal");
+   put_short_section ("PTSZ", vpixels);
+   maxw_at = outlen + 8;   /* filled in once the glyphs are written */
+   put_short_section ("MAXW", 0);
+   put_short_section ("MAXH", vpixels);
+   put_short_section ("ASCE", ascent);
+   put_short_section ("DESC", vpixels - ascent);
+
+   /* The index is filled in as the glyph data are written. */
+   reserve (8 + CHIX_ENTRY * nglyphs);
+   memcpy (out + outlen, "CHIX", 4);
+   outlen += 4;
+   put_msb (CHIX_ENTRY * nglyphs, 4);
+   chix_at = outlen;
+   outlen += CHIX_ENTRY * nglyphs;
+
+   /* The DATA section runs to the end of the file. */
+   reserve (8);
+   memcpy (out + outlen, "DATA", 4);
+   outlen += 4;
+   put_msb (0xFFFFFFFF, 4);
+
+   for (i = 0; i < nglyphs; i++) {
+      set_msb32 (chix_at + CHIX_ENTRY * i, glyphs[i].codept);
+      out[chix_at + CHIX_ENTRY * i + 4] = 0;   /* not compressed */
+      set_msb32 (chix_at + CHIX_ENTRY * i + 5, outlen);
+      width = put_glyph (&glyphs[i], vpixels, ascent);
+      if (width > max_width) max_width = width;
+   }
+   out[maxw_at]     = (max_width >> 8) & 0xFF;
+   out[maxw_at + 1] =  max_width       & 0xFF;
+}
@@ -0,0 +1,788 @@
+/**
+   @file hex2psf.c
+
+   @brief hex2psf - Convert a GNU Unifont .hex file into Linux console fonts
+
+   @author Paul Hardy
+
+   @copyright Copyright (C) 2023 Paul Hardy
+
+   This program reads glyphs in Unifont .hex format from the files
+   named on the command line, or from stdin if none are named, and
+   writes one or more PC Screen Font (PSF) console fonts with a Unicode
+   table.  It takes the place of running hex2bdf and then bdf2psf.
+
+   Synopsis: hex2psf [--rows n] [--width n] [--size n] [--psf1|--psf2]
+                     [--gzip] [--equivalents file[+file...]]
+                     --symbols file[+file...] [--output file] ...
+                     [input.hex ...]
+
+   The symbols and equivalents files have the same format as those of
+   bdf2psf.  A symbols file lists the code points to put in the font,
+   one "U+hhhh" per line.  An equivalents file lists code points, one
+   line per group, that can share one glyph.  Text after "#" is a
+   comment.
+
+   Each --output option writes a font from the options given before
+   it, so several fonts can be made from one reading of the input.
+   Options keep their values for the fonts that follow.  If there is
+   no --output option, one font is written to stdout.
+
+   Glyphs and positions are chosen as bdf2psf chooses them, so that a
+   PSF1 font is the same as the one bdf2psf makes from the same glyphs.
+   Each line of an equivalents file adds its code points after the
+   first to the group of its first code point, repeats and all.  A
+   symbol and its group share one glyph: that of the last code point
+   in the group with a glyph that fits.  Its Unicode table entry lists
+   the group from last to first, and it goes at the Code Page 437
+   position of the first code point in that order that has a free
+   one, so that the font also works without its Unicode table.  The
+   other glyphs fill the remaining positions in the order of the
+   symbols files.
+*/
+/*
+   LICENSE:
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 2 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "unihex.h"
+
+#define MAXUNI   0x110000  ///< One past the highest Unicode code point.
+#define MAXLINE  4096      ///< Longest line in a symbols or equivalents file.
+#define MAXROWS  64        ///< Tallest glyph allowed, in pixels.
+#define MAXCOLS  32        ///< Widest glyph allowed, in pixels.
+
+#define PSF1_MAGIC   0x0436      ///< First two bytes of a PSF1 font.
+#define PSF1_MODE512 0x01        ///< PSF1 font has 512 glyphs.
+#define PSF1_MODEHASTAB 0x02     ///< PSF1 font has a Unicode table.
+#define PSF2_MAGIC   0x864AB572  ///< First four bytes of a PSF2 font.
+#define PSF2_HAS_UNICODE_TABLE 0x01  ///< PSF2 font has a Unicode table.
+
+
+/**
+   @brief The options for one output font.
+*/
+struct Variant {
+   char *equivalents;   ///< Equivalents file names, joined by "+".
+   char *symbols;       ///< Symbols file names, joined by "+".
+   char *output;        ///< Output file name, or NULL for stdout.
+   int   rows;          ///< Glyph height in pixels.
+   int   width;         ///< Glyph width in pixels.
+   int   size;          ///< Number of glyphs in the font.
+   int   psf1;          ///< 1 to write PSF1, 0 to write PSF2.
+   int   gzip;          ///< 1 to compress the font with gzip.
+};
+
+
+/*
+   Code point of the glyph at each Code Page 437 position, including
+   the graphic characters in the control code positions.
+*/
+static const unsigned cp437[256] = {
+   0x0000, 0x263A, 0x263B, 0x2665, 0x2666, 0x2663, 0x2660, 0x2022,
+   0x25D8, 0x25CB, 0x25D9, 0x2642, 0x2640, 0x266A, 0x266B, 0x263C,
+   0x25BA, 0x25C4, 0x2195, 0x203C, 0x00B6, 0x00A7, 0x25AC, 0x21A8,
+   0x2191, 0x2193, 0x2192, 0x2190, 0x221F, 0x2194, 0x25B2, 0x25BC,
+   0x0020, 0x0021, 0x0022, 0x0023, 0x0024, 0x0025, 0x0026, 0x0027,
+   0x0028, 0x0029, 0x002A, 0x002B, 0x002C, 0x002D, 0x002E, 0x002F,
+   0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,
+   0x0038, 0x0039, 0x003A, 0x003B, 0x003C, 0x003D, 0x003E, 0x003F,
+   0x0040, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+   0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F,
+   0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057,
+   0x0058, 0x0059, 0x005A, 0x005B, 0x005C, 0x005D, 0x005E, 0x005F,
+   0x0060, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+   0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+   0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077,
+   0x0078, 0x0079, 0x007A, 0x007B, 0x007C, 0x007D, 0x007E, 0x2302,
+   0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7,
+   0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+   0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9,
+   0x00FF, 0x00D6, 0x00DC, 0x00A2, 0x00A3, 0x00A5, 0x20A7, 0x0192,
+   0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA,
+   0x00BF, 0x2310, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,
+   0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556,
+   0x2555, 0x2563, 0x2551, 0x2557, 0x255D, 0x255C, 0x255B, 0x2510,
+   0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x255E, 0x255F,
+   0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x2567,
+   0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256B,
+   0x256A, 0x2518, 0x250C, 0x2588, 0x2584, 0x258C, 0x2590, 0x2580,
+   0x03B1, 0x00DF, 0x0393, 0x03C0, 0x03A3, 0x03C3, 0x00B5, 0x03C4,
+   0x03A6, 0x0398, 0x03A9, 0x03B4, 0x221E, 0x03C6, 0x03B5, 0x2229,
+   0x2261, 0x00B1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00F7, 0x2248,
+   0x00B0, 0x2219, 0x00B7, 0x221A, 0x207F, 0x00B2, 0x25A0, 0x00A0
+};
+
+
+/**
+   @brief A growing list of code points.
+*/
+struct CodeList {
+   unsigned long *codepts;   ///< The code points.
+   unsigned long  count;     ///< Number of code points in the list.
+   unsigned long  room;      ///< Number of code points allocated.
+};
+
+
+struct Glyph *glyphs;       ///< Index of the glyphs in the input.
+long *glyph_of;             ///< Index in glyphs of each code point, or -1.
+long *group_of;             ///< Equivalents group of each code point, or -1.
+struct CodeList *groups;    ///< The equivalents groups.
+long ngroups    = 0;        ///< Number of equivalents groups.
+long groupsroom = 0;        ///< Number of groups allocated.
+
+unsigned char *out = NULL;  ///< The font being written, built in memory.
+size_t outlen  = 0;         ///< Number of bytes in out.
+size_t outroom = 0;         ///< Number of bytes allocated for out.
+
+
+/**
+   @brief The main function.
+
+   @param[in] argc The count of command line arguments.
+   @param[in] argv Pointer to array of command line arguments.
+   @return This program exits with status EXIT_SUCCESS or EXIT_FAILURE.
+*/
+int
+main (int argc, char *argv[])
+{
+   struct Variant current;        /* options for the next font          */
+   struct Variant *variants;      /* options for each font to write     */
+   int   nvariants = 0;           /* number of fonts to write           */
+   char *text;                    /* all input, read into memory        */
+   size_t textlen;                /* number of bytes in text            */
+   unsigned long nglyphs;         /* number of glyphs in the index      */
+   unsigned long i;               /* loop variable                      */
+   int   nfiles = 0;              /* number of input files named        */
+   int   argi;                    /* index of the current argument      */
+   char *arg, *value;             /* current option and its value       */
+
+   void check_variant (struct Variant *variant);
+   void write_variant (struct Variant *variant);
+
+   memset (&current, 0, sizeof (current));
+   current.rows  = 16;
+   current.width = 8;
+   current.size  = 512;
+   variants = malloc (argc * sizeof (struct Variant));
+   if (variants == NULL) {
+      fprintf (stderr, "hex2psf: out of memory.\n");
+      exit (EXIT_FAILURE);
+   }
+
+   /*
+      Options are accepted as "--name value", "--name=value",
+      "-n value", or "-n=value", as in hex2bdf.  File names are
+      moved to the front of argv.
+   */
+   for (argi = 1; argi < argc; argi++) {
+      arg = argv[argi];
+      if (arg[0] != '-' || arg[1] == '\0') {
+         argv[nfiles++] = arg;
+         continue;
+      }
+      if (arg[1] == '-')
+         arg += 2;
+      else
+         arg += 1;
+      if (strcmp (arg, "gzip") == 0 || strcmp (arg, "z") == 0) {
+         current.gzip = 1;
+         continue;
+      }
+      if (strcmp (arg, "psf1") == 0 || strcmp (arg, "psf2") == 0) {
+         current.psf1 = arg[3] == '1';
+         continue;
+      }
+      value = strchr (arg, '=');
+      if (value != NULL)
+         *value++ = '\0';
+      else if (argi + 1 < argc)
+         value = argv[++argi];
+      if (value == NULL) {
+         fprintf (stderr, "hex2psf: option %s needs a value.\n", argv[argi]);
+         exit (EXIT_FAILURE);
+      }
+      if      (strcmp (arg, "equivalents") == 0 || strcmp (arg, "e") == 0)
+         current.equivalents = value;
+      else if (strcmp (arg, "symbols") == 0 || strcmp (arg, "s") == 0)
+         current.symbols = value;
+      else if (strcmp (arg, "rows") == 0 || strcmp (arg, "r") == 0)
+         current.rows = atoi (value);
+      else if (strcmp (arg, "width") == 0 || strcmp (arg, "w") == 0)
+         current.width = atoi (value);
+      else if (strcmp (arg, "size") == 0 || strcmp (arg, "n") == 0)
+         current.size = atoi (value);
+      else if (strcmp (arg, "output") == 0 || strcmp (arg, "o") == 0) {
+         current.output = value;
+         check_variant (&current);
+         variants[nvariants++] = current;
+      }
+      else {
+         fprintf (stderr, "\nSyntax:\n\n");
+         fprintf (stderr, "   hex2psf [--rows n] [--width n] [--size n] ");
+         fprintf (stderr, "[--psf1|--psf2] [--gzip]\n");
+         fprintf (stderr, "           [--equivalents file[+file...]] ");
+         fprintf (stderr, "--symbols file[+file...]\n");
+         fprintf (stderr, "           [--output file] ... ");
+         fprintf (stderr, "[input.hex ...]\n\n");
+         exit (EXIT_FAILURE);
+      }
+   }
+   if (nvariants == 0) {
+      current.output = NULL;
+      check_variant (&current);
+      variants[nvariants++] = current;
+   }
+
+   text   = read_input ("hex2psf", argv, nfiles, &textlen);
+   glyphs = index_glyphs ("hex2psf", text, textlen, &nglyphs);
+
+   /* Index the glyphs by code point, for constant time lookup. */
+   glyph_of = malloc (MAXUNI * sizeof (long));
+   group_of = malloc (MAXUNI * sizeof (long));
+   if (glyph_of == NULL || group_of == NULL) {
+      fprintf (stderr, "hex2psf: out of memory.\n");
+      exit (EXIT_FAILURE);
+   }
+   for (i = 0; i < MAXUNI; i++)
+      glyph_of[i] = -1;
+   for (i = 0; i < nglyphs; i++)
+      if (glyphs[i].codept < MAXUNI)
+         glyph_of[glyphs[i].codept] = i;
+
+   for (argi = 0; argi < nvariants; argi++)
+      write_variant (&variants[argi]);
+
+   exit (EXIT_SUCCESS);
+}
+
+
+/**
+   @brief Check that the options for one font make sense.
+
+   @param[in] variant The options for the font.
+*/
+void
+check_variant (struct Variant *variant)
+{
+   if (variant->symbols == NULL) {
+      fprintf (stderr, "hex2psf: no symbols file given.\n");
+      exit (EXIT_FAILURE);
+   }
+   if (variant->rows <= 0 || variant->rows > MAXROWS) {
+      fprintf (stderr, "hex2psf: rows must be from 1 to %d.\n", MAXROWS);
+      exit (EXIT_FAILURE);
+   }
+   if (variant->width <= 0 || variant->width > MAXCOLS) {
+      fprintf (stderr, "hex2psf: width must be from 1 to %d.\n", MAXCOLS);
+      exit (EXIT_FAILURE);
+   }
+   if (variant->size <= 0 || variant->size > 0xFFFF) {
+      fprintf (stderr, "hex2psf: invalid font size %d.\n", variant->size);
+      exit (EXIT_FAILURE);
+   }
+   if (variant->psf1 && (variant->width != 8 ||
+                         (variant->size != 256 && variant->size != 512))) {
+      fprintf (stderr, "hex2psf: a PSF1 font must be 8 pixels wide ");
+      fprintf (stderr, "with 256 or 512 glyphs.\n");
+      exit (EXIT_FAILURE);
+   }
+#ifndef HAVE_ZLIB
+   if (variant->gzip) {
+      fprintf (stderr, "hex2psf: built without zlib; can't use --gzip.\n");
+      exit (EXIT_FAILURE);
+   }
+#endif
+}
+
+
+/**
+   @brief Add a code point to the end of a list.
+
+   @param[in,out] list The list.
+   @param[in] codept The code point.
+*/
+void
+add_codept (struct CodeList *list, unsigned long codept)
+{
+   if (list->count == list->room) {
+      list->room = list->room ? 2 * list->room : 16;
+      list->codepts = realloc (list->codepts,
+                               list->room * sizeof (unsigned long));
+      if (list->codepts == NULL) {
+         fprintf (stderr, "hex2psf: out of memory.\n");
+         exit (EXIT_FAILURE);
+      }
+   }
+   list->codepts[list->count++] = codept;
+}
+
+
+/**
+   @brief Get the equivalents group of a code point.
+
+   A code point that is in no group is a group by itself.
+
+   @param[in] codept Pointer to the code point.
+   @param[out] n The number of code points in the group.
+   @return The code points of the group, in the order they were added.
+*/
+unsigned long *
+group_members (unsigned long *codept, unsigned long *n)
+{
+   if (group_of[*codept] < 0) {
+      *n = 1;
+      return codept;
+   }
+   *n = groups[group_of[*codept]].count;
+   return groups[group_of[*codept]].codepts;
+}
+
+
+/**
+   @brief Read the code points on each line of a list of files.
+
+   Each "U+hhhh" before a "#" on a line gives one code point.  The
+   handler is called once for each line that has any.
+
+   @param[in] names The file names, joined by "+".
+   @param[in] handler The function to call with the code points of a line.
+   @param[in] data Passed on to the handler.
+*/
+void
+read_codepoints (char *names,
+                 void (*handler) (unsigned long *codepts, int n, void *data),
+                 void *data)
+{
+   char  line[MAXLINE];
+   char  name[MAXLINE];
+   unsigned long codepts[MAXLINE / 3];
+   char *p, *end;
+   int   n, len;
+   FILE *fp;
+
+   while (*names != '\0') {
+      len = strcspn (names, "+");
+      if (len >= MAXLINE) len = MAXLINE - 1;
+      memcpy (name, names, len);
+      name[len] = '\0';
+      names += len;
+      if (*names == '+') names++;
+
+      if ((fp = fopen (name, "r")) == NULL) {
+         fprintf (stderr, "hex2psf: can't open %s for input.\n", name);
+         exit (EXIT_FAILURE);
+      }
+      while (fgets (line, MAXLINE, fp) != NULL) {
+         if ((p = strchr (line, '#')) != NULL)
+            *p = '\0';
+         n = 0;
+         for (p = line; (p = strstr (p, "U+")) != NULL; p = end) {
+            p += 2;
+            codepts[n] = strtoul (p, &end, 16);
+            if (end > p && codepts[n] < MAXUNI)
+               n++;
+         }
+         if (n > 0)
+            handler (codepts, n, data);
+      }
+      fclose (fp);
+   }
+}
+
+
+/**
+   @brief Add the code points on a line of an equivalents file to a group.
+
+   As in bdf2psf, the code points after the first are added to the
+   group of the first code point, which is made if it does not exist,
+   even if they are in that group already.
+
+   @param[in] codepts The code points on the line.
+   @param[in] n The number of code points.
+   @param[in] data Not used.
+*/
+void
+equivalents_line (unsigned long *codepts, int n, void *data)
+{
+   long g;
+   int  i;
+
+   g = group_of[codepts[0]];
+   if (g < 0) {
+      if (ngroups == groupsroom) {
+         groupsroom = groupsroom ? 2 * groupsroom : 64;
+         groups = realloc (groups, groupsroom * sizeof (struct CodeList));
+         if (groups == NULL) {
+            fprintf (stderr, "hex2psf: out of memory.\n");
+            exit (EXIT_FAILURE);
+         }
+      }
+      g = ngroups++;
+      memset (&groups[g], 0, sizeof (struct CodeList));
+      add_codept (&groups[g], codepts[0]);
+      group_of[codepts[0]] = g;
+   }
+   for (i = 1; i < n; i++) {
+      add_codept (&groups[g], codepts[i]);
+      group_of[codepts[i]] = g;
+   }
+}
+
+
+/**
+   @brief Add the code points on a line of a symbols file to a list.
+
+   @param[in] codepts The code points on the line.
+   @param[in] n The number of code points.
+   @param[in,out] data The struct CodeList to add them to.
+*/
+void
+symbols_line (unsigned long *codepts, int n, void *data)
+{
+   int i;
+
+   for (i = 0; i < n; i++)
+      add_codept (data, codepts[i]);
+}
+
+
+/**
+   @brief Make room for more bytes at the end of the output.
+
+   @param[in] len The number of bytes about to be appended.
+*/
+void
+reserve (size_t len)
+{
+   if (outroom - outlen >= len)
+      return;
+   while (outroom - outlen < len)
+      outroom = outroom ? 2 * outroom : 1 << 16;
+   out = realloc (out, outroom);
+   if (out == NULL) {
+      fprintf (stderr, "hex2psf: out of memory.\n");
+      exit (EXIT_FAILURE);
+   }
+}
+
+
+/**
+   @brief Append a number to the output, least significant byte first.
+
+   @param[in] value The number to append.
+   @param[in] nbytes The number of bytes to write it in.
+*/
+void
+put_lsb (unsigned long value, int nbytes)
+{
+   reserve (nbytes);
+   while (nbytes-- > 0) {
+      out[outlen++] = value & 0xFF;
+      value >>= 8;
+   }
+}
+
+
+/**
+   @brief Append a code point to the output in UTF-8.
+
+   @param[in] codept The code point.
+*/
+void
+put_utf8 (unsigned long codept)
+{
+   reserve (4);
+   if (codept < 0x80)
+      out[outlen++] = codept;
+   else if (codept < 0x800) {
+      out[outlen++] = 0xC0 |  (codept >> 6);
+      out[outlen++] = 0x80 |  (codept        & 0x3F);
+   }
+   else if (codept < 0x10000) {
+      out[outlen++] = 0xE0 |  (codept >> 12);
+      out[outlen++] = 0x80 | ((codept >>  6) & 0x3F);
+      out[outlen++] = 0x80 |  (codept        & 0x3F);
+   }
+   else {
+      out[outlen++] = 0xF0 |  (codept >> 18);
+      out[outlen++] = 0x80 | ((codept >> 12) & 0x3F);
+      out[outlen++] = 0x80 | ((codept >>  6) & 0x3F);
+      out[outlen++] = 0x80 |  (codept        & 0x3F);
+   }
+}
+
+
+/**
+   @brief Return whether the input has a glyph for a code point that fits.
+
+   @param[in] codept The code point.
+   @param[in] variant The options for the font.
+   @return 1 if the glyph exists and fits in the font, 0 if not.
+*/
+int
+glyph_fits (unsigned long codept, struct Variant *variant)
+{
+   struct Glyph *glyph;
+
+   if (glyph_of[codept] < 0)
+      return 0;
+   glyph = &glyphs[glyph_of[codept]];
+   return glyph->bitlen % variant->rows == 0 &&
+          4 * (glyph->bitlen / variant->rows) <= variant->width;
+}
+
+
+/**
+   @brief Append the bitmap of a glyph to the output.
+
+   The glyph is placed at the left of each row, which is padded to a
+   whole number of bytes.
+
+   @param[in] glyph The glyph, or NULL for a blank glyph.
+   @param[in] variant The options for the font.
+*/
+void
+put_bitmap (struct Glyph *glyph, struct Variant *variant)
+{
+   int rowbytes = (variant->width + 7) / 8;
+   int digits, row, col, c;
+   unsigned char *p;
+
+   reserve (variant->rows * rowbytes);
+   p = out + outlen;
+   memset (p, 0, variant->rows * rowbytes);
+   outlen += variant->rows * rowbytes;
+   if (glyph == NULL)
+      return;
+
+   digits = glyph->bitlen / variant->rows;
+   for (row = 0; row < variant->rows; row++, p += rowbytes) {
+      for (col = 0; col < digits; col++) {
+         c = glyph->bitmap[row * digits + col];
+         c = isdigit (c) ? c - '0' : toupper (c) - 'A' + 10;
+         p[col / 2] |= (col & 1) ? c : c << 4;
+      }
+   }
+}
+
+
+/**
+   @brief Choose the glyphs of one font and write it.
+
+   @param[in] variant The options for the font.
+*/
+void
+write_variant (struct Variant *variant)
+{
+   struct CodeList symbols = { NULL, 0, 0 };
+   unsigned long *slot_symbol;   /* symbol shown at each font position */
+   unsigned long *slot_codept;   /* code point whose glyph is used     */
+   unsigned long *chosen;        /* symbols that get a glyph, in order */
+   unsigned long *chosen_codept; /* code point whose glyph each uses   */
+   unsigned long  nchosen = 0;
+   unsigned long  i, c, s;
+   unsigned long *members;       /* a symbol's equivalents group       */
+   unsigned long  nmembers, k;
+   char *used;                   /* code points already in the font    */
+   int   pos, next_free;
+   int   nrows = variant->rows;
+
+   void write_output (char *outname, int gzip);
+
+   for (i = 0; i < MAXUNI; i++)
+      group_of[i] = -1;
+   while (ngroups > 0)
+      free (groups[--ngroups].codepts);
+   if (variant->equivalents != NULL)
+      read_codepoints (variant->equivalents, equivalents_line, NULL);
+   read_codepoints (variant->symbols, symbols_line, &symbols);
+
+   used          = calloc (MAXUNI, 1);
+   chosen        = malloc ((symbols.count + 1) * sizeof (unsigned long));
+   chosen_codept = malloc ((symbols.count + 1) * sizeof (unsigned long));
+   slot_symbol   = malloc (variant->size * sizeof (unsigned long));
+   slot_codept   = malloc (variant->size * sizeof (unsigned long));
+   if (used == NULL || chosen == NULL || chosen_codept == NULL ||
+       slot_symbol == NULL || slot_codept == NULL) {
+      fprintf (stderr, "hex2psf: out of memory.\n");
+      exit (EXIT_FAILURE);
+   }
+
+   /*
+      Find a glyph for each symbol that is not already in the font
+      as the equivalent of an earlier symbol: that of the last code
+      point in its group that has one.
+   */
+   for (i = 0; i < symbols.count; i++) {
+      s = symbols.codepts[i];
+      if (used[s])
+         continue;
+      members = group_members (&symbols.codepts[i], &nmembers);
+      for (k = nmembers; k > 0 && !glyph_fits (members[k - 1], variant); k--)
+         ;
+      if (k == 0) {
+         fprintf (stderr, "hex2psf: no glyph for U+%04lX.\n", s);
+         continue;
+      }
+      chosen[nchosen] = s;
+      chosen_codept[nchosen++] = members[k - 1];
+      for (k = 0; k < nmembers; k++)
+         used[members[k]] = 1;
+   }
+   if (nchosen > (unsigned long)variant->size)
+      fprintf (stderr, "hex2psf: %lu glyphs did not fit in %s.\n",
+               nchosen - variant->size,
+               variant->output ? variant->output : "the font");
+
+   /*
+      Put glyphs at their Code Page 437 positions first, trying the
+      code points of each group from last to first, then fill the
+      remaining positions in order.
+   */
+   for (pos = 0; pos < variant->size; pos++)
+      slot_symbol[pos] = MAXUNI;
+   for (i = 0; i < nchosen; i++) {
+      s = chosen[i];
+      members = group_members (&chosen[i], &nmembers);
+      pos = 256;
+      for (k = nmembers; k > 0; k--) {
+         c = members[k - 1];
+         for (pos = 1; pos < 256 && pos < variant->size; pos++)
+            if (cp437[pos] == c) break;
+         if (pos < 256 && pos < variant->size && slot_symbol[pos] == MAXUNI)
+            break;
+      }
+      if (pos < 256 && pos < variant->size && slot_symbol[pos] == MAXUNI) {
+         slot_symbol[pos] = s;
+         slot_codept[pos] = chosen_codept[i];
+         chosen[i] = MAXUNI;
+      }
+   }
+   next_free = 0;
+   for (i = 0; i < nchosen; i++) {
+      if (chosen[i] == MAXUNI)
+         continue;
+      while (next_free < variant->size && slot_symbol[next_free] != MAXUNI)
+         next_free++;
+      if (next_free == variant->size)
+         break;
+      slot_symbol[next_free] = chosen[i];
+      slot_codept[next_free] = chosen_codept[i];
+   }
+
+   /* The header, then the bitmaps, then the Unicode table. */
+   outlen = 0;
+   if (variant->psf1) {
+      put_lsb (PSF1_MAGIC, 2);
+      put_lsb (PSF1_MODEHASTAB | (variant->size == 512 ? PSF1_MODE512 : 0), 1);
+      put_lsb (nrows, 1);
+   }
+   else {
+      put_lsb (PSF2_MAGIC, 4);
+      put_lsb (0, 4);                           /* version          */
+      put_lsb (32, 4);                          /* header size      */
+      put_lsb (PSF2_HAS_UNICODE_TABLE, 4);
+      put_lsb (variant->size, 4);
+      put_lsb (nrows * ((variant->width + 7) / 8), 4);
+      put_lsb (nrows, 4);
+      put_lsb (variant->width, 4);
+   }
+   for (pos = 0; pos < variant->size; pos++)
+      put_bitmap (slot_symbol[pos] == MAXUNI ? NULL :
+                  &glyphs[glyph_of[slot_codept[pos]]], variant);
+   for (pos = 0; pos < variant->size; pos++) {
+      if (slot_symbol[pos] != MAXUNI) {
+         members = group_members (&slot_symbol[pos], &nmembers);
+         for (k = nmembers; k > 0; k--) {
+            c = members[k - 1];
+            if (!variant->psf1)
+               put_utf8 (c);
+            else if (c < 0xFFFE)
+               put_lsb (c, 2);
+         }
+      }
+      if (variant->psf1)
+         put_lsb (0xFFFF, 2);
+      else
+         put_lsb (0xFF, 1);
+   }
+
+   write_output (variant->output, variant->gzip);
+
+   free (symbols.codepts);
+   free (used);
+   free (chosen);
+   free (chosen_codept);
+   free (slot_symbol);
+   free (slot_codept);
+}
+
+
+/**
+   @brief Write the font to a file or to stdout.
+
+   @param[in] outname The output file name, or NULL for stdout.
+   @param[in] gzip 1 to compress the output with gzip, 0 not to.
+*/
+void
+write_output (char *outname, int gzip)
+{
+   FILE *outfp;
+
+   if (gzip) {
+#ifdef HAVE_ZLIB
+      gzFile gz;
+
+      fflush (stdout);
+      if (outname == NULL)
+         gz = gzdopen (fileno (stdout), "wb9");
+      else
+         gz = gzopen (outname, "wb9");
+      if (gz == NULL) {
+         fprintf (stderr, "hex2psf: can't open %s for output.\n",
+                  outname == NULL ? "stdout" : outname);
+         exit (EXIT_FAILURE);
+      }
+      if (gzwrite (gz, out, outlen) != (int)outlen || gzclose (gz) != Z_OK) {
+         fprintf (stderr, "hex2psf: error writing compressed output.\n");
+         exit (EXIT_FAILURE);
+      }
+      return;
+#endif
+   }
+
+   if (outname == NULL)
+      outfp = stdout;
+   else if ((outfp = fopen (outname, "wb")) == NULL) {
+      fprintf (stderr, "hex2psf: can't open %s for output.\n", outname);
+      exit (EXIT_FAILURE);
+   }
+   if (fwrite (out, 1, outlen, outfp) != outlen || fflush (outfp) != 0) {
+      fprintf (stderr, "hex2psf: error writing output.\n");
+      exit (EXIT_FAILURE);
+   }
+   if (outfp != stdout)
+      fclose (outfp);
+}
@@ -0,0 +1,425 @@
+/**
+   @file hex2ufb.c
+
+   @brief hex2ufb - Convert a GNU Unifont .hex file into a binary glyph store
+
+   @author Paul Hardy
+
+   @copyright Copyright (C) 2023 Paul Hardy
+
+   This program reads glyphs in Unifont .hex format from the files
+   named on the command line, or from stdin if none are named, and
+   writes them as a Unifont binary glyph store (.ufb).  See ufb.h
+   for the format.  ufb2hex converts the result back.
+
+   Synopsis: hex2ufb [--rows n] [--base base.ufb] [--output file]
+                     [input.hex ...]
+
+   If a code point appears more than once, the glyph read last is
+   used, as in hex2bdf.
+
+   With --base, the output is an overlay: it holds only the glyphs
+   that are new or different from those in the base .ufb file, and
+   marks the base glyphs that the input does not have as deleted.
+   Programs that open the overlay see the whole font variant, while
+   several variants of one font share a single copy of the base.
+*/
+/*
+   LICENSE:
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 2 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "unihex.h"
+#include "ufb.h"
+
+
+unsigned char *out = NULL;   ///< The .ufb file, built in memory.
+size_t outlen = 0;           ///< Number of bytes in out.
+
+char *base_name = NULL;      ///< Base name recorded in an overlay, or NULL.
+unsigned long base_size = 0; ///< Size of the base file of an overlay.
+
+
+/**
+   @brief The main function.
+
+   @param[in] argc The count of command line arguments.
+   @param[in] argv Pointer to array of command line arguments.
+   @return This program exits with status EXIT_SUCCESS or EXIT_FAILURE.
+*/
+int
+main (int argc, char *argv[])
+{
+   int   vpixels   = 16;          /* nominal glyph height in rows      */
+   char *outname   = NULL;        /* output file name; NULL for stdout */
+   char *basefile  = NULL;        /* base .ufb file for an overlay     */
+   struct Ufb *base;              /* the base, mapped into memory      */
+   char *text;                    /* all input, read into memory       */
+   size_t textlen;                /* number of bytes in text           */
+   struct Glyph *glyphs;          /* index of glyphs in text           */
+   unsigned long nglyphs;         /* number of glyphs in the index     */
+   int   nfiles = 0;              /* number of input files named       */
+   int   i;                       /* loop variable                     */
+   char *arg, *value;             /* current option and its value      */
+   FILE *outfp;                   /* where to write the store          */
+
+   void build_store (struct Glyph *glyphs, unsigned long nglyphs,
+                     unsigned long total, int vpixels);
+   struct Glyph *diff_glyphs (struct Ufb *base, struct Glyph *glyphs,
+                              unsigned long *nglyphs);
+   char *base_record (const char *basefile, const char *outname);
+
+   /*
+      Options are accepted as "--name value", "--name=value",
+      "-n value", or "-n=value", as in hex2bdf.  File names are
+      moved to the front of argv.
+   */
+   for (i = 1; i < argc; i++) {
+      arg = argv[i];
+      if (arg[0] != '-' || arg[1] == '\0') {
+         argv[nfiles++] = arg;
+         continue;
+      }
+      if (arg[1] == '-')
+         arg += 2;
+      else
+         arg += 1;
+      value = strchr (arg, '=');
+      if (value != NULL)
+         *value++ = '\0';
+      else if (i + 1 < argc)
+         value = argv[++i];
+      if (value == NULL) {
+         fprintf (stderr, "hex2ufb: option %s needs a value.\n", argv[i]);
+         exit (EXIT_FAILURE);
+      }
+      if (strcmp (arg, "output") == 0 || strcmp (arg, "o") == 0)
+         outname = value;
+      else if (strcmp (arg, "base") == 0 || strcmp (arg, "b") == 0)
+         basefile = value;
+      else if (strcmp (arg, "rows") == 0 || strcmp (arg, "r") == 0) {
+         vpixels = atoi (value);
+         if (vpixels <= 0) {
+            fprintf (stderr, "hex2ufb: invalid number of rows: %s\n", value);
+            exit (EXIT_FAILURE);
+         }
+      }
+      else {
+         fprintf (stderr, "\nSyntax:\n\n");
+         fprintf (stderr, "   hex2ufb [--rows n] [--base base.ufb] ");
+         fprintf (stderr, "[--output file] [input.hex ...]\n\n");
+         exit (EXIT_FAILURE);
+      }
+   }
+
+   text   = read_input ("hex2ufb", argv, nfiles, &textlen);
+   glyphs = index_glyphs ("hex2ufb", text, textlen, &nglyphs);
+   if (basefile == NULL)
+      build_store (glyphs, nglyphs, nglyphs, vpixels);
+   else {
+      if ((base = ufb_open (basefile)) == NULL) {
+         fprintf (stderr, "hex2ufb: %s is not a .ufb file.\n", basefile);
+         exit (EXIT_FAILURE);
+      }
+      base_name = base_record (basefile, outname);
+      base_size = base->size;
+      i = nglyphs;
+      glyphs = diff_glyphs (base, glyphs, &nglyphs);
+      build_store (glyphs, nglyphs, i, vpixels);
+   }
+
+   if (outname == NULL)
+      outfp = stdout;
+   else if ((outfp = fopen (outname, "wb")) == NULL) {
+      fprintf (stderr, "hex2ufb: can't open %s for output.\n", outname);
+      exit (EXIT_FAILURE);
+   }
+   if (fwrite (out, 1, outlen, outfp) != outlen || fflush (outfp) != 0) {
+      fprintf (stderr, "hex2ufb: error writing output.\n");
+      exit (EXIT_FAILURE);
+   }
+   if (outfp != stdout)
+      fclose (outfp);
+
+   exit (EXIT_SUCCESS);
+}
+
+
+/**
+   @brief Store a 32-bit number in the output, least significant byte first.
+
+   @param[in] where The offset in the output to store the number at.
+   @param[in] value The number.
+*/
+void
+set_lsb32 (size_t where, unsigned long value)
+{
+   out[where]     =  value        & 0xFF;
+   out[where + 1] = (value >>  8) & 0xFF;
+   out[where + 2] = (value >> 16) & 0xFF;
+   out[where + 3] = (value >> 24) & 0xFF;
+}
+
+
+/**
+   @brief Test whether a glyph is the same as a base glyph.
+
+   @param[in] glyph The glyph, as read from a .hex file.
+   @param[in] bits The base glyph's digits, packed two to a byte.
+   @param[in] digits The number of digits in the base glyph.
+   @return 1 if the glyphs are the same, or 0 if not.
+*/
+int
+same_glyph (const struct Glyph *glyph, const unsigned char *bits, int digits)
+{
+   int d, n;
+
+   if (bits == NULL || glyph->bitlen != digits)
+      return 0;
+   for (d = 0; d < digits; d++) {
+      n = glyph->bitmap[d];
+      n = (n <= '9') ? n - '0' : (n & ~0x20) - 'A' + 10;
+      if (n != ((d & 1) ? bits[d / 2] & 0xF : bits[d / 2] >> 4))
+         return 0;
+   }
+   return 1;
+}
+
+
+/**
+   @brief Find the differences between the input glyphs and a base.
+
+   The result holds the input glyphs that are not in the base or
+   differ from it, and, with a null bitmap, the base glyphs that are
+   not in the input.
+
+   @param[in] base The base .ufb file.
+   @param[in] glyphs The input glyphs, sorted by code point.
+   @param[in,out] nglyphs The number of glyphs, in and out.
+   @return The differences, sorted by code point.
+*/
+struct Glyph *
+diff_glyphs (struct Ufb *base, struct Glyph *glyphs, unsigned long *nglyphs)
+{
+   struct Glyph *diff;
+   unsigned long i, n, codept;
+   const unsigned char *bits;
+   int digits;
+
+   diff = malloc ((*nglyphs + base->nglyphs + 1) * sizeof (struct Glyph));
+   if (diff == NULL) {
+      fprintf (stderr, "hex2ufb: out of memory.\n");
+      exit (EXIT_FAILURE);
+   }
+   n = 0;
+   i = 0;
+   codept = ufb_next (base, 0);
+   while (i < *nglyphs || codept < UFB_END) {
+      if (i < *nglyphs && glyphs[i].codept <= codept) {
+         bits = NULL;
+         if (glyphs[i].codept == codept) {
+            bits   = ufb_glyph (base, codept, &digits);
+            codept = ufb_next (base, codept + 1);
+         }
+         if (!same_glyph (&glyphs[i], bits, digits))
+            diff[n++] = glyphs[i];
+         i++;
+      }
+      else {
+         memset (&diff[n], 0, sizeof (struct Glyph));
+         diff[n++].codept = codept;
+         codept = ufb_next (base, codept + 1);
+      }
+   }
+   *nglyphs = n;
+   return diff;
+}
+
+
+/**
+   @brief Choose the name of the base to record in an overlay.
+
+   Programs look for a relative base name in the overlay's directory,
+   so the name is given relative to it if both files are in the same
+   directory, and otherwise as a full path name.
+
+   @param[in] basefile The base file name, as given.
+   @param[in] outname The overlay file name, or NULL for stdout.
+   @return The name to record.
+*/
+char *
+base_record (const char *basefile, const char *outname)
+{
+   static char path[PATH_MAX];
+   const char *baseslash, *outslash;
+
+   if (basefile[0] == '/' || outname == NULL)
+      return (char *)basefile;
+   baseslash = strrchr (basefile, '/');
+   outslash  = strrchr (outname, '/');
+   if (outslash == NULL && baseslash == NULL)
+      return (char *)basefile;
+   if (outslash != NULL && baseslash != NULL &&
+       outslash - outname == baseslash - basefile &&
+       strncmp (outname, basefile, outslash - outname) == 0)
+      return (char *)baseslash + 1;
+   if (realpath (basefile, path) == NULL) {
+      fprintf (stderr, "hex2ufb: can't find %s.\n", basefile);
+      exit (EXIT_FAILURE);
+   }
+   return path;
+}
+
+
+/**
+   @brief Build the .ufb file in memory.
+
+   The sizes of all parts are known once the glyphs have been put
+   into width classes, so the whole file is allocated at once and
+   filled in place.
+
+   For an overlay, glyphs with a null bitmap are the deleted base
+   glyphs, and the base's size and name are stored after the width
+   class table.
+
+   @param[in] glyphs The glyphs, sorted by code point.
+   @param[in] nglyphs The number of glyphs.
+   @param[in] total The number of glyphs in the font, for the header.
+   @param[in] vpixels The nominal glyph height, stored in the header.
+*/
+void
+build_store (struct Glyph *glyphs, unsigned long nglyphs,
+             unsigned long total, int vpixels)
+{
+   int classof[2 * 255 + 1];         /* width class of each digit count */
+   int digits[255];                  /* digit count of each class       */
+   unsigned long count[255];         /* glyphs in each class            */
+   size_t slab[255];                 /* offset of each class's slab     */
+   unsigned long used[255];          /* glyphs stored in each slab      */
+   int nclasses = 0;
+   int npages = 0;
+   long lastpage = -1;
+   size_t record, pages, tables, where, bytes;
+   unsigned long i;
+   unsigned char *dst;
+   const char *src;
+   int c, d, n, page;
+
+   for (i = 0; i <= 2 * 255; i++)
+      classof[i] = -1;
+
+   /* Sort the glyphs into width classes and count the pages used. */
+   for (i = 0; i < nglyphs; i++) {
+      if ((long)(glyphs[i].codept >> 8) != lastpage) {
+         lastpage = glyphs[i].codept >> 8;
+         npages++;
+      }
+      if (glyphs[i].bitmap == NULL)   /* deleted from the base */
+         continue;
+      n = glyphs[i].bitlen;
+      if (n > 255 * 2) {
+         fprintf (stderr, "hex2ufb: glyph %.*s is too long.\n",
+                  glyphs[i].keylen, glyphs[i].key);
+         exit (EXIT_FAILURE);
+      }
+      if (glyphs[i].codept >= UFB_END) {
+         fprintf (stderr, "hex2ufb: code point %.*s is out of range.\n",
+                  glyphs[i].keylen, glyphs[i].key);
+         exit (EXIT_FAILURE);
+      }
+      if (classof[n] < 0) {
+         if (nclasses == 255) {
+            fprintf (stderr, "hex2ufb: too many glyph widths.\n");
+            exit (EXIT_FAILURE);
+         }
+         classof[n] = nclasses;
+         digits[nclasses] = n;
+         count[nclasses] = 0;
+         nclasses++;
+      }
+      count[classof[n]]++;
+   }
+
+   /* Lay out the file. */
+   record = UFB_HEADER + UFB_CLASS_SIZE * nclasses;
+   pages  = record;
+   if (base_name != NULL)
+      pages += (4 + strlen (base_name) + 1 + 3) & ~(size_t)3;
+   tables = pages + 4 * UFB_PAGES;
+   where  = tables + 4 * 256 * (size_t)npages;
+   for (c = 0; c < nclasses; c++) {
+      slab[c] = where;
+      used[c] = 0;
+      where  += count[c] * ((digits[c] + 1) / 2);
+   }
+   outlen = where;
+   out = calloc (outlen, 1);
+   if (out == NULL) {
+      fprintf (stderr, "hex2ufb: out of memory.\n");
+      exit (EXIT_FAILURE);
+   }
+
+   memcpy (out, UFB_MAGIC, 8);
+   set_lsb32 ( 8, base_name != NULL ? UFB_OVERLAY_VERSION : UFB_VERSION);
+   set_lsb32 (12, vpixels);
+   set_lsb32 (16, total);
+   set_lsb32 (20, nclasses);
+   set_lsb32 (24, outlen);
+   set_lsb32 (28, pages);
+   for (c = 0; c < nclasses; c++) {
+      set_lsb32 (UFB_HEADER + UFB_CLASS_SIZE * c,      digits[c]);
+      set_lsb32 (UFB_HEADER + UFB_CLASS_SIZE * c +  4, count[c]);
+      set_lsb32 (UFB_HEADER + UFB_CLASS_SIZE * c +  8, slab[c]);
+      set_lsb32 (UFB_HEADER + UFB_CLASS_SIZE * c + 12, (digits[c] + 1) / 2);
+   }
+   if (base_name != NULL) {
+      set_lsb32 (record, base_size);
+      strcpy ((char *)out + record + 4, base_name);
+   }
+
+   /* Fill in the page tables and slabs, in code point order. */
+   lastpage = -1;
+   where = tables;
+   for (i = 0; i < nglyphs; i++) {
+      page = glyphs[i].codept >> 8;
+      if (page != lastpage) {
+         set_lsb32 (pages + 4 * page, where);
+         lastpage = page;
+         where += 4 * 256;
+      }
+      if (glyphs[i].bitmap == NULL) {
+         set_lsb32 (where - 4 * 256 + 4 * (glyphs[i].codept & 0xFF),
+                    UFB_DELETED);
+         continue;
+      }
+      c = classof[glyphs[i].bitlen];
+      set_lsb32 (where - 4 * 256 + 4 * (glyphs[i].codept & 0xFF),
+                 (unsigned long)c << 24 | (used[c] + 1));
+      bytes = (digits[c] + 1) / 2;
+      dst = out + slab[c] + used[c] * bytes;
+      src = glyphs[i].bitmap;
+      for (d = 0; d < digits[c]; d++) {
+         n = src[d];
+         n = (n <= '9') ? n - '0' : (n & ~0x20) - 'A' + 10;
+         dst[d / 2] |= (d & 1) ? n : n << 4;
+      }
+      used[c]++;
+   }
+}
@@ -0,0 +1,235 @@
+/**
+   @file hexidx-support.c
+
+   @brief Use a .hexidx page index to read part of a .hex file.
+
+   @author Paul Hardy
+
+   @copyright Copyright (C) 2023 Paul Hardy
+
+   See hexidx.h for the index format.
+*/
+/*
+   LICENSE:
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 2 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "hexidx.h"
+
+
+/**
+   @brief Get the name of the index of a .hex file.
+
+   @param[in] hexname The name of the .hex file.
+   @return The name of its index, in newly allocated memory.
+*/
+char *
+hexidx_name (const char *hexname)
+{
+   size_t len = strlen (hexname);
+   char  *name;
+
+   name = malloc (len + sizeof (".hexidx"));
+   if (name == NULL) {
+      fprintf (stderr, "Out of memory.\n");
+      exit (EXIT_FAILURE);
+   }
+   strcpy (name, hexname);
+   if (len >= 4 && strcmp (hexname + len - 4, ".hex") == 0)
+      strcat (name, "idx");
+   else
+      strcat (name, ".hexidx");
+   return name;
+}
+
+
+/**
+   @brief Read a 64-bit number stored least significant byte first.
+
+   @param[in] fp The file to read from.
+   @param[out] value The number.
+   @return 1 if the number was read, 0 otherwise.
+*/
+static int
+get64 (FILE *fp, unsigned long long *value)
+{
+   unsigned char bytes[8];
+   int i;
+
+   if (fread (bytes, 1, 8, fp) != 8)
+      return 0;
+   *value = 0;
+   for (i = 7; i >= 0; i--)
+      *value = (*value << 8) | bytes[i];
+   return 1;
+}
+
+
+/**
+   @brief Find the page of the glyph on the line at an offset.
+
+   @param[in] fp The open .hex file.
+   @param[in] pos The offset, which must be the start of a line.
+   @return The page (code point >> 8), or -1 if pos is not the start
+           of a line or the line does not start with a code point.
+*/
+static long
+line_page (FILE *fp, unsigned long long pos)
+{
+   unsigned long codept = 0;
+   int c, ndigits;
+
+   if (pos > 0) {
+      if (fseek (fp, (long)(pos - 1), SEEK_SET) != 0 || getc (fp) != '\n')
+         return -1;
+   }
+   else if (fseek (fp, 0L, SEEK_SET) != 0)
+      return -1;
+
+   for (ndigits = 0; ndigits < 8; ndigits++) {
+      c = getc (fp);
+      if      (c >= '0' && c <= '9') codept = (codept << 4) | (c - '0');
+      else if (c >= 'A' && c <= 'F') codept = (codept << 4) | (c - 'A' + 10);
+      else if (c >= 'a' && c <= 'f') codept = (codept << 4) | (c - 'a' + 10);
+      else break;
+   }
+   if (ndigits == 8)
+      c = getc (fp);
+   if (ndigits == 0 || c != ':')
+      return -1;
+   return (long)(codept >> 8);
+}
+
+
+/**
+   @brief Find the page of the glyph on the line before an offset.
+
+   @param[in] fp The open .hex file.
+   @param[in] pos The offset, which must be the start of a line after
+              the first.
+   @return The page, -1 if the line before does not start with a code
+           point, or -2 if pos is not the start of a line or the line
+           before is too long to look at.
+*/
+static long
+prev_line_page (FILE *fp, unsigned long long pos)
+{
+   char   buf[512];               /* the bytes before pos */
+   unsigned long long from;       /* offset of buf[0]     */
+   size_t len, i;
+
+   from = pos > sizeof (buf) ? pos - sizeof (buf) : 0;
+   len  = (size_t)(pos - from);
+   if (len == 0 || fseek (fp, (long)from, SEEK_SET) != 0 ||
+       fread (buf, 1, len, fp) != len || buf[len - 1] != '\n')
+      return -2;
+   for (i = len - 1; i > 0 && buf[i - 1] != '\n'; i--)
+      ;
+   if (i == 0 && from > 0)
+      return -2;
+   return line_page (fp, from + i);
+}
+
+
+/**
+   @brief Position a .hex file at the start of a range of pages.
+
+   If the .hex file has an up to date index, fp is positioned at the
+   first line of page first, and *end is set to the offset just past
+   the last line of page last.  Otherwise fp is left alone and *end
+   is set to -1, so the caller reads the whole file as before.
+
+   Besides the size and modification time, the lines on each side of
+   both ends of the range are checked: any glyph before the range
+   must be in an earlier page, any glyph after it in a later page,
+   and the first and last glyphs in it in the pages wanted.  As the
+   glyphs are in order, the range then holds every line of those
+   pages.  This catches a file rewritten with the same size within
+   the resolution of the file system's clock.
+
+   @param[in] fp The open .hex file.
+   @param[in] hexname The name of the .hex file.
+   @param[in] first The first page wanted (code point >> 8).
+   @param[in] last The last page wanted.
+   @param[out] end The offset to stop reading at, or -1.
+   @return 1 if fp was positioned using the index, 0 otherwise.
+*/
+int
+hexidx_seek (FILE *fp, const char *hexname,
+             unsigned long first, unsigned long last, long *end)
+{
+   struct stat st;
+   char *idxname;
+   FILE *idxfp;
+   char  magic[8];
+   unsigned long long version, size, mtime, nsec, start, stop;
+   long  page;
+   long  here;                    /* where fp was on entry */
+   int   ok;
+
+   *end = -1;
+   if (first > last || last >= HEXIDX_PAGES ||
+       fstat (fileno (fp), &st) != 0 || !S_ISREG (st.st_mode))
+      return 0;
+
+   if ((here = ftell (fp)) < 0)
+      return 0;
+   idxname = hexidx_name (hexname);
+   idxfp = fopen (idxname, "rb");
+   free (idxname);
+   if (idxfp == NULL)
+      return 0;
+
+   ok = fread (magic, 1, 8, idxfp) == 8 &&
+        memcmp (magic, HEXIDX_MAGIC, 8) == 0 &&
+        get64 (idxfp, &version) && version == HEXIDX_VERSION &&
+        get64 (idxfp, &size)    && size  == (unsigned long long)st.st_size &&
+        get64 (idxfp, &mtime)   && mtime == (unsigned long long)st.st_mtime &&
+        get64 (idxfp, &nsec)    && nsec  == HEXIDX_MTIME_NSEC (st) &&
+        fseek (idxfp, HEXIDX_HEADER + 8 * first, SEEK_SET) == 0 &&
+        get64 (idxfp, &start) &&
+        fseek (idxfp, HEXIDX_HEADER + 8 * (last + 1), SEEK_SET) == 0 &&
+        get64 (idxfp, &stop) &&
+        start <= stop && stop <= size;
+   fclose (idxfp);
+
+   if (ok && start > 0) {
+      page = prev_line_page (fp, start);
+      ok = page == -1 || (page >= 0 && page < (long)first);
+   }
+   if (ok && start < stop) {
+      page = line_page (fp, start);
+      ok = page >= (long)first && page <= (long)last;
+   }
+   if (ok && start < stop) {
+      page = prev_line_page (fp, stop);
+      ok = page == -1 || (page >= (long)first && page <= (long)last);
+   }
+   if (ok && stop < size)
+      ok = line_page (fp, stop) > (long)last;
+   if (ok)
+      ok = fseek (fp, (long)start, SEEK_SET) == 0;
+   if (!ok)
+      fseek (fp, here, SEEK_SET);
+
+   if (ok)
+      *end = (long)stop;
+   return ok;
+}
@@ -0,0 +1,79 @@
+/**
+   @file hexidx.h
+
+   @brief Define the .hexidx page index for Unifont .hex files.
+
+   @author Paul Hardy
+
+   @copyright Copyright (C) 2023 Paul Hardy
+
+   A .hexidx file, written by hexindex, sits beside a .hex file and
+   records where each page of 256 code points starts in it, so that
+   a program that only needs one page or one plane can seek straight
+   to it.  The index for "font.hex" is "font.hexidx"; for a file whose
+   name does not end in ".hex", ".hexidx" is appended to the name.
+
+   All numbers are 64 bits, least significant byte first.  The file
+   holds the 8 byte magic string HEXIDX_MAGIC, the format version,
+   the size of the .hex file when it was indexed, its modification
+   time in seconds and the nanoseconds past that second (0 where the
+   system does not keep them), and then HEXIDX_PAGES + 1 byte offsets.  Entry p is the
+   offset of the first line of page p, so page p occupies the bytes
+   from entry p up to entry p + 1.  This requires the glyphs to be
+   in ascending code point order, as Unifont's .hex files are.
+
+   An index whose recorded size or time does not match the .hex file
+   is stale, and is ignored.  A file rewritten with the same size
+   within the resolution of the file system's clock is caught when
+   the index is used: the lines at the offsets of the pages wanted,
+   and of the page after them, must start where a line starts and
+   hold glyphs of the pages their entries say.
+*/
+/*
+   LICENSE:
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 2 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _HEXIDX_H_
+#define _HEXIDX_H_
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+
+#define HEXIDX_MAGIC   "UHEXIDX\n" ///< First 8 bytes of a .hexidx file.
+#define HEXIDX_VERSION 2           ///< Format version written by hexindex.
+#define HEXIDX_HEADER  40          ///< Size of the header in bytes.
+#define HEXIDX_PAGES   0x1100      ///< Number of 256 code point pages.
+
+/*
+   The nanoseconds of a file's modification time, from struct stat.
+   Where st_mtime is a macro, it names the seconds of st_mtim (or of
+   st_mtimespec on macOS).
+*/
+#if defined (__APPLE__)
+#define HEXIDX_MTIME_NSEC(st) ((unsigned long long)(st).st_mtimespec.tv_nsec)
+#elif defined (st_mtime)
+#define HEXIDX_MTIME_NSEC(st) ((unsigned long long)(st).st_mtim.tv_nsec)
+#else
+#define HEXIDX_MTIME_NSEC(st) 0ULL
+#endif
+
+
+char *hexidx_name (const char *hexname);
+int hexidx_seek (FILE *fp, const char *hexname,
+                 unsigned long first, unsigned long last, long *end);
+
+#endif
@@ -0,0 +1,191 @@
+/**
+   @file hexindex.c
+
+   @brief hexindex - Write a page index for GNU Unifont .hex files
+
+   @author Paul Hardy
+
+   @copyright Copyright (C) 2023 Paul Hardy
+
+   This program writes a .hexidx page index beside each .hex file
+   named on the command line.  The index records where each page of
+   256 code points starts, so that programs needing only one page or
+   plane, such as unihex2bmp, unifontpic, and unipagecount, can seek
+   straight to it instead of reading the file from the start.  See
+   hexidx.h for the format.
+
+   Synopsis: hexindex input.hex ...
+
+   The glyphs in each file must be in ascending code point order.
+   The index records the size and modification time of the file to
+   the nanosecond, where the system keeps it, and
+   programs ignore it once the file changes, so run hexindex again
+   after editing a .hex file.
+*/
+/*
+   LICENSE:
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 2 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/stat.h>
+
+#include "hexidx.h"
+
+
+/**
+   @brief The main function.
+
+   @param[in] argc The count of command line arguments.
+   @param[in] argv Pointer to array of command line arguments.
+   @return This program exits with status EXIT_SUCCESS or EXIT_FAILURE.
+*/
+int
+main (int argc, char *argv[])
+{
+   int i;   /* loop variable */
+
+   void index_file (const char *hexname);
+
+   if (argc < 2 || argv[1][0] == '-') {
+      fprintf (stderr, "\nSyntax:\n\n");
+      fprintf (stderr, "   hexindex input.hex ...\n\n");
+      exit (EXIT_FAILURE);
+   }
+
+   for (i = 1; i < argc; i++)
+      index_file (argv[i]);
+
+   exit (EXIT_SUCCESS);
+}
+
+
+/**
+   @brief Append a 64-bit number to a file, least significant byte first.
+
+   @param[in] value The number.
+   @param[in] fp The file.
+*/
+void
+put64 (unsigned long long value, FILE *fp)
+{
+   int i;
+
+   for (i = 0; i < 8; i++) {
+      putc (value & 0xFF, fp);
+      value >>= 8;
+   }
+}
+
+
+/**
+   @brief Write the index of one .hex file.
+
+   Lines that do not start with a code point and a colon, such as
+   comments, are counted as part of the page of the line before.
+
+   @param[in] hexname The name of the .hex file.
+*/
+void
+index_file (const char *hexname)
+{
+   static unsigned long long offset[HEXIDX_PAGES + 1];
+   unsigned long long pos;         /* offset of the current byte       */
+   unsigned long long linestart;   /* offset of the current line       */
+   unsigned long codept;           /* code point of the current line   */
+   long  page, lastpage;           /* page of this and the last glyph  */
+   int   c, ndigits;
+   char *idxname;
+   FILE *fp;
+   struct stat st;
+
+   if ((fp = fopen (hexname, "r")) == NULL) {
+      fprintf (stderr, "hexindex: can't open %s for input.\n", hexname);
+      exit (EXIT_FAILURE);
+   }
+   if (fstat (fileno (fp), &st) != 0 || !S_ISREG (st.st_mode)) {
+      fprintf (stderr, "hexindex: %s is not a regular file.\n", hexname);
+      exit (EXIT_FAILURE);
+   }
+
+   pos = 0;
+   lastpage = -1;
+   c = getc (fp);
+   while (c != EOF) {
+      /* Read the code point at the start of the line, if any. */
+      linestart = pos;
+      codept  = 0;
+      ndigits = 0;
+      while (isxdigit (c) && ndigits < 8) {
+         codept = (codept << 4) |
+                  (isdigit (c) ? c - '0' : toupper (c) - 'A' + 10);
+         ndigits++;
+         c = getc (fp);
+         pos++;
+      }
+      if (ndigits > 0 && c == ':') {
+         page = codept >> 8;
+         if (page >= HEXIDX_PAGES || page < lastpage) {
+            fprintf (stderr,
+                     "hexindex: %s: U+%04lX is out of order or out of range.\n",
+                     hexname, codept);
+            exit (EXIT_FAILURE);
+         }
+         /* This line starts its page and any empty pages before it. */
+         while (lastpage < page) {
+            lastpage++;
+            offset[lastpage] = (lastpage == 0) ? 0 : linestart;
+         }
+      }
+      /* Skip the rest of the line. */
+      while (c != EOF && c != '\n') {
+         c = getc (fp);
+         pos++;
+      }
+      if (c == '\n') {
+         c = getc (fp);
+         pos++;
+      }
+   }
+   if (ferror (fp)) {
+      fprintf (stderr, "hexindex: %s: read error.\n", hexname);
+      exit (EXIT_FAILURE);
+   }
+   fclose (fp);
+   while (lastpage < HEXIDX_PAGES)
+      offset[++lastpage] = pos;
+
+   idxname = hexidx_name (hexname);
+   if ((fp = fopen (idxname, "wb")) == NULL) {
+      fprintf (stderr, "hexindex: can't open %s for output.\n", idxname);
+      exit (EXIT_FAILURE);
+   }
+   fwrite (HEXIDX_MAGIC, 1, 8, fp);
+   put64 (HEXIDX_VERSION, fp);
+   put64 (st.st_size, fp);
+   put64 (st.st_mtime, fp);
+   put64 (HEXIDX_MTIME_NSEC (st), fp);
+   for (page = 0; page <= HEXIDX_PAGES; page++)
+      put64 (offset[page], fp);
+   if (fflush (fp) != 0 || ferror (fp)) {
+      fprintf (stderr, "hexindex: error writing %s.\n", idxname);
+      exit (EXIT_FAILURE);
+   }
+   fclose (fp);
+   free (idxname);
+}
@@ -0,0 +1,509 @@
+/**
+   @file hexmerge.c
+
+   @brief hexmerge - Merge two or more GNU Unifont .hex font files into one
+
+   @author Roman Czyborra (original Perl script), Paul Hardy (Plane 1-16)
+
+   @copyright Copyright (C) 1998, 2013 Roman Czyborra
+
+   This program reads glyphs from one or more files in Unifont .hex
+   format (or from stdin if no file is given), and writes them to
+   stdout in ascending code point order.  It replaces the Perl script
+   of the same name, which held every glyph in memory and sorted
+   code points as strings.
+
+   If every input file is already sorted, as "sort" leaves a Unifont
+   .hex file, the files are merged in one pass with a heap of the
+   current line of each file, so memory use does not depend on the
+   size of the font.  Otherwise all glyphs are read into memory and
+   radix sorted by numeric code point.
+
+   Synopsis: hexmerge [-d<policy>] [input-font1.hex ...] > output-font.hex
+
+   Glyphs with the same code point are handled according to policy:
+
+      last   Keep the glyph read last, as the Perl script did (default).
+      first  Keep the glyph read first.
+      error  Print the code point on stderr and exit with status 1.
+      diff   Keep the glyph read last, and print on stderr the code
+             points of duplicates whose bitmaps differ.
+
+   Files are read in command line order, and lines within a file in
+   file order, so "first" and "last" refer to that order.
+*/
+/*
+   LICENSE:
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 2 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define MAXBUF 1024  ///< Maximum input line length - 1 (32x32 glyph: 264)
+
+#define DUP_LAST  0  ///< Keep the last glyph with a given code point.
+#define DUP_FIRST 1  ///< Keep the first glyph with a given code point.
+#define DUP_ERROR 2  ///< Exit with an error on duplicate code points.
+#define DUP_DIFF  3  ///< Keep the last glyph, report differing duplicates.
+
+
+/**
+   @brief One input file, as read by the merge.
+
+   Standard input cannot be read twice, so it is read into memory
+   first; the lines of a file read into memory are then taken from
+   the array "lines" instead of the file "fp".
+*/
+struct Source {
+   FILE *fp;               ///< Input file, or NULL if read into memory.
+   char *name;             ///< Input file name, for error messages.
+   char **lines;           ///< Lines read into memory, if fp is NULL.
+   unsigned long nlines;   ///< Number of lines in "lines".
+   unsigned long next;     ///< Index of the next line in "lines".
+   int      index;         ///< Position on the command line; breaks ties.
+   unsigned long codept;   ///< Code point of the current line.
+   char    *line;          ///< Current line, or NULL at end of input.
+   char     buf[MAXBUF];   ///< Line buffer when reading from fp.
+};
+
+
+/**
+   @brief An input line held in memory for sorting.
+*/
+struct Glyph {
+   unsigned long codept;   ///< Code point of the glyph.
+   char *line;             ///< Complete line, including the newline.
+};
+
+
+/**
+   @brief The main function.
+
+   @param[in] argc The count of command line arguments.
+   @param[in] argv Pointer to array of command line arguments.
+   @return This program exits with status EXIT_SUCCESS or EXIT_FAILURE.
+*/
+int
+main (int argc, char *argv[])
+{
+   int i;                       /* loop variable                     */
+   int policy = DUP_LAST;       /* what to do with duplicate glyphs  */
+   int nsources = 0;            /* number of input files             */
+   int sorted;                  /* 1 if all input files are sorted   */
+   struct Source *sources;      /* the input files                   */
+   char *policyname;            /* argument of -d option             */
+
+   void read_source (struct Source *source);
+   int  next_line   (struct Source *source);
+   int  check_sorted (struct Source *source);
+   void merge_sorted (struct Source *sources, int nsources, int policy);
+   void sort_all     (struct Source *sources, int nsources, int policy);
+
+   sources = calloc (argc + 1, sizeof (struct Source));
+   if (sources == NULL) {
+      fprintf (stderr, "hexmerge: out of memory.\n");
+      exit (EXIT_FAILURE);
+   }
+
+   for (i = 1; i < argc; i++) {
+      if (argv[i][0] == '-' && argv[i][1] == 'd') {
+         policyname = argv[i][2] != '\0' ? &argv[i][2] : argv[++i];
+         if (policyname == NULL)
+            policyname = "";
+         if      (strcmp (policyname, "last")  == 0) policy = DUP_LAST;
+         else if (strcmp (policyname, "first") == 0) policy = DUP_FIRST;
+         else if (strcmp (policyname, "error") == 0) policy = DUP_ERROR;
+         else if (strcmp (policyname, "diff")  == 0) policy = DUP_DIFF;
+         else {
+            fprintf (stderr, "hexmerge: unknown duplicate policy \"%s\".\n",
+                     policyname);
+            exit (EXIT_FAILURE);
+         }
+      }
+      else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+         fprintf (stderr, "\nSyntax:\n\n");
+         fprintf (stderr, "   %s [-dlast|-dfirst|-derror|-ddiff] ", argv[0]);
+         fprintf (stderr, "[input-font.hex ...] > output-font.hex\n\n");
+         exit (EXIT_FAILURE);
+      }
+      else {
+         sources[nsources].name  = argv[i];
+         sources[nsources].index = nsources;
+         nsources++;
+      }
+   }
+   if (nsources == 0) {
+      sources[0].name = "-";
+      nsources = 1;
+   }
+
+   /*
+      Open every input file.  Standard input is read into memory,
+      so that its order can be checked before it is merged.
+   */
+   for (i = 0; i < nsources; i++) {
+      if (strcmp (sources[i].name, "-") == 0) {
+         sources[i].name = "<stdin>";
+         sources[i].fp   = stdin;
+         read_source (&sources[i]);
+      }
+      else if ((sources[i].fp = fopen (sources[i].name, "r")) == NULL) {
+         fprintf (stderr, "hexmerge: can't open %s for input.\n",
+                  sources[i].name);
+         exit (EXIT_FAILURE);
+      }
+   }
+
+   sorted = 1;
+   for (i = 0; sorted && i < nsources; i++)
+      sorted = check_sorted (&sources[i]);
+
+   setvbuf (stdout, NULL, _IOFBF, 1 << 16);
+   if (sorted)
+      merge_sorted (sources, nsources, policy);
+   else
+      sort_all (sources, nsources, policy);
+
+   if (fflush (stdout) != 0 || ferror (stdout)) {
+      fprintf (stderr, "hexmerge: cannot print to stdout.\n");
+      exit (EXIT_FAILURE);
+   }
+   exit (EXIT_SUCCESS);
+}
+
+
+/**
+   @brief Parse the code point at the start of a Unifont .hex line.
+
+   @param[in] line The input line.
+   @param[out] codept The code point, if the line holds a glyph.
+   @return 1 if the line holds a glyph, 0 if it is to be skipped.
+*/
+int
+parse_codept (char *line, unsigned long *codept)
+{
+   int ndigits;
+
+   *codept = 0;
+   for (ndigits = 0; isxdigit ((unsigned char)line[ndigits]); ndigits++) {
+      *codept = (*codept << 4) |
+                (isdigit ((unsigned char)line[ndigits]) ?
+                 line[ndigits] - '0' :
+                 (toupper ((unsigned char)line[ndigits]) - 'A' + 10));
+   }
+   return ndigits > 0 && ndigits <= 6 && line[ndigits] == ':';
+}
+
+
+/**
+   @brief Read one line into a buffer, adding a final newline if missing.
+
+   Lines that do not hold a glyph (blank lines, comments) are skipped,
+   as the Perl version of hexmerge did.
+
+   @param[in] fp The file to read.
+   @param[in] name The file name, for error messages.
+   @param[out] buf Buffer of MAXBUF bytes for the line.
+   @param[out] codept Code point of the line read.
+   @return 1 if a line was read, 0 at end of file.
+*/
+int
+read_line (FILE *fp, char *name, char *buf, unsigned long *codept)
+{
+   size_t len;
+
+   while (fgets (buf, MAXBUF, fp) != NULL) {
+      len = strlen (buf);
+      if (len == MAXBUF - 1 && buf[len - 1] != '\n') {
+         fprintf (stderr, "hexmerge: %s: line too long.\n", name);
+         exit (EXIT_FAILURE);
+      }
+      if (buf[len - 1] != '\n') {  /* last line without a newline */
+         buf[len]     = '\n';
+         buf[len + 1] = '\0';
+      }
+      if (parse_codept (buf, codept))
+         return 1;
+   }
+   if (ferror (fp)) {
+      fprintf (stderr, "hexmerge: %s: read error.\n", name);
+      exit (EXIT_FAILURE);
+   }
+   return 0;
+}
+
+
+/**
+   @brief Read all remaining lines of a source into memory.
+
+   @param[in,out] source The input source, which is then closed.
+*/
+void
+read_source (struct Source *source)
+{
+   unsigned long codept;
+   unsigned long room = 0;
+   char *copy;
+
+   while (read_line (source->fp, source->name, source->buf, &codept)) {
+      if (source->nlines == room) {
+         room = room ? 2 * room : 4096;
+         source->lines = realloc (source->lines, room * sizeof (char *));
+      }
+      copy = malloc (strlen (source->buf) + 1);
+      if (source->lines == NULL || copy == NULL) {
+         fprintf (stderr, "hexmerge: out of memory.\n");
+         exit (EXIT_FAILURE);
+      }
+      strcpy (copy, source->buf);
+      source->lines[source->nlines++] = copy;
+   }
+   if (source->fp != stdin)
+      fclose (source->fp);
+   source->fp = NULL;
+}
+
+
+/**
+   @brief Advance a source to its next glyph line.
+
+   @param[in,out] source The input source.
+   @return 1 if source->line now holds a glyph, 0 at end of input.
+*/
+int
+next_line (struct Source *source)
+{
+   if (source->fp != NULL) {
+      if (read_line (source->fp, source->name, source->buf, &source->codept))
+         source->line = source->buf;
+      else
+         source->line = NULL;
+   }
+   else if (source->next < source->nlines) {
+      source->line = source->lines[source->next++];
+      parse_codept (source->line, &source->codept);
+   }
+   else {
+      source->line = NULL;
+   }
+   return source->line != NULL;
+}
+
+
+/**
+   @brief Check whether a source is in ascending code point order.
+
+   A file is read through once and then rewound.
+
+   @param[in,out] source The input source.
+   @return 1 if the source is sorted, 0 otherwise.
+*/
+int
+check_sorted (struct Source *source)
+{
+   unsigned long last = 0;
+   int sorted = 1;
+
+   while (sorted && next_line (source)) {
+      sorted = source->codept >= last;
+      last = source->codept;
+   }
+   if (source->fp != NULL)
+      rewind (source->fp);
+   source->next = 0;
+   source->line = NULL;
+   return sorted;
+}
+
+
+/**
+   @brief Handle a group of glyphs with the same code point.
+
+   The merge and the sort both call this function once per glyph, in
+   output order; a glyph with a new code point flushes the previous
+   group.  Only the first and current lines of a group are kept.
+
+   @param[in] line The next glyph line, or NULL to flush the last group.
+   @param[in] codept The code point of line.
+   @param[in] policy The duplicate policy.
+*/
+void
+add_glyph (char *line, unsigned long codept, int policy)
+{
+   static char kept[MAXBUF];       /* line to print for the current group */
+   static unsigned long keptcp;    /* code point of the current group     */
+   static int  have = 0;           /* 1 if a group is open                */
+   static int  differ = 0;         /* 1 if the group has differing lines  */
+
+   if (have && line != NULL && codept == keptcp) {
+      if (policy == DUP_ERROR) {
+         fprintf (stderr, "hexmerge: duplicate code point: %04lX\n", codept);
+         exit (EXIT_FAILURE);
+      }
+      if (strcmp (strchr (line, ':'), strchr (kept, ':')) != 0)
+         differ = 1;
+      if (policy != DUP_FIRST)
+         strcpy (kept, line);
+      return;
+   }
+   if (have) {
+      if (policy == DUP_DIFF && differ)
+         fprintf (stderr, "hexmerge: differing glyphs for code point %04lX\n",
+                  keptcp);
+      fputs (kept, stdout);
+   }
+   have = line != NULL;
+   if (have) {
+      strcpy (kept, line);
+      keptcp = codept;
+      differ = 0;
+   }
+}
+
+
+/**
+   @brief Compare the current lines of two sources for the merge heap.
+
+   @return Nonzero if source a comes before source b.
+*/
+int
+source_before (struct Source *a, struct Source *b)
+{
+   return a->codept < b->codept ||
+          (a->codept == b->codept && a->index < b->index);
+}
+
+
+/**
+   @brief Restore the heap property below a given heap position.
+
+   @param[in,out] heap The heap of sources, least first.
+   @param[in] n The number of sources in the heap.
+   @param[in] i The position whose source may be out of order.
+*/
+void
+sift_down (struct Source **heap, int n, int i)
+{
+   int child;
+   struct Source *tmp;
+
+   for (;;) {
+      child = 2 * i + 1;
+      if (child >= n) break;
+      if (child + 1 < n && source_before (heap[child + 1], heap[child]))
+         child++;
+      if (!source_before (heap[child], heap[i])) break;
+      tmp = heap[i]; heap[i] = heap[child]; heap[child] = tmp;
+      i = child;
+   }
+}
+
+
+/**
+   @brief Merge sorted sources with a heap of their current lines.
+
+   @param[in,out] sources The input sources, all sorted.
+   @param[in] nsources The number of sources.
+   @param[in] policy The duplicate policy.
+*/
+void
+merge_sorted (struct Source *sources, int nsources, int policy)
+{
+   struct Source **heap;
+   int n = 0;
+   int i;
+
+   heap = malloc (nsources * sizeof (struct Source *));
+   if (heap == NULL) {
+      fprintf (stderr, "hexmerge: out of memory.\n");
+      exit (EXIT_FAILURE);
+   }
+   for (i = 0; i < nsources; i++)
+      if (next_line (&sources[i]))
+         heap[n++] = &sources[i];
+   for (i = n / 2 - 1; i >= 0; i--)
+      sift_down (heap, n, i);
+
+   while (n > 0) {
+      add_glyph (heap[0]->line, heap[0]->codept, policy);
+      if (!next_line (heap[0]))
+         heap[0] = heap[--n];
+      sift_down (heap, n, 0);
+   }
+   add_glyph (NULL, 0, policy);
+   free (heap);
+}
+
+
+/**
+   @brief Read all sources into memory and radix sort them.
+
+   The sort is a stable least significant digit radix sort on the
+   24 bits a code point can have, so glyphs with the same code point
+   stay in the order in which they were read.
+
+   @param[in,out] sources The input sources.
+   @param[in] nsources The number of sources.
+   @param[in] policy The duplicate policy.
+*/
+void
+sort_all (struct Source *sources, int nsources, int policy)
+{
+   struct Glyph *glyphs, *sorted, *tmp;
+   unsigned long nglyphs = 0;
+   unsigned long count[257];
+   unsigned long i;
+   int s, shift, digit;
+
+   for (s = 0; s < nsources; s++) {
+      if (sources[s].fp != NULL)
+         read_source (&sources[s]);
+      nglyphs += sources[s].nlines;
+   }
+   glyphs = malloc ((nglyphs + 1) * sizeof (struct Glyph));
+   sorted = malloc ((nglyphs + 1) * sizeof (struct Glyph));
+   if (glyphs == NULL || sorted == NULL) {
+      fprintf (stderr, "hexmerge: out of memory.\n");
+      exit (EXIT_FAILURE);
+   }
+   nglyphs = 0;
+   for (s = 0; s < nsources; s++) {
+      while (next_line (&sources[s])) {
+         glyphs[nglyphs].codept = sources[s].codept;
+         glyphs[nglyphs].line   = sources[s].line;
+         nglyphs++;
+      }
+   }
+
+   for (shift = 0; shift < 24; shift += 8) {
+      memset (count, 0, sizeof (count));
+      for (i = 0; i < nglyphs; i++)
+         count[((glyphs[i].codept >> shift) & 0xFF) + 1]++;
+      for (digit = 1; digit <= 256 && count[digit] != nglyphs; digit++);
+      if (digit <= 256) continue;  /* all glyphs share this digit */
+      for (digit = 1; digit <= 256; digit++)
+         count[digit] += count[digit - 1];
+      for (i = 0; i < nglyphs; i++)
+         sorted[count[(glyphs[i].codept >> shift) & 0xFF]++] = glyphs[i];
+      tmp = glyphs; glyphs = sorted; sorted = tmp;
+   }
+
+   for (i = 0; i < nglyphs; i++)
+      add_glyph (glyphs[i].line, glyphs[i].codept, policy);
+   add_glyph (NULL, 0, policy);
+}
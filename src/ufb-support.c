@@ -0,0 +1,414 @@
+/**
+   @file ufb-support.c
+
+   @brief Read Unifont binary glyph store (.ufb) files.
+
+   @author Paul Hardy
+
+   @copyright Copyright (C) 2023 Paul Hardy
+
+   A .ufb file is mapped into memory rather than read, so opening
+   even a full font costs almost nothing, and any glyph can be found
+   with two table lookups.  An overlay is opened together with its
+   base, and the functions here see the two as one font.  See ufb.h
+   for the file format.
+*/
+/*
+   LICENSE:
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 2 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ufb.h"
+
+
+/**
+   @brief Get a 32-bit number stored least significant byte first.
+
+   @param[in] p Pointer to the first byte of the number.
+   @return The number.
+*/
+static unsigned long
+get32 (const unsigned char *p)
+{
+   return (unsigned long)p[0]       | (unsigned long)p[1] <<  8 |
+          (unsigned long)p[2] << 16 | (unsigned long)p[3] << 24;
+}
+
+
+/**
+   @brief Report a damaged .ufb file and exit.
+
+   @param[in] filename The name of the file.
+*/
+static void
+ufb_corrupt (const char *filename)
+{
+   fprintf (stderr, "%s: not a valid .ufb file.\n", filename);
+   exit (EXIT_FAILURE);
+}
+
+
+/**
+   @brief Open the base of an overlay.
+
+   @param[in] ufb The overlay.
+   @param[in] filename The name of the overlay.
+   @return The base, which must match the size the overlay records.
+*/
+static struct Ufb *
+ufb_open_base (struct Ufb *ufb, const char *filename)
+{
+   const unsigned char *record;   /* base size and name in the overlay */
+   const unsigned char *end;      /* the overlay's page index          */
+   const char *slash;
+   char *basename;
+   struct Ufb *base;
+   size_t dirlen, namelen;
+
+   record = ufb->classes + UFB_CLASS_SIZE * ufb->nclasses;
+   end    = ufb->pages;
+   if (end - record < 5 || memchr (record + 4, '\0', end - record - 4) == NULL)
+      ufb_corrupt (filename);
+   namelen = strlen ((const char *)record + 4);
+
+   /* A relative name is relative to the overlay's directory. */
+   slash  = strrchr (filename, '/');
+   dirlen = (record[4] != '/' && slash != NULL) ? slash - filename + 1 : 0;
+   basename = malloc (dirlen + namelen + 1);
+   if (basename == NULL) {
+      fprintf (stderr, "%s: out of memory.\n", filename);
+      exit (EXIT_FAILURE);
+   }
+   memcpy (basename, filename, dirlen);
+   memcpy (basename + dirlen, record + 4, namelen + 1);
+
+   if ((base = ufb_open (basename)) == NULL) {
+      fprintf (stderr, "%s: can't open base font %s.\n", filename, basename);
+      exit (EXIT_FAILURE);
+   }
+   if (base->size != get32 (record)) {
+      fprintf (stderr, "%s: base font %s has changed.\n", filename, basename);
+      exit (EXIT_FAILURE);
+   }
+   free (basename);
+   return base;
+}
+
+
+/**
+   @brief Map an open file into memory if it is a .ufb file.
+
+   The file offset of fd is not changed, so if the file is not a
+   .ufb file, the caller can go on to read it as text.  A file
+   that starts like a .ufb file but is damaged is an error.
+
+   If the file is an overlay, its base is opened too.
+
+   @param[in] fd The open file descriptor.
+   @param[in] filename The name of the file, for error messages and
+              for finding an overlay's base.
+   @return The mapped file, or NULL if fd is not a .ufb file.
+*/
+struct Ufb *
+ufb_fdopen (int fd, const char *filename)
+{
+   static int depth = 0;   /* overlays being opened, to catch loops */
+   struct stat st;
+   struct Ufb *ufb;
+   const unsigned char *map;
+   unsigned long i, offset, count, bytes, digits, version;
+
+   if (fstat (fd, &st) != 0 || !S_ISREG (st.st_mode) ||
+       st.st_size < UFB_HEADER)
+      return NULL;
+   map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   if (map == MAP_FAILED)
+      return NULL;
+   if (memcmp (map, UFB_MAGIC, 8) != 0) {
+      munmap ((void *)map, st.st_size);
+      return NULL;
+   }
+
+   ufb = malloc (sizeof (struct Ufb));
+   if (ufb == NULL) {
+      fprintf (stderr, "%s: out of memory.\n", filename);
+      exit (EXIT_FAILURE);
+   }
+   ufb->map      = map;
+   ufb->size     = st.st_size;
+   ufb->rows     = get32 (map + 12);
+   ufb->nglyphs  = get32 (map + 16);
+   ufb->nclasses = get32 (map + 20);
+   ufb->classes  = map + UFB_HEADER;
+   ufb->cursor   = 0;
+   ufb->base     = NULL;
+   ufb->scan_from = UFB_END;
+   ufb->scan_next = UFB_END;
+   offset        = get32 (map + 28);
+   version       = get32 (map + 8);
+
+   /* Check everything that lookups will rely on. */
+   if (version != UFB_VERSION && version != UFB_OVERLAY_VERSION) {
+      fprintf (stderr, "%s: unknown .ufb format version %lu.\n",
+               filename, version);
+      exit (EXIT_FAILURE);
+   }
+   if (get32 (map + 24) != ufb->size || ufb->nclasses > 255 ||
+       UFB_HEADER + UFB_CLASS_SIZE * ufb->nclasses > ufb->size ||
+       offset > ufb->size || ufb->size - offset < 4 * UFB_PAGES)
+      ufb_corrupt (filename);
+   ufb->pages = map + offset;
+   for (i = 0; i < ufb->nclasses; i++) {
+      digits = get32 (ufb->classes + UFB_CLASS_SIZE * i);
+      count  = get32 (ufb->classes + UFB_CLASS_SIZE * i + 4);
+      offset = get32 (ufb->classes + UFB_CLASS_SIZE * i + 8);
+      bytes  = get32 (ufb->classes + UFB_CLASS_SIZE * i + 12);
+      if (bytes != (digits + 1) / 2 || offset > ufb->size ||
+          (bytes > 0 && (ufb->size - offset) / bytes < count))
+         ufb_corrupt (filename);
+   }
+   for (i = 0; i < UFB_PAGES; i++) {
+      offset = get32 (ufb->pages + 4 * i);
+      if (offset != 0 && (offset > ufb->size || ufb->size - offset < 4 * 256))
+         ufb_corrupt (filename);
+   }
+   if (version == UFB_OVERLAY_VERSION) {
+      if (++depth > 16) {
+         fprintf (stderr, "%s: too many nested overlays.\n", filename);
+         exit (EXIT_FAILURE);
+      }
+      ufb->base = ufb_open_base (ufb, filename);
+      depth--;
+   }
+   return ufb;
+}
+
+
+/**
+   @brief Open a file and map it into memory if it is a .ufb file.
+
+   @param[in] filename The name of the file.
+   @return The mapped file, or NULL if it is not a .ufb file or
+           cannot be opened.
+*/
+struct Ufb *
+ufb_open (const char *filename)
+{
+   struct Ufb *ufb;
+   int fd;
+
+   if ((fd = open (filename, O_RDONLY)) < 0)
+      return NULL;
+   ufb = ufb_fdopen (fd, filename);
+   close (fd);   /* the mapping stays valid */
+   return ufb;
+}
+
+
+/**
+   @brief Unmap a .ufb file.
+
+   @param[in] ufb The mapped file.
+*/
+void
+ufb_close (struct Ufb *ufb)
+{
+   if (ufb->base != NULL)
+      ufb_close (ufb->base);
+   munmap ((void *)ufb->map, ufb->size);
+   free (ufb);
+}
+
+
+/**
+   @brief Get a code point's glyph table entry in one file.
+
+   @param[in] ufb The mapped file.
+   @param[in] codept The code point.
+   @return The entry, or 0 if the file has none.
+*/
+static unsigned long
+ufb_entry (struct Ufb *ufb, unsigned long codept)
+{
+   unsigned long offset;
+
+   if (codept >= UFB_END ||
+       (offset = get32 (ufb->pages + 4 * (codept >> 8))) == 0)
+      return 0;
+   return get32 (ufb->map + offset + 4 * (codept & 0xFF));
+}
+
+
+/**
+   @brief Find the glyph of a code point.
+
+   @param[in] ufb The mapped file.
+   @param[in] codept The code point.
+   @param[out] digits The number of hexadecimal digits in the glyph.
+   @return The glyph's digits packed two to a byte, or NULL if the
+           code point has no glyph.
+*/
+const unsigned char *
+ufb_glyph (struct Ufb *ufb, unsigned long codept, int *digits)
+{
+   unsigned long entry, class, index;
+   const unsigned char *c;
+
+   entry = ufb_entry (ufb, codept);
+   if (entry == 0)
+      return ufb->base != NULL ? ufb_glyph (ufb->base, codept, digits)
+                               : NULL;
+   if (entry == UFB_DELETED)
+      return NULL;
+   class = entry >> 24;
+   index = (entry & 0xFFFFFF) - 1;
+   if (class >= ufb->nclasses)
+      return NULL;
+   c = ufb->classes + UFB_CLASS_SIZE * class;
+   if (index >= get32 (c + 4))
+      return NULL;
+   *digits = get32 (c);
+   return ufb->map + get32 (c + 8) + index * get32 (c + 12);
+}
+
+
+/**
+   @brief Find the first code point at or after another with an entry
+          in one file.
+
+   Empty pages are skipped with one lookup each.  The last result is
+   remembered, so that stepping through a sparse overlay one code
+   point at a time does not scan the same empty entries again.
+
+   @param[in] ufb The mapped file.
+   @param[in] codept The code point to start from.
+   @return The code point found, or UFB_END if there is none.
+*/
+static unsigned long
+ufb_next_entry (struct Ufb *ufb, unsigned long codept)
+{
+   unsigned long offset;
+   unsigned long from = codept;
+
+   if (codept >= ufb->scan_from && codept <= ufb->scan_next)
+      return ufb->scan_next;
+   ufb->scan_from = from;
+   while (codept < UFB_END) {
+      offset = get32 (ufb->pages + 4 * (codept >> 8));
+      if (offset == 0) {
+         codept = (codept | 0xFF) + 1;
+         continue;
+      }
+      for (; ; codept++) {
+         if (get32 (ufb->map + offset + 4 * (codept & 0xFF)) != 0)
+            return ufb->scan_next = codept;
+         if ((codept & 0xFF) == 0xFF)
+            break;
+      }
+      codept++;
+   }
+   return ufb->scan_next = UFB_END;
+}
+
+
+/**
+   @brief Find the first code point at or after another that has a glyph.
+
+   In an overlay, this is the first code point that has a glyph in
+   the overlay, or that has one in the base and is not deleted.
+
+   @param[in] ufb The mapped file.
+   @param[in] codept The code point to start from.
+   @return The code point found, or UFB_END if there is none.
+*/
+unsigned long
+ufb_next (struct Ufb *ufb, unsigned long codept)
+{
+   unsigned long own, below;
+
+   for (;;) {
+      own = ufb_next_entry (ufb, codept);
+      if (ufb->base == NULL)
+         return own;
+      below = ufb_next (ufb->base, codept);
+      if (below < own)
+         return below;
+      if (own == UFB_END || ufb_entry (ufb, own) != UFB_DELETED)
+         return own;
+      codept = own + 1;
+   }
+}
+
+
+/**
+   @brief Set the code point that ufb_gets starts from.
+
+   @param[in] ufb The mapped file.
+   @param[in] codept The code point.
+*/
+void
+ufb_seek (struct Ufb *ufb, unsigned long codept)
+{
+   ufb->cursor = codept;
+}
+
+
+/**
+   @brief Get the next glyph as a line of a .hex file.
+
+   This is a replacement for fgets for programs that read .hex files
+   line by line.  The line ends with a newline and a null.
+
+   @param[in] ufb The mapped file.
+   @param[out] line The line.
+   @param[in] size The size of line in bytes.
+   @return 1 if a line was returned, or 0 after the last glyph.
+*/
+int
+ufb_gets (struct Ufb *ufb, char *line, int size)
+{
+   static const char hexdigit[] = "0123456789ABCDEF";
+   const unsigned char *bits;
+   unsigned long codept;
+   int digits, len, i;
+
+   codept = ufb_next (ufb, ufb->cursor);
+   if (codept == UFB_END)
+      return 0;
+   ufb->cursor = codept + 1;
+   bits = ufb_glyph (ufb, codept, &digits);
+   if (bits == NULL)   /* damaged entry; skip it */
+      return ufb_gets (ufb, line, size);
+
+   /* Unifont writes 4 digits in Plane 0 and 6 in the other planes. */
+   len = sprintf (line, codept < 0x10000 ? "%04lX:" : "%06lX:", codept);
+   if (len + digits + 2 > size) {
+      fprintf (stderr, "Glyph U+%04lX is too long.\n", codept);
+      exit (EXIT_FAILURE);
+   }
+   for (i = 0; i < digits; i++)
+      line[len++] = hexdigit[(i & 1) ? bits[i / 2] & 0xF : bits[i / 2] >> 4];
+   line[len++] = '\n';
+   line[len]   = '\0';
+   return 1;
+}
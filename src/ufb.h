@@ -0,0 +1,113 @@
+/**
+   @file ufb.h
+
+   @brief Define the Unifont binary glyph store (.ufb) format.
+
+   @author Paul Hardy
+
+   @copyright Copyright (C) 2023 Paul Hardy
+
+   A .ufb file holds the same glyphs as a .hex file, in a form that
+   can be mapped into memory and used without parsing.  It is made
+   by hex2ufb and turned back into a .hex file by ufb2hex.  Several
+   other programs accept a .ufb file wherever they read a .hex file.
+
+   All numbers are 32 bits, least significant byte first.  The file
+   holds, in order:
+
+      - A header: the 8 byte magic string UFB_MAGIC, then the format
+        version, the nominal glyph height in rows, the number of
+        glyphs, the number of width classes, the file size, and the
+        offset of the page index.
+
+      - The width class table.  Glyphs with the same number of
+        hexadecimal digits form a width class.  Each entry gives
+        the digits per glyph, the number of glyphs, the offset of
+        the class's bitmap slab, and the bytes per glyph.
+
+      - The page index: UFB_PAGES offsets, one for each page of 256
+        code points, of that page's glyph table, or 0 if the page
+        has no glyphs.
+
+      - The glyph tables.  Each has 256 entries, one per code point
+        in the page: 0 if there is no glyph, or else the width class
+        in the top 8 bits and the glyph's number in the slab plus 1
+        in the low 24 bits.
+
+      - The bitmap slabs.  A slab holds the glyphs of one width class
+        in code point order, each as its .hex digits packed two to a
+        byte, so that finding any glyph takes two table lookups.
+
+   An overlay is a .ufb file that only holds the differences between
+   a font variant and a base .ufb file, made with "hex2ufb --base".
+   It has format version UFB_OVERLAY_VERSION.  Between its width
+   class table and its page index are the size of the base file and
+   the base file's name, ending in a null; a relative name is taken
+   relative to the directory that holds the overlay.  A glyph table
+   entry of UFB_DELETED marks a base glyph that the variant does not
+   have.  A code point with no entry in the overlay has the base's
+   glyph, if any, so a glyph is still found in at most four lookups.
+   The glyph count in the header is that of the whole variant.  The
+   base may itself be an overlay.
+*/
+/*
+   LICENSE:
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 2 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _UFB_H_
+#define _UFB_H_
+
+#include <stdlib.h>
+
+
+#define UFB_MAGIC      "\211UFB\r\n\032\n"  ///< First 8 bytes of a .ufb file.
+#define UFB_VERSION    1          ///< Format version written by hex2ufb.
+#define UFB_OVERLAY_VERSION 2     ///< Format version of an overlay.
+#define UFB_DELETED    0xFF000000UL  ///< Overlay entry for a removed glyph.
+#define UFB_HEADER     32         ///< Size of the header in bytes.
+#define UFB_CLASS_SIZE 16         ///< Size of a width class entry in bytes.
+#define UFB_PAGES      0x1100     ///< Number of 256 code point pages.
+#define UFB_END        0x110000UL ///< Returned by ufb_next past the last glyph.
+
+
+/**
+   @brief A .ufb file mapped into memory.
+*/
+struct Ufb {
+   const unsigned char *map;      ///< The mapped file.
+   size_t size;                   ///< Size of the file in bytes.
+   unsigned long rows;            ///< Nominal glyph height in rows.
+   unsigned long nglyphs;         ///< Number of glyphs in the file.
+   unsigned long nclasses;        ///< Number of width classes.
+   const unsigned char *classes;  ///< The width class table.
+   const unsigned char *pages;    ///< The page index.
+   unsigned long cursor;          ///< Code point ufb_gets starts from.
+   struct Ufb *base;              ///< Base of an overlay, or NULL.
+   unsigned long scan_from;       ///< Last code point ufb_next scanned from.
+   unsigned long scan_next;       ///< Next entry in this file after scan_from.
+};
+
+
+struct Ufb *ufb_open (const char *filename);
+struct Ufb *ufb_fdopen (int fd, const char *filename);
+void ufb_close (struct Ufb *ufb);
+const unsigned char *ufb_glyph (struct Ufb *ufb, unsigned long codept,
+                                int *digits);
+unsigned long ufb_next (struct Ufb *ufb, unsigned long codept);
+void ufb_seek (struct Ufb *ufb, unsigned long codept);
+int ufb_gets (struct Ufb *ufb, char *line, int size);
+
+#endif
@@ -0,0 +1,137 @@
+/**
+   @file ufb2hex.c
+
+   @brief ufb2hex - Convert a Unifont binary glyph store into a .hex file
+
+   @author Paul Hardy
+
+   @copyright Copyright (C) 2023 Paul Hardy
+
+   This program reads a Unifont binary glyph store (.ufb) made by
+   hex2ufb and writes its glyphs in Unifont .hex format, in code
+   point order.
+
+   Synopsis: ufb2hex [--range from-to] [--output file] [input.ufb]
+
+   If no input file is named, stdin is read; it must be a file, not
+   a pipe, because it is mapped into memory.
+*/
+/*
+   LICENSE:
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 2 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ufb.h"
+
+#define MAXBUF 1024   ///< Longest .hex line written, plus room.
+
+
+/**
+   @brief The main function.
+
+   @param[in] argc The count of command line arguments.
+   @param[in] argv Pointer to array of command line arguments.
+   @return This program exits with status EXIT_SUCCESS or EXIT_FAILURE.
+*/
+int
+main (int argc, char *argv[])
+{
+   char *inname  = NULL;          /* input file name; NULL for stdin   */
+   char *outname = NULL;          /* output file name; NULL for stdout */
+   unsigned long first = 0;       /* first code point to write         */
+   unsigned long last  = UFB_END - 1;  /* last code point to write     */
+   struct Ufb *ufb;               /* the mapped input file             */
+   char  line[MAXBUF];            /* one line of output                */
+   int   i;                       /* loop variable                     */
+   char *arg, *value, *end;       /* current option and its value      */
+   FILE *outfp;                   /* where to write the .hex file      */
+
+   /*
+      Options are accepted as "--name value", "--name=value",
+      "-n value", or "-n=value", as in hex2bdf.
+   */
+   for (i = 1; i < argc; i++) {
+      arg = argv[i];
+      if (arg[0] != '-' || arg[1] == '\0') {
+         inname = arg;
+         continue;
+      }
+      if (arg[1] == '-')
+         arg += 2;
+      else
+         arg += 1;
+      value = strchr (arg, '=');
+      if (value != NULL)
+         *value++ = '\0';
+      else if (i + 1 < argc)
+         value = argv[++i];
+      if (value == NULL) {
+         fprintf (stderr, "ufb2hex: option %s needs a value.\n", argv[i]);
+         exit (EXIT_FAILURE);
+      }
+      if (strcmp (arg, "output") == 0 || strcmp (arg, "o") == 0)
+         outname = value;
+      else if (strcmp (arg, "range") == 0 || strcmp (arg, "R") == 0) {
+         first = last = strtoul (value, &end, 16);
+         if (*end == '-')
+            last = strtoul (end + 1, &end, 16);
+         if (end == value || *end != '\0' || last < first) {
+            fprintf (stderr, "ufb2hex: invalid range: %s\n", value);
+            exit (EXIT_FAILURE);
+         }
+      }
+      else {
+         fprintf (stderr, "\nSyntax:\n\n");
+         fprintf (stderr, "   ufb2hex [--range from-to] [--output file] ");
+         fprintf (stderr, "[input.ufb]\n\n");
+         exit (EXIT_FAILURE);
+      }
+   }
+
+   if (inname == NULL)
+      ufb = ufb_fdopen (0, "stdin");
+   else
+      ufb = ufb_open (inname);
+   if (ufb == NULL) {
+      fprintf (stderr, "ufb2hex: %s is not a .ufb file.\n",
+               inname == NULL ? "stdin" : inname);
+      exit (EXIT_FAILURE);
+   }
+
+   if (outname == NULL)
+      outfp = stdout;
+   else if ((outfp = fopen (outname, "w")) == NULL) {
+      fprintf (stderr, "ufb2hex: can't open %s for output.\n", outname);
+      exit (EXIT_FAILURE);
+   }
+
+   ufb_seek (ufb, first);
+   while (ufb_next (ufb, ufb->cursor) <= last && ufb_gets (ufb, line, MAXBUF))
+      fputs (line, outfp);
+
+   if (fflush (outfp) != 0 || ferror (outfp)) {
+      fprintf (stderr, "ufb2hex: error writing output.\n");
+      exit (EXIT_FAILURE);
+   }
+   if (outfp != stdout)
+      fclose (outfp);
+   ufb_close (ufb);
+
+   exit (EXIT_SUCCESS);
+}
@@ -9,6 +9,14 @@
    @copyright Copyright (C) 2007, 2008, 2013, 2017, 2019, 2022 Paul Hardy
 
    Synopsis: unibmp2hex [-iin_file.bmp] [-oout_file.hex] [-phex_page_num] [-w]
+             unibmp2hex [-oout_file.hex] [-din_dir] [-jjobs] [-w] [in_file.bmp ...]
+
+   The input bitmap can be gzip or zstd compressed, and the output is
+   compressed if its name ends in ".gz" or ".zst".
+
+   Given several bitmap files, or a directory of them with -d, the files
+   are read several at a time in child processes and their glyphs are
+   written as one .hex file, in code point order.
 */
 /*
 
@@ -100,6 +108,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "unizio.h"
 
 #define MAXBUF 256	///< Maximum input file line length - 1
 
@@ -136,52 +152,212 @@ struct {
 /** Bitmap Color Table -- maximum of 256 colors in a BMP file */
 unsigned char color_table[256][4];  /* R, G, B, alpha for up to 256 colors */
 
+
+/**
+   @brief A range of code points whose glyphs are forced to a width.
+*/
+struct WideRange {
+   unsigned first;  ///< First code point in the range.
+   unsigned last;   ///< Last code point in the range.
+   int width;       ///< 1 = force double-width; 4 = force quadruple-width.
+};
+
+/**
+   Selected code points for double width (16x16), in code point order.
+   Double-width is forced in cases where a glyph (usually a combining
+   glyph) only occupies the left-hand side of a 16x16 grid, but must
+   be rendered as double-width to appear properly with other glyphs
+   in a given script.  If additions were made to a script after
+   Unicode 5.0, the Unicode version is given in parentheses after
+   the script name.  The ranges must not overlap.
+*/
+const struct WideRange wide[] = {
+   { 0x0700, 0x074F, 1 },  /* Syriac                 */
+   { 0x0800, 0x083F, 1 },  /* Samaritan (5.2)        */
+   { 0x0900, 0x0DFF, 1 },  /* Indic                  */
+   { 0x1000, 0x109F, 1 },  /* Myanmar                */
+   { 0x1100, 0x11FF, 1 },  /* Hangul Jamo            */
+   { 0x1400, 0x167F, 1 },  /* Canadian Aboriginal    */
+   { 0x1700, 0x171F, 1 },  /* Tagalog                */
+   { 0x1720, 0x173F, 1 },  /* Hanunoo                */
+   { 0x1740, 0x175F, 1 },  /* Buhid                  */
+   { 0x1760, 0x177F, 1 },  /* Tagbanwa               */
+   { 0x1780, 0x17FF, 1 },  /* Khmer                  */
+   { 0x1800, 0x18AF, 1 },  /* Mongolian              */
+   { 0x18B0, 0x18FF, 1 },  /* Ext. Can. Aboriginal   */
+   { 0x1900, 0x194F, 1 },  /* Limbu                  */
+// { 0x1980, 0x19DF, 1 },  /* New Tai Lue            */
+   { 0x1A00, 0x1A1F, 1 },  /* Buginese               */
+   { 0x1A20, 0x1AAF, 1 },  /* Tai Tham (5.2)         */
+   { 0x1B00, 0x1B7F, 1 },  /* Balinese               */
+   { 0x1B80, 0x1BBF, 1 },  /* Sundanese (5.1)        */
+   { 0x1BC0, 0x1BFF, 1 },  /* Batak (6.0)            */
+   { 0x1C00, 0x1C4F, 1 },  /* Lepcha (5.1)           */
+   { 0x1CC0, 0x1CCF, 1 },  /* Sundanese Supplement   */
+   { 0x1CD0, 0x1CFF, 1 },  /* Vedic Extensions (5.2) */
+   { 0x2329, 0x232A, 1 },  /* Left- & Right-pointing Angle Brackets */
+   { 0x2E80, 0x303E, 1 },  /* CJK                    */
+                           /* U+303F, CJK half-space fill, is not wide */
+   { 0x3040, 0xA4CF, 1 },  /* CJK                    */
+// { 0x9FD8, 0x9FE9, 4 },  /* CJK quadruple-width    */
+   { 0xA900, 0xA92F, 1 },  /* Kayah Li (5.1)         */
+   { 0xA930, 0xA95F, 1 },  /* Rejang (5.1)           */
+   { 0xA960, 0xA97F, 1 },  /* Hangul Jamo Extended-A */
+   { 0xA980, 0xA9DF, 1 },  /* Javanese (5.2)         */
+   { 0xA9E0, 0xA9FF, 1 },  /* Myanmar Extended-B     */
+   { 0xAA00, 0xAA5F, 1 },  /* Cham (5.1)             */
+   { 0xAA60, 0xAA7F, 1 },  /* Myanmar Extended-A     */
+   { 0xAAE0, 0xAAFF, 1 },  /* Meetei Mayek Ext (6.0) */
+   { 0xABC0, 0xABFF, 1 },  /* Meetei Mayek (5.2)     */
+   { 0xAC00, 0xD7AF, 1 },  /* Hangul Syllables       */
+   { 0xD7B0, 0xD7FF, 1 },  /* Hangul Jamo Extended-B */
+   { 0xF900, 0xFAFF, 1 },  /* CJK Compatibility      */
+   { 0xFE10, 0xFE1F, 1 },  /* Vertical Forms         */
+   { 0xFE30, 0xFE60, 1 },  /* CJK Compatibility Forms*/
+   { 0xFFE0, 0xFFE6, 1 },  /* CJK Compatibility Forms*/
+
+   /* Supplemental Multilingual Plane (Plane 01) */
+   { 0x010A00, 0x010A5F, 1 },  /* Kharoshthi         */
+   { 0x011000, 0x01107F, 1 },  /* Brahmi             */
+   { 0x011080, 0x0110CF, 1 },  /* Kaithi             */
+   { 0x011100, 0x01114F, 1 },  /* Chakma             */
+   { 0x011180, 0x0111DF, 1 },  /* Sharada            */
+   { 0x011200, 0x01124F, 1 },  /* Khojki             */
+   { 0x0112B0, 0x0112FF, 1 },  /* Khudawadi          */
+   { 0x011300, 0x01137F, 1 },  /* Grantha            */
+   { 0x011400, 0x01147F, 1 },  /* Newa               */
+   { 0x011480, 0x0114DF, 1 },  /* Tirhuta            */
+   { 0x011580, 0x0115FF, 1 },  /* Siddham            */
+   { 0x011600, 0x01165F, 1 },  /* Modi               */
+   { 0x011660, 0x01167F, 1 },  /* Mongolian Suppl.   */
+   { 0x011680, 0x0116CF, 1 },  /* Takri              */
+   { 0x011700, 0x01173F, 1 },  /* Ahom               */
+   { 0x011800, 0x01184F, 1 },  /* Dogra              */
+   { 0x011900, 0x01195F, 1 },  /* Dives Akuru        */
+   { 0x0119A0, 0x0119FF, 1 },  /* Nandinagari        */
+   { 0x011A00, 0x011A4F, 1 },  /* Zanabazar Square   */
+   { 0x011A50, 0x011AAF, 1 },  /* Soyombo            */
+   { 0x011B00, 0x011B5F, 1 },  /* Devanagari Extended-A*/
+   { 0x011C00, 0x011C6F, 1 },  /* Bhaiksuki          */
+   { 0x011C70, 0x011CBF, 1 },  /* Marchen            */
+   { 0x011D00, 0x011D5F, 1 },  /* Masaram Gondi      */
+   { 0x011EE0, 0x011EFF, 1 },  /* Makasar            */
+   { 0x011F00, 0x011F5F, 1 },  /* Kawi               */
+   { 0x012F90, 0x012FFF, 1 },  /* Cypro-Minoan       */
+   /* Make Bassa Vah all single width or all double width */
+   { 0x016AD0, 0x016AFF, 1 },  /* Bassa Vah          */
+   { 0x016B00, 0x016B8F, 1 },  /* Pahawh Hmong       */
+   { 0x016F00, 0x016F9F, 1 },  /* Miao               */
+   { 0x016FE0, 0x016FFF, 1 },  /* Ideograph Sym/Punct*/
+   { 0x017000, 0x0187FF, 1 },  /* Tangut             */
+   { 0x018800, 0x018AFF, 1 },  /* Tangut Components  */
+   { 0x01AFF0, 0x01AFFF, 1 },  /* Kana Extended-B    */
+   { 0x01B000, 0x01B0FF, 1 },  /* Kana Supplement    */
+   { 0x01B100, 0x01B12F, 1 },  /* Kana Extended-A    */
+   { 0x01B170, 0x01B2FF, 1 },  /* Nushu              */
+   { 0x01CF00, 0x01CFCF, 1 },  /* Znamenny Musical   */
+   { 0x01D100, 0x01D1FF, 1 },  /* Musical Symbols    */
+   { 0x01D800, 0x01DAAF, 1 },  /* Sutton SignWriting */
+   { 0x01E2C0, 0x01E2FF, 1 },  /* Wancho             */
+   { 0x01E800, 0x01E8DF, 1 },  /* Mende Kikakui      */
+   { 0x01F200, 0x01F2FF, 1 },  /* Encl Ideograp Suppl*/
+   { 0x01F5E7, 0x01F5E7, 1 }   /* Three Rays Right   */
+};
+
+#define NWIDE (sizeof (wide) / sizeof (wide[0])) ///< Entries in wide[].
+
+
+/**
+   @brief The glyphs read from one grid bitmap.
+*/
+struct Grid {
+   int status;         ///< 0 = not read yet, 1 = read, -1 = error.
+   unsigned page;      ///< Code point of the grid's first glyph >> 8.
+   unsigned char width[256];  ///< Bytes per glyph row, or 0 if no glyph.
+   unsigned char rows[256][16][4];  ///< Each glyph's 16 rows.
+};
+
 // #define DEBUG
 
 /**
    @brief The main function.
 
+   With no input file names after the options, read one grid from the
+   -i file or stdin.  Otherwise, read each named .bmp or .wbmp file,
+   and each one in the directory given with -d, in child processes,
+   and write the glyphs of all of them as one .hex file in code point
+   order.  If two grids have a glyph for the same code point, the one
+   named last is used.
+
    @param[in] argc The count of command line arguments.
    @param[in] argv Pointer to array of command line arguments.
-   @return This program exits with status 0.
+   @return This program exits with status 0, or 1 if a grid could
+           not be read.
 */
 int
 main (int argc, char *argv[])
 {
 
-   int i, j, k;               /* loop variables                       */
-   unsigned char inchar;       /* temporary input character */
-   char header[MAXBUF];        /* input buffer for bitmap file header */
-   int wbmp=0; /* =0 for Windows Bitmap (.bmp); 1 for Wireless Bitmap (.wbmp) */
-   int fatal; /* =1 if a fatal error occurred */
-   int match; /* =1 if we're still matching a pattern, 0 if no match */
-   int empty1, empty2; /* =1 if bytes tested are all zeroes */
-   unsigned char thischar1[16], thischar2[16]; /* bytes of hex char */
-   unsigned char thischar0[16], thischar3[16]; /* bytes for quadruple-width */
-   int thisrow; /* index to point into thischar1[] and thischar2[] */
-   int tmpsum;  /* temporary sum to see if a character is blank */
-   unsigned this_pixel;  /* color of one pixel, if > 1 bit per pixel */
-   unsigned next_pixels; /* pending group of 8 pixels being read */
-   unsigned color_mask = 0x00;  /* to invert monochrome bitmap, set to 0xFF */
-
-   unsigned char bitmap[17*32][18*32/8]; /* final bitmap */
-   /* For wide array:
-         0 = don't force glyph to double-width;
-         1 = force glyph to double-width;
-         4 = force glyph to quadruple-width.
-   */
-   char wide[0x200000]={0x200000 * 0};
-
+   int i;                      /* loop variable */
    char *infile="", *outfile="";  /* names of input and output files */
+   char *indir="";          /* directory of grid files, with -d        */
    FILE *infp, *outfp;      /* file pointers of input and output files */
 
+   char **names;            /* grid files to read in batch mode */
+   int nnames = 0;          /* number of grid files             */
+   int maxnames;            /* allocated size of names[]        */
+   DIR *dir;                /* the -d directory                 */
+   struct dirent *entry;    /* a file in the -d directory       */
+   char *name;
+   struct Grid *grids;      /* the glyphs of each grid file     */
+   struct Grid grid;        /* the glyphs of the single grid    */
+   struct Grid **sorted;    /* the grids in page order          */
+   int n;                   /* number of grids with one page    */
+   int jobs;                /* most grids read at once          */
+   int running = 0;         /* child processes reading grids    */
+   int status;              /* exit status of a child process   */
+   int failed = 0;          /* 1 if a grid could not be read    */
+   pid_t pid;
+
+   /* read a grid bitmap file and get the glyphs in it */
+   int read_grid (FILE *infp, struct Grid *grid);
+
+   /* read one of the named grid files */
+   int read_grid_file (char *name, struct Grid *grid);
+
+   /* 1 if a file name is that of a .bmp or .wbmp file */
+   int grid_name (char *name);
+
+   /* compare grids[] entries by page, for sorting */
+   int compare_grids (const void *a, const void *b);
+
+   /* write the glyphs of one or more grids of the same page */
+   void write_glyphs (FILE *outfp, struct Grid **group, int n);
+
+   jobs = (int)sysconf (_SC_NPROCESSORS_ONLN);
+   if (jobs < 1) jobs = 1;
+
+   maxnames = argc + 1;
+   names = malloc (maxnames * sizeof (char *));
+   if (names == NULL) {
+      fprintf (stderr, "Error: out of memory.\n");
+      exit (1);
+   }
+
    if (argc > 1) {
       for (i = 1; i < argc; i++) {
          if (argv[i][0] == '-') {  /* this is an option argument */
             switch (argv[i][1]) {
+               case 'd':  /* directory of grid files */
+                  indir = &argv[i][2];
+                  break;
                case 'i':  /* name of input file */
                   infile = &argv[i][2];
                   break;
+               case 'j':  /* most grid files read at once */
+                  jobs = atoi (&argv[i][2]);
+                  if (jobs < 1) jobs = 1;
+                  break;
                case 'o':  /* name of output file */
                   outfile = &argv[i][2];
                   break;
@@ -195,7 +371,10 @@ main (int argc, char *argv[])
                default:   /* if unrecognized option, print list and exit */
                   fprintf (stderr, "\nSyntax:\n\n");
                   fprintf (stderr, "   %s -p<Unicode_Page> ", argv[0]);
-                  fprintf (stderr, "-i<Input_File> -o<Output_File> -w\n\n");
+                  fprintf (stderr, "-i<Input_File> -o<Output_File> -w\n");
+                  fprintf (stderr, "   %s -o<Output_File> ", argv[0]);
+                  fprintf (stderr, "-d<Input_Dir> -j<Jobs> -w ");
+                  fprintf (stderr, "[Input_File ...]\n\n");
                   fprintf (stderr, "   -w specifies .wbmp output instead of ");
                   fprintf (stderr, "default Windows .bmp output.\n\n");
                   fprintf (stderr, "   -p is followed by 1 to 6 ");
@@ -207,23 +386,61 @@ main (int argc, char *argv[])
                   exit (1);
             }
          }
+         else {  /* a grid file to read in batch mode */
+            names[nnames++] = argv[i];
+         }
       }
    }
    /*
-      Make sure we can open any I/O files that were specified before
-      doing anything else.
+      Add the grid files in the -d directory.
    */
-   if (strlen (infile) > 0) {
-      if ((infp = fopen (infile, "r")) == NULL) {
-         fprintf (stderr, "Error: can't open %s for input.\n", infile);
+   if (strlen (indir) > 0) {
+      if ((dir = opendir (indir)) == NULL) {
+         fprintf (stderr, "Error: can't open directory %s.\n", indir);
+         exit (1);
+      }
+      while ((entry = readdir (dir)) != NULL) {
+         if (!grid_name (entry->d_name))
+            continue;
+         if (nnames == maxnames) {
+            maxnames *= 2;
+            names = realloc (names, maxnames * sizeof (char *));
+         }
+         name = malloc (strlen (indir) + strlen (entry->d_name) + 2);
+         if (names == NULL || name == NULL) {
+            fprintf (stderr, "Error: out of memory.\n");
+            exit (1);
+         }
+         sprintf (name, "%s/%s", indir, entry->d_name);
+         names[nnames++] = name;
+      }
+      closedir (dir);
+      if (nnames == 0) {
+         fprintf (stderr, "Error: no .bmp or .wbmp files in %s.\n", indir);
          exit (1);
       }
    }
-   else {
-      infp = stdin;
+   if (nnames > 0 && strlen (infile) > 0) {
+      fprintf (stderr, "Error: -i can't be used with other input files.\n");
+      exit (1);
+   }
+   /*
+      Make sure we can open any I/O files that were specified before
+      doing anything else.
+   */
+   if (nnames == 0) {
+      if (strlen (infile) > 0) {
+         if ((infp = zio_open (infile, "r")) == NULL) {
+            fprintf (stderr, "Error: can't open %s for input.\n", infile);
+            exit (1);
+         }
+      }
+      else {
+         infp = zio_wrap (stdin, "stdin");
+      }
    }
    if (strlen (outfile) > 0) {
-      if ((outfp = fopen (outfile, "w")) == NULL) {
+      if ((outfp = zio_open (outfile, "w")) == NULL) {
          fprintf (stderr, "Error: can't open %s for output.\n", outfile);
          exit (1);
       }
@@ -231,106 +448,154 @@ main (int argc, char *argv[])
    else {
       outfp = stdout;
    }
+
+   if (nnames == 0) {
+      if (read_grid (infp, &grid) != 0) {
+         fprintf (stderr, "Fatal error; end of input file.\n\n");
+         exit (1);
+      }
+      /*
+         We've read the entire file.  Now close the input file pointer.
+      */
+      fclose (infp);
+      sorted = malloc (sizeof (struct Grid *));
+      if (sorted == NULL) {
+         fprintf (stderr, "Error: out of memory.\n");
+         exit (1);
+      }
+      sorted[0] = &grid;
+      write_glyphs (outfp, sorted, 1);
+      fclose (outfp);  /* completes a compressed output file */
+      exit (0);
+   }
+
+   /*
+      Read each grid in a child process, with at most "jobs" running
+      at once.  Each child leaves its glyphs in its own entry of
+      grids[], which is shared with this process.
+   */
+   grids = mmap (NULL, nnames * sizeof (struct Grid), PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   if (grids == MAP_FAILED) {
+      fprintf (stderr, "Error: out of memory.\n");
+      exit (1);
+   }
+   fflush (stdout);
+   fflush (stderr);
+   for (i = 0; i < nnames; i++) {
+      if (jobs == 1) {
+         (void)read_grid_file (names[i], &grids[i]);
+         continue;
+      }
+      if (running == jobs) {
+         if (wait (&status) < 0 || !WIFEXITED (status))
+            failed = 1;
+         running--;
+      }
+      pid = fork ();
+      if (pid == 0) {
+         exit (read_grid_file (names[i], &grids[i]) ?
+               EXIT_FAILURE : EXIT_SUCCESS);
+      }
+      else if (pid < 0)
+         (void)read_grid_file (names[i], &grids[i]);
+      else
+         running++;
+   }
+   while (running > 0) {
+      if (wait (&status) < 0 || !WIFEXITED (status))
+         failed = 1;
+      running--;
+   }
+   for (i = 0; i < nnames; i++) {
+      if (grids[i].status != 1) {
+         fprintf (stderr, "Error: can't read %s.\n", names[i]);
+         failed = 1;
+      }
+   }
+   if (failed)
+      exit (1);
+
    /*
-      Initialize selected code points for double width (16x16).
-      Double-width is forced in cases where a glyph (usually a combining
-      glyph) only occupies the left-hand side of a 16x16 grid, but must
-      be rendered as double-width to appear properly with other glyphs
-      in a given script.  If additions were made to a script after
-      Unicode 5.0, the Unicode version is given in parentheses after
-      the script name.
+      Write the glyphs of all grids in page order.  Grids of the same
+      page stay in the order they were named.
    */
-   for (i = 0x0700; i <= 0x074F; i++) wide[i] = 1; /* Syriac                 */
-   for (i = 0x0800; i <= 0x083F; i++) wide[i] = 1; /* Samaritan (5.2)        */
-   for (i = 0x0900; i <= 0x0DFF; i++) wide[i] = 1; /* Indic                  */
-   for (i = 0x1000; i <= 0x109F; i++) wide[i] = 1; /* Myanmar                */
-   for (i = 0x1100; i <= 0x11FF; i++) wide[i] = 1; /* Hangul Jamo            */
-   for (i = 0x1400; i <= 0x167F; i++) wide[i] = 1; /* Canadian Aboriginal    */
-   for (i = 0x1700; i <= 0x171F; i++) wide[i] = 1; /* Tagalog                */
-   for (i = 0x1720; i <= 0x173F; i++) wide[i] = 1; /* Hanunoo                */
-   for (i = 0x1740; i <= 0x175F; i++) wide[i] = 1; /* Buhid                  */
-   for (i = 0x1760; i <= 0x177F; i++) wide[i] = 1; /* Tagbanwa               */
-   for (i = 0x1780; i <= 0x17FF; i++) wide[i] = 1; /* Khmer                  */
-   for (i = 0x18B0; i <= 0x18FF; i++) wide[i] = 1; /* Ext. Can. Aboriginal   */
-   for (i = 0x1800; i <= 0x18AF; i++) wide[i] = 1; /* Mongolian              */
-   for (i = 0x1900; i <= 0x194F; i++) wide[i] = 1; /* Limbu                  */
-// for (i = 0x1980; i <= 0x19DF; i++) wide[i] = 1; /* New Tai Lue            */
-   for (i = 0x1A00; i <= 0x1A1F; i++) wide[i] = 1; /* Buginese               */
-   for (i = 0x1A20; i <= 0x1AAF; i++) wide[i] = 1; /* Tai Tham (5.2)         */
-   for (i = 0x1B00; i <= 0x1B7F; i++) wide[i] = 1; /* Balinese               */
-   for (i = 0x1B80; i <= 0x1BBF; i++) wide[i] = 1; /* Sundanese (5.1)        */
-   for (i = 0x1BC0; i <= 0x1BFF; i++) wide[i] = 1; /* Batak (6.0)            */
-   for (i = 0x1C00; i <= 0x1C4F; i++) wide[i] = 1; /* Lepcha (5.1)           */
-   for (i = 0x1CC0; i <= 0x1CCF; i++) wide[i] = 1; /* Sundanese Supplement   */
-   for (i = 0x1CD0; i <= 0x1CFF; i++) wide[i] = 1; /* Vedic Extensions (5.2) */
-   wide[0x2329] = wide[0x232A] = 1; /* Left- & Right-pointing Angle Brackets */
-   for (i = 0x2E80; i <= 0xA4CF; i++) wide[i] = 1; /* CJK                    */
-// for (i = 0x9FD8; i <= 0x9FE9; i++) wide[i] = 4; /* CJK quadruple-width    */
-   for (i = 0xA900; i <= 0xA92F; i++) wide[i] = 1; /* Kayah Li (5.1)         */
-   for (i = 0xA930; i <= 0xA95F; i++) wide[i] = 1; /* Rejang (5.1)           */
-   for (i = 0xA960; i <= 0xA97F; i++) wide[i] = 1; /* Hangul Jamo Extended-A */
-   for (i = 0xA980; i <= 0xA9DF; i++) wide[i] = 1; /* Javanese (5.2)         */
-   for (i = 0xAA00; i <= 0xAA5F; i++) wide[i] = 1; /* Cham (5.1)             */
-   for (i = 0xA9E0; i <= 0xA9FF; i++) wide[i] = 1; /* Myanmar Extended-B     */
-   for (i = 0xAA00; i <= 0xAA5F; i++) wide[i] = 1; /* Cham                   */
-   for (i = 0xAA60; i <= 0xAA7F; i++) wide[i] = 1; /* Myanmar Extended-A     */
-   for (i = 0xAAE0; i <= 0xAAFF; i++) wide[i] = 1; /* Meetei Mayek Ext (6.0) */
-   for (i = 0xABC0; i <= 0xABFF; i++) wide[i] = 1; /* Meetei Mayek (5.2)     */
-   for (i = 0xAC00; i <= 0xD7AF; i++) wide[i] = 1; /* Hangul Syllables       */
-   for (i = 0xD7B0; i <= 0xD7FF; i++) wide[i] = 1; /* Hangul Jamo Extended-B */
-   for (i = 0xF900; i <= 0xFAFF; i++) wide[i] = 1; /* CJK Compatibility      */
-   for (i = 0xFE10; i <= 0xFE1F; i++) wide[i] = 1; /* Vertical Forms         */
-   for (i = 0xFE30; i <= 0xFE60; i++) wide[i] = 1; /* CJK Compatibility Forms*/
-   for (i = 0xFFE0; i <= 0xFFE6; i++) wide[i] = 1; /* CJK Compatibility Forms*/
-
-   wide[0x303F] = 0; /* CJK half-space fill */
+   sorted = malloc (nnames * sizeof (struct Grid *));
+   if (sorted == NULL) {
+      fprintf (stderr, "Error: out of memory.\n");
+      exit (1);
+   }
+   for (i = 0; i < nnames; i++)
+      sorted[i] = &grids[i];
+   qsort (sorted, nnames, sizeof (struct Grid *), compare_grids);
+   for (i = 0; i < nnames; i += n) {
+      for (n = 1; i + n < nnames && sorted[i + n]->page == sorted[i]->page;
+           n++);
+      write_glyphs (outfp, &sorted[i], n);
+   }
+   fclose (outfp);  /* completes a compressed output file */
+   exit (0);
+}
 
-   /* Supplemental Multilingual Plane (Plane 01) */
-   for (i = 0x010A00; i <= 0x010A5F; i++) wide[i] = 1; /* Kharoshthi         */
-   for (i = 0x011000; i <= 0x01107F; i++) wide[i] = 1; /* Brahmi             */
-   for (i = 0x011080; i <= 0x0110CF; i++) wide[i] = 1; /* Kaithi             */
-   for (i = 0x011100; i <= 0x01114F; i++) wide[i] = 1; /* Chakma             */
-   for (i = 0x011180; i <= 0x0111DF; i++) wide[i] = 1; /* Sharada            */
-   for (i = 0x011200; i <= 0x01124F; i++) wide[i] = 1; /* Khojki             */
-   for (i = 0x0112B0; i <= 0x0112FF; i++) wide[i] = 1; /* Khudawadi          */
-   for (i = 0x011300; i <= 0x01137F; i++) wide[i] = 1; /* Grantha            */
-   for (i = 0x011400; i <= 0x01147F; i++) wide[i] = 1; /* Newa               */
-   for (i = 0x011480; i <= 0x0114DF; i++) wide[i] = 1; /* Tirhuta            */
-   for (i = 0x011580; i <= 0x0115FF; i++) wide[i] = 1; /* Siddham            */
-   for (i = 0x011600; i <= 0x01165F; i++) wide[i] = 1; /* Modi               */
-   for (i = 0x011660; i <= 0x01167F; i++) wide[i] = 1; /* Mongolian Suppl.   */
-   for (i = 0x011680; i <= 0x0116CF; i++) wide[i] = 1; /* Takri              */
-   for (i = 0x011700; i <= 0x01173F; i++) wide[i] = 1; /* Ahom               */
-   for (i = 0x011800; i <= 0x01184F; i++) wide[i] = 1; /* Dogra              */
-   for (i = 0x011900; i <= 0x01195F; i++) wide[i] = 1; /* Dives Akuru        */
-   for (i = 0x0119A0; i <= 0x0119FF; i++) wide[i] = 1; /* Nandinagari        */
-   for (i = 0x011A00; i <= 0x011A4F; i++) wide[i] = 1; /* Zanabazar Square   */
-   for (i = 0x011A50; i <= 0x011AAF; i++) wide[i] = 1; /* Soyombo            */
-   for (i = 0x011B00; i <= 0x011B5F; i++) wide[i] = 1; /* Devanagari Extended-A*/
-   for (i = 0x011F00; i <= 0x011F5F; i++) wide[i] = 1; /* Kawi               */
-   for (i = 0x011C00; i <= 0x011C6F; i++) wide[i] = 1; /* Bhaiksuki          */
-   for (i = 0x011C70; i <= 0x011CBF; i++) wide[i] = 1; /* Marchen            */
-   for (i = 0x011D00; i <= 0x011D5F; i++) wide[i] = 1; /* Masaram Gondi      */
-   for (i = 0x011EE0; i <= 0x011EFF; i++) wide[i] = 1; /* Makasar            */
-   for (i = 0x012F90; i <= 0x012FFF; i++) wide[i] = 1; /* Cypro-Minoan       */
-   /* Make Bassa Vah all single width or all double width */
-   for (i = 0x016AD0; i <= 0x016AFF; i++) wide[i] = 1; /* Bassa Vah          */
-   for (i = 0x016B00; i <= 0x016B8F; i++) wide[i] = 1; /* Pahawh Hmong       */
-   for (i = 0x016F00; i <= 0x016F9F; i++) wide[i] = 1; /* Miao               */
-   for (i = 0x016FE0; i <= 0x016FFF; i++) wide[i] = 1; /* Ideograph Sym/Punct*/
-   for (i = 0x017000; i <= 0x0187FF; i++) wide[i] = 1; /* Tangut             */
-   for (i = 0x018800; i <= 0x018AFF; i++) wide[i] = 1; /* Tangut Components  */
-   for (i = 0x01AFF0; i <= 0x01AFFF; i++) wide[i] = 1; /* Kana Extended-B    */
-   for (i = 0x01B000; i <= 0x01B0FF; i++) wide[i] = 1; /* Kana Supplement    */
-   for (i = 0x01B100; i <= 0x01B12F; i++) wide[i] = 1; /* Kana Extended-A    */
-   for (i = 0x01B170; i <= 0x01B2FF; i++) wide[i] = 1; /* Nushu              */
-   for (i = 0x01CF00; i <= 0x01CFCF; i++) wide[i] = 1; /* Znamenny Musical   */
-   for (i = 0x01D100; i <= 0x01D1FF; i++) wide[i] = 1; /* Musical Symbols    */
-   for (i = 0x01D800; i <= 0x01DAAF; i++) wide[i] = 1; /* Sutton SignWriting */
-   for (i = 0x01E2C0; i <= 0x01E2FF; i++) wide[i] = 1; /* Wancho             */
-   for (i = 0x01E800; i <= 0x01E8DF; i++) wide[i] = 1; /* Mende Kikakui      */
-   for (i = 0x01F200; i <= 0x01F2FF; i++) wide[i] = 1; /* Encl Ideograp Suppl*/
-   wide[0x01F5E7] = 1;                                 /* Three Rays Right   */
+
+/**
+   @brief Read one of the named grid files.
+
+   @param[in] name The name of the .bmp or .wbmp file.
+   @param[out] grid The glyphs in the file.
+   @return 0 if the file was read, or 1 on error.
+*/
+int
+read_grid_file (char *name, struct Grid *grid)
+{
+   FILE *infp;
+
+   int read_grid (FILE *infp, struct Grid *grid);
+
+   if ((infp = zio_open (name, "r")) == NULL) {
+      grid->status = -1;
+      return 1;
+   }
+   if (read_grid (infp, grid) != 0) {
+      fclose (infp);
+      return 1;
+   }
+   fclose (infp);
+   return 0;
+}
+
+
+/**
+   @brief Read a grid bitmap file and get the glyphs in it.
+
+   The file is a .bmp or .wbmp file made by unihex2bmp, before or
+   after editing.  Unless the page was given with -p, it is found
+   from the row and column headers in the bitmap.
+
+   @param[in] infp The input file.
+   @param[out] grid The glyphs in the file, and its page number.
+   @return 0 if the file was read, or 1 if it ended early.
+*/
+int
+read_grid (FILE *infp, struct Grid *grid)
+{
+   int i, j, k;               /* loop variables                       */
+   unsigned char inchar;       /* temporary input character */
+   char header[MAXBUF];        /* input buffer for bitmap file header */
+   int wbmp=0; /* =0 for Windows Bitmap (.bmp); 1 for Wireless Bitmap (.wbmp) */
+   int fatal; /* =1 if a fatal error occurred */
+   int match; /* =1 if we're still matching a pattern, 0 if no match */
+   int tmpsum;  /* temporary sum to see if a character is blank */
+   unsigned this_pixel;  /* color of one pixel, if > 1 bit per pixel */
+   unsigned next_pixels; /* pending group of 8 pixels being read */
+   unsigned color_mask = 0x00;  /* to invert monochrome bitmap, set to 0xFF */
+
+   unsigned char bitmap[17*32][18*32/8]; /* final bitmap */
+
+   /* get the glyphs from the bitmap */
+   void grid_glyphs (unsigned char bitmap[17*32][18*32/8], struct Grid *grid);
+
+   grid->status = -1;
 
    /*
       Determine whether or not the file is a Microsoft Windows Bitmap file.
@@ -357,10 +622,8 @@ main (int argc, char *argv[])
    else
       fatal = 1;
 
-   if (fatal) {
-      fprintf (stderr, "Fatal error; end of input file.\n\n");
-      exit (1);
-   }
+   if (fatal)
+      return 1;
    /*
       If this is a Wireless Bitmap (.wbmp) format file,
       skip the header and point to the start of the bitmap itself.
@@ -547,10 +810,6 @@ main (int argc, char *argv[])
    }
 
    /*
-      We've read the entire file.  Now close the input file pointer.
-   */
-   fclose (infp);
-  /*
       We now have the header portion in the header[] array,
       and have the bitmap portion from top-to-bottom in the bitmap[] array.
    */
@@ -561,6 +820,7 @@ main (int argc, char *argv[])
 
       Store bitmaps for the hex digit patterns that this file uses.
    */
+   flip = 0;
    if (!planeset) {  /* If Unicode range not specified with -p parameter */
       for (i = 0x0; i <= 0xF; i++) {  /* hex digit pattern we're storing */
          for (j = 0; j < 4; j++) {
@@ -638,8 +898,38 @@ main (int argc, char *argv[])
       }
       uniplane >>= 4;
    }
+   grid->page = uniplane;
+
+   grid_glyphs (bitmap, grid);
+   grid->status = 1;
+   return 0;
+}
+
+
+/**
+   @brief Get the glyphs from a grid bitmap.
+
+   A glyph is 8 pixels wide if its right half is blank, unless it is
+   forced to a wider width with -w or by the wide[] table.  A blank
+   glyph is left out.
+
+   @param[in] bitmap The grid bitmap, read from top to bottom.
+   @param[in,out] grid The grid, with its page number set.
+*/
+void
+grid_glyphs (unsigned char bitmap[17*32][18*32/8], struct Grid *grid)
+{
+   int i, j, k;               /* loop variables                       */
+   int empty1, empty2; /* =1 if bytes tested are all zeroes */
+   unsigned char thischar1[16], thischar2[16]; /* bytes of hex char */
+   unsigned char thischar0[16], thischar3[16]; /* bytes for quadruple-width */
+   int thisrow; /* index to point into thischar1[] and thischar2[] */
+   int width;   /* forced width of this code point, from wide[] */
+
+   int forced_width (unsigned codept);
+
    /*
-      Now read each glyph and print it as hex.
+      Now read each glyph.
    */
    for (i = 0x0; i <= 0xf; i++) {
       for (j = 0x0; j <= 0xf; j++) {
@@ -659,7 +949,7 @@ main (int argc, char *argv[])
          }
          /*
             If the second half of the 16*16 character is all zeroes, this
-            character is only 8 bits wide, so print a half-width character.
+            character is only 8 bits wide, so keep a half-width character.
          */
          empty1 = empty2 = 1;
          for (k=0; (empty1 || empty2) && k < 16; k++) {
@@ -667,54 +957,180 @@ main (int argc, char *argv[])
             if (thischar2[k] != 0) empty2 = 0;
             }
          /*
-            Only print this glyph if it isn't blank.
+            Only keep this glyph if it isn't blank.
          */
-         if (!empty1 || !empty2) {
-            /*
-               If the second half is empty, this is a half-width character.
-               Only print the first half.
-            */
-            /*
-               Original GNU Unifont format is four hexadecimal digit character
-               code followed by a colon followed by a hex string.  Add support
-               for codes beyond the Basic Multilingual Plane.
-
-               Unicode ranges from U+0000 to U+10FFFF, so print either a
-               4-digit or a 6-digit code point.  Note that this software
-               should support up to an 8-digit code point, extending beyond
-               the normal Unicode range, but this has not been fully tested.
-            */
-            if (uniplane > 0xff)
-               fprintf (outfp, "%04X%X%X:", uniplane, i, j); // 6 digit code pt.
-            else
-               fprintf (outfp, "%02X%X%X:", uniplane, i, j); // 4 digit code pt.
-            for (thisrow=0; thisrow<16; thisrow++) {
-               /*
-                  If second half is empty and we're not forcing this
-                  code point to double width, print as single width.
-               */
-               if (!forcewide &&
-                   empty2 && !wide[(uniplane << 8) | (i << 4) | j]) {
-                  fprintf (outfp,
-                          "%02X",
-                          thischar1[thisrow]);
-               }
-               else if (wide[(uniplane << 8) | (i << 4) | j] == 4) {
-                  /* quadruple-width; force 32nd pixel to zero */
-                  fprintf (outfp,
-                          "%02X%02X%02X%02X",
-                          thischar0[thisrow], thischar1[thisrow],
-                          thischar2[thisrow], thischar3[thisrow] & 0xFE);
-               }
-               else { /* treat as double-width */
-                  fprintf (outfp,
-                          "%02X%02X",
-                          thischar1[thisrow], thischar2[thisrow]);
-               }
+         if (empty1 && empty2) {
+            grid->width[(i << 4) | j] = 0;
+            continue;
+         }
+         width = forced_width ((grid->page << 8) | (i << 4) | j);
+         /*
+            If second half is empty and we're not forcing this
+            code point to double width, keep it as single width.
+         */
+         if (!forcewide && empty2 && !width)
+            grid->width[(i << 4) | j] = 1;
+         else if (width == 4)  /* quadruple-width */
+            grid->width[(i << 4) | j] = 4;
+         else  /* treat as double-width */
+            grid->width[(i << 4) | j] = 2;
+         for (thisrow=0; thisrow<16; thisrow++) {
+            grid->rows[(i << 4) | j][thisrow][0] = thischar0[thisrow];
+            grid->rows[(i << 4) | j][thisrow][1] = thischar1[thisrow];
+            grid->rows[(i << 4) | j][thisrow][2] = thischar2[thisrow];
+            /* force 32nd pixel to zero, as it holds the cell border */
+            grid->rows[(i << 4) | j][thisrow][3] = thischar3[thisrow] & 0xFE;
+         }
+      }
+   }
+
+   return;
+}
+
+
+/**
+   @brief Find the width a code point's glyph is forced to.
+
+   Look up the code point in the sorted wide[] table of ranges.
+
+   @param[in] codept The code point.
+   @return 0 = don't force glyph to double-width;
+           1 = force glyph to double-width;
+           4 = force glyph to quadruple-width.
+*/
+int
+forced_width (unsigned codept)
+{
+   int low, high, mid;
+
+   low = 0;
+   high = NWIDE - 1;
+   while (low <= high) {
+      mid = (low + high) / 2;
+      if (codept < wide[mid].first)
+         high = mid - 1;
+      else if (codept > wide[mid].last)
+         low = mid + 1;
+      else
+         return wide[mid].width;
+   }
+   return 0;
+}
+
+
+/**
+   @brief Write the glyphs of one or more grids of the same page.
+
+   If more than one grid has a glyph for a code point, the glyph of
+   the last grid is written.
+
+   Original GNU Unifont format is four hexadecimal digit character
+   code followed by a colon followed by a hex string.  Add support
+   for codes beyond the Basic Multilingual Plane.
+
+   Unicode ranges from U+0000 to U+10FFFF, so print either a
+   4-digit or a 6-digit code point.  Note that this software
+   should support up to an 8-digit code point, extending beyond
+   the normal Unicode range, but this has not been fully tested.
+
+   @param[in] outfp The output file.
+   @param[in] group The grids, in the order they were named.
+   @param[in] n The number of grids in group.
+*/
+void
+write_glyphs (FILE *outfp, struct Grid **group, int n)
+{
+   int i, k;
+   int thisrow;
+   char line[MAXBUF];   /* one output line */
+   char *outp;          /* next character in line[] */
+   struct Grid *grid;   /* the grid with this code point's glyph */
+   unsigned char *row;
+   static const char hexchars[] = "0123456789ABCDEF";
+
+   for (i = 0; i < 256; i++) {
+      grid = NULL;
+      for (k = n - 1; grid == NULL && k >= 0; k--) {
+         if (group[k]->width[i] != 0)
+            grid = group[k];
+      }
+      if (grid == NULL)
+         continue;
+
+      if (grid->page > 0xff)
+         sprintf (line, "%04X%02X:", grid->page, i); // 6 digit code pt.
+      else
+         sprintf (line, "%02X%02X:", grid->page, i); // 4 digit code pt.
+      outp = line + strlen (line);
+      for (thisrow=0; thisrow<16; thisrow++) {
+         row = grid->rows[i][thisrow];
+         if (grid->width[i] == 1) {
+            *outp++ = hexchars[row[1] >> 4];
+            *outp++ = hexchars[row[1] & 0xF];
+         }
+         else if (grid->width[i] == 4) {
+            for (k = 0; k < 4; k++) {
+               *outp++ = hexchars[row[k] >> 4];
+               *outp++ = hexchars[row[k] & 0xF];
+            }
+         }
+         else {
+            for (k = 1; k < 3; k++) {
+               *outp++ = hexchars[row[k] >> 4];
+               *outp++ = hexchars[row[k] & 0xF];
             }
-            fprintf (outfp, "\n");
          }
       }
+      *outp++ = '\n';
+      *outp = '\0';
+      fputs (line, outfp);
    }
-   exit (0);
+
+   return;
+}
+
+
+/**
+   @brief Tell whether a file name is that of a grid bitmap file.
+
+   @param[in] name The file name.
+   @return 1 if the name ends in ".bmp" or ".wbmp", possibly followed
+           by ".gz" or ".zst", or 0 otherwise.
+*/
+int
+grid_name (char *name)
+{
+   size_t len;
+
+   len = strlen (name);
+   if (len > 3 && strcmp (&name[len - 3], ".gz") == 0)
+      len -= 3;
+   else if (len > 4 && strcmp (&name[len - 4], ".zst") == 0)
+      len -= 4;
+   if (len > 4 && strncmp (&name[len - 4], ".bmp", 4) == 0)
+      return 1;
+   if (len > 5 && strncmp (&name[len - 5], ".wbmp", 5) == 0)
+      return 1;
+   return 0;
+}
+
+
+/**
+   @brief Compare two grids by page number, for qsort.
+
+   Grids of the same page are kept in the order they were named.
+
+   @param[in] a Pointer to the first grid pointer.
+   @param[in] b Pointer to the second grid pointer.
+   @return Less than, equal to, or greater than 0.
+*/
+int
+compare_grids (const void *a, const void *b)
+{
+   const struct Grid *grid1 = *(struct Grid * const *)a;
+   const struct Grid *grid2 = *(struct Grid * const *)b;
+
+   if (grid1->page != grid2->page)
+      return grid1->page < grid2->page ? -1 : 1;
+   return grid1 < grid2 ? -1 : (grid1 > grid2 ? 1 : 0);
 }
@@ -13,7 +13,12 @@
    result matches the format of a unihex2bmp image.  This conversion
    then lets unibmp2hex decode the result.
 
+   The input file is mapped into memory and its headers are read in
+   place.  With -d, every .bmp file in a directory is converted, several
+   at a time in child processes, into the directory given with -o.
+
    Synopsis: unibmpbump [-iin_file.bmp] [-oout_file.bmp]
+             unibmpbump -din_dir -oout_dir [-jjobs]
 */
 /*
    LICENSE:
@@ -34,21 +39,207 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 #define VERSION "1.0"	///< Version of this program
 
 #define MAX_COMPRESSION_METHOD 13   ///< Maximum supported compression method
 
+#define ROW_BYTES 72    ///< Bytes in one row of a 560 or 576 pixel wide image
+
 
 /**
    @brief The main function.
 
    @param[in] argc The count of command line arguments.
    @param[in] argv Pointer to array of command line arguments.
-   @return This program exits with status EXIT_SUCCESS.
+   @return This program exits with status EXIT_SUCCESS, or EXIT_FAILURE
+           if an image could not be converted.
 */
 int main (int argc, char *argv[]) {
 
+   /*
+      Flags for conversion & I/O.
+   */
+   int verbose      = 0;      /* Whether to print file info on stderr     */
+
+   /*
+      Temporary variables.
+   */
+   int i;                 /* loop variable */
+
+   int  bump      (char *, char *, int);
+   int  bmp_name  (char *);
+
+   char *infile="", *outfile="";  /* names of input and output files         */
+   char *indir="";                /* directory of input files, with -d       */
+   char *inname, *outname;        /* input and output files in -d mode       */
+   struct stat instat, outstat;   /* to tell if -d and -o are the same       */
+   DIR *dir;                      /* the -d directory                        */
+   struct dirent *entry;          /* a file in the -d directory              */
+   int jobs;                      /* most images converted at once           */
+   int running = 0;               /* child processes converting images       */
+   int status;                    /* exit status of a child process          */
+   int failed = 0;                /* 1 if an image could not be converted    */
+   pid_t pid;
+
+   jobs = (int)sysconf (_SC_NPROCESSORS_ONLN);
+   if (jobs < 1) jobs = 1;
+
+   /*
+      Process command line arguments.
+   */
+   if (argc > 1) {
+      for (i = 1; i < argc; i++) {
+         if (argv[i][0] == '-') {  /* this is an option argument */
+            switch (argv[i][1]) {
+               case 'd':  /* directory of input files */
+                  indir = &argv[i][2];
+                  break;
+               case 'i':  /* name of input file */
+                  infile = &argv[i][2];
+                  break;
+               case 'j':  /* most images converted at once with -d */
+                  jobs = atoi (&argv[i][2]);
+                  if (jobs < 1) jobs = 1;
+                  break;
+               case 'o':  /* name of output file */
+                  outfile = &argv[i][2];
+                  break;
+               case 'v':  /* verbose output */
+                  verbose = 1;
+                  break;
+               case 'V':  /* print version & quit */
+                  fprintf (stderr, "unibmpbump version %s\n\n", VERSION);
+                  exit (EXIT_SUCCESS);
+                  break;
+               case '-':  /* see if "--verbose" */
+                  if (strcmp (argv[i], "--verbose") == 0) {
+                     verbose = 1;
+                  }
+                  else if (strcmp (argv[i], "--version") == 0) {
+                     fprintf (stderr, "unibmpbump version %s\n\n", VERSION);
+                     exit (EXIT_SUCCESS);
+                  }
+                  break;
+               default:   /* if unrecognized option, print list and exit */
+                  fprintf (stderr, "\nSyntax:\n\n");
+                  fprintf (stderr, "   unibmpbump ");
+                  fprintf (stderr, "-i<Input_File> -o<Output_File>\n");
+                  fprintf (stderr, "   unibmpbump ");
+                  fprintf (stderr, "-d<Input_Dir> -o<Output_Dir> -j<Jobs>\n\n");
+                  fprintf (stderr, "-v or --verbose gives verbose output");
+                  fprintf (stderr, " on stderr\n\n");
+                  fprintf (stderr, "-V or --version prints version");
+                  fprintf (stderr, " on stderr and exits\n\n");
+                  fprintf (stderr, "\nExample:\n\n");
+                  fprintf (stderr, "   unibmpbump -iuni0101.bmp");
+                  fprintf (stderr, " -onew-uni0101.bmp\n\n");
+                  exit (EXIT_SUCCESS);
+            }
+         }
+      }
+   }
+
+   if (strlen (indir) == 0)
+      exit (bump (infile, outfile, verbose));
+
+   /*
+      Convert every .bmp file in the -d directory into a file of the
+      same name in the -o directory.  The two must differ, because an
+      input file is read while its output file is written.
+   */
+   if (strlen (outfile) == 0) {
+      fprintf (stderr, "Error: -d needs an output directory given with -o.\n");
+      exit (EXIT_FAILURE);
+   }
+   if (mkdir (outfile, 0777) != 0 && errno != EEXIST) {
+      fprintf (stderr, "Error: can't make directory %s.\n", outfile);
+      exit (EXIT_FAILURE);
+   }
+   if (stat (indir, &instat) != 0 || stat (outfile, &outstat) != 0) {
+      fprintf (stderr, "Error: can't find directory %s.\n", indir);
+      exit (EXIT_FAILURE);
+   }
+   if (instat.st_dev == outstat.st_dev && instat.st_ino == outstat.st_ino) {
+      fprintf (stderr, "Error: the output directory must not be %s.\n",
+               indir);
+      exit (EXIT_FAILURE);
+   }
+   if ((dir = opendir (indir)) == NULL) {
+      fprintf (stderr, "Error: can't open directory %s.\n", indir);
+      exit (EXIT_FAILURE);
+   }
+
+   /*
+      Convert each image in a child process, with at most "jobs"
+      running at once.
+   */
+   fflush (stdout);
+   fflush (stderr);
+   while ((entry = readdir (dir)) != NULL) {
+      if (!bmp_name (entry->d_name))
+         continue;
+      inname  = malloc (strlen (indir)   + strlen (entry->d_name) + 2);
+      outname = malloc (strlen (outfile) + strlen (entry->d_name) + 2);
+      if (inname == NULL || outname == NULL) {
+         fprintf (stderr, "Error: out of memory.\n");
+         exit (EXIT_FAILURE);
+      }
+      sprintf (inname,  "%s/%s", indir,   entry->d_name);
+      sprintf (outname, "%s/%s", outfile, entry->d_name);
+      if (jobs == 1) {
+         failed |= bump (inname, outname, verbose);
+      }
+      else {
+         if (running == jobs) {
+            if (wait (&status) < 0 || !WIFEXITED (status) ||
+                WEXITSTATUS (status) != EXIT_SUCCESS)
+               failed = 1;
+            running--;
+         }
+         pid = fork ();
+         if (pid == 0) {
+            exit (bump (inname, outname, verbose));
+         }
+         else if (pid < 0)
+            failed |= bump (inname, outname, verbose);
+         else
+            running++;
+      }
+      free (inname);
+      free (outname);
+   }
+   closedir (dir);
+   while (running > 0) {
+      if (wait (&status) < 0 || !WIFEXITED (status) ||
+          WEXITSTATUS (status) != EXIT_SUCCESS)
+         failed = 1;
+      running--;
+   }
+
+   exit (failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+
+/**
+   @brief Convert one image.
+
+   @param[in] infile The input file name, or "" for stdin.
+   @param[in] outfile The output file name, or "" for stdout.
+   @param[in] verbose 1 to print the image's headers on stderr.
+   @return EXIT_SUCCESS, or EXIT_FAILURE if the image could not be
+           read or is not in a supported format.
+*/
+int bump (char *infile, char *outfile, int verbose) {
+
    /*
       Values preserved from file header (first 14 bytes).
    */
@@ -88,23 +279,31 @@ int main (int argc, char *argv[]) {
       colors are stored.
    */
    unsigned char color_map[2][4]; /* two of R, G, B, and possibly alpha  */
+   unsigned color_start;      /* byte offset of color map in file           */
+   int color_size = 4;        /* bytes per color map entry: 3 or 4          */
 
    /*
       The monochrome image bitmap, stored as a vector 544 rows by
-      72*8 columns.
+      72*8 columns, one pixel per bit.
    */
-   unsigned image_bytes[544*72];
+   unsigned char image_bytes[544*ROW_BYTES];
+
+   unsigned char image_xor = 0x00; /* Invert (= 0xFF) if color 0 is not black  */
 
    /*
-      Flags for conversion & I/O.
+      The input file, mapped into memory.
    */
-   int verbose      = 0;      /* Whether to print file info on stderr     */
-   unsigned image_xor = 0x00; /* Invert (= 0xFF) if color 0 is not black  */
+   unsigned char *image;      /* the whole input file                       */
+   size_t image_length;       /* its length in bytes                        */
+   int mapped;                /* 1 if image is mapped, 0 if allocated       */
+   const unsigned char *inrow;  /* next row of the input image              */
+   unsigned char *outrow;     /* next row of image_bytes                    */
+   int failed = 0;
 
    /*
       Temporary variables.
    */
-   int i, j, k;           /* loop variables */
+   int i, j;              /* loop variables */
 
    /* Compression type, for parsing file */
    char *compression_type[MAX_COMPRESSION_METHOD + 1] = {
@@ -122,7 +321,7 @@ int main (int argc, char *argv[]) {
    };
 
    /* Standard unihex2bmp.c header for BMP image */
-   unsigned standard_header [62] = {
+   static const unsigned char standard_header [62] = {
       /*  0 */ 0x42, 0x4d, 0x3e, 0x99, 0x00, 0x00, 0x00, 0x00,
       /*  8 */ 0x00, 0x00, 0x3e, 0x00, 0x00, 0x00, 0x28, 0x00,
       /* 16 */ 0x00, 0x00, 0x40, 0x02, 0x00, 0x00, 0x20, 0x02,
@@ -133,98 +332,44 @@ int main (int argc, char *argv[]) {
       /* 56 */ 0x00, 0x00, 0xff, 0xff, 0xff, 0x00
    };
 
-   unsigned get_bytes (FILE *, int);
-   void     regrid    (unsigned *);
+   unsigned char *map_image (char *, size_t *, int *);
+   unsigned get_bytes (const unsigned char *, int);
+   void     regrid    (unsigned char *);
 
-   char *infile="", *outfile="";  /* names of input and output files         */
-   FILE *infp, *outfp;            /* file pointers of input and output files */
-
-   /*
-      Process command line arguments.
-   */
-   if (argc > 1) {
-      for (i = 1; i < argc; i++) {
-         if (argv[i][0] == '-') {  /* this is an option argument */
-            switch (argv[i][1]) {
-               case 'i':  /* name of input file */
-                  infile = &argv[i][2];
-                  break;
-               case 'o':  /* name of output file */
-                  outfile = &argv[i][2];
-                  break;
-               case 'v':  /* verbose output */
-                  verbose = 1;
-                  break;
-               case 'V':  /* print version & quit */
-                  fprintf (stderr, "unibmpbump version %s\n\n", VERSION);
-                  exit (EXIT_SUCCESS);
-                  break;
-               case '-':  /* see if "--verbose" */
-                  if (strcmp (argv[i], "--verbose") == 0) {
-                     verbose = 1;
-                  }
-                  else if (strcmp (argv[i], "--version") == 0) {
-                     fprintf (stderr, "unibmpbump version %s\n\n", VERSION);
-                     exit (EXIT_SUCCESS);
-                  }
-                  break;
-               default:   /* if unrecognized option, print list and exit */
-                  fprintf (stderr, "\nSyntax:\n\n");
-                  fprintf (stderr, "   unibmpbump ");
-                  fprintf (stderr, "-i<Input_File> -o<Output_File>\n\n");
-                  fprintf (stderr, "-v or --verbose gives verbose output");
-                  fprintf (stderr, " on stderr\n\n");
-                  fprintf (stderr, "-V or --version prints version");
-                  fprintf (stderr, " on stderr and exits\n\n");
-                  fprintf (stderr, "\nExample:\n\n");
-                  fprintf (stderr, "   unibmpbump -iuni0101.bmp");
-                  fprintf (stderr, " -onew-uni0101.bmp\n\n");
-                  exit (EXIT_SUCCESS);
-            }
-         }
-      }
-   }
+   FILE *outfp;                   /* file pointer of output file */
 
    /*
       Make sure we can open any I/O files that were specified before
       doing anything else.
    */
-   if (strlen (infile) > 0) {
-      if ((infp = fopen (infile, "r")) == NULL) {
-         fprintf (stderr, "Error: can't open %s for input.\n", infile);
-         exit (EXIT_FAILURE);
-      }
+   if ((image = map_image (infile, &image_length, &mapped)) == NULL) {
+      fprintf (stderr, "Error: can't open %s for input.\n",
+               strlen (infile) > 0 ? infile : "stdin");
+      return EXIT_FAILURE;
    }
-   else {
-      infp = stdin;
-   }
-   if (strlen (outfile) > 0) {
-      if ((outfp = fopen (outfile, "w")) == NULL) {
-         fprintf (stderr, "Error: can't open %s for output.\n", outfile);
-         exit (EXIT_FAILURE);
-      }
-   }
-   else {
-      outfp = stdout;
+   if (image_length < 14 + 4) {
+      fprintf (stderr, "\nInvalid file format: file is too short.\n\n");
+      failed = 1;
+      goto done;
    }
 
 
    /* Read bitmap file header */
-   file_format[0] = get_bytes (infp, 1);
-   file_format[1] = get_bytes (infp, 1);
+   file_format[0] = image[0];
+   file_format[1] = image[1];
    file_format[2] = '\0';  /* Terminate string with null */
 
    /* Read file size */
-   filesize = get_bytes (infp, 4);
+   filesize = get_bytes (&image[2], 4);
 
    /* Read Reserved bytes */
-   rsvd_hdr[0] = get_bytes (infp, 1);
-   rsvd_hdr[1] = get_bytes (infp, 1);
-   rsvd_hdr[2] = get_bytes (infp, 1);
-   rsvd_hdr[3] = get_bytes (infp, 1);
+   rsvd_hdr[0] = image[6];
+   rsvd_hdr[1] = image[7];
+   rsvd_hdr[2] = image[8];
+   rsvd_hdr[3] = image[9];
 
    /* Read Image Offset Address within file */
-   image_start = get_bytes (infp, 4);
+   image_start = get_bytes (&image[10], 4);
 
    /*
       See if this looks like a valid image file based on
@@ -232,7 +377,8 @@ int main (int argc, char *argv[]) {
    */
    if (strncmp (file_format, "BM", 2) != 0) {
       fprintf (stderr, "\nInvalid file format: not file type \"BM\".\n\n");
-      exit (EXIT_FAILURE);
+      failed = 1;
+      goto done;
    }
 
    if (verbose) {
@@ -250,35 +396,51 @@ int main (int argc, char *argv[]) {
       Device Independent Bitmap (DIB) Header: bitmap information header
       ("BM" format file DIB Header is 12 bytes long).
    */
-   dib_length = get_bytes (infp, 4);
+   dib_length = get_bytes (&image[14], 4);
+   if (dib_length < 12 || 14 + (size_t)dib_length > image_length) {
+      fprintf (stderr, "\nInvalid DIB header length: %d\n\n", dib_length);
+      failed = 1;
+      goto done;
+   }
 
    /*
-      Parse one of three versions of Device Independent Bitmap (DIB) format:
+      Parse one of the versions of Device Independent Bitmap (DIB) format:
 
            Length  Format
            ------  ------
               12   BITMAPCOREHEADER
+              16   OS22XBITMAPHEADER (short form)
               40   BITMAPINFOHEADER
+              52   BITMAPV2INFOHEADER
+              56   BITMAPV3INFOHEADER
+              64   OS22XBITMAPHEADER
              108   BITMAPV4HEADER
              124   BITMAPV5HEADER
+
+      Every version after BITMAPCOREHEADER begins with the fields of
+      BITMAPINFOHEADER, or as many of them as fit.
    */
-   if (dib_length == 12) { /* BITMAPCOREHEADER format -- UNTESTED */
-      image_width    = get_bytes (infp, 2);
-      image_height   = get_bytes (infp, 2);
-      num_planes     = get_bytes (infp, 2);
-      bits_per_pixel = get_bytes (infp, 2);
-   }
-   else if (dib_length >= 40) { /* BITMAPINFOHEADER format or later */
-      image_width = get_bytes (infp, 4);
-      image_height       = get_bytes (infp, 4);
-      num_planes         = get_bytes (infp, 2);
-      bits_per_pixel     = get_bytes (infp, 2);
-      compression_method = get_bytes (infp, 4);  /* BI_BITFIELDS */
-      image_size         = get_bytes (infp, 4);
-      hres               = get_bytes (infp, 4);
-      vres               = get_bytes (infp, 4);
-      num_colors         = get_bytes (infp, 4);
-      important_colors   = get_bytes (infp, 4);
+   if (dib_length == 12) { /* BITMAPCOREHEADER format */
+      image_width    = get_bytes (&image[18], 2);
+      image_height   = (short)get_bytes (&image[20], 2);
+      num_planes     = get_bytes (&image[22], 2);
+      bits_per_pixel = get_bytes (&image[24], 2);
+      color_size     = 3;  /* color map entries are R, G, B */
+      true_colors    = 1 << bits_per_pixel;
+   }
+   else if (dib_length >= 16) { /* BITMAPINFOHEADER format or later */
+      image_width        = get_bytes (&image[18], 4);
+      image_height       = get_bytes (&image[22], 4);
+      num_planes         = get_bytes (&image[26], 2);
+      bits_per_pixel     = get_bytes (&image[28], 2);
+      if (dib_length >= 40) {
+         compression_method = get_bytes (&image[30], 4);  /* BI_BITFIELDS */
+         image_size         = get_bytes (&image[34], 4);
+         hres               = get_bytes (&image[38], 4);
+         vres               = get_bytes (&image[42], 4);
+         num_colors         = get_bytes (&image[46], 4);
+         important_colors   = get_bytes (&image[50], 4);
+      }
 
       /* true_colors is true number of colors in image */
       if (num_colors == 0)
@@ -287,12 +449,10 @@ int main (int argc, char *argv[]) {
          true_colors = num_colors;
 
       /*
-         If dib_length > 40, the format is BITMAPV4HEADER or
-         BITMAPV5HEADER.  As this program is only designed
-         to handle a monochrome image, we can ignore the rest
-         of the header but must read past the remaining bytes.
+         If dib_length > 40, the format is a later version.  As this
+         program is only designed to handle a monochrome image, we can
+         ignore the rest of the header.
       */
-      for (i = 40; i < dib_length; i++) (void)get_bytes (infp, 1);
    }
 
    if (verbose) {
@@ -300,16 +460,21 @@ int main (int argc, char *argv[]) {
       fprintf (stderr, "   DIB Length:  %9d bytes (version = ", dib_length);
 
       if      (dib_length ==  12) fprintf (stderr, "\"BITMAPCOREHEADER\")\n");
+      else if (dib_length ==  16) fprintf (stderr, "\"OS22XBITMAPHEADER\")\n");
       else if (dib_length ==  40) fprintf (stderr, "\"BITMAPINFOHEADER\")\n");
+      else if (dib_length ==  52) fprintf (stderr, "\"BITMAPV2INFOHEADER\")\n");
+      else if (dib_length ==  56) fprintf (stderr, "\"BITMAPV3INFOHEADER\")\n");
+      else if (dib_length ==  64) fprintf (stderr, "\"OS22XBITMAPHEADER\")\n");
       else if (dib_length == 108) fprintf (stderr, "\"BITMAPV4HEADER\")\n");
       else if (dib_length == 124) fprintf (stderr, "\"BITMAPV5HEADER\")\n");
-      else fprintf (stderr, "unknown)");
+      else fprintf (stderr, "unknown)\n");
       fprintf (stderr, "   Bitmap Width:   %6d pixels\n", image_width);
       fprintf (stderr, "   Bitmap Height:  %6d pixels\n", image_height);
       fprintf (stderr, "   Color Planes:   %6d\n",        num_planes);
       fprintf (stderr, "   Bits per Pixel: %6d\n",        bits_per_pixel);
       fprintf (stderr, "   Compression Method: %2d --> ", compression_method);
-      if (compression_method <= MAX_COMPRESSION_METHOD) {
+      if (compression_method >= 0 &&
+          compression_method <= MAX_COMPRESSION_METHOD) {
          fprintf (stderr, "%s", compression_type [compression_method]);
       }
       /*
@@ -322,7 +487,8 @@ int main (int argc, char *argv[]) {
       }
       else {
          fprintf (stderr, "Image uses compression; this is unsupported.\n\n");
-         exit (EXIT_FAILURE);
+         failed = 1;
+         goto done;
       }
       fprintf (stderr, "\n");
       fprintf (stderr, "   Image Size:            %5d bytes\n", image_size);
@@ -341,18 +507,22 @@ int main (int argc, char *argv[]) {
 
    /*
       Print Color Table information for images with pallettized colors.
+      The color table follows the DIB header, and the three color masks
+      of a BI_BITFIELDS BITMAPINFOHEADER image.
    */
+   memset (color_map, 0, sizeof (color_map));
    if (bits_per_pixel <= 8) {
-      for (i = 0; i < 2; i++) {
-         color_map [i][0] = get_bytes (infp, 1);
-         color_map [i][1] = get_bytes (infp, 1);
-         color_map [i][2] = get_bytes (infp, 1);
-         color_map [i][3] = get_bytes (infp, 1);
+      color_start = 14 + dib_length;
+      if (dib_length == 40 && compression_method == 3)
+         color_start += 12;
+      if (color_start + 2 * color_size > image_length) {
+         fprintf (stderr, "\nInvalid file format: no color table.\n\n");
+         failed = 1;
+         goto done;
       }
-      /* Skip remaining color table entries if more than 2 */
-      while (i < true_colors) {
-         (void) get_bytes (infp, 4);
-         i++;
+      for (i = 0; i < 2; i++) {
+         memcpy (color_map [i], &image[color_start + i * color_size],
+                 color_size);
       }
 
       if (color_map [0][0] >= 128) image_xor = 0xFF;  /* Invert colors */
@@ -375,82 +545,81 @@ int main (int argc, char *argv[]) {
 
 
    /*
-      Check format before writing output file.
+      Check format before writing output file.  The image can be
+      stored from bottom to top (positive height) or from top to
+      bottom (negative height).
    */
    if (image_width != 560 && image_width != 576) {
       fprintf (stderr, "\nUnsupported image width: %d\n", image_width);
       fprintf (stderr, "Width should be 560 or 576 pixels.\n\n");
-      exit (EXIT_FAILURE);
+      failed = 1;
    }
 
-   if (image_height != 544) {
+   else if (image_height != 544 && image_height != -544) {
       fprintf (stderr, "\nUnsupported image height: %d\n", image_height);
       fprintf (stderr, "Height should be 544 pixels.\n\n");
-      exit (EXIT_FAILURE);
+      failed = 1;
    }
 
-   if (num_planes != 1) {
+   else if (num_planes != 1) {
       fprintf (stderr, "\nUnsupported number of planes: %d\n", num_planes);
       fprintf (stderr, "Number of planes should be 1.\n\n");
-      exit (EXIT_FAILURE);
+      failed = 1;
    }
 
-   if (bits_per_pixel != 1) {
+   else if (bits_per_pixel != 1) {
       fprintf (stderr, "\nUnsupported number of bits per pixel: %d\n",
                bits_per_pixel);
       fprintf (stderr, "Bits per pixel should be 1.\n\n");
-      exit (EXIT_FAILURE);
+      failed = 1;
    }
 
-   if (compression_method != 0 && compression_method != 11) {
+   else if (compression_method != 0 && compression_method != 11) {
       fprintf (stderr, "\nUnsupported compression method: %d\n",
                compression_method);
       fprintf (stderr, "Compression method should be 1 or 11.\n\n");
-      exit (EXIT_FAILURE);
+      failed = 1;
    }
 
-   if (true_colors != 2) {
+   else if (true_colors != 2) {
       fprintf (stderr, "\nUnsupported number of colors: %d\n", true_colors);
       fprintf (stderr, "Number of colors should be 2.\n\n");
-      exit (EXIT_FAILURE);
+      failed = 1;
    }
 
+   else if (image_start > image_length ||
+            image_length - image_start < 544 * ROW_BYTES) {
+      fprintf (stderr, "\nInvalid file format: image data is too short.\n\n");
+      failed = 1;
+   }
 
-   /*
-      If we made it this far, things look okay, so write out
-      the standard header for image conversion.
-   */
-   for (i = 0; i < 62; i++) fputc (standard_header[i], outfp);
+   if (failed)
+      goto done;
 
 
    /*
       Image Data.  Each row must be a multiple of 4 bytes, with
-      padding at the end of each row if necessary.
+      padding at the end of each row if necessary, so a row is
+      72 bytes for either image width.
    */
-   k = 0;  /* byte number within the binary image */
    for (i = 0; i < 544; i++) {
+      inrow = &image[image_start + ROW_BYTES *
+                     (image_height < 0 ? 543 - i : i)];
+      outrow = &image_bytes[ROW_BYTES * i];
       /*
          If original image is 560 pixels wide (not 576), add
-         2 white bytes at beginning of row.
+         2 white bytes at beginning of row, and skip the 2
+         padding bytes at end of row in file.
       */
       if (image_width == 560) {  /* Insert 2 white bytes */
-         image_bytes[k++] = 0xFF;
-         image_bytes[k++] = 0xFF;
+         *outrow++ = 0xFF;
+         *outrow++ = 0xFF;
+         for (j = 0; j < 70; j++)  /* Copy next 70 bytes */
+            outrow[j] = inrow[j] ^ image_xor;
       }
-      for (j = 0; j < 70; j++) {  /* Copy next 70 bytes */
-         image_bytes[k++] = (get_bytes (infp, 1) & 0xFF) ^ image_xor;
-      }
-      /*
-         If original image is 560 pixels wide (not 576), skip
-         2 padding bytes at end of row in file because we inserted
-         2 white bytes at the beginning of the row.
-      */
-      if (image_width == 560) {
-         (void) get_bytes (infp, 2);
-      }
-      else {  /* otherwise, next 2 bytes are part of the image so copy them */
-         image_bytes[k++] = (get_bytes (infp, 1) & 0xFF) ^ image_xor;
-         image_bytes[k++] = (get_bytes (infp, 1) & 0xFF) ^ image_xor;
+      else {
+         for (j = 0; j < ROW_BYTES; j++)
+            outrow[j] = inrow[j] ^ image_xor;
       }
    }
 
@@ -462,42 +631,125 @@ int main (int argc, char *argv[]) {
       regrid (image_bytes);
    }
 
-   for (i = 0; i < 544 * 576 / 8; i++) {
-      fputc (image_bytes[i], outfp);
+
+   /*
+      If we made it this far, things look okay, so write out
+      the standard header for image conversion, then the image.
+   */
+   if (strlen (outfile) > 0) {
+      if ((outfp = fopen (outfile, "w")) == NULL) {
+         fprintf (stderr, "Error: can't open %s for output.\n", outfile);
+         failed = 1;
+         goto done;
+      }
+   }
+   else {
+      outfp = stdout;
+   }
+   fwrite (standard_header, 1, 62, outfp);
+   fwrite (image_bytes, 1, 544 * ROW_BYTES, outfp);
+   if (fclose (outfp) != 0) {
+      fprintf (stderr, "Error: can't write %s.\n",
+               strlen (outfile) > 0 ? outfile : "stdout");
+      failed = 1;
    }
 
 
    /*
       Wrap up.
    */
-   fclose (infp);
-   fclose (outfp);
+done:
+   if (mapped)
+      munmap (image, image_length);
+   else
+      free (image);
 
-   exit (EXIT_SUCCESS);
+   return failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
 
 /**
-   @brief Get from 1 to 4 bytes, inclusive, from input file.
+   @brief Map an input file into memory.
+
+   A file that can't be mapped, such as a pipe on stdin, is read
+   into allocated memory instead.
 
-   @param[in] infp Pointer to input file.
+   @param[in] infile The file name, or "" for stdin.
+   @param[out] length The length of the file in bytes.
+   @param[out] mapped 1 if the file was mapped, 0 if it was read.
+   @return The file contents, or NULL if the file could not be read.
+*/
+unsigned char *map_image (char *infile, size_t *length, int *mapped) {
+   int fd;
+   struct stat st;
+   unsigned char *image;
+   size_t size;      /* allocated size of image */
+   ssize_t nread;
+
+   if (strlen (infile) > 0) {
+      if ((fd = open (infile, O_RDONLY)) < 0)
+         return NULL;
+   }
+   else {
+      fd = 0;
+   }
+
+   *mapped = 0;
+   if (fstat (fd, &st) == 0 && S_ISREG (st.st_mode) && st.st_size > 0) {
+      image = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (image != MAP_FAILED) {
+         if (fd != 0) close (fd);
+         *length = st.st_size;
+         *mapped = 1;
+         return image;
+      }
+   }
+
+   size = 62 + 544 * ROW_BYTES;  /* a unihex2bmp image */
+   *length = 0;
+   image = malloc (size);
+   while (image != NULL &&
+          (nread = read (fd, image + *length, size - *length)) > 0) {
+      *length += nread;
+      if (*length == size) {
+         size *= 2;
+         image = realloc (image, size);
+      }
+   }
+   if (fd != 0) close (fd);
+   return image;
+}
+
+
+/**
+   @brief Tell whether a file name is that of a .bmp file.
+
+   @param[in] name The file name.
+   @return 1 if the name ends in ".bmp" or ".BMP", or 0 otherwise.
+*/
+int bmp_name (char *name) {
+   size_t len;
+
+   len = strlen (name);
+   return len > 4 && (strcmp (&name[len - 4], ".bmp") == 0 ||
+                      strcmp (&name[len - 4], ".BMP") == 0);
+}
+
+
+/**
+   @brief Get from 1 to 4 bytes, inclusive, from the input image.
+
+   @param[in] inbytes Pointer to the bytes in the input image.
    @param[in] nbytes Number of bytes to read, from 1 to 4, inclusive.
    @return The unsigned 1 to 4 bytes in machine native endian format.
 */
-unsigned get_bytes (FILE *infp, int nbytes) {
+unsigned get_bytes (const unsigned char *inbytes, int nbytes) {
    int i;
-   unsigned char inchar[4];
    unsigned inword;
 
-   for (i = 0; i < nbytes; i++) {
-      if (fread (&inchar[i], 1, 1, infp) != 1) {
-         inchar[i] = 0;
-      }
-   }
-   for (i = nbytes; i < 4; i++) inchar[i] = 0;
-
-   inword = ((inchar[3] & 0xFF) << 24) | ((inchar[2] & 0xFF) << 16) |
-            ((inchar[1] & 0xFF) <<  8) |  (inchar[0] & 0xFF);
+   inword = 0;
+   for (i = nbytes - 1; i >= 0; i--)
+      inword = (inword << 8) | inbytes[i];
 
    return inword;
 }
@@ -507,24 +759,26 @@ unsigned get_bytes (FILE *infp, int nbytes) {
    @brief After reading in the image, shift it.
 
    This function adjusts the input image from an original PNG file
-   to match unihex2bmp.c format.
+   to match unihex2bmp.c format.  The glyphs are shifted a pixel row
+   at a time, with each 32 pixel glyph cell in the row handled as
+   one 32 bit word.
 
    @param[in,out] image_bytes The pixels in an image.
 */
-void regrid (unsigned *image_bytes) {
+void regrid (unsigned char *image_bytes) {
    int i, j, k;  /* loop variables */
    int offset;
+   unsigned char *cell; /* the 4 bytes of one glyph cell in a pixel row */
    unsigned glyph_row; /* one grid row of 32 pixels */
-   unsigned last_pixel; /* last pixel in a byte, to preserve */
 
    /* To insert "00" after "U+" at top of image */
-   char zero_pattern[16] = {
+   static const unsigned char zero_pattern[16] = {
        0x00, 0x00, 0x00, 0x00, 0x18, 0x24, 0x42, 0x42,
        0x42, 0x42, 0x42, 0x42, 0x24, 0x18, 0x00, 0x00
    };
 
    /* This is the horizontal grid pattern on glyph boundaries */
-   unsigned hgrid[72] = {
+   static const unsigned char hgrid[ROW_BYTES] = {
       /*  0 */ 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe,
       /*  8 */ 0x00, 0x81, 0x81, 0x00, 0x00, 0x81, 0x81, 0x00,
       /* 16 */ 0x00, 0x81, 0x81, 0x00, 0x00, 0x81, 0x81, 0x00,
@@ -542,7 +796,7 @@ void regrid (unsigned *image_bytes) {
    */
    j = 15; /* rows are written bottom to top, so we'll decrement j */
    for (i = 543 - 8; i > 544 - 24; i--) {
-      offset = 72 * i;
+      offset = ROW_BYTES * i;
       image_bytes [offset + 0] = image_bytes [offset + 2];
       image_bytes [offset + 1] = image_bytes [offset + 3];
       image_bytes [offset + 2] = image_bytes [offset + 4];
@@ -551,40 +805,33 @@ void regrid (unsigned *image_bytes) {
    }
 
    /*
-      Now move glyph bitmaps to the right by 8 pixels.
+      Now move glyph bitmaps to the right by 4 pixels, one pixel row
+      of all 16 glyph columns at a time.
    */
-   for (i = 0; i < 16; i++) { /* for each glyph row */
-      for (j = 0; j < 16; j++) { /* for each glyph column */
-         /* set offset to lower left-hand byte of next glyph */
-         offset = (32 * 72 * i) + (9 * 72) + (4 * j) + 8;
-         for (k = 0; k < 16; k++) { /* for each glyph row */
-            glyph_row = (image_bytes [offset + 0] << 24) |
-                        (image_bytes [offset + 1] << 16) |
-                        (image_bytes [offset + 2] <<  8) |
-                        (image_bytes [offset + 3]);
-            last_pixel = glyph_row & 1;  /* preserve border */
-            glyph_row >>= 4;
-            glyph_row &=  0x0FFFFFFE;
-            /* Set left 4 pixels to white and preserve last pixel */
-            glyph_row |=  0xF0000000 | last_pixel;
-            image_bytes [offset + 3] = glyph_row & 0xFF;
-            glyph_row >>= 8;
-            image_bytes [offset + 2] = glyph_row & 0xFF;
-            glyph_row >>= 8;
-            image_bytes [offset + 1] = glyph_row & 0xFF;
-            glyph_row >>= 8;
-            image_bytes [offset + 0] = glyph_row & 0xFF;
-            offset += 72;  /* move up to next row in current glyph */
+   for (i = 0; i < 16; i++) { /* for each row of glyphs */
+      for (k = 0; k < 16; k++) { /* for each pixel row in the glyphs */
+         cell = &image_bytes [ROW_BYTES * (32 * i + 9 + k) + 8];
+         for (j = 0; j < 16; j++) { /* for each glyph column */
+            glyph_row = ((unsigned)cell[0] << 24) | ((unsigned)cell[1] << 16) |
+                        ((unsigned)cell[2] <<  8) |  (unsigned)cell[3];
+            /*
+               Set left 4 pixels to white and preserve last pixel,
+               which is the cell border.
+            */
+            glyph_row = 0xF0000000 | ((glyph_row >> 4) & 0x0FFFFFFE) |
+                        (glyph_row & 1);
+            cell[0] = glyph_row >> 24;
+            cell[1] = glyph_row >> 16;
+            cell[2] = glyph_row >>  8;
+            cell[3] = glyph_row;
+            cell += 4;
          }
       }
    }
 
    /* Replace horizontal grid with unihex2bmp.c grid */
    for (i = 0; i <= 16; i++) {
-      offset = 32 * 72 * i;
-      for (j = 0; j < 72; j++) {
-         image_bytes [offset + j] = hgrid [j];
-      }
+      memcpy (&image_bytes [32 * ROW_BYTES * i], hgrid, ROW_BYTES);
    }
 
    return;
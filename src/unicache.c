@@ -0,0 +1,627 @@
+/**
+   @file unicache.c
+
+   @brief unicache - Reuse a font build step's output if its inputs
+                     have not changed
+
+   @author Paul Hardy
+
+   @copyright Copyright (C) 2023 Paul Hardy
+
+   This program runs one step of a font build, such as hex2bdf or
+   unihex2bmp, through a cache of earlier results.  It hashes
+   everything the step's output depends on: the command line, the
+   program that will be run, and the contents of the input files.
+   If an earlier run with the same hash left its output in the cache
+   directory, the output is copied from there and the command is not
+   run.  Otherwise the command is run and its output is saved in the
+   cache for next time.
+
+   Synopsis: unicache [--cache dir] [--input file ...]
+                      [--stdin file] [--stdout] [--range from-to ...]
+                      [--tool file] --output file ... -- command ...
+
+             unicache [--cache dir] --prune stamp-file
+
+   A step that only uses one page or plane of a large .hex file can
+   name that part of it with --range, so that the hash covers only the
+   glyphs with code points in that range.  Changing a glyph then only
+   runs again the steps whose range includes it.
+
+   The hash is a 64-bit FNV-1a hash.  Cached files are named by the
+   hash in hexadecimal, followed by the output's position in the list
+   of outputs.  The cache can be removed at any time.
+
+   A step that reads a pipe gives "--stdin -".  The piped text is then
+   saved in a temporary file in the cache directory, so that it can be
+   hashed with the other inputs before it is given to the command.
+
+   Each run sets the modification time of the cached files it uses.
+   The --prune form removes every file in the cache directory that was
+   not used since the stamp file was last modified, so that a build
+   which touches the stamp file first and prunes last keeps only the
+   outputs of its own steps.
+*/
+/*
+   LICENSE:
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 2 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <utime.h>
+
+#include "unizio.h"
+
+#define MAXFILES  64        ///< Most input, output, or range arguments.
+#define MAXLINE   1024      ///< Longest input line, with room to spare.
+#define FNV_BASIS 0xCBF29CE484222325ULL  ///< FNV-1a 64-bit offset basis.
+#define FNV_PRIME 0x100000001B3ULL       ///< FNV-1a 64-bit prime.
+
+#define CACHE_VERSION "unicache 1"  ///< Changed if the hash input changes.
+
+
+unsigned long long hash = FNV_BASIS;  ///< Hash of the step so far.
+
+unsigned long from[MAXFILES];   ///< First code point of each range.
+unsigned long to  [MAXFILES];   ///< Last code point of each range.
+int nranges = 0;                ///< Number of ranges; 0 for no limit.
+
+char *stdin_copy = NULL;        ///< Temporary copy of a piped stdin.
+
+
+/**
+   @brief The main function.
+
+   @param[in] argc The count of command line arguments.
+   @param[in] argv Pointer to array of command line arguments.
+   @return This program exits with the command's exit status, or with
+           EXIT_SUCCESS if the output came from the cache.
+*/
+int
+main (int argc, char *argv[])
+{
+   char *cachedir = ".unicache";  /* directory of cached outputs       */
+   char *inputs [MAXFILES];       /* files the output depends on       */
+   char *outputs[MAXFILES];       /* files the command writes          */
+   char *tools  [MAXFILES];       /* programs the command runs         */
+   int   ninputs = 0, noutputs = 0, ntools = 0;
+   char *stdin_file = NULL;       /* file to give the command on stdin */
+   int   read_stdin = 0;          /* 1 if stdin is a pipe to hash      */
+   char *prune_stamp = NULL;      /* stamp file for --prune            */
+   int   to_stdout = 0;           /* 1 if output[0] is the command's stdout */
+   char **command;                /* the command to run                */
+   char *cached;                  /* name of a cached output           */
+   char *arg, *value;             /* current option and its value      */
+   char *end;                     /* end of a number in a range        */
+   int   hit;                     /* 1 if all outputs are in the cache */
+   int   status;                  /* the command's exit status         */
+   int   i;
+
+   void  add_bytes (const void *bytes, size_t len);
+   void  add_file (const char *filename, int filtered);
+   char *find_program (const char *name);
+   char *cache_name (const char *cachedir, int output);
+   int   copy_file (const char *from, const char *to);
+   int   run_command (char **command, const char *stdin_file,
+                      const char *stdout_file);
+   char *save_stdin (const char *cachedir);
+   void  remove_stdin_copy (void);
+   void  prune_cache (const char *cachedir, const char *stamp);
+
+   for (i = 1; i < argc && strcmp (argv[i], "--") != 0; i++) {
+      arg = argv[i];
+      if (strcmp (arg, "--stdout") == 0 || strcmp (arg, "-s") == 0) {
+         to_stdout = 1;
+         continue;
+      }
+      if (arg[0] != '-' || i + 1 >= argc) {
+         i = argc;
+         break;
+      }
+      value = argv[++i];
+      if (strcmp (arg, "--cache") == 0 || strcmp (arg, "-c") == 0)
+         cachedir = value;
+      else if (strcmp (arg, "--stdin") == 0) {
+         if (strcmp (value, "-") == 0)
+            read_stdin = 1;
+         else
+            stdin_file = value;
+      }
+      else if (strcmp (arg, "--prune") == 0)
+         prune_stamp = value;
+      else if (ninputs  == MAXFILES || noutputs == MAXFILES ||
+               ntools   == MAXFILES || nranges  == MAXFILES) {
+         fprintf (stderr, "unicache: too many arguments.\n");
+         exit (EXIT_FAILURE);
+      }
+      else if (strcmp (arg, "--input") == 0 || strcmp (arg, "-i") == 0)
+         inputs[ninputs++] = value;
+      else if (strcmp (arg, "--output") == 0 || strcmp (arg, "-o") == 0)
+         outputs[noutputs++] = value;
+      else if (strcmp (arg, "--tool") == 0 || strcmp (arg, "-t") == 0)
+         tools[ntools++] = value;
+      else if (strcmp (arg, "--range") == 0 || strcmp (arg, "-r") == 0) {
+         from[nranges] = strtoul (value, &end, 16);
+         to  [nranges] = *end == '-' ? strtoul (end + 1, &end, 16)
+                                     : from[nranges];
+         if (*end != '\0' || to[nranges] < from[nranges]) {
+            fprintf (stderr, "unicache: invalid range: %s\n", value);
+            exit (EXIT_FAILURE);
+         }
+         nranges++;
+      }
+      else {
+         i = argc;
+         break;
+      }
+   }
+   if (prune_stamp != NULL && i >= argc) {
+      if (cachedir[0] != '\0')
+         prune_cache (cachedir, prune_stamp);
+      exit (EXIT_SUCCESS);
+   }
+   if (i + 1 >= argc || noutputs == 0) {
+      fprintf (stderr, "\nSyntax:\n\n");
+      fprintf (stderr, "   unicache [--cache dir] [--input file ...] ");
+      fprintf (stderr, "[--stdin file] [--stdout]\n");
+      fprintf (stderr, "            [--range from-to ...] [--tool file] ");
+      fprintf (stderr, "--output file ... -- command ...\n\n");
+      fprintf (stderr, "   unicache [--cache dir] --prune stamp-file\n\n");
+      exit (EXIT_FAILURE);
+   }
+   command = &argv[i + 1];
+
+   /* An empty cache directory name turns the cache off. */
+   if (cachedir[0] == '\0')
+      exit (run_command (command, stdin_file,
+                         to_stdout ? outputs[0] : NULL));
+
+   /* Keep a piped stdin in a file, to hash it and give it to the command. */
+   if (read_stdin) {
+      atexit (remove_stdin_copy);
+      stdin_file = stdin_copy = save_stdin (cachedir);
+   }
+
+   /*
+      Hash the command line, the programs, the ranges, and the inputs.
+      Each part ends with a null byte, so that no two different steps
+      give the same bytes to hash.
+   */
+   add_bytes (CACHE_VERSION, sizeof (CACHE_VERSION));
+   for (i = 0; command[i] != NULL; i++)
+      add_bytes (command[i], strlen (command[i]) + 1);
+   add_bytes ("", 1);
+   if (to_stdout)
+      add_bytes (">", 2);
+   add_file (find_program (command[0]), 0);
+   for (i = 0; i < ntools; i++)
+      add_file (tools[i], 0);
+   for (i = 0; i < nranges; i++) {
+      add_bytes (&from[i], sizeof (from[i]));
+      add_bytes (&to[i], sizeof (to[i]));
+   }
+   if (stdin_file != NULL)
+      add_file (stdin_file, 1);
+   for (i = 0; i < ninputs; i++)
+      add_file (inputs[i], 1);
+
+   /* If every output is cached, mark them as used and copy them out. */
+   hit = 1;
+   for (i = 0; hit && i < noutputs; i++) {
+      cached = cache_name (cachedir, i);
+      if (access (cached, R_OK) != 0)
+         hit = 0;
+      free (cached);
+   }
+   if (hit) {
+      for (i = 0; i < noutputs; i++) {
+         cached = cache_name (cachedir, i);
+         utime (cached, NULL);
+         if (copy_file (cached, outputs[i]) != 0) {
+            fprintf (stderr, "unicache: can't copy %s to %s.\n",
+                     cached, outputs[i]);
+            exit (EXIT_FAILURE);
+         }
+         free (cached);
+      }
+      exit (EXIT_SUCCESS);
+   }
+
+   /*
+      Otherwise run the command.  If it succeeds, save its outputs.
+      Failing to save them is not an error; the step is just run
+      again next time.
+   */
+   status = run_command (command, stdin_file, to_stdout ? outputs[0] : NULL);
+   if (status == EXIT_SUCCESS &&
+       (mkdir (cachedir, 0777) == 0 || errno == EEXIST)) {
+      for (i = 0; i < noutputs; i++) {
+         cached = cache_name (cachedir, i);
+         if (copy_file (outputs[i], cached) != 0)
+            fprintf (stderr, "unicache: can't save %s in %s.\n",
+                     outputs[i], cachedir);
+         free (cached);
+      }
+   }
+   exit (status);
+}
+
+
+/**
+   @brief Add bytes to the hash.
+
+   @param[in] bytes The bytes.
+   @param[in] len The number of bytes.
+*/
+void
+add_bytes (const void *bytes, size_t len)
+{
+   const unsigned char *p = bytes;
+
+   while (len-- > 0) {
+      hash ^= *p++;
+      hash *= FNV_PRIME;
+   }
+}
+
+
+/**
+   @brief Test whether a .hex line's code point is in one of the ranges.
+
+   @param[in] line The line.
+   @return 1 if the line holds a glyph in a range, or 0 if not.
+*/
+int
+in_range (const char *line)
+{
+   unsigned long codept;
+   char *end;
+   int   i;
+
+   codept = strtoul (line, &end, 16);
+   if (end == line || *end != ':')
+      return 0;
+   for (i = 0; i < nranges; i++)
+      if (codept >= from[i] && codept <= to[i])
+         return 1;
+   return 0;
+}
+
+
+/**
+   @brief Add the contents of a file to the hash.
+
+   Compressed files are hashed as their uncompressed contents.  If
+   ranges were given and filtered is 1, only the lines of glyphs in
+   those ranges are hashed.
+
+   @param[in] filename The file, or NULL to hash nothing.
+   @param[in] filtered 1 to hash only glyphs in the ranges.
+*/
+void
+add_file (const char *filename, int filtered)
+{
+   FILE  *fp;
+   char   buf[MAXLINE];
+   size_t got;
+
+   if (filename == NULL)
+      return;
+   if ((fp = zio_open (filename, "r")) == NULL) {
+      fprintf (stderr, "unicache: can't open %s for input.\n", filename);
+      exit (EXIT_FAILURE);
+   }
+   if (filtered && nranges > 0) {
+      while (fgets (buf, MAXLINE, fp) != NULL)
+         if (in_range (buf))
+            add_bytes (buf, strlen (buf));
+   }
+   else {
+      while ((got = fread (buf, 1, MAXLINE, fp)) > 0)
+         add_bytes (buf, got);
+   }
+   if (ferror (fp)) {
+      fprintf (stderr, "unicache: can't read %s.\n", filename);
+      exit (EXIT_FAILURE);
+   }
+   fclose (fp);
+   add_bytes ("", 1);
+}
+
+
+/**
+   @brief Find the file a command name runs, as execvp does.
+
+   @param[in] name The command name.
+   @return The program's file name, or NULL if it is not found.
+*/
+char *
+find_program (const char *name)
+{
+   static char path[4096];
+   const char *dirs, *colon;
+   size_t len;
+
+   if (strchr (name, '/') != NULL)
+      return (char *)name;
+   dirs = getenv ("PATH");
+   if (dirs == NULL)
+      dirs = "/bin:/usr/bin";
+   for (;;) {
+      colon = strchr (dirs, ':');
+      len = colon != NULL ? (size_t)(colon - dirs) : strlen (dirs);
+      if (len + strlen (name) + 2 <= sizeof (path)) {
+         if (len == 0)
+            strcpy (path, name);
+         else
+            sprintf (path, "%.*s/%s", (int)len, dirs, name);
+         if (access (path, X_OK) == 0)
+            return path;
+      }
+      if (colon == NULL)
+         return NULL;
+      dirs = colon + 1;
+   }
+}
+
+
+/**
+   @brief Make the name of an output's file in the cache.
+
+   @param[in] cachedir The cache directory.
+   @param[in] output The output's position in the list of outputs.
+   @return The file name, which the caller must free.
+*/
+char *
+cache_name (const char *cachedir, int output)
+{
+   char *name;
+
+   name = malloc (strlen (cachedir) + 32);
+   if (name == NULL) {
+      fprintf (stderr, "unicache: out of memory.\n");
+      exit (EXIT_FAILURE);
+   }
+   sprintf (name, "%s/%016llX.%d", cachedir, hash, output);
+   return name;
+}
+
+
+/**
+   @brief Copy a file.
+
+   The copy is written under a temporary name and then renamed, so
+   that a cached file is never seen half written.
+
+   @param[in] from The file to copy.
+   @param[in] to The name of the copy.
+   @return 0 on success, or -1 on failure.
+*/
+int
+copy_file (const char *from, const char *to)
+{
+   FILE  *infp, *outfp;
+   char  *tmpname;
+   char   buf[1 << 16];
+   size_t got;
+   int    result = 0;
+
+   tmpname = malloc (strlen (to) + 32);
+   if (tmpname == NULL) {
+      fprintf (stderr, "unicache: out of memory.\n");
+      exit (EXIT_FAILURE);
+   }
+   sprintf (tmpname, "%s.tmp%ld", to, (long)getpid ());
+
+   if ((infp = fopen (from, "rb")) == NULL) {
+      free (tmpname);
+      return -1;
+   }
+   if ((outfp = fopen (tmpname, "wb")) == NULL) {
+      fclose (infp);
+      free (tmpname);
+      return -1;
+   }
+   while ((got = fread (buf, 1, sizeof (buf), infp)) > 0)
+      if (fwrite (buf, 1, got, outfp) != got)
+         result = -1;
+   if (ferror (infp))
+      result = -1;
+   fclose (infp);
+   if (fclose (outfp) != 0)
+      result = -1;
+   if (result == 0 && rename (tmpname, to) != 0)
+      result = -1;
+   if (result != 0)
+      remove (tmpname);
+   free (tmpname);
+   return result;
+}
+
+
+/**
+   @brief Run a command and wait for it to finish.
+
+   @param[in] command The command and its arguments.
+   @param[in] stdin_file File for the command's stdin, or NULL.
+   @param[in] stdout_file File for the command's stdout, or NULL.
+   @return The command's exit status, or EXIT_FAILURE if it could
+           not be run or was killed.
+*/
+int
+run_command (char **command, const char *stdin_file, const char *stdout_file)
+{
+   pid_t pid;
+   int   status;
+   int   fd;
+
+   fflush (stdout);
+   pid = fork ();
+   if (pid < 0) {
+      fprintf (stderr, "unicache: can't run %s.\n", command[0]);
+      return EXIT_FAILURE;
+   }
+   if (pid == 0) {
+      if (stdin_file != NULL) {
+         if ((fd = open (stdin_file, O_RDONLY)) < 0) {
+            fprintf (stderr, "unicache: can't open %s for input.\n",
+                     stdin_file);
+            _exit (EXIT_FAILURE);
+         }
+         dup2 (fd, 0);
+         close (fd);
+      }
+      if (stdout_file != NULL) {
+         if ((fd = open (stdout_file, O_WRONLY | O_CREAT | O_TRUNC,
+                         0666)) < 0) {
+            fprintf (stderr, "unicache: can't open %s for output.\n",
+                     stdout_file);
+            _exit (EXIT_FAILURE);
+         }
+         dup2 (fd, 1);
+         close (fd);
+      }
+      execvp (command[0], command);
+      fprintf (stderr, "unicache: can't run %s.\n", command[0]);
+      _exit (127);
+   }
+   if (waitpid (pid, &status, 0) < 0 || !WIFEXITED (status))
+      return EXIT_FAILURE;
+   return WEXITSTATUS (status);
+}
+
+
+/**
+   @brief Save this program's stdin in a temporary file.
+
+   The file is made in the cache directory, which is created if it
+   does not exist yet.
+
+   @param[in] cachedir The cache directory.
+   @return The file name, which the caller must free.
+*/
+char *
+save_stdin (const char *cachedir)
+{
+   FILE  *outfp;
+   char  *name;
+   char   buf[1 << 16];
+   size_t got;
+   int    result = 0;
+
+   if (mkdir (cachedir, 0777) != 0 && errno != EEXIST) {
+      fprintf (stderr, "unicache: can't create %s.\n", cachedir);
+      exit (EXIT_FAILURE);
+   }
+   name = malloc (strlen (cachedir) + 32);
+   if (name == NULL) {
+      fprintf (stderr, "unicache: out of memory.\n");
+      exit (EXIT_FAILURE);
+   }
+   sprintf (name, "%s/stdin.tmp%ld", cachedir, (long)getpid ());
+
+   if ((outfp = fopen (name, "wb")) == NULL) {
+      fprintf (stderr, "unicache: can't open %s for output.\n", name);
+      free (name);
+      exit (EXIT_FAILURE);
+   }
+   while ((got = fread (buf, 1, sizeof (buf), stdin)) > 0)
+      if (fwrite (buf, 1, got, outfp) != got)
+         result = -1;
+   if (ferror (stdin))
+      result = -1;
+   if (fclose (outfp) != 0)
+      result = -1;
+   if (result != 0) {
+      fprintf (stderr, "unicache: can't save stdin in %s.\n", name);
+      remove (name);
+      free (name);
+      exit (EXIT_FAILURE);
+   }
+   return name;
+}
+
+
+/**
+   @brief Remove the temporary copy of stdin, if there is one.
+
+   This is called by exit.
+*/
+void
+remove_stdin_copy (void)
+{
+   if (stdin_copy != NULL) {
+      remove (stdin_copy);
+      free (stdin_copy);
+      stdin_copy = NULL;
+   }
+}
+
+
+/**
+   @brief Remove the cached files that were not used since a stamp file.
+
+   A cached file is used when it is saved or copied out of the cache,
+   so a file older than the stamp belongs to a step that was not run
+   since the stamp was made.  Leftover temporary files are old too and
+   are removed with them.
+
+   @param[in] cachedir The cache directory.
+   @param[in] stamp The stamp file.
+*/
+void
+prune_cache (const char *cachedir, const char *stamp)
+{
+   DIR    *dir;
+   struct dirent *entry;
+   struct stat    stampstat, filestat;
+   char  *name;
+   size_t len;
+   int    removed = 0;
+
+   if (stat (stamp, &stampstat) != 0) {
+      fprintf (stderr, "unicache: can't find %s.\n", stamp);
+      exit (EXIT_FAILURE);
+   }
+   if ((dir = opendir (cachedir)) == NULL)
+      return;   /* no cache, so nothing to remove */
+
+   len = strlen (cachedir);
+   while ((entry = readdir (dir)) != NULL) {
+      name = malloc (len + strlen (entry->d_name) + 2);
+      if (name == NULL) {
+         fprintf (stderr, "unicache: out of memory.\n");
+         exit (EXIT_FAILURE);
+      }
+      sprintf (name, "%s/%s", cachedir, entry->d_name);
+      if (stat (name, &filestat) == 0 && S_ISREG (filestat.st_mode) &&
+          filestat.st_mtime < stampstat.st_mtime && remove (name) == 0)
+         removed++;
+      free (name);
+   }
+   closedir (dir);
+   if (removed > 0)
+      fprintf (stderr, "unicache: removed %d unused files from %s.\n",
+               removed, cachedir);
+}
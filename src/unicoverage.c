@@ -10,6 +10,10 @@
 
    Synopsis: unicoverage [-ifont_file.hex] [-ocoverage_file.txt]
 
+   The input can also be a binary glyph store made by hex2ufb, or
+   a gzip or zstd compressed .hex file.  The output is compressed if
+   its name ends in ".gz" or ".zst".
+
    This program requires the file "coverage.dat" to be present
    in the directory from which it is run.
 */
@@ -56,6 +60,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "ufb.h"
+#include "unizio.h"
 
 #define MAXBUF 256   ///< Maximum input line length - 1
 
@@ -76,6 +82,8 @@ main (int argc, char *argv[])
    unsigned slen;             /* string length of coverage file line */
    char     inbuf[256];       /* input buffer                        */
    unsigned thischar;         /* the current character               */
+   unsigned long nextchar=0;  /* where to look for the next .ufb glyph */
+   struct Ufb *ufb;           /* input, if it is a .ufb file         */
 
    char *infile="", *outfile="";  /* names of input and output files        */
    FILE *infp, *outfp;        /* file pointers of input and output files    */
@@ -121,16 +129,17 @@ main (int argc, char *argv[])
       doing anything else.
    */
    if (strlen (infile) > 0) {
-      if ((infp = fopen (infile, "r")) == NULL) {
+      if ((infp = zio_open (infile, "r")) == NULL) {
          fprintf (stderr, "Error: can't open %s for input.\n", infile);
          exit (1);
       }
    }
    else {
-      infp = stdin;
+      infp = zio_wrap (stdin, "stdin");
    }
+   ufb = ufb_fdopen (fileno (infp), strlen (infile) == 0 ? "stdin" : infile);
    if (strlen (outfile) > 0) {
-      if ((outfp = fopen (outfile, "w")) == NULL) {
+      if ((outfp = zio_open (outfile, "w")) == NULL) {
          fprintf (stderr, "Error: can't open %s for output.\n", outfile);
          exit (1);
       }
@@ -157,8 +166,15 @@ main (int argc, char *argv[])
    /*
       Read in the glyphs in the file
    */
-   while (slen != 0 && fgets (inbuf, MAXBUF-1, infp) != NULL) {
-      sscanf (inbuf, "%x", &thischar);
+   while (slen != 0) {
+      if (ufb != NULL) {  /* binary glyph store: no lines to parse */
+         if ((nextchar = ufb_next (ufb, nextchar)) == UFB_END) break;
+         thischar = nextchar++;
+      }
+      else {
+         if (fgets (inbuf, MAXBUF-1, infp) == NULL) break;
+         sscanf (inbuf, "%x", &thischar);
+      }
 
       /* Read a character beyond end of current script. */
       while (cend < thischar && slen != 0) {
@@ -173,6 +189,7 @@ main (int argc, char *argv[])
 
    print_subtotal (outfp, print_n, nglyphs, cstart, cend, coverstring);
 
+   fclose (outfp);  /* completes a compressed output file */
    exit (0);
 }
 
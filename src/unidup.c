@@ -13,6 +13,8 @@
    Synopsis: unidup < unifont_file.hex
 
              [Hopefully there won't be any output!]
+
+   The input can be gzip or zstd compressed.
 */
 /*
    LICENSE:
@@ -34,6 +36,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "unizio.h"
+
 #define MAXBUF 256   ///< Maximum input line length - 1
 
 
@@ -55,13 +59,13 @@ main (int argc, char **argv)
 
    if (argc > 1) {
       infile = argv[1];
-      if ((infilefp = fopen (infile, "r")) == NULL) {
+      if ((infilefp = zio_open (infile, "r")) == NULL) {
          fprintf (stderr, "\nERROR: Can't open file %s\n\n", infile);
          exit (EXIT_FAILURE);
       }
    }
    else {
-      infilefp = stdin;
+      infilefp = zio_wrap (stdin, "stdin");
    }
 
    ix = -1;
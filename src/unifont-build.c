@@ -0,0 +1,1081 @@
+/**
+   @file unifont-build.c
+
+   @brief unifont-build - Build the aggregate GNU Unifont .hex files
+
+   @author Paul Hardy
+
+   @copyright Copyright (C) 2023 Paul Hardy
+
+   This program does the work of the "hex-stamp" target in
+   font/Makefile: it combines the .hex files in the font source
+   directories into the aggregate .hex files in the compiled directory
+   that the other font targets are built from.  It must be run from
+   the font directory, after the plane01 and plane00csur directories'
+   own Makefiles have made plane01-all.hex and plane00csur-all.hex.
+
+   Synopsis: unifont-build [--version string] [--output dir]
+                           [--jobs n] --name "files" ... unifile.hex ...
+
+   The files named on the command line are those that make up
+   unifont-VERSION.hex (UNIFILES in font/Makefile).  Each of the
+   other inputs is given by an option whose value is a list of file
+   names or glob patterns separated by spaces, so that font/Makefile
+   stays the one place that names them; see file_options below.
+
+   Each input file is read into memory once.  The sorting, the
+   removal of U+FFFE, U+FFFF, and U+0020 glyphs, the patching of
+   Japanese glyphs from JIS X 0213 into unifont_jp, and the dashed
+   circles on combining characters in the sample files are all done
+   in memory, and the output files are then written in parallel by
+   up to n child processes (by default, one per processor).  Each
+   output file is byte for byte what the shell commands of the
+   earlier hex-stamp recipe wrote with LC_ALL=C: lines are sorted
+   in byte order, as "sort" does in the C locale, and the dashed
+   circles are drawn exactly as unigencircles draws them.
+*/
+/*
+   LICENSE:
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 2 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glob.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "unihex.h"
+
+#define MAXCODE  0x110000  ///< One past the highest Unicode code point.
+#define NOUTPUTS 15        ///< Number of output files written.
+
+/*
+   Input files, relative to the font directory, from the options in
+   file_options.  Each is a null terminated list of file names.
+*/
+char **sample_files;           ///< --sample: PLANE0 in font/Makefile.
+char **combining_files;        ///< --combining: COMBINING.
+char **nonprinting_files;      ///< --nonprinting: NONPRINTING.
+char **jp_plane0_files;        ///< --jp-plane0: PLANE_0_JP_HEX.
+char **plane1_files;           ///< --plane1: PLANE_1_ALL.
+char **zh_plane2_files;        ///< --zh-plane2: PLANE_2_ZH_HEX.
+char **jp_plane2_files;        ///< --jp-plane2: PLANE_2_JP_HEX.
+char **zh_plane3_files;        ///< --zh-plane3: PLANE_3_ZH_HEX.
+char **plane0E_files;          ///< --plane0E: ALL_HEX_PLANE0E.
+char **upper_combining_files;  ///< --upper-combining: UPPER_COMBINING.
+char **upper_nonprint_files;   ///< --upper-nonprinting: UPPER_NONPRINTING.
+char **upper_hex_files;        ///< --upper-hex: UPPER_SAMPLE_HEX.
+char **csur_files;             ///< --csur: CSUR_ALL.
+char **csur_combining_files;   ///< --csur-combining: CSUR_COMBINING.
+char **upper_csur_files;       ///< --upper-csur: UPPER_CSUR_HEX.
+char **upper_csur_comb_files;  ///< --upper-csur-combining: UPPER_CSUR_COMBINING.
+
+/**
+   @brief An option that names a list of input files.
+*/
+struct FileOption {
+   const char *name;      ///< The option name, without dashes.
+   char ***files;         ///< Where the list of files is kept.
+};
+
+/** The options that name input files; all of them must be given. */
+const struct FileOption file_options[] = {
+   {"sample",               &sample_files},
+   {"combining",            &combining_files},
+   {"nonprinting",          &nonprinting_files},
+   {"jp-plane0",            &jp_plane0_files},
+   {"plane1",               &plane1_files},
+   {"zh-plane2",            &zh_plane2_files},
+   {"jp-plane2",            &jp_plane2_files},
+   {"zh-plane3",            &zh_plane3_files},
+   {"plane0E",              &plane0E_files},
+   {"upper-combining",      &upper_combining_files},
+   {"upper-nonprinting",    &upper_nonprint_files},
+   {"upper-hex",            &upper_hex_files},
+   {"csur",                 &csur_files},
+   {"csur-combining",       &csur_combining_files},
+   {"upper-csur",           &upper_csur_files},
+   {"upper-csur-combining", &upper_csur_comb_files},
+   {NULL,                   NULL}
+};
+
+
+/**
+   @brief One line of text, without its newline.
+*/
+struct Line {
+   const char *text;      ///< Start of the line.
+   size_t len;            ///< Length of the line in bytes.
+   unsigned long order;   ///< Position in the input, for stable sorting.
+};
+
+/**
+   @brief A list of lines.
+*/
+struct Lines {
+   struct Line *line;     ///< The lines.
+   unsigned long n;       ///< Number of lines in the list.
+   unsigned long room;    ///< Number of lines allocated.
+};
+
+/**
+   @brief An input file read into memory.
+*/
+struct Input {
+   char *name;            ///< File name.
+   char *text;            ///< Contents of the file.
+   size_t len;            ///< Length of the file in bytes.
+   struct Lines lines;    ///< The lines of the file.
+};
+
+
+struct Input *inputs = NULL;   ///< Files read so far.
+int ninputs = 0;               ///< Number of files read so far.
+
+char **unifiles;               ///< The files making up unifont.hex.
+int nunifiles;                 ///< Number of files in unifiles.
+char *version = "1.0";         ///< Version string in output file names.
+char *outdir  = "compiled";    ///< Directory for the output files.
+
+/*
+   Lists shared by several output files, made before any are written.
+*/
+struct Lines unifont;          ///< unifont-VERSION.hex.
+struct Lines zh_plane02;       ///< unifont_zh-plane02.hex.
+struct Lines jp_plane02;       ///< unifont_jp-plane02.hex.
+struct Lines plane0E;          ///< unifont-plane0E.hex.
+struct Lines upper_combining;  ///< upper_combining.txt.
+struct Lines upper_nonprint;   ///< upper_nonprinting.hex.
+struct Lines csur;             ///< unifont_csur-VERSION.hex.
+struct Lines csur_combining;   ///< csur_combining.txt.
+struct Lines jp_lower;         ///< Plane 0 part of unifont_jp-VERSION.hex.
+
+
+/**
+   @brief The main function.
+
+   @param[in] argc The count of command line arguments.
+   @param[in] argv Pointer to array of command line arguments.
+   @return This program exits with status EXIT_SUCCESS or EXIT_FAILURE.
+*/
+int
+main (int argc, char *argv[])
+{
+   int   jobs;                    /* most output files written at once */
+   int   running = 0;             /* child processes still running     */
+   int   failed  = 0;             /* 1 if any output file failed       */
+   int   status;                  /* exit status of a child process    */
+   int   output;                  /* output file number                */
+   pid_t pid;                     /* child process id                  */
+   int   nfiles = 0;              /* number of input files named       */
+   int   i;                       /* loop variable                     */
+   char *arg, *value;             /* current option and its value      */
+   const struct FileOption *fo;   /* option naming input files         */
+
+   char **expand_list (const char *list);
+   void build_shared (void);
+   void write_output (int output);
+
+   jobs = (int)sysconf (_SC_NPROCESSORS_ONLN);
+   if (jobs < 1)
+      jobs = 1;
+
+   /*
+      Options are accepted as "--name value", "--name=value",
+      "-n value", or "-n=value", as in hex2bdf.
+      File names are moved to the front of argv.
+   */
+   for (i = 1; i < argc; i++) {
+      arg = argv[i];
+      if (arg[0] != '-' || arg[1] == '\0') {
+         argv[nfiles++] = arg;
+         continue;
+      }
+      if (arg[1] == '-')
+         arg += 2;
+      else
+         arg += 1;
+      value = strchr (arg, '=');
+      if (value != NULL)
+         *value++ = '\0';
+      else if (i + 1 < argc)
+         value = argv[++i];
+      if (value == NULL) {
+         fprintf (stderr, "unifont-build: option %s needs a value.\n",
+                  argv[i]);
+         exit (EXIT_FAILURE);
+      }
+      if      (strcmp (arg, "version") == 0 || strcmp (arg, "v") == 0)
+         version = value;
+      else if (strcmp (arg, "output") == 0 || strcmp (arg, "o") == 0)
+         outdir = value;
+      else if (strcmp (arg, "jobs") == 0 || strcmp (arg, "j") == 0) {
+         jobs = atoi (value);
+         if (jobs < 1) {
+            fprintf (stderr, "unifont-build: invalid number of jobs: %s\n",
+                     value);
+            exit (EXIT_FAILURE);
+         }
+      }
+      else {
+         for (fo = file_options; fo->name != NULL; fo++)
+            if (strcmp (arg, fo->name) == 0)
+               break;
+         if (fo->name == NULL) {
+            nfiles = 0;
+            break;
+         }
+         *fo->files = expand_list (value);
+      }
+   }
+   for (fo = file_options; fo->name != NULL && nfiles > 0; fo++) {
+      if (*fo->files == NULL) {
+         fprintf (stderr, "unifont-build: --%s not given.\n", fo->name);
+         nfiles = 0;
+      }
+   }
+   if (nfiles == 0) {
+      fprintf (stderr, "\nSyntax:\n\n");
+      fprintf (stderr, "   unifont-build [--version string] ");
+      fprintf (stderr, "[--output dir] [--jobs n]\n");
+      fprintf (stderr, "                 --name \"files\" ... ");
+      fprintf (stderr, "unifile.hex ...\n\n");
+      fprintf (stderr, "where each --name is one of:\n");
+      for (i = 0, fo = file_options; fo->name != NULL; fo++, i++) {
+         if (i % 4 == 0)
+            fprintf (stderr, "\n  ");
+         else
+            fprintf (stderr, "%*s", 20 - (int)strlen (fo[-1].name), "");
+         fprintf (stderr, " --%s", fo->name);
+      }
+      fprintf (stderr, "\n\n");
+      exit (EXIT_FAILURE);
+   }
+   unifiles  = argv;
+   nunifiles = nfiles;
+
+   build_shared ();
+
+   /*
+      Write each output file in a child process, with at most
+      "jobs" running at once.  The children share the lists built
+      above with this process.
+   */
+   fflush (stdout);
+   fflush (stderr);
+   for (output = 0; output < NOUTPUTS; output++) {
+      if (jobs == 1) {
+         write_output (output);
+         continue;
+      }
+      if (running == jobs) {
+         if (wait (&status) < 0 || !WIFEXITED (status) ||
+             WEXITSTATUS (status) != EXIT_SUCCESS)
+            failed = 1;
+         running--;
+      }
+      pid = fork ();
+      if (pid == 0) {
+         write_output (output);
+         exit (EXIT_SUCCESS);
+      }
+      else if (pid < 0)
+         write_output (output);
+      else
+         running++;
+   }
+   while (running > 0) {
+      if (wait (&status) < 0 || !WIFEXITED (status) ||
+          WEXITSTATUS (status) != EXIT_SUCCESS)
+         failed = 1;
+      running--;
+   }
+
+   exit (failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+
+/**
+   @brief Add a line to the end of a list.
+
+   @param[in,out] lines The list.
+   @param[in] text The start of the line.
+   @param[in] len The length of the line.
+*/
+void
+add_line (struct Lines *lines, const char *text, size_t len)
+{
+   if (lines->n == lines->room) {
+      lines->room = lines->room ? 2 * lines->room : 1024;
+      lines->line = realloc (lines->line,
+                             lines->room * sizeof (struct Line));
+      if (lines->line == NULL) {
+         fprintf (stderr, "unifont-build: out of memory.\n");
+         exit (EXIT_FAILURE);
+      }
+   }
+   lines->line[lines->n].text  = text;
+   lines->line[lines->n].len   = len;
+   lines->line[lines->n].order = lines->n;
+   lines->n++;
+}
+
+
+/**
+   @brief Add copies of all the lines in one list to the end of another.
+
+   @param[in,out] to The list to add to.
+   @param[in] from The lines to add.
+*/
+void
+add_lines (struct Lines *to, const struct Lines *from)
+{
+   unsigned long i;
+
+   for (i = 0; i < from->n; i++)
+      add_line (to, from->line[i].text, from->line[i].len);
+}
+
+
+/**
+   @brief Read a file into memory, unless it was read before.
+
+   @param[in] name The file name.
+   @return The file's contents and lines.
+*/
+struct Input *
+read_file (const char *name)
+{
+   struct Input *input;
+   char  *names[1];
+   size_t start, end;
+   int    i;
+
+   for (i = 0; i < ninputs; i++)
+      if (strcmp (inputs[i].name, name) == 0)
+         return &inputs[i];
+
+   inputs = realloc (inputs, (ninputs + 1) * sizeof (struct Input));
+   if (inputs == NULL) {
+      fprintf (stderr, "unifont-build: out of memory.\n");
+      exit (EXIT_FAILURE);
+   }
+   input = &inputs[ninputs++];
+   memset (input, 0, sizeof (struct Input));
+   input->name = (char *)name;
+   names[0]    = (char *)name;
+   input->text = read_input ("unifont-build", names, 1, &input->len);
+   input->len--;  /* drop the newline read_input adds */
+
+   /* A last line without a newline is still a line, as in sort. */
+   for (start = 0; start < input->len; start = end + 1) {
+      for (end = start; end < input->len && input->text[end] != '\n'; end++)
+         ;
+      add_line (&input->lines, input->text + start, end - start);
+   }
+   return input;
+}
+
+
+/**
+   @brief Add the lines of a file to the end of a list.
+
+   @param[in,out] lines The list.
+   @param[in] name The file name.
+*/
+void
+add_file (struct Lines *lines, const char *name)
+{
+   add_lines (lines, &read_file (name)->lines);
+}
+
+
+/**
+   @brief Copy a string into newly allocated memory.
+
+   @param[in] text The start of the string.
+   @param[in] len The length of the string.
+   @return The copy, which is not null terminated.
+*/
+char *
+copy_text (const char *text, size_t len)
+{
+   char *copy;
+
+   copy = malloc (len > 0 ? len : 1);
+   if (copy == NULL) {
+      fprintf (stderr, "unifont-build: out of memory.\n");
+      exit (EXIT_FAILURE);
+   }
+   memcpy (copy, text, len);
+   return copy;
+}
+
+
+/**
+   @brief Add the lines of a list of files to the end of a list of lines.
+
+   @param[in,out] lines The list of lines.
+   @param[in] files The null terminated list of file names.
+*/
+void
+add_list (struct Lines *lines, char **files)
+{
+   for (; *files != NULL; files++)
+      add_file (lines, *files);
+}
+
+
+/**
+   @brief Expand a list of file names and patterns from an option.
+
+   The words of the list are separated by spaces or tabs.  Each is
+   a glob pattern, and its files are taken in the order the shell
+   would list them.  A plain file name must name a file that exists.
+
+   @param[in] list The list, as given on the command line.
+   @return The null terminated list of file names.
+*/
+char **
+expand_list (const char *list)
+{
+   glob_t files;
+   char  *copy, *word;
+   char **names = NULL;
+   size_t nnames = 0;
+   size_t i;
+
+   copy = copy_text (list, strlen (list) + 1);
+   for (word = strtok (copy, " \t\n"); word != NULL;
+        word = strtok (NULL, " \t\n")) {
+      if (glob (word, 0, NULL, &files) != 0) {
+         fprintf (stderr, "unifont-build: no files match %s\n", word);
+         exit (EXIT_FAILURE);
+      }
+      names = realloc (names, (nnames + files.gl_pathc + 1) * sizeof (char *));
+      if (names == NULL) {
+         fprintf (stderr, "unifont-build: out of memory.\n");
+         exit (EXIT_FAILURE);
+      }
+      for (i = 0; i < files.gl_pathc; i++)
+         names[nnames++] = copy_text (files.gl_pathv[i],
+                                      strlen (files.gl_pathv[i]) + 1);
+      globfree (&files);
+   }
+   free (copy);
+   if (names == NULL) {
+      fprintf (stderr, "unifont-build: empty file list.\n");
+      exit (EXIT_FAILURE);
+   }
+   names[nnames] = NULL;
+   return names;
+}
+
+
+/**
+   @brief Compare two lines byte by byte, for qsort.
+
+   @param[in] a The first line.
+   @param[in] b The second line.
+   @return Less than, equal to, or greater than 0, as for strcmp.
+*/
+int
+compare_lines (const void *a, const void *b)
+{
+   const struct Line *x = a, *y = b;
+   int result;
+
+   result = memcmp (x->text, y->text, x->len < y->len ? x->len : y->len);
+   if (result == 0)
+      result = (x->len > y->len) - (x->len < y->len);
+   return result;
+}
+
+
+/**
+   @brief Return the length of the part of a line before its first colon.
+
+   @param[in] line The line.
+   @return The number of bytes before the first colon, or the line length.
+*/
+size_t
+key_length (const struct Line *line)
+{
+   const char *colon;
+
+   colon = memchr (line->text, ':', line->len);
+   return colon == NULL ? line->len : (size_t)(colon - line->text);
+}
+
+
+/**
+   @brief Compare the code points of two lines, keeping input order.
+
+   @param[in] a The first line.
+   @param[in] b The second line.
+   @return Less than, equal to, or greater than 0, as for strcmp.
+*/
+int
+compare_keys (const void *a, const void *b)
+{
+   const struct Line *x = a, *y = b;
+   size_t xlen, ylen;
+   int result;
+
+   xlen = key_length (x);
+   ylen = key_length (y);
+   result = memcmp (x->text, y->text, xlen < ylen ? xlen : ylen);
+   if (result == 0)
+      result = (xlen > ylen) - (xlen < ylen);
+   if (result == 0)
+      result = (x->order > y->order) - (x->order < y->order);
+   return result;
+}
+
+
+/**
+   @brief Sort a list of lines, as "sort" does.
+
+   @param[in,out] lines The list.
+*/
+void
+sort_lines (struct Lines *lines)
+{
+   if (lines->n > 1)
+      qsort (lines->line, lines->n, sizeof (struct Line), compare_lines);
+}
+
+
+/**
+   @brief Sort lines by code point, keeping the first line for each.
+
+   This does what "sort -u -t ':' -k 1,1" does.
+
+   @param[in,out] lines The list.
+*/
+void
+sort_unique_keys (struct Lines *lines)
+{
+   unsigned long i, n;
+
+   if (lines->n < 2)
+      return;
+   qsort (lines->line, lines->n, sizeof (struct Line), compare_keys);
+   for (i = 1, n = 1; i < lines->n; i++) {
+      if (key_length (&lines->line[i]) != key_length (&lines->line[n - 1]) ||
+          memcmp (lines->line[i].text, lines->line[n - 1].text,
+                  key_length (&lines->line[i])) != 0)
+         lines->line[n++] = lines->line[i];
+   }
+   lines->n = n;
+}
+
+
+/**
+   @brief Test whether a line starts with a pattern.
+
+   The pattern is a regular expression anchored at the start of the
+   line, limited to ordinary characters, "." for any character, and
+   bracketed lists of characters.
+
+   @param[in] line The line.
+   @param[in] pattern The pattern.
+   @return 1 if the line matches, or 0 if not.
+*/
+int
+line_matches (const struct Line *line, const char *pattern)
+{
+   size_t i;
+   int    found;
+
+   for (i = 0; *pattern != '\0'; i++) {
+      if (i >= line->len)
+         return 0;
+      if (*pattern == '[') {
+         found = 0;
+         for (pattern++; *pattern != ']'; pattern++)
+            if (*pattern == line->text[i])
+               found = 1;
+         if (!found)
+            return 0;
+      }
+      else if (*pattern != '.' && *pattern != line->text[i])
+         return 0;
+      pattern++;
+   }
+   return 1;
+}
+
+
+/**
+   @brief Remove the lines that start with a pattern, as "grep -v" does.
+
+   @param[in,out] lines The list.
+   @param[in] pattern The pattern; see line_matches.
+*/
+void
+drop_lines (struct Lines *lines, const char *pattern)
+{
+   unsigned long i, n;
+
+   for (i = 0, n = 0; i < lines->n; i++)
+      if (!line_matches (&lines->line[i], pattern))
+         lines->line[n++] = lines->line[i];
+   lines->n = n;
+}
+
+
+/**
+   @brief Put a prefix in front of every line, as "sed -e 's/^/00/'" does.
+
+   @param[in,out] lines The list.
+   @param[in] prefix The prefix.
+*/
+void
+prefix_lines (struct Lines *lines, const char *prefix)
+{
+   size_t plen = strlen (prefix);
+   unsigned long i;
+   char *text;
+
+   for (i = 0; i < lines->n; i++) {
+      text = malloc (plen + lines->line[i].len);
+      if (text == NULL) {
+         fprintf (stderr, "unifont-build: out of memory.\n");
+         exit (EXIT_FAILURE);
+      }
+      memcpy (text, prefix, plen);
+      memcpy (text + plen, lines->line[i].text, lines->line[i].len);
+      lines->line[i].text = text;
+      lines->line[i].len += plen;
+   }
+}
+
+
+/**
+   @brief Replace glyphs in one list with glyphs from another.
+
+   This does what font/unipatch-hex.awk does: the result has one line
+   for each code point in base, with the bitmap of the last such line
+   in patch, or else the last such line in base.  Code points that
+   are only in patch are ignored.  As in awk with "-F:", the bitmap is
+   the text between the first colon and any second colon.  The result
+   is unsorted.
+
+   @param[out] to The list to add the result to.
+   @param[in] base The glyphs to patch.
+   @param[in] patch The replacement glyphs.
+*/
+void
+patch_lines (struct Lines *to, const struct Lines *base,
+             const struct Lines *patch)
+{
+   struct Lines sorted;         /* base, by code point            */
+   struct Line *found;          /* line in sorted with a code point */
+   struct Line  probe;          /* a patch line, without its order  */
+   const char  *value;          /* bitmap for the current code point */
+   size_t       vlen;           /* length of value                  */
+   size_t       klen;           /* length of the code point         */
+   unsigned long i, n;
+   char *text;
+
+   /*
+      Sort base by code point, keeping the last line for each,
+      then replace lines from patch.
+   */
+   memset (&sorted, 0, sizeof (sorted));
+   add_lines (&sorted, base);
+   if (sorted.n > 1)
+      qsort (sorted.line, sorted.n, sizeof (struct Line), compare_keys);
+   for (i = 0, n = 0; i < sorted.n; i++) {
+      if (n > 0 &&
+          key_length (&sorted.line[i]) == key_length (&sorted.line[n - 1]) &&
+          memcmp (sorted.line[i].text, sorted.line[n - 1].text,
+                  key_length (&sorted.line[i])) == 0)
+         n--;
+      sorted.line[n++] = sorted.line[i];
+   }
+   sorted.n = n;
+   for (i = 0; i < sorted.n; i++)
+      sorted.line[i].order = 0;
+
+   for (i = 0; i < patch->n; i++) {
+      probe = patch->line[i];
+      probe.order = 0;
+      found = bsearch (&probe, sorted.line, sorted.n, sizeof (struct Line),
+                       compare_keys);
+      if (found != NULL)
+         *found = probe;
+   }
+
+   for (i = 0; i < sorted.n; i++) {
+      klen  = key_length (&sorted.line[i]);
+      value = sorted.line[i].text + klen;
+      vlen  = sorted.line[i].len - klen;
+      if (vlen > 0) {
+         value++;
+         vlen--;
+      }
+      if (memchr (value, ':', vlen) != NULL)
+         vlen = (const char *)memchr (value, ':', vlen) - value;
+      text = copy_text (sorted.line[i].text, klen + 1 + vlen);
+      text[klen] = ':';
+      memcpy (text + klen + 1, value, vlen);
+      add_line (to, text, klen + 1 + vlen);
+   }
+   free (sorted.line);
+}
+
+
+/**
+   @brief Superimpose dashed circles on combining characters.
+
+   This gives the same output as unigencircles: a glyph listed in the
+   combining list, and not in the nonprinting list, gets a dashed
+   circle.  A bitmap shorter than 34 hexadecimal digits is treated
+   as a single-width glyph and keeps its first 32 digits; any other
+   bitmap is treated as double-width and keeps its first 64 digits.
+   U+01107F and U+01D1A0 never get a circle.
+
+   @param[in,out] lines The glyphs.
+   @param[in] combining The combining characters, as "code:offset".
+   @param[in] nonprinting The nonprinting glyphs.
+*/
+void
+add_circles (struct Lines *lines, const struct Lines *combining,
+             const struct Lines *nonprinting)
+{
+   /* Circle patterns, as in add_single_circle and add_double_circle. */
+   static const char single[] = "00000000000024004200240000000000";
+   static const char left[]   = "000000000000000000000000240000004200"
+                                "0000240000000000000000000000";
+   static const char center[] = "000000000000000000000000024000000420"
+                                "0000024000000000000000000000";
+   static const char hexdigit[] = "0123456789ABCDEF";
+   char *flag;                  /* 1 for a combining character    */
+   signed char *x_offset;       /* offset from *combining.txt     */
+   const char *circle;          /* circle pattern for a glyph     */
+   const char *bitmap;          /* start of a glyph's bitmap      */
+   size_t ndigits;              /* digits in the circled glyph    */
+   size_t start;                /* bytes before the bitmap        */
+   int    loc = 0;              /* code point                     */
+   int    offset = 0;           /* offset of a combining character */
+   int    digit;
+   unsigned long i;
+   size_t j;
+   char  *text;
+   char   buf[16];
+
+   flag     = calloc (MAXCODE, 1);
+   x_offset = calloc (MAXCODE, 1);
+   if (flag == NULL || x_offset == NULL) {
+      fprintf (stderr, "unifont-build: out of memory.\n");
+      exit (EXIT_FAILURE);
+   }
+
+   for (i = 0; i < combining->n; i++) {
+      j = combining->line[i].len < 15 ? combining->line[i].len : 15;
+      memcpy (buf, combining->line[i].text, j);
+      buf[j] = '\0';
+      if (sscanf (buf, "%X:%d", &loc, &offset) >= 1 &&
+          loc >= 0 && loc < MAXCODE && loc != 0x01107F && loc != 0x01D1A0) {
+         flag    [loc] = 1;
+         x_offset[loc] = offset;
+      }
+   }
+   for (i = 0; i < nonprinting->n; i++) {
+      j = key_length (&nonprinting->line[i]);
+      memcpy (buf, nonprinting->line[i].text, j < 15 ? j : 15);
+      buf[j < 15 ? j : 15] = '\0';
+      if (sscanf (buf, "%X", &loc) == 1 && loc >= 0 && loc < MAXCODE)
+         flag[loc] = 0;
+   }
+
+   for (i = 0; i < lines->n; i++) {
+      start = key_length (&lines->line[i]) + 1;
+      if (start > lines->line[i].len)
+         continue;
+      memcpy (buf, lines->line[i].text, start < 15 ? start : 15);
+      buf[start < 15 ? start : 15] = '\0';
+      if (sscanf (buf, "%X", &loc) != 1 || loc < 0 || loc >= MAXCODE ||
+          !flag[loc])
+         continue;
+      bitmap = lines->line[i].text + start;
+      if (lines->line[i].len - start < 34) {
+         ndigits = 32;
+         circle  = single;
+      }
+      else {
+         ndigits = 64;
+         circle  = x_offset[loc] >= -8 ? left : center;
+      }
+      if (lines->line[i].len - start < ndigits)
+         continue;
+      text = copy_text (lines->line[i].text, start + ndigits);
+      for (j = 0; j < ndigits; j++) {
+         digit = bitmap[j] <= '9' ? bitmap[j] - '0'
+                                  : (bitmap[j] & ~0x20) - 'A' + 0xA;
+         text[start + j] = hexdigit[(digit | (circle[j] - '0')) & 0xF];
+      }
+      lines->line[i].text = text;
+      lines->line[i].len  = start + ndigits;
+   }
+   free (flag);
+   free (x_offset);
+}
+
+
+/**
+   @brief Build the lists that several output files are made from.
+*/
+void
+build_shared (void)
+{
+   struct Lines upper;          /* CSUR glyphs above Plane 0 */
+   int i;
+
+   for (i = 0; i < nunifiles; i++)
+      add_file (&unifont, unifiles[i]);
+   sort_lines (&unifont);
+
+   add_list (&zh_plane02, zh_plane2_files);
+   add_list (&zh_plane02, jp_plane2_files);
+   sort_unique_keys (&zh_plane02);
+   add_list (&jp_plane02, jp_plane2_files);
+   add_list (&jp_plane02, zh_plane2_files);
+   sort_unique_keys (&jp_plane02);
+
+   add_list (&plane0E, plane0E_files);
+   sort_lines (&plane0E);
+
+   add_list (&upper_combining, upper_combining_files);
+   sort_lines (&upper_combining);
+   add_list (&upper_nonprint, upper_nonprint_files);
+   sort_lines (&upper_nonprint);
+
+   add_list (&csur, csur_files);
+   sort_lines (&csur);
+   prefix_lines (&csur, "00");
+   memset (&upper, 0, sizeof (upper));
+   add_list (&upper, upper_csur_files);
+   sort_lines (&upper);
+   drop_lines (&upper, "0020:");
+   add_lines (&csur, &upper);
+   free (upper.line);
+
+   add_list (&csur_combining, csur_combining_files);
+   sort_lines (&csur_combining);
+   memset (&upper, 0, sizeof (upper));
+   add_list (&upper, upper_csur_comb_files);
+   sort_lines (&upper);
+   add_lines (&csur_combining, &upper);
+   free (upper.line);
+
+   memset (&upper, 0, sizeof (upper));
+   add_list (&upper, jp_plane0_files);
+   patch_lines (&jp_lower, &unifont, &upper);
+   free (upper.line);
+   sort_lines (&jp_lower);
+
+   /*
+      Read the remaining inputs now so that no child reads them again.
+      The list only holds lines that point into the files read.
+   */
+   memset (&upper, 0, sizeof (upper));
+   add_list (&upper, sample_files);
+   add_list (&upper, combining_files);
+   add_list (&upper, nonprinting_files);
+   add_list (&upper, plane1_files);
+   add_list (&upper, zh_plane3_files);
+   add_list (&upper, upper_hex_files);
+   free (upper.line);
+}
+
+
+/**
+   @brief Write a list of lines to a file.
+
+   @param[in] fp The output file.
+   @param[in] lines The list.
+*/
+void
+put_lines (FILE *fp, const struct Lines *lines)
+{
+   unsigned long i;
+
+   for (i = 0; i < lines->n; i++) {
+      fwrite (lines->line[i].text, 1, lines->line[i].len, fp);
+      putc ('\n', fp);
+   }
+}
+
+
+/**
+   @brief Copy files' contents unchanged to a file, as "cat" does.
+
+   @param[in] fp The output file.
+   @param[in] files The null terminated list of input file names.
+*/
+void
+put_files (FILE *fp, char **files)
+{
+   struct Input *input;
+
+   for (; *files != NULL; files++) {
+      input = read_file (*files);
+      fwrite (input->text, 1, input->len, fp);
+   }
+}
+
+
+/**
+   @brief Build and write one output file.
+
+   The output files are numbered in the order the earlier hex-stamp
+   recipe wrote them.
+
+   @param[in] output The output file number, from 0 to NOUTPUTS - 1.
+*/
+void
+write_output (int output)
+{
+   static const char *names[NOUTPUTS] = {
+      "unifont-%s.hex",              "unifont_sample-%s.hex",
+      "unifont_zh-plane02.hex",      "unifont_jp-plane02.hex",
+      "upper_combining.txt",         "upper_nonprinting.hex",
+      "unifont_upper_sample-%s.hex", "unifont_csur_lower-%s.hex",
+      "unifont_csur-%s.hex",         "csur_combining.txt",
+      "unifont_csur_sample-%s.hex",  "unifont_jp-%s.hex",
+      "unifont_jp_sample-%s.hex",    "unifont-plane0E.hex",
+      "unifont_upper-%s.hex"
+   };
+   struct Lines lines;          /* lines being built for the file */
+   struct Lines nonprinting;    /* nonprinting glyphs for circles  */
+   struct Lines combining;      /* combining characters for circles */
+   char  *filename;
+   FILE  *fp;
+
+   filename = malloc (strlen (outdir) + strlen (names[output]) +
+                      strlen (version) + 2);
+   if (filename == NULL) {
+      fprintf (stderr, "unifont-build: out of memory.\n");
+      exit (EXIT_FAILURE);
+   }
+   sprintf (filename, "%s/", outdir);
+   sprintf (filename + strlen (filename), names[output], version);
+   if ((fp = fopen (filename, "w")) == NULL) {
+      fprintf (stderr, "unifont-build: can't open %s for output.\n",
+               filename);
+      exit (EXIT_FAILURE);
+   }
+   memset (&lines, 0, sizeof (lines));
+   memset (&nonprinting, 0, sizeof (nonprinting));
+   memset (&combining, 0, sizeof (combining));
+
+   switch (output) {
+      case 0:
+         put_lines (fp, &unifont);
+         break;
+      case 1:
+         add_list (&lines, sample_files);
+         sort_lines (&lines);
+         drop_lines (&lines, "FFF[EF]");
+         drop_lines (&lines, "01F12F:");
+         add_list (&nonprinting, nonprinting_files);
+         add_list (&combining, combining_files);
+         add_circles (&lines, &combining, &nonprinting);
+         put_lines (fp, &lines);
+         break;
+      case 2:
+         put_lines (fp, &zh_plane02);
+         break;
+      case 3:
+         put_lines (fp, &jp_plane02);
+         break;
+      case 4:
+         put_lines (fp, &upper_combining);
+         break;
+      case 5:
+         put_lines (fp, &upper_nonprint);
+         break;
+      case 6:
+         add_list  (&lines, plane1_files);
+         add_lines (&lines, &zh_plane02);
+         add_list  (&lines, upper_hex_files);
+         sort_lines (&lines);
+         drop_lines (&lines, "0020:");
+         drop_lines (&lines, "..FFF[EF]");
+         add_circles (&lines, &upper_combining, &upper_nonprint);
+         put_lines (fp, &lines);
+         break;
+      case 7:
+         add_list  (&lines, csur_files);
+         drop_lines (&lines, "0020:");
+         add_lines (&lines, &unifont);
+         sort_lines (&lines);
+         put_lines (fp, &lines);
+         break;
+      case 8:
+         put_lines (fp, &csur);
+         break;
+      case 9:
+         put_lines (fp, &csur_combining);
+         break;
+      case 10:
+         add_lines (&lines, &csur);
+         add_list (&nonprinting, nonprinting_files);
+         add_circles (&lines, &csur_combining, &nonprinting);
+         put_lines (fp, &lines);
+         break;
+      case 11:
+         /*
+            The earlier recipe's "grep -v ... | >> unifont_jp" wrote
+            none of Plane 1 to this file, so none is written here.
+         */
+         put_lines (fp, &jp_lower);
+         put_lines (fp, &jp_plane02);
+         put_files (fp, zh_plane3_files);
+         put_lines (fp, &plane0E);
+         break;
+      case 12:
+         add_lines (&lines, &jp_lower);
+         add_list (&nonprinting, nonprinting_files);
+         add_list (&combining, combining_files);
+         add_circles (&lines, &combining, &nonprinting);
+         put_lines (fp, &lines);
+         break;
+      case 13:
+         put_lines (fp, &plane0E);
+         break;
+      case 14:
+         put_files (fp, plane1_files);
+         put_lines (fp, &zh_plane02);
+         put_files (fp, zh_plane3_files);
+         put_lines (fp, &plane0E);
+         break;
+   }
+
+   if (ferror (fp) || fclose (fp) != 0) {
+      fprintf (stderr, "unifont-build: can't write %s.\n", filename);
+      exit (EXIT_FAILURE);
+   }
+   free (lines.line);
+   free (nonprinting.line);
+   free (combining.line);
+   free (filename);
+}
@@ -14,8 +14,11 @@
    Unifont hex representation.
 
    This program creates files of the form "U+<codepoint>.bmp", 1 per glyph.
+   The glyphs can also be written as PBM or PNG files, and all of them
+   can be written into one tar archive instead of a directory.
 
-   Synopsis: unifont1per < unifont.hex
+   Synopsis: unifont1per [-fbmp|-fpbm|-fpng] [-o<dir>|-o<file>.tar|-o-]
+                < unifont.hex
 */
 /*
    LICENSE:
@@ -39,6 +42,8 @@
       cd my-bmp
       unifont1per < ../glyphs.hex
 
+      unifont1per -fpng -oglyphs.tar < glyphs.hex
+
 */
 
 /*
@@ -52,28 +57,295 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 /** Maximum size of an input line in a Unifont .hex file - 1. */
 #define MAXSTRING 266
 
-/** Maximum size of a filename of the form "U+%06X.bmp". */
+/**
+   Maximum size of a filename of the form "U+%06X.bmp".  A code point
+   above U+FFFFFF has more than six digits, so leave room for eight.
+*/
 #define MAXFILENAME 20
 
+/** Largest output image: a 32 pixel wide PNG, or BMP, file. */
+#define MAXIMAGE 256
+
+/** Value of hexadecimal digit c; c must be one of 0-9, A-F, or a-f. */
+#define HEXVAL(c) ((c) <= '9' ? (c) - '0' : ((c) & 0x7) + 9)
+
+#define FORMAT_BMP 0   ///< Write Microsoft Windows Bitmap files.
+#define FORMAT_PBM 1   ///< Write Portable Bitmap files.
+#define FORMAT_PNG 2   ///< Write Portable Network Graphics files.
+
+
+/**
+   @brief Where the glyph image files go.
+*/
+struct Output {
+   int dirfd;      ///< The output directory, or -1 if writing a tar file.
+   FILE *tarfp;    ///< The tar file, or NULL if writing to a directory.
+   long mtime;     ///< Modification time of each file in the tar file.
+};
+
 
 /**
    @brief The main function.
 
-   @return This program exits with status EXIT_SUCCESS.
+   @param[in] argc The count of command line arguments.
+   @param[in] argv Pointer to array of command line arguments.
+   @return This program exits with status EXIT_SUCCESS, or EXIT_FAILURE
+           if an output file could not be written.
+*/
+int
+main (int argc, char *argv[]) {
+
+   int i, j; /* loop variables */
+
+   char instring[MAXSTRING]; /* input string                        */
+   unsigned long code_point; /* current Unicode code point          */
+   char *glyph;              /* bitmap string for this glyph        */
+   int  glyph_height=16;     /* for now, fixed at 16 pixels high    */
+   int  glyph_width;         /* 8, 16, 24, or 32 pixels wide        */
+   int  ndigits;             /* hexadecimal digits in glyph         */
+   unsigned char rows[16][4];/* the glyph bitmap, 1 = black         */
+   char filename[MAXFILENAME];/* name of current output file        */
+   unsigned char image[MAXIMAGE]; /* the current output file        */
+   int  image_size;          /* bytes in image[]                    */
+
+   int format = FORMAT_BMP;  /* output file format                  */
+   char *outname = ".";      /* output directory or tar file        */
+   char *extension = "bmp";  /* output file name extension          */
+   struct Output out;        /* where the output files go           */
+   int failed = 0;           /* 1 if an output file was not written */
+   size_t len;
+
+   int make_bmp (unsigned char rows[16][4], int width, unsigned char *image);
+   int make_pbm (unsigned char rows[16][4], int width, unsigned char *image);
+   int make_png (unsigned char rows[16][4], int width, unsigned char *image);
+   int put_file (struct Output *out, const char *name,
+                 const unsigned char *data, int size);
+
+   for (i = 1; i < argc; i++) {
+      if (argv[i][0] == '-' && argv[i][1] == 'f') {  /* output file format */
+         if (strcmp (&argv[i][2], "bmp") == 0) {
+            format = FORMAT_BMP;
+            extension = "bmp";
+         }
+         else if (strcmp (&argv[i][2], "pbm") == 0) {
+            format = FORMAT_PBM;
+            extension = "pbm";
+         }
+#ifdef HAVE_ZLIB
+         else if (strcmp (&argv[i][2], "png") == 0) {
+            format = FORMAT_PNG;
+            extension = "png";
+         }
+#endif
+         else {
+            fprintf (stderr, "unifont1per: unknown format \"%s\".\n",
+                     &argv[i][2]);
+            exit (EXIT_FAILURE);
+         }
+      }
+      else if (argv[i][0] == '-' && argv[i][1] == 'o') {  /* output */
+         outname = &argv[i][2];
+      }
+      else {
+         fprintf (stderr, "\nSyntax:\n\n");
+         fprintf (stderr, "   unifont1per [-fbmp|-fpbm");
+#ifdef HAVE_ZLIB
+         fprintf (stderr, "|-fpng");
+#endif
+         fprintf (stderr, "] [-o<dir>|-o<file>.tar|-o-] < unifont.hex\n\n");
+         exit (EXIT_FAILURE);
+      }
+   }
+
+   /*
+      Open the output: a tar file if its name ends in ".tar" or is "-",
+      for stdout, and otherwise a directory, which is made if need be.
+   */
+   len = strlen (outname);
+   out.mtime = (long)time (NULL);
+   if (strcmp (outname, "-") == 0 ||
+       (len > 4 && strcmp (&outname[len - 4], ".tar") == 0)) {
+      out.dirfd = -1;
+      out.tarfp = strcmp (outname, "-") == 0 ? stdout : fopen (outname, "wb");
+      if (out.tarfp == NULL) {
+         fprintf (stderr, "unifont1per: can't open %s for output.\n",
+                  outname);
+         exit (EXIT_FAILURE);
+      }
+      setvbuf (out.tarfp, NULL, _IOFBF, 1 << 16);
+   }
+   else {
+      out.tarfp = NULL;
+      if (mkdir (outname, 0777) != 0 && errno != EEXIST) {
+         fprintf (stderr, "unifont1per: can't make directory %s.\n",
+                  outname);
+         exit (EXIT_FAILURE);
+      }
+      if ((out.dirfd = open (outname, O_RDONLY | O_DIRECTORY)) < 0) {
+         fprintf (stderr, "unifont1per: can't open directory %s.\n",
+                  outname);
+         exit (EXIT_FAILURE);
+      }
+   }
+
+   /* Repeat for each line in the input stream */
+   while (fgets (instring, MAXSTRING - 1, stdin) != NULL) {
+      /* Read next Unifont ASCII hexadecimal format glyph description */
+      code_point = strtoul (instring, &glyph, 16);
+      if (glyph == instring || *glyph != ':')
+         continue;  /* not a glyph line */
+      glyph++;
+      for (ndigits = 0; isxdigit ((unsigned char)glyph[ndigits]); ndigits++);
+      /* Calculate width of a glyph in pixels; 4 bits per ASCII hex digit */
+      glyph_width = ndigits / (glyph_height / 4);
+      if (ndigits % (2 * glyph_height) != 0 ||
+          glyph_width < 8 || glyph_width > 32) {
+         fprintf (stderr, "unifont1per: skipping U+%04lX, ", code_point);
+         fprintf (stderr, "which is not 8, 16, 24, or 32 pixels wide.\n");
+         continue;
+      }
+      if (snprintf (filename, MAXFILENAME, "U+%06lX.%s",
+                    code_point, extension) >= MAXFILENAME) {
+         fprintf (stderr, "unifont1per: skipping U+%lX, ", code_point);
+         fprintf (stderr, "whose code point is too long.\n");
+         continue;
+      }
+
+      /* Decode the glyph, one byte per pair of hexadecimal digits */
+      for (i = 0; i < glyph_height; i++) {
+         for (j = 0; j < glyph_width / 8; j++) {
+            rows[i][j] = (HEXVAL (glyph[0]) << 4) | HEXVAL (glyph[1]);
+            glyph += 2;
+         }
+         for ( ; j < 4; j++)
+            rows[i][j] = 0x00;
+      }
+
+      if (format == FORMAT_PBM)
+         image_size = make_pbm (rows, glyph_width, image);
+      else if (format == FORMAT_PNG)
+         image_size = make_png (rows, glyph_width, image);
+      else
+         image_size = make_bmp (rows, glyph_width, image);
+
+      if (image_size < 0 || put_file (&out, filename, image, image_size) != 0) {
+         fprintf (stderr, "unifont1per: can't write %s.\n", filename);
+         failed = 1;
+      }
+   }
+
+   /*
+      A tar file ends with two empty 512 byte records.
+   */
+   if (out.tarfp != NULL) {
+      for (i = 0; i < 2 * 512; i++)
+         fputc (0x00, out.tarfp);
+      if (fclose (out.tarfp) != 0) {
+         fprintf (stderr, "unifont1per: can't write %s.\n", outname);
+         failed = 1;
+      }
+   }
+   else {
+      close (out.dirfd);
+   }
+
+   exit (failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+
+/**
+   @brief Write one output file.
+
+   In a directory, the file is made with openat on the directory and
+   written with one write call.  In a tar file, it gets a 512 byte
+   header and is padded to a multiple of 512 bytes.
+
+   @param[in] out Where the output files go.
+   @param[in] name The file name.
+   @param[in] data The file contents.
+   @param[in] size The number of bytes in data.
+   @return 0 if the file was written, or 1 on error.
 */
 int
-main () {
+put_file (struct Output *out, const char *name, const unsigned char *data,
+          int size) {
 
-   int i; /* loop variable */
+   int fd;
+   int i;
+   unsigned char header[512]; /* tar file header for this file */
+   unsigned checksum;
+
+   if (out->tarfp == NULL) {
+      fd = openat (out->dirfd, name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+      if (fd < 0)
+         return 1;
+      if (write (fd, data, size) != size) {
+         close (fd);
+         return 1;
+      }
+      return close (fd) != 0;
+   }
+
+   /*
+      A POSIX ustar header.  The checksum is computed with its own
+      field filled with spaces.
+   */
+   memset (header, 0, 512);
+   strcpy ((char *)&header[0], name);                    /* name     */
+   sprintf ((char *)&header[100], "%07o", 0644);         /* mode     */
+   sprintf ((char *)&header[108], "%07o", 0);            /* uid      */
+   sprintf ((char *)&header[116], "%07o", 0);            /* gid      */
+   sprintf ((char *)&header[124], "%011o", size);        /* size     */
+   sprintf ((char *)&header[136], "%011lo", out->mtime); /* mtime    */
+   memset (&header[148], ' ', 8);                        /* checksum */
+   header[156] = '0';                                    /* typeflag */
+   memcpy (&header[257], "ustar", 6);                    /* magic    */
+   memcpy (&header[263], "00", 2);                       /* version  */
+   checksum = 0;
+   for (i = 0; i < 512; i++)
+      checksum += header[i];
+   sprintf ((char *)&header[148], "%06o", checksum);
+
+   fwrite (header, 1, 512, out->tarfp);
+   fwrite (data, 1, size, out->tarfp);
+   memset (header, 0, 512);
+   fwrite (header, 1, (512 - size % 512) % 512, out->tarfp);
+
+   return ferror (out->tarfp) != 0;
+}
+
+
+/**
+   @brief Make a Microsoft Windows Bitmap (.bmp) file of a glyph.
+
+   @param[in] rows The glyph bitmap, 4 bytes per row.
+   @param[in] width The glyph width in pixels.
+   @param[out] image The .bmp file contents.
+   @return The number of bytes in image.
+*/
+int
+make_bmp (unsigned char rows[16][4], int width, unsigned char *image) {
+
+   int glyph_height=16;     /* for now, fixed at 16 pixels high    */
 
    /*
       Define bitmap header bytes
    */
-   unsigned char header [62] = {
+   static unsigned char header [62] = {
       /*
          Bitmap File Header -- 14 bytes
       */
@@ -107,69 +379,131 @@ main () {
          0,    0,    0, 0   /* Black */
    };
 
-   char instring[MAXSTRING]; /* input string                        */
-   int  code_point;          /* current Unicode code point          */
-   char glyph[MAXSTRING];    /* bitmap string for this glyph        */
-   int  glyph_height=16;     /* for now, fixed at 16 pixels high    */
-   int  glyph_width;         /* 8, 16, 24, or 32 pixels wide        */
-   char filename[MAXFILENAME];/* name of current output file        */
-   FILE *outfp;              /* file pointer to current output file */
+   header [18] =  width;         /* bitmap width */
+   header [22] = -glyph_height;  /* negative height --> draw top to bottom */
+   memcpy (image, header, 62);
+   /*
+      Bitmap, with each row padded with zeroes if necessary
+      so each row is four bytes wide.  (Each row must end
+      on a four-byte boundary, and four bytes is the maximum
+      possible row length for up to 32 pixels in a row.)
+   */
+   memcpy (&image[62], rows, 4 * glyph_height);
 
-   int string_index;  /* pointer into hexadecimal glyph string */
-   int nextbyte;      /* next set of 8 bits to print out       */
+   return 62 + 4 * glyph_height;
+}
 
-   /* Repeat for each line in the input stream */
-   while (fgets (instring, MAXSTRING - 1, stdin) != NULL) {
-      /* Read next Unifont ASCII hexadecimal format glyph description */
-      sscanf (instring, "%X:%s", &code_point, glyph);
-      /* Calculate width of a glyph in pixels; 4 bits per ASCII hex digit */
-      glyph_width = strlen (glyph) / (glyph_height / 4);
-      snprintf (filename, MAXFILENAME, "U+%06X.bmp", code_point);
-      header [18] =  glyph_width;  /* bitmap width */
-      header [22] = -glyph_height; /* negative height --> draw top to bottom */
-      if ((outfp = fopen (filename, "w")) != NULL) {
-         for (i = 0; i < 62; i++) fputc (header[i], outfp);
-         /*
-            Bitmap, with each row padded with zeroes if necessary
-            so each row is four bytes wide.  (Each row must end
-            on a four-byte boundary, and four bytes is the maximum
-            possible row length for up to 32 pixels in a row.)
-         */
-         string_index = 0;
-         for (i = 0; i < glyph_height; i++) {
-            /* Read 2 ASCII hexadecimal digits (1 byte of output pixels) */
-            sscanf (&glyph[string_index], "%2X", &nextbyte);
-            string_index += 2;
-            fputc (nextbyte, outfp);  /* write out the 8 pixels    */
-            if (glyph_width <= 8) {   /* pad row with 3 zero bytes */
-               fputc (0x00, outfp); fputc (0x00, outfp); fputc (0x00, outfp);
-            }
-            else { /* get 8 more pixels */
-               sscanf (&glyph[string_index], "%2X", &nextbyte);
-               string_index += 2;
-               fputc (nextbyte, outfp);  /* write out the 8 pixels    */
-               if (glyph_width <= 16) {  /* pad row with 2 zero bytes */
-                  fputc (0x00, outfp); fputc (0x00, outfp);
-               }
-               else { /* get 8 more pixels */
-                  sscanf (&glyph[string_index], "%2X", &nextbyte);
-                  string_index += 2;
-                  fputc (nextbyte, outfp);  /* write out the 8 pixels   */
-                  if (glyph_width <= 24) {  /* pad row with 1 zero byte */
-                     fputc (0x00, outfp);
-                  }
-                  else { /* get 8 more pixels */
-                     sscanf (&glyph[string_index], "%2X", &nextbyte);
-                     string_index += 2;
-                     fputc (nextbyte, outfp); /* write out the 8 pixels */
-                  }  /* glyph is 32 pixels wide */
-               }  /* glyph is 24 pixels wide */
-            }  /* glyph is 16 pixels wide */
-         }  /* glyph is 8 pixels wide */
-
-         fclose (outfp);
-      }
+
+/**
+   @brief Make a binary Portable Bitmap (.pbm) file of a glyph.
+
+   @param[in] rows The glyph bitmap, 4 bytes per row.
+   @param[in] width The glyph width in pixels.
+   @param[out] image The .pbm file contents.
+   @return The number of bytes in image.
+*/
+int
+make_pbm (unsigned char rows[16][4], int width, unsigned char *image) {
+
+   int i;
+   int size;
+
+   size = sprintf ((char *)image, "P4\n%d %d\n", width, 16);
+   for (i = 0; i < 16; i++) {
+      memcpy (&image[size], rows[i], width / 8);
+      size += width / 8;
+   }
+
+   return size;
+}
+
+
+#ifdef HAVE_ZLIB
+/**
+   @brief Add one PNG chunk to a PNG file being made in memory.
+
+   @param[out] out Where the chunk goes.
+   @param[in] type The 4-letter chunk type.
+   @param[in] data The chunk data.
+   @param[in] len The number of bytes of data.
+   @return The number of bytes in the chunk.
+*/
+int
+png_chunk (unsigned char *out, const char *type, const unsigned char *data,
+           int len) {
+
+   unsigned long crc;
+
+   out[0] = (len >> 24) & 0xFF;
+   out[1] = (len >> 16) & 0xFF;
+   out[2] = (len >>  8) & 0xFF;
+   out[3] =  len        & 0xFF;
+   memcpy (&out[4], type, 4);
+   if (len > 0)
+      memcpy (&out[8], data, len);
+   crc = crc32 (0L, &out[4], 4 + len);
+   out[8 + len]  = (crc >> 24) & 0xFF;
+   out[9 + len]  = (crc >> 16) & 0xFF;
+   out[10 + len] = (crc >>  8) & 0xFF;
+   out[11 + len] =  crc        & 0xFF;
+
+   return 12 + len;
+}
+
+
+/**
+   @brief Make a Portable Network Graphics (.png) file of a glyph.
+
+   The image is a 1 bit grayscale image, so black pixels are 0 bits.
+
+   @param[in] rows The glyph bitmap, 4 bytes per row.
+   @param[in] width The glyph width in pixels.
+   @param[out] image The .png file contents.
+   @return The number of bytes in image, or -1 on error.
+*/
+int
+make_png (unsigned char rows[16][4], int width, unsigned char *image) {
+
+   int i, j;
+   unsigned char ihdr[13];          /* IHDR chunk data               */
+   unsigned char raw[16 * (1 + 4)]; /* filter byte and pixels per row */
+   unsigned char idat[MAXIMAGE];    /* compressed raw[]              */
+   uLongf idat_size;
+   int size;
+   int linebytes;
+
+   linebytes = 1 + width / 8;
+   for (i = 0; i < 16; i++) {
+      raw[i * linebytes] = 0;  /* no filter */
+      for (j = 0; j < width / 8; j++)
+         raw[i * linebytes + 1 + j] = ~rows[i][j];
    }
+   idat_size = sizeof (idat);
+   if (compress2 (idat, &idat_size, raw, 16 * linebytes,
+                  Z_BEST_COMPRESSION) != Z_OK)
+      return -1;
 
-   exit (EXIT_SUCCESS);
+   memcpy (ihdr, "\0\0\0\0\0\0\0\020\001\0\0\0\0", 13);
+   ihdr[3] = width;  /* width, most significant byte first; height is 16 */
+
+   memcpy (image, "\211PNG\r\n\032\n", 8);
+   size = 8;
+   size += png_chunk (&image[size], "IHDR", ihdr, 13);
+   if (size + 12 + idat_size + 12 > MAXIMAGE)
+      return -1;
+   size += png_chunk (&image[size], "IDAT", idat, idat_size);
+   size += png_chunk (&image[size], "IEND", NULL, 0);
+
+   return size;
+}
+#else
+/**
+   @brief Make a PNG file of a glyph; not available without zlib.
+
+   @return Always returns -1.
+*/
+int
+make_png (unsigned char rows[16][4], int width, unsigned char *image) {
+   return -1;
 }
+#endif
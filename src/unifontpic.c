@@ -7,6 +7,22 @@
    @author Paul Hardy, 2013
 
    @copyright Copyright (C) 2013, 2017 Paul Hardy
+
+   The glyphs are read from stdin or from the file given with -i,
+   either as a .hex file or as a binary glyph store made by hex2ufb.
+   If a .hex file named with -i has an up to date .hexidx index from
+   hexindex, only the lines of the plane being drawn are read.
+   A .hex input file can be gzip or zstd compressed.
+
+   The chart is drawn one band of 16 pixel rows at a time, and
+   written as a monochrome BMP file or, with -p, a PNG file.
+
+   With a list of planes given with -P, or -Pall, the input is read
+   once and the glyphs of each plane are kept apart; the charts are
+   then drawn at the same time in child processes.
+
+   With -z, each chart is written as a deep zoom tile pyramid of PNG
+   tiles, for viewing with OpenSeadragon or another Deep Zoom viewer.
 */
 /*
    LICENSE:
@@ -67,7 +83,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 #include "unifontpic.h"
+#include "ufb.h"
+#include "hexidx.h"
+#include "unizio.h"
 
 /** Define length of header string for top of chart. */
 #define HDR_LEN 33
@@ -87,7 +114,7 @@
 
    @param[in] argc The count of command line arguments.
    @param[in] argv Pointer to array of command line arguments.
-   @return This program exits with status EXIT_SUCCESS.
+   @return This program exits with status EXIT_SUCCESS or EXIT_FAILURE.
 */
 int
 main (int argc, char **argv)
@@ -99,18 +126,43 @@ main (int argc, char **argv)
    int wide=1; /* =1 for a 256x256 grid, =0 for a 16x4096 grid */
    int dpi=96; /* change for 256x256 grid to fit paper if desired */
    int tinynum=0; /* whether to use tiny labels for 256x256 grid */
+   int png=0;  /* =1 to write a PNG file instead of a BMP file */
+   int tiles=0; /* =1 to write a deep zoom tile pyramid */
 
    int i, j; /* loop variables */
 
    int plane=0;      /* Unicode plane, 0..17; Plane 0 is default */
-   /* 16 pixel rows for each of 65,536 glyphs in a Unicode plane */
-   int plane_array[0x10000][16];
-
-   void gethex     (char *instring, int plane_array[0x10000][16], int plane);
-   void genlongbmp (int plane_array[0x10000][16], int dpi, int tinynum,
-                    int plane);
-   void genwidebmp (int plane_array[0x10000][16], int dpi, int tinynum,
-                    int plane);
+   int allplanes=0;  /* =1 to draw every plane that has glyphs */
+   int nplanes=0;    /* number of planes to draw */
+   char *planelist;  /* current plane number in the -P list */
+   char *infile=NULL; /* input file name; NULL for stdin */
+   char *outfile=NULL; /* output file name; NULL for stdout */
+   int jobs;         /* most charts drawn at once */
+   int running=0;    /* charts being drawn in child processes */
+   int stripe;       /* tile pyramid stripe, or -1 for a whole chart */
+   int nstripes;     /* number of stripes in a tile pyramid */
+   char outname[MAXSTRING]; /* output file name for a plane */
+   int failed=0;     /* whether drawing any chart failed */
+   int status;       /* exit status of a child process */
+   pid_t pid;        /* child process id */
+   FILE *infp;       /* input file pointer */
+   struct Ufb *ufb;  /* input, if it is a .ufb file */
+   long endpos;      /* where the plane ends, if indexed; or -1 */
+   unsigned long codept; /* first glyph of a plane in a .ufb file */
+   unsigned short rows[16]; /* one glyph's pixel rows */
+   static struct Chart charts[18]; /* a chart for each plane */
+
+   void gethex     (char *instring, struct Chart charts[18]);
+   int  hex2rows   (char *bitstring, unsigned short rows[16]);
+   void init_chart (struct Chart *chart);
+   void plane_name (char *outfile, int plane, char *outname);
+   int  start_tiles (struct Chart *chart, char *name);
+   int  tile_stripes (struct Chart *chart);
+   int  draw_chart (struct Chart *chart, char *outfile, int png, int stripe);
+   void usage      (void);
+
+   jobs = (int)sysconf (_SC_NPROCESSORS_ONLN);
+   if (jobs < 1) jobs = 1;
 
    if (argc > 1) {
       for (i = 1; i < argc; i++) {
@@ -120,27 +172,77 @@ main (int argc, char **argv)
          else if (strncmp (argv[i],"-d",2) == 0) {
             dpi = atoi (&argv[i][2]); /* dots/inch specified on command line */
          }
+         else if (strncmp (argv[i],"-i",2) == 0) {
+            infile = &argv[i][2]; /* input file instead of stdin */
+            if (*infile == '\0') {
+               fprintf (stderr, "ERROR: -i needs an attached argument, "
+                                "as in -ifont.hex.\n\n");
+               usage ();
+            }
+         }
+         else if (strncmp (argv[i],"-o",2) == 0) {
+            outfile = &argv[i][2]; /* output file instead of stdout */
+            if (*outfile == '\0') {
+               fprintf (stderr, "ERROR: -o needs an attached argument, "
+                                "as in -ofont.bmp.\n\n");
+               usage ();
+            }
+         }
+         else if (strncmp (argv[i],"-j",2) == 0) {
+            jobs = atoi (&argv[i][2]); /* most charts drawn at once */
+            if (jobs < 1) jobs = 1;
+         }
          else if (strncmp (argv[i],"-t",2) == 0) {
             tinynum = 1;
          }
+         else if (strncmp (argv[i],"-p",2) == 0) {
+            png = 1;
+         }
+         else if (strncmp (argv[i],"-z",2) == 0) {
+            tiles = 1;
+         }
+         else if (strcmp (argv[i],"-Pall") == 0) {
+            allplanes = 1;
+         }
          else if (strncmp (argv[i],"-P",2) == 0) {
-            /* Get Unicode plane */
+            /* Get Unicode planes, as a comma-separated list */
+            planelist = &argv[i][2];
             for (j = 2; argv[i][j] != '\0'; j++) {
-               if (argv[i][j] < '0' || argv[i][j] > '9') {
+               if ((argv[i][j] < '0' || argv[i][j] > '9') &&
+                   (argv[i][j] != ',' || argv[i][j + 1] == '\0')) {
                   fprintf (stderr,
                            "ERROR: Specify Unicode plane as decimal number.\n\n");
                   exit (EXIT_FAILURE);
                }
             }
-            plane = atoi (&argv[i][2]); /* Unicode plane, 0..17 */
-            if (plane < 0 || plane > 17) {
-               fprintf (stderr,
-                        "ERROR: Plane out of Unicode range [0,17].\n\n");
-               exit (EXIT_FAILURE);
-            }
+            do {
+               plane = atoi (planelist); /* Unicode plane, 0..17 */
+               if (plane < 0 || plane > 17) {
+                  fprintf (stderr,
+                           "ERROR: Plane out of Unicode range [0,17].\n\n");
+                  exit (EXIT_FAILURE);
+               }
+               charts[plane].selected = 1;
+               planelist = strchr (planelist, ',');
+            } while (planelist++ != NULL);
+         }
+         else {
+            fprintf (stderr, "ERROR: unknown argument \"%s\".\n\n",
+                     argv[i]);
+            usage ();
          }
       }
    }
+#ifndef HAVE_ZLIB
+   if (png || tiles) {
+      fprintf (stderr, "ERROR: built without zlib; can't write PNG.\n\n");
+      exit (EXIT_FAILURE);
+   }
+#endif
+   if (tiles && outfile == NULL) {
+      fprintf (stderr, "ERROR: give the tile pyramid name with -o.\n\n");
+      exit (EXIT_FAILURE);
+   }
 
 
    /*
@@ -148,47 +250,245 @@ main (int argc, char **argv)
    */
    for (i = 0; i < 128; i++) {
       /* convert Unifont hexadecimal string to bitmap */
-      gethex ((char *)ascii_hex[i], plane_array, 0);
-      for (j = 0; j < 16; j++) ascii_bits[i][j] = plane_array[i][j];
+      hex2rows (strchr (ascii_hex[i], ':') + 1, rows);
+      for (j = 0; j < 16; j++) ascii_bits[i][j] = rows[j];
+   }
+
+   for (i = 0; i < 18; i++) {
+      if (allplanes) charts[i].selected = 1;
+      nplanes += charts[i].selected;
+      if (charts[i].selected) plane = i;
+      charts[i].plane   = i;
+      charts[i].wide    = wide;
+      charts[i].tinynum = tinynum;
+      charts[i].dpi     = dpi;
+   }
+   if (nplanes == 0) {  /* Plane 0 is the default */
+      charts[0].selected = 1;
+      nplanes = 1;
    }
 
 
    /*
-      Read in the Unifont hex file to render from standard input
+      Read in the Unifont hex file to render, sorting the glyphs of
+      each plane being drawn into that plane's chart.  A binary glyph
+      store from hex2ufb is not read in; its glyphs are taken from the
+      mapped file as they are drawn.  When drawing one plane, with a
+      .hexidx index, only the lines of that plane are read from a
+      .hex file.
    */
-   memset ((void *)plane_array, 0, 0x10000 * 16 * sizeof (int));
-   while (fgets (instring, MAXSTRING, stdin) != NULL) {
-      gethex (instring, plane_array, plane); /* read .hex input file and fill plane_array with glyph data */
-   }  /* while not EOF */
+   if (infile == NULL) {
+      infp = zio_wrap (stdin, "stdin");
+   }
+   else if ((infp = zio_open (infile, "r")) == NULL) {
+      fprintf (stderr, "ERROR: can't open %s for input.\n\n", infile);
+      exit (EXIT_FAILURE);
+   }
+   if ((ufb = ufb_fdopen (fileno (infp),
+                          infile == NULL ? "stdin" : infile)) != NULL) {
+      for (i = 0; i < 18; i++) {
+         charts[i].ufb = ufb;
+         codept = ufb_next (ufb, (unsigned long)i << 16);
+         if (codept < UFB_END && (codept >> 16) == i)
+            charts[i].nglyphs = 1;  /* at least one */
+      }
+   }
+   else {
+      endpos = -1;
+      if (infile != NULL && nplanes == 1 && !allplanes)
+         hexidx_seek (infp, infile, plane << 8, (plane << 8) | 0xFF, &endpos);
+      while ((endpos < 0 || ftell (infp) < endpos) &&
+             fgets (instring, MAXSTRING, infp) != NULL) {
+         gethex (instring, charts); /* read .hex input file and fill the glyph pools */
+      }  /* while not EOF */
+   }
+   if (infp != stdin) fclose (infp);
+
+   /* With -Pall, only draw the planes that have glyphs. */
+   if (allplanes) {
+      nplanes = 0;
+      for (i = 0; i < 18; i++) {
+         if (charts[i].nglyphs == 0) charts[i].selected = 0;
+         nplanes += charts[i].selected;
+      }
+   }
+   if (nplanes > 1 && (outfile == NULL || strstr (outfile, "%d") == NULL)) {
+      fprintf (stderr,
+               "ERROR: give an output file name with \"%%d\" for the plane\n"
+               "       number with -o to draw more than one plane.\n\n");
+      exit (EXIT_FAILURE);
+   }
 
 
    /*
-      Write plane_array glyph data to BMP file as wide or long bitmap.
+      Draw each chart as a wide or long bitmap, or as a tile pyramid
+      in stripes.  With more than one chart or stripe, each is drawn
+      in a child process, with at most "jobs" running at once.  The
+      children share the glyphs read above with this process.
    */
-   if (wide) {
-      genwidebmp (plane_array, dpi, tinynum, plane);
+   fflush (stdout);
+   fflush (stderr);
+   for (i = 0; i < 18; i++) {
+      if (!charts[i].selected)
+         continue;
+      nstripes = -1;
+      if (tiles) {
+         init_chart (&charts[i]);
+         plane_name (outfile, i, outname);
+         if (start_tiles (&charts[i], outname) != 0) {
+            failed = 1;
+            continue;
+         }
+         nstripes = tile_stripes (&charts[i]);
+      }
+      for (stripe = (tiles ? 0 : -1); stripe <= nstripes; stripe++) {
+         if ((nplanes == 1 && !tiles) || jobs == 1) {
+            failed |= draw_chart (&charts[i], outfile, png, stripe);
+            continue;
+         }
+         if (running == jobs) {
+            if (wait (&status) < 0 || !WIFEXITED (status) ||
+                WEXITSTATUS (status) != EXIT_SUCCESS)
+               failed = 1;
+            running--;
+         }
+         pid = fork ();
+         if (pid == 0) {
+            exit (draw_chart (&charts[i], outfile, png, stripe) ?
+                  EXIT_FAILURE : EXIT_SUCCESS);
+         }
+         else if (pid < 0)
+            failed |= draw_chart (&charts[i], outfile, png, stripe);
+         else
+            running++;
+      }
+   }
+   while (running > 0) {
+      if (wait (&status) < 0 || !WIFEXITED (status) ||
+          WEXITSTATUS (status) != EXIT_SUCCESS)
+         failed = 1;
+      running--;
+   }
+
+   exit (failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+
+/**
+   @brief Print the command line syntax and exit with failure.
+*/
+void
+usage (void)
+{
+   fprintf (stderr, "Syntax:\n\n");
+   fprintf (stderr, "   unifontpic [-dnnn] [-l] [-t] [-p | -z] ");
+   fprintf (stderr, "[-Pplane[,plane...] | -Pall] [-jjobs]\n");
+   fprintf (stderr, "              [-iinput-file] [-ooutput-file] ");
+   fprintf (stderr, "< input-font.hex > output-font.bmp\n\n");
+   fprintf (stderr, "Option arguments are attached, with no space: ");
+   fprintf (stderr, "-ochart.bmp, not -o chart.bmp.\n\n");
+   exit (EXIT_FAILURE);
+}
+
+
+/**
+   @brief Get the output file name for a plane.
+
+   @param[in] outfile The output file name, with "%d" standing for the
+              plane number.
+   @param[in] plane The plane.
+   @param[out] outname The output file name, MAXSTRING bytes long.
+*/
+void
+plane_name (char *outfile, int plane, char *outname)
+{
+   char *plane_at;           /* where "%d" is in outfile */
+
+   plane_at = strstr (outfile, "%d");
+   if (plane_at == NULL)
+      snprintf (outname, MAXSTRING, "%s", outfile);
+   else
+      snprintf (outname, MAXSTRING, "%.*s%d%s", (int)(plane_at - outfile),
+                outfile, plane, plane_at + 2);
+
+   return;
+}
+
+
+/**
+   @brief Draw a chart and write it to a file or to stdout.
+
+   @param[in] chart The chart, with its glyphs read in.
+   @param[in] outfile The output file name, with "%d" standing for the
+              plane number; or NULL for stdout.
+   @param[in] png 1 to write a PNG file, or 0 to write a BMP file.
+   @param[in] stripe The stripe of the chart's tile pyramid to draw,
+              or -1 to draw the whole chart as one image.
+   @return 0 on success, or 1 if the output could not be written.
+*/
+int
+draw_chart (struct Chart *chart, char *outfile, int png, int stripe)
+{
+   char outname[MAXSTRING];  /* output file name for this plane */
+   FILE *outfp;              /* output file pointer */
+   int failed;
+
+   void init_chart (struct Chart *chart);
+   void plane_name (char *outfile, int plane, char *outname);
+   void write_bmp  (struct Chart *chart, FILE *outfp);
+   void write_png  (struct Chart *chart, FILE *outfp);
+   void write_tiles_stripe (struct Chart *chart, char *name, int stripe);
+
+   if (stripe >= 0) {
+      init_chart (chart);
+      plane_name (outfile, chart->plane, outname);
+      write_tiles_stripe (chart, outname, stripe);
+      return 0;
+   }
+
+   if (outfile == NULL) {
+      outfp = stdout;
+      strcpy (outname, "stdout");
+   }
+   else {
+      plane_name (outfile, chart->plane, outname);
+      if ((outfp = fopen (outname, "wb")) == NULL) {
+         fprintf (stderr, "ERROR: can't open %s for output.\n\n", outname);
+         return 1;
+      }
+   }
+
+   init_chart (chart);
+   if (png) {
+      write_png (chart, outfp);
    }
    else {
-      genlongbmp (plane_array, dpi, tinynum, plane);
+      write_bmp (chart, outfp);
    }
+   failed = fflush (outfp) != 0 || ferror (outfp);
+   if (outfp != stdout && fclose (outfp) != 0)
+      failed = 1;
+   if (failed)
+      fprintf (stderr, "ERROR: can't write %s.\n\n", outname);
 
-   exit (EXIT_SUCCESS);
+   return failed;
 }
 
 
 /**
    @brief Output a 4-byte integer in little-endian order.
 
+   @param[in] outfp The output file.
    @param[in] thisword The 4-byte integer to output as binary data.
 */
 void
-output4 (int thisword)
+output4 (FILE *outfp, int thisword)
 {
 
-   putchar ( thisword        & 0xFF);
-   putchar ((thisword >>  8) & 0xFF);
-   putchar ((thisword >> 16) & 0xFF);
-   putchar ((thisword >> 24) & 0xFF);
+   putc ( thisword        & 0xFF, outfp);
+   putc ((thisword >>  8) & 0xFF, outfp);
+   putc ((thisword >> 16) & 0xFF, outfp);
+   putc ((thisword >> 24) & 0xFF, outfp);
 
    return;
 }
@@ -197,194 +497,350 @@ output4 (int thisword)
 /**
    @brief Output a 2-byte integer in little-endian order.
 
+   @param[in] outfp The output file.
    @param[in] thisword The 2-byte integer to output as binary data.
 */
 void
-output2 (int thisword)
+output2 (FILE *outfp, int thisword)
 {
 
-   putchar ( thisword       & 0xFF);
-   putchar ((thisword >> 8) & 0xFF);
+   putc ( thisword       & 0xFF, outfp);
+   putc ((thisword >> 8) & 0xFF, outfp);
+
+   return;
+}
+
+
+/**
+   @brief Convert a glyph's bitmap bytes to 16 rows of 16 pixels.
+
+   Each glyph can be 1, 2, 3, or 4 bytes wide.  Single-width glyphs
+   are left-justified; glyphs wider than double-width are compressed
+   horizontally by 50%.
+
+   @param[in] bits The glyph's bitmap, bytespl bytes per row.
+   @param[in] bytespl Bytes per row, 1 to 4.
+   @param[out] rows The 16 pixel rows.
+*/
+void
+pack_glyph (const unsigned char *bits, int bytespl, unsigned short rows[16])
+{
+   int i, k;               /* loop variables                     */
+   unsigned long temprow;  /* 1 row of the glyph, left-justified */
+   unsigned long newrow;   /* 1 row of double-width output pixels */
+   unsigned long bitmask;  /* to mask off 2 bits of long width glyph */
+
+   for (i = 0; i < 16; i++) { /* 16 rows per glyph */
+      temprow = 0;
+      for (k = 0; k < bytespl; k++)
+         temprow = (temprow << 8) | *bits++;
+      if (bytespl & 1) temprow <<= 8; /* left-justify 1 or 3 byte rows */
+      /* compress glyph width by 50% if greater than double-width */
+      if (bytespl > 2) {
+         newrow = 0x0000;
+         /* mask off 2 bits at a time to convert each pair to 1 bit out */
+         for (bitmask = 0xC0000000; bitmask != 0; bitmask >>= 2) {
+            newrow <<= 1;
+            if ((temprow & bitmask) != 0) newrow |= 1;
+         }
+         temprow = newrow;
+      }  /* done conditioning glyphs beyond double-width */
+      rows[i] = temprow;
+   }
 
    return;
 }
 
 
 /**
-   @brief Read a Unifont .hex-format input file from stdin.
+   @brief Convert the hexadecimal bitmap of a .hex line to pixel rows.
 
-   Each glyph can be 2, 4, 6, or 8 ASCII hexadecimal digits wide.
    Glyph height is fixed at 16 pixels.
 
+   @param[in] bitstring The bitmap, after the colon of a .hex line.
+   @param[out] rows The 16 pixel rows.
+   @return 1 if the glyph is 1 to 4 bytes wide, or 0 if not.
+*/
+int
+hex2rows (char *bitstring, unsigned short rows[16])
+{
+   unsigned char bits[64]; /* the bitmap as bytes                */
+   int ndigits; /* number of ASCII hexadecimal digits in glyph   */
+   int bytespl; /* bytes per line of pixels in a glyph           */
+   int i, n;
+
+   for (ndigits = 0; bitstring[ndigits] != '\0' &&
+                     bitstring[ndigits] != '\n'; ndigits++);
+   bytespl = ndigits >> 5;  /* 16 rows per line, 2 digits per byte */
+   if (bytespl < 1 || bytespl > 4)
+      return 0;
+
+   for (i = 0; i < 32 * bytespl; i++) {
+      n = bitstring[i];
+      n = (n <= '9') ? n - '0' : (n & ~0x20) - 'A' + 10;
+      if (i & 1)
+         bits[i >> 1] |= n & 0xF;
+      else
+         bits[i >> 1] = (n & 0xF) << 4;
+   }
+   pack_glyph (bits, bytespl, rows);
+
+   return 1;
+}
+
+
+/**
+   @brief Add one line of a Unifont .hex-format input file to its chart.
+
+   Glyphs in planes that are not being drawn are skipped.  The first
+   glyph in a page of 256 code points allocates that page in the
+   chart's glyph pool.
+
    @param[in] instring One line from a Unifont .hex-format file.
-   @param[in,out] plane_array Bitmap for this plane, one bitmap row per element.
-   @param[in] plane The Unicode plane, 0..17.
+   @param[in,out] charts The charts of each plane.
 */
 void
-gethex (char *instring, int plane_array[0x10000][16], int plane)
+gethex (char *instring, struct Chart charts[18])
 {
    char *bitstring;  /* pointer into instring for glyph bitmap */
-   int i;       /* loop variable                               */
-   int codept;  /* the Unicode code point of the current glyph */
-   int glyph_plane; /* Unicode plane of current glyph          */
-   int ndigits; /* number of ASCII hexadecimal digits in glyph */
-   int bytespl; /* bytes per line of pixels in a glyph         */
-   int temprow; /* 1 row of a quadruple-width glyph            */
-   int newrow;  /* 1 row of double-width output pixels         */
-   unsigned bitmask; /* to mask off 2 bits of long width glyph */
+   unsigned long codept;  /* the Unicode code point of the current glyph */
+   struct Chart *chart;      /* the chart of the glyph's plane */
+   unsigned short rows[16];  /* the glyph's pixel rows */
+   unsigned short **page;    /* the glyph's page in the pool */
 
    /*
-      Read each input line and place its glyph into the bit array.
+      Read each input line and place its glyph into the pool.
    */
-   sscanf (instring, "%X", &codept);
-   glyph_plane = codept >> 16;
-   if (glyph_plane == plane) {
-      codept &= 0xFFFF;  /* array index will only have 16 bit address */
-      /* find the colon separator */
-      for (i = 0; (i < 9) && (instring[i] != ':'); i++);
-      i++; /* position past it */
-      bitstring = &instring[i];
-      ndigits = strlen (bitstring);
-      /* don't count '\n' at end of line if present */
-      if (bitstring[ndigits - 1] == '\n') ndigits--;
-      bytespl = ndigits >> 5;  /* 16 rows per line, 2 digits per byte */
-
-      if (bytespl >= 1 && bytespl <= 4) {
-         for (i = 0; i < 16; i++) { /* 16 rows per glyph */
-            /* Read correct number of hexadecimal digits given glyph width */
-            switch (bytespl) {
-               case 1: sscanf (bitstring, "%2X", &temprow);
-                       bitstring += 2;
-                       temprow <<= 8; /* left-justify single-width glyph */
-                       break;
-               case 2: sscanf (bitstring, "%4X", &temprow);
-                       bitstring += 4;
-                       break;
-               /* cases 3 and 4 widths will be compressed by 50% (see below) */
-               case 3: sscanf (bitstring, "%6X", &temprow);
-                       bitstring += 6;
-                       temprow <<= 8; /* left-justify */
-                       break;
-               case 4: sscanf (bitstring, "%8X", &temprow);
-                       bitstring += 8;
-                       break;
-            }  /* switch on number of bytes per row */
-            /* compress glyph width by 50% if greater than double-width */
-            if (bytespl > 2) {
-               newrow = 0x0000;
-               /* mask off 2 bits at a time to convert each pair to 1 bit out */
-               for (bitmask = 0xC0000000; bitmask != 0; bitmask >>= 2) {
-                  newrow <<= 1;
-                  if ((temprow & bitmask) != 0) newrow |= 1;
-               }
-               temprow = newrow;
-            }  /* done conditioning glyphs beyond double-width */
-            plane_array[codept][i] = temprow;  /* store glyph bitmap for output */
-         }  /* for each row */
-      }  /* if 1 to 4 bytes per row/line */
-   }  /* if this is the plane we are seeking */
+   codept = strtoul (instring, &bitstring, 16);
+   if ((codept >> 16) >= 18 || !charts[codept >> 16].selected ||
+       *bitstring != ':' || !hex2rows (bitstring + 1, rows))
+      return;
+
+   chart = &charts[codept >> 16];
+   codept &= 0xFFFF;  /* pool index will only have 16 bit address */
+   page = &chart->page[codept >> 8];
+   if (*page == NULL &&
+       (*page = calloc (256 * 16, sizeof (unsigned short))) == NULL) {
+      fprintf (stderr, "ERROR: out of memory.\n\n");
+      exit (EXIT_FAILURE);
+   }
+   memcpy (*page + 16 * (codept & 0xFF), rows, sizeof (rows));
+   chart->nglyphs++;
+
+   return;
+}
+
+
+/**
+   @brief Get the pixel rows of a glyph in the chart's plane.
+
+   @param[in] chart The chart.
+   @param[in] codept The code point in the plane, 0..0xFFFF.
+   @param[out] rows The 16 pixel rows; all 0 if there is no glyph.
+*/
+void
+glyph_rows (struct Chart *chart, unsigned codept, unsigned short rows[16])
+{
+   const unsigned char *bits;  /* glyph bitmap in a .ufb file */
+   int digits;                 /* number of hexadecimal digits */
+
+   if (chart->ufb != NULL) {
+      bits = ufb_glyph (chart->ufb,
+                        ((unsigned long)chart->plane << 16) | codept, &digits);
+      if (bits != NULL && (digits >> 5) >= 1 && (digits >> 5) <= 4) {
+         pack_glyph (bits, digits >> 5, rows);
+         return;
+      }
+   }
+   else if (chart->page[codept >> 8] != NULL) {
+      memcpy (rows, chart->page[codept >> 8] + 16 * (codept & 0xFF),
+              16 * sizeof (unsigned short));
+      return;
+   }
+   memset ((void *)rows, 0, 16 * sizeof (unsigned short));
 
    return;
 }
 
 
 /**
-   @brief Generate the BMP output file in long format.
+   @brief Store 16 pixels in an output row, inverted.
 
-   This function generates the BMP output file from a bitmap parameter.
-   This is a long bitmap, 16 glyphs wide by 4,096 glyphs tall.
+   XOR each byte with 0xFF because black = 0, white = 1 in BMP
+   and in 1-bit grayscale PNG.
 
-   @param[in] plane_array The array of glyph bitmaps for a plane.
-   @param[in] dpi Dots per inch, for encoding in the BMP output file header.
-   @param[in] tinynum Whether to generate tiny numbers in wide grid (unused).
-   @param[in] plane The Unicode plane, 0..17.
+   @param[out] out Where to store the 2 bytes.
+   @param[in] bits The pixels, 1 for black.
 */
 void
-genlongbmp (int plane_array[0x10000][16], int dpi, int tinynum, int plane)
+put16 (unsigned char *out, unsigned bits)
 {
+   out[0] = (~bits >> 8) & 0xFF;
+   out[1] =  ~bits       & 0xFF;
 
-   char header_string[HDR_LEN]; /* centered header             */
-   char raw_header[HDR_LEN];    /* left-aligned header         */
-   int header[16][16];     /* header row, for chart title */
-   int hdrlen;             /* length of HEADER_STRING     */
-   int startcol;           /* column to start printing header, for centering */
+   return;
+}
 
-   unsigned leftcol[0x1000][16]; /* code point legend on left side of chart */
-   int d1, d2, d3, d4;           /* digits for filling leftcol[][] legend   */
-   int codept;                   /* current starting code point for legend  */
-   int thisrow;                  /* glyph row currently being rendered      */
-   unsigned toprow[16][16];      /* code point legend on top of chart       */
-   int digitrow;       /* row we're in (0..4) for the above hexdigit digits */
 
-   /*
-      DataOffset = BMP Header bytes + InfoHeader bytes + ColorTable bytes.
-   */
-   int DataOffset = 14 + 40 + 8; /* fixed size for monochrome BMP */
-   int ImageSize;
-   int FileSize;
-   int Width, Height; /* bitmap image width and height in pixels */
-   int ppm;     /* integer pixels per meter */
+/**
+   @brief Store 32 pixels in an output row, inverted.
 
-   int i, j, k;
+   @param[out] out Where to store the 4 bytes.
+   @param[in] bits The pixels, 1 for black.
+*/
+void
+put32 (unsigned char *out, unsigned bits)
+{
+   put16 (out,     bits >> 16);
+   put16 (out + 2, bits);
 
-   unsigned bytesout;
+   return;
+}
 
-   void output4(int), output2(int);
 
-   /*
-      Image width and height, in pixels.
+/**
+   @brief Make the left column legend for one row of a long chart.
 
-         N.B.: Width must be an even multiple of 32 pixels, or 4 bytes.
-   */
-   Width  =   18 * 16;  /* (2 legend +   16 glyphs) * 16 pixels/glyph */
-   Height = 4099 * 16;  /* (1 header + 4096 glyphs) * 16 rows/glyph   */
+   @param[in] thisrow The row of 16 glyphs, 0..0xFFF.
+   @param[out] leftcol The legend's 16 pixel rows.
+*/
+void
+long_leftcol (int thisrow, unsigned leftcol[16])
+{
+   int d1, d2, d3;   /* digits for filling leftcol[] legend   */
+   int codept;       /* starting code point for legend        */
+   int digitrow;     /* row we're in (0..4) for the hexdigit digits */
+   int i;
+
+   memset ((void *)leftcol, 0, 16 * sizeof (unsigned));
+
+   codept = thisrow << 4;
+   d1 = (codept >> 12) & 0xF; /* most significant hex digit */
+   d2 = (codept >>  8) & 0xF;
+   d3 = (codept >>  4) & 0xF;
+
+   /* fill in first and second digits */
+   for (digitrow = 0; digitrow < 5; digitrow++) {
+      leftcol[2 + digitrow] =
+         (hexdigit[d1][digitrow] << 10) |
+         (hexdigit[d2][digitrow] <<  4);
+   }
 
-   ImageSize = Height * (Width / 8); /* in bytes, calculated from pixels */
+   /* fill in third digit */
+   for (digitrow = 0; digitrow < 5; digitrow++) {
+      leftcol[9 + digitrow] = hexdigit[d3][digitrow] << 10;
+   }
+   leftcol[9 + 4] |= 0xF << 4; /* underscore as 4th digit */
 
-   FileSize = DataOffset + ImageSize;
+   for (i = 0; i < 15; i ++) {
+      leftcol[i] |= 0x00000002;      /* right border */
+   }
 
-   /* convert dots/inch to pixels/meter */
-   if (dpi == 0) dpi = 96;
-   ppm = (int)((double)dpi * 100.0 / 2.54 + 0.5);
+   leftcol[15] = 0x0000FFFE;        /* bottom border */
 
-   /*
-      Generate the BMP Header
-   */
-   putchar ('B');
-   putchar ('M');
+   if (d3 == 0xF) {                     /* 256-point boundary */
+      leftcol[15] |= 0x00FF0000;  /* longer tic mark */
+   }
 
-   /*
-      Calculate file size:
+   if ((thisrow % 0x40) == 0x3F) {    /* 1024-point boundary */
+      leftcol[15] |= 0xFFFF0000; /* longest tic mark */
+   }
 
-         BMP Header + InfoHeader + Color Table + Raster Data
-   */
-   output4 (FileSize);  /* FileSize */
-   output4 (0x0000); /* reserved */
+   return;
+}
 
-   /* Calculate DataOffset */
-   output4 (DataOffset);
 
-   /*
-      InfoHeader
-   */
-   output4 (40);         /* Size of InfoHeader                       */
-   output4 (Width);      /* Width of bitmap in pixels                */
-   output4 (Height);     /* Height of bitmap in pixels               */
-   output2 (1);          /* Planes (1 plane)                         */
-   output2 (1);          /* BitCount (1 = monochrome)                */
-   output4 (0);          /* Compression (0 = none)                   */
-   output4 (ImageSize);  /* ImageSize, in bytes                      */
-   output4 (ppm);        /* XpixelsPerM (96 dpi = 3780 pixels/meter) */
-   output4 (ppm);        /* YpixelsPerM (96 dpi = 3780 pixels/meter) */
-   output4 (2);          /* ColorsUsed (= 2)                         */
-   output4 (2);          /* ColorsImportant (= 2)                    */
-   output4 (0x00000000); /* black (reserved, B, G, R)                */
-   output4 (0x00FFFFFF); /* white (reserved, B, G, R)                */
+/**
+   @brief Make the left column legend for one row of a wide chart.
+
+   @param[in] thisrow The row of 256 glyphs, 0..0xFF.
+   @param[in] tinynum Whether to use tiny numbers.
+   @param[out] leftcol The legend's 16 pixel rows.
+*/
+void
+wide_leftcol (int thisrow, int tinynum, unsigned leftcol[16])
+{
+   int d1, d2;       /* digits for filling leftcol[] legend   */
+   int codept;       /* starting code point for legend        */
+   int digitrow;     /* row we're in (0..4) for the hexdigit digits */
+   int hexalpha1, hexalpha2;    /* to convert hex digits to ASCII */
+   int i;
+
+   memset ((void *)leftcol, 0, 16 * sizeof (unsigned));
+
+   codept = thisrow << 8;
+   d1 = (codept >> 12) & 0xF; /* most significant hex digit */
+   d2 = (codept >>  8) & 0xF;
+
+   /* fill in first and second digits */
+
+   if (tinynum) { /* use 4x5 pixel glyphs */
+      for (digitrow = 0; digitrow < 5; digitrow++) {
+         leftcol[6 + digitrow] =
+            (hexdigit[d1][digitrow] << 10) |
+            (hexdigit[d2][digitrow] <<  4);
+      }
+   }
+   else { /* bigger numbers -- use glyphs from Unifont itself */
+      /* convert hexadecimal digits to ASCII equivalent */
+      hexalpha1 = d1 < 0xA ? '0' + d1 : 'A' + d1 - 0xA;
+      hexalpha2 = d2 < 0xA ? '0' + d2 : 'A' + d2 - 0xA;
+
+      for (i = 0 ; i < 16; i++) {
+         leftcol[i] =
+            (ascii_bits[hexalpha1][i] << 2) |
+            (ascii_bits[hexalpha2][i] >> 6);
+      }
+   }
+
+   for (i = 0; i < 15; i ++) {
+      leftcol[i] |= 0x00000002;      /* right border */
+   }
+
+   leftcol[15] = 0x0000FFFE;        /* bottom border */
+
+   if (d2 == 0xF) {                     /* 4096-point boundary */
+      leftcol[15] |= 0x00FF0000;  /* longer tic mark */
+   }
+
+   if ((thisrow % 0x40) == 0x3F) {    /* 16,384-point boundary */
+      leftcol[15] |= 0xFFFF0000; /* longest tic mark */
+   }
+
+   return;
+}
+
+
+/**
+   @brief Draw the title and top legend of a long chart.
+
+   The chart is 16 glyphs wide by 4,096 glyphs tall.  This fills in
+   the first 48 pixel rows of the image, top-down.
+
+   @param[in,out] chart The chart; chart->top is filled in.
+*/
+void
+make_long_top (struct Chart *chart)
+{
+
+   char header_string[HDR_LEN]; /* centered header             */
+   char raw_header[HDR_LEN];    /* left-aligned header         */
+   int header[16][16];     /* header row, for chart title */
+   int hdrlen;             /* length of HEADER_STRING     */
+   int startcol;           /* column to start printing header, for centering */
+
+   int codept;                   /* current starting code point for legend  */
+   unsigned toprow[16][16];      /* code point legend on top of chart       */
+   int d4;                       /* digit for filling toprow[][] legend     */
+   int digitrow;       /* row we're in (0..4) for the above hexdigit digits */
+
+   int i, j;
+   unsigned char *out;  /* current output row */
 
    /*
       Create header row bits.
    */
-   snprintf (raw_header, HDR_LEN, "%s Plane %d", HEADER_STRING, plane);
+   snprintf (raw_header, HDR_LEN, "%s Plane %d", HEADER_STRING, chart->plane);
    memset ((void *)header, 0, 16 * 16 * sizeof (int)); /* fill with white */
    memset ((void *)header_string, ' ', 32 * sizeof (char)); /* 32 spaces */
    header_string[32] = '\0';  /* null-terminated */
@@ -395,7 +851,7 @@ genlongbmp (int plane_array[0x10000][16], int dpi, int tinynum, int plane)
    /* center up to 32 chars */
    memcpy (&header_string[startcol], raw_header, hdrlen);
 
-   /* Copy each letter's bitmap from the plane_array[][] we constructed. */
+   /* Copy each letter's bitmap from the ascii_bits[][] we constructed. */
    /* Each glyph must be single-width, to fit two glyphs in 16 pixels */
    for (j = 0; j < 16; j++) {
       for (i = 0; i < 16; i++) {
@@ -405,55 +861,12 @@ genlongbmp (int plane_array[0x10000][16], int dpi, int tinynum, int plane)
       }
    }
 
-   /*
-      Create the left column legend.
-   */
-   memset ((void *)leftcol, 0, 4096 * 16 * sizeof (unsigned));
-
-   for (codept = 0x0000; codept < 0x10000; codept += 0x10) {
-      d1 = (codept >> 12) & 0xF; /* most significant hex digit */
-      d2 = (codept >>  8) & 0xF;
-      d3 = (codept >>  4) & 0xF;
-
-      thisrow = codept >> 4; /* rows of 16 glyphs */
-
-      /* fill in first and second digits */
-      for (digitrow = 0; digitrow < 5; digitrow++) {
-         leftcol[thisrow][2 + digitrow] =
-            (hexdigit[d1][digitrow] << 10) |
-            (hexdigit[d2][digitrow] <<  4);
-      }
-
-      /* fill in third digit */
-      for (digitrow = 0; digitrow < 5; digitrow++) {
-         leftcol[thisrow][9 + digitrow] = hexdigit[d3][digitrow] << 10;
-      }
-      leftcol[thisrow][9 + 4] |= 0xF << 4; /* underscore as 4th digit */
-
-      for (i = 0; i < 15; i ++) {
-         leftcol[thisrow][i] |= 0x00000002;      /* right border */
-      }
-
-      leftcol[thisrow][15] = 0x0000FFFE;        /* bottom border */
-
-      if (d3 == 0xF) {                     /* 256-point boundary */
-         leftcol[thisrow][15] |= 0x00FF0000;  /* longer tic mark */
-      }
-
-      if ((thisrow % 0x40) == 0x3F) {    /* 1024-point boundary */
-         leftcol[thisrow][15] |= 0xFFFF0000; /* longest tic mark */
-      }
-   }
-
    /*
       Create the top row legend.
    */
    memset ((void *)toprow, 0, 16 * 16 * sizeof (unsigned));
 
    for (codept = 0x0; codept <= 0xF; codept++) {
-      d1 = (codept >> 12) & 0xF; /* most significant hex digit */
-      d2 = (codept >>  8) & 0xF;
-      d3 = (codept >>  4) & 0xF;
       d4 =  codept        & 0xF; /* least significant hex digit */
 
       /* fill in last digit */
@@ -480,95 +893,46 @@ genlongbmp (int plane_array[0x10000][16], int dpi, int tinynum, int plane)
    }
 
    /*
-      Now write the raster image.
-
-      XOR each byte with 0xFF because black = 0, white = 1 in BMP.
-   */
-
-   /* Write the glyphs, bottom-up, left-to-right, in rows of 16 (i.e., 0x10) */
-   for (i = 0xFFF0; i >= 0; i -= 0x10) {
-      thisrow = i >> 4; /* 16 glyphs per row */
-      for (j = 15; j >= 0; j--) {
-         /* left-hand legend */
-         putchar ((~leftcol[thisrow][j] >> 24) & 0xFF);
-         putchar ((~leftcol[thisrow][j] >> 16) & 0xFF);
-         putchar ((~leftcol[thisrow][j] >>  8) & 0xFF);
-         putchar ( ~leftcol[thisrow][j]        & 0xFF);
-         /* Unifont glyph */
-         for (k = 0; k < 16; k++) {
-            bytesout = ~plane_array[i+k][j] & 0xFFFF;
-            putchar ((bytesout >> 8) & 0xFF);
-            putchar ( bytesout       & 0xFF);
-         }
-      }
-   }
-
-   /*
-      Write the top legend.
+      Now draw the rows, top-down.
    */
-   /* i == 15: bottom pixel row of header is output here */
-   /* left-hand legend: solid black line except for right-most pixel */
-   putchar (0x00);
-   putchar (0x00);
-   putchar (0x00);
-   putchar (0x01);
-   for (j = 0; j < 16; j++) {
-      putchar ((~toprow[15][j] >> 8) & 0xFF);
-      putchar ( ~toprow[15][j]       & 0xFF);
-   }
 
-   putchar (0xFF);
-   putchar (0xFF);
-   putchar (0xFF);
-   putchar (0xFC);
-   for (j = 0; j < 16; j++) {
-      putchar ((~toprow[14][j] >> 8) & 0xFF);
-      putchar ( ~toprow[14][j]       & 0xFF);
-   }
+   /* 8 completely white rows at very top */
+   out = chart->top;
+   memset ((void *)out, 0xFF, 8 * chart->rowbytes);
+   out += 8 * chart->rowbytes;
 
-   for (i = 13; i >= 0; i--) {
-      putchar (0xFF);
-      putchar (0xFF);
-      putchar (0xFF);
-      putchar (0xFD);
+   /* Draw the header. */
+   for (i = 0; i < 16; i++) {
+      /* left-hand legend */
+      put32 (out, 0);
+      /* header glyph */
       for (j = 0; j < 16; j++) {
-         putchar ((~toprow[i][j] >> 8) & 0xFF);
-         putchar ( ~toprow[i][j]       & 0xFF);
+         put16 (out + 4 + 2 * j, header[i][j]);
       }
+      out += chart->rowbytes;
    }
 
+   /* 8 completely white rows */
+   memset ((void *)out, 0xFF, 8 * chart->rowbytes);
+   out += 8 * chart->rowbytes;
+
    /*
-      Write the header.
+      Draw the top legend.
    */
-
-   /* 7 completely white rows */
-   for (i = 7; i >= 0; i--) {
-      for (j = 0; j < 18; j++) {
-         putchar (0xFF);
-         putchar (0xFF);
-      }
-   }
-
-   for (i = 15; i >= 0; i--) {
-      /* left-hand legend */
-      putchar (0xFF);
-      putchar (0xFF);
-      putchar (0xFF);
-      putchar (0xFF);
-      /* header glyph */
-      for (j = 0; j < 16; j++) {
-         bytesout = ~header[i][j] & 0xFFFF;
-         putchar ((bytesout >> 8) & 0xFF);
-         putchar ( bytesout       & 0xFF);
-      }
-   }
-
-   /* 8 completely white rows at very top */
-   for (i = 7; i >= 0; i--) {
-      for (j = 0; j < 18; j++) {
-      putchar (0xFF);
-      putchar (0xFF);
+   for (i = 0; i < 16; i++) {
+      if (i < 14) {        /* vertical stroke on right */
+         put32 (out, 0x00000002);
+      }
+      else if (i == 14) {  /* left-hand legend line */
+         put32 (out, 0x00000003);
+      }
+      else {  /* solid black line except for right-most pixel */
+         put32 (out, 0xFFFFFFFE);
+      }
+      for (j = 0; j < 16; j++) {
+         put16 (out + 4 + 2 * j, toprow[i][j]);
       }
+      out += chart->rowbytes;
    }
 
    return;
@@ -576,18 +940,15 @@ genlongbmp (int plane_array[0x10000][16], int dpi, int tinynum, int plane)
 
 
 /**
-   @brief Generate the BMP output file in wide format.
+   @brief Draw the title and top legend of a wide chart.
 
-   This function generates the BMP output file from a bitmap parameter.
-   This is a wide bitmap, 256 glyphs wide by 256 glyphs tall.
+   The chart is 256 glyphs wide by 256 glyphs tall.  This fills in
+   the first 64 pixel rows of the image, top-down.
 
-   @param[in] plane_array The array of glyph bitmaps for a plane.
-   @param[in] dpi Dots per inch, for encoding in the BMP output file header.
-   @param[in] tinynum Whether to generate tiny numbers in 256x256 grid.
-   @param[in] plane The Unicode plane, 0..17.
+   @param[in,out] chart The chart; chart->top is filled in.
 */
 void
-genwidebmp (int plane_array[0x10000][16], int dpi, int tinynum, int plane)
+make_wide_top (struct Chart *chart)
 {
 
    char header_string[257];
@@ -596,81 +957,19 @@ genwidebmp (int plane_array[0x10000][16], int dpi, int tinynum, int plane)
    int hdrlen;         /* length of HEADER_STRING */
    int startcol;       /* column to start printing header, for centering */
 
-   unsigned leftcol[0x100][16]; /* code point legend on left side of chart */
-   int d1, d2, d3, d4;          /* digits for filling leftcol[][] legend   */
+   int d3, d4;                  /* digits for filling toprow[][] legend    */
    int codept;                  /* current starting code point for legend  */
-   int thisrow;                 /* glyph row currently being rendered      */
    unsigned toprow[32][256];    /* code point legend on top of chart       */
    int digitrow;      /* row we're in (0..4) for the above hexdigit digits */
    int hexalpha1, hexalpha2;    /* to convert hex digits to ASCII          */
 
-   /*
-      DataOffset = BMP Header bytes + InfoHeader bytes + ColorTable bytes.
-   */
-   int DataOffset = 14 + 40 + 8; /* fixed size for monochrome BMP */
-   int ImageSize;
-   int FileSize;
-   int Width, Height; /* bitmap image width and height in pixels */
-   int ppm;     /* integer pixels per meter */
-
-   int i, j, k;
-
-   unsigned bytesout;
-
-   void output4(int), output2(int);
-
-   /*
-      Image width and height, in pixels.
-
-         N.B.: Width must be an even multiple of 32 pixels, or 4 bytes.
-   */
-   Width  = 258 * 16;  /* (           2 legend + 256 glyphs) * 16 pixels/glyph */
-   Height = 260 * 16;  /* (2 header + 2 legend + 256 glyphs) * 16 rows/glyph   */
-
-   ImageSize = Height * (Width / 8); /* in bytes, calculated from pixels */
-
-   FileSize = DataOffset + ImageSize;
-
-   /* convert dots/inch to pixels/meter */
-   if (dpi == 0) dpi = 96;
-   ppm = (int)((double)dpi * 100.0 / 2.54 + 0.5);
-
-   /*
-      Generate the BMP Header
-   */
-   putchar ('B');
-   putchar ('M');
-   /*
-      Calculate file size:
-
-         BMP Header + InfoHeader + Color Table + Raster Data
-   */
-   output4 (FileSize);  /* FileSize */
-   output4 (0x0000); /* reserved */
-   /* Calculate DataOffset */
-   output4 (DataOffset);
-
-   /*
-      InfoHeader
-   */
-   output4 (40);         /* Size of InfoHeader                       */
-   output4 (Width);      /* Width of bitmap in pixels                */
-   output4 (Height);     /* Height of bitmap in pixels               */
-   output2 (1);          /* Planes (1 plane)                         */
-   output2 (1);          /* BitCount (1 = monochrome)                */
-   output4 (0);          /* Compression (0 = none)                   */
-   output4 (ImageSize);  /* ImageSize, in bytes                      */
-   output4 (ppm);        /* XpixelsPerM (96 dpi = 3780 pixels/meter) */
-   output4 (ppm);        /* YpixelsPerM (96 dpi = 3780 pixels/meter) */
-   output4 (2);          /* ColorsUsed (= 2)                         */
-   output4 (2);          /* ColorsImportant (= 2)                    */
-   output4 (0x00000000); /* black (reserved, B, G, R)                */
-   output4 (0x00FFFFFF); /* white (reserved, B, G, R)                */
+   int i, j;
+   unsigned char *out;  /* current output row */
 
    /*
       Create header row bits.
    */
-   snprintf (raw_header, HDR_LEN, "%s Plane %d", HEADER_STRING, plane);
+   snprintf (raw_header, HDR_LEN, "%s Plane %d", HEADER_STRING, chart->plane);
    memset ((void *)header, 0, 256 * 16 * sizeof (int)); /* fill with white */
    memset ((void *)header_string, ' ', 256 * sizeof (char)); /* 256 spaces */
    header_string[256] = '\0';  /* null-terminated */
@@ -682,60 +981,13 @@ genwidebmp (int plane_array[0x10000][16], int dpi, int tinynum, int plane)
    /* center up to 32 chars */
    memcpy (&header_string[startcol], raw_header, hdrlen);
 
-   /* Copy each letter's bitmap from the plane_array[][] we constructed. */
+   /* Copy each letter's bitmap from the ascii_bits[][] we constructed. */
    for (j = 0; j < 256; j++) {
       for (i = 0; i < 16; i++) {
          header[i][j] = ascii_bits[header_string[j] & 0x7F][i];
       }
    }
 
-   /*
-      Create the left column legend.
-   */
-   memset ((void *)leftcol, 0, 256 * 16 * sizeof (unsigned));
-
-   for (codept = 0x0000; codept < 0x10000; codept += 0x100) {
-      d1 = (codept >> 12) & 0xF; /* most significant hex digit */
-      d2 = (codept >>  8) & 0xF;
-
-      thisrow = codept >> 8; /* rows of 256 glyphs */
-
-      /* fill in first and second digits */
-
-      if (tinynum) { /* use 4x5 pixel glyphs */
-         for (digitrow = 0; digitrow < 5; digitrow++) {
-            leftcol[thisrow][6 + digitrow] =
-               (hexdigit[d1][digitrow] << 10) |
-               (hexdigit[d2][digitrow] <<  4);
-         }
-      }
-      else { /* bigger numbers -- use glyphs from Unifont itself */
-         /* convert hexadecimal digits to ASCII equivalent */
-         hexalpha1 = d1 < 0xA ? '0' + d1 : 'A' + d1 - 0xA;
-         hexalpha2 = d2 < 0xA ? '0' + d2 : 'A' + d2 - 0xA;
-
-         for (i = 0 ; i < 16; i++) {
-            leftcol[thisrow][i] =
-               (ascii_bits[hexalpha1][i] << 2) |
-               (ascii_bits[hexalpha2][i] >> 6);
-         }
-      }
-
-      for (i = 0; i < 15; i ++) {
-         leftcol[thisrow][i] |= 0x00000002;      /* right border */
-      }
-
-      leftcol[thisrow][15] = 0x0000FFFE;        /* bottom border */
-
-      if (d2 == 0xF) {                     /* 4096-point boundary */
-         leftcol[thisrow][15] |= 0x00FF0000;  /* longer tic mark */
-      }
-
-      if ((thisrow % 0x40) == 0x3F) {    /* 16,384-point boundary */
-         leftcol[thisrow][15] |= 0xFFFF0000; /* longest tic mark */
-      }
-   }
-
    /*
       Create the top row legend.
    */
@@ -745,7 +997,7 @@ genwidebmp (int plane_array[0x10000][16], int dpi, int tinynum, int plane)
       d3 = (codept >>  4) & 0xF;
       d4 =  codept        & 0xF; /* least significant hex digit */
 
-      if (tinynum) {
+      if (chart->tinynum) {
          for (digitrow = 0; digitrow < 5; digitrow++) {
             toprow[16 + 6 + digitrow][codept] =
                (hexdigit[d3][digitrow] << 10) |
@@ -789,105 +1041,771 @@ genwidebmp (int plane_array[0x10000][16], int dpi, int tinynum, int plane)
    }
 
    /*
-      Now write the raster image.
+      Now draw the rows, top-down.
+   */
 
-      XOR each byte with 0xFF because black = 0, white = 1 in BMP.
+   /* 8 completely white rows at very top */
+   out = chart->top;
+   memset ((void *)out, 0xFF, 8 * chart->rowbytes);
+   out += 8 * chart->rowbytes;
+
+   /* Draw the header. */
+   for (i = 0; i < 16; i++) {
+      /* left-hand legend */
+      put32 (out, 0);
+      /* header glyph */
+      for (j = 0; j < 256; j++) {
+         put16 (out + 4 + 2 * j, header[i][j]);
+      }
+      out += chart->rowbytes;
+   }
+
+   /* 8 completely white rows */
+   memset ((void *)out, 0xFF, 8 * chart->rowbytes);
+   out += 8 * chart->rowbytes;
+
+   /*
+      Draw the top legend.
    */
+   for (i = 0; i < 32; i++) {
+      if (i < 8) {              /* all white */
+         put32 (out, 0);
+      }
+      else if (i < 16 + 14) {   /* vertical stroke on right */
+         put32 (out, 0x00000002);
+      }
+      else if (i == 16 + 14) {  /* left-hand legend line */
+         put32 (out, 0x00000003);
+      }
+      else {  /* solid black line except for right-most pixel */
+         put32 (out, 0xFFFFFFFE);
+      }
+      for (j = 0; j < 256; j++) {
+         put16 (out + 4 + 2 * j, toprow[i][j]);
+      }
+      out += chart->rowbytes;
+   }
 
-   /* Write the glyphs, bottom-up, left-to-right, in rows of 16 (i.e., 0x10) */
-   for (i = 0xFF00; i >= 0; i -= 0x100) {
-      thisrow = i >> 8; /* 256 glyphs per row */
-      for (j = 15; j >= 0; j--) {
-         /* left-hand legend */
-         putchar ((~leftcol[thisrow][j] >> 24) & 0xFF);
-         putchar ((~leftcol[thisrow][j] >> 16) & 0xFF);
-         putchar ((~leftcol[thisrow][j] >>  8) & 0xFF);
-         putchar ( ~leftcol[thisrow][j]        & 0xFF);
-         /* Unifont glyph */
-         for (k = 0x00; k < 0x100; k++) {
-            bytesout = ~plane_array[i+k][j] & 0xFFFF;
-            putchar ((bytesout >> 8) & 0xFF);
-            putchar ( bytesout       & 0xFF);
-         }
+   return;
+}
+
+
+/**
+   @brief Set up a chart's image size and draw its title and legend.
+
+   @param[in,out] chart The chart, with its plane and options set.
+*/
+void
+init_chart (struct Chart *chart)
+{
+   void make_long_top (struct Chart *chart);
+   void make_wide_top (struct Chart *chart);
+
+   if (chart->top != NULL)  /* already set up */
+      return;
+
+   /*
+      Image width and height, in pixels.
+
+         N.B.: Width must be an even multiple of 32 pixels, or 4 bytes.
+   */
+   if (chart->wide) {
+      chart->width    = 258 * 16;  /* (2 legend + 256 glyphs) * 16 pixels/glyph */
+      chart->topbands = 4;         /* 2 header + 2 legend */
+      chart->nbands   = chart->topbands + 256;
+   }
+   else {
+      chart->width    = 18 * 16;   /* (2 legend +  16 glyphs) * 16 pixels/glyph */
+      chart->topbands = 3;         /* 2 header + 1 legend */
+      chart->nbands   = chart->topbands + 4096;
+   }
+   chart->height   = chart->nbands * BAND_ROWS;
+   chart->rowbytes = chart->width / 8;
+
+   chart->top = malloc (chart->topbands * BAND_ROWS * chart->rowbytes);
+   if (chart->top == NULL) {
+      fprintf (stderr, "ERROR: out of memory.\n\n");
+      exit (EXIT_FAILURE);
+   }
+   if (chart->wide) {
+      make_wide_top (chart);
+   }
+   else {
+      make_long_top (chart);
+   }
+
+   return;
+}
+
+
+/**
+   @brief Draw one band of 16 pixel rows of a chart.
+
+   Band 0 is at the top of the image.  Below the title and top legend,
+   each band is one row of glyphs with its left-hand legend.
+
+   @param[in] chart The chart.
+   @param[in] band The band to draw.
+   @param[out] out The band's pixel rows, top-down, chart->rowbytes each.
+*/
+void
+render_band (struct Chart *chart, int band, unsigned char *out)
+{
+   unsigned leftcol[16];     /* code point legend on left side of chart */
+   unsigned short rows[16];  /* pixel rows of the current glyph */
+   int thisrow;              /* glyph row being drawn */
+   int perrow;               /* glyphs per row */
+   int j, k;
+
+   if (band < chart->topbands) {
+      memcpy (out, chart->top + band * BAND_ROWS * chart->rowbytes,
+              BAND_ROWS * chart->rowbytes);
+      return;
+   }
+
+   thisrow = band - chart->topbands;
+   if (chart->wide) {
+      perrow = 256;
+      wide_leftcol (thisrow, chart->tinynum, leftcol);
+   }
+   else {
+      perrow = 16;
+      long_leftcol (thisrow, leftcol);
+   }
+   for (j = 0; j < 16; j++) {
+      put32 (out + j * chart->rowbytes, leftcol[j]);
+   }
+   for (k = 0; k < perrow; k++) {
+      glyph_rows (chart, thisrow * perrow + k, rows);
+      for (j = 0; j < 16; j++) {
+         put16 (out + j * chart->rowbytes + 4 + 2 * k, rows[j]);
       }
    }
 
+   return;
+}
+
+
+/**
+   @brief Write a chart as a monochrome BMP file.
+
+   BMP images are stored bottom-up, so the bands are drawn and
+   written from the bottom of the chart to the top.
+
+   @param[in] chart The chart.
+   @param[in] outfp The output file.
+*/
+void
+write_bmp (struct Chart *chart, FILE *outfp)
+{
    /*
-      Write the top legend.
+      DataOffset = BMP Header bytes + InfoHeader bytes + ColorTable bytes.
    */
-   /* i == 15: bottom pixel row of header is output here */
-   /* left-hand legend: solid black line except for right-most pixel */
-   putchar (0x00);
-   putchar (0x00);
-   putchar (0x00);
-   putchar (0x01);
-   for (j = 0; j < 256; j++) {
-      putchar ((~toprow[16 + 15][j] >> 8) & 0xFF);
-      putchar ( ~toprow[16 + 15][j]       & 0xFF);
+   int DataOffset = 14 + 40 + 8; /* fixed size for monochrome BMP */
+   int ImageSize;
+   int FileSize;
+   int ppm;     /* integer pixels per meter */
+   int dpi;
+   int band, j;
+   unsigned char *out; /* one band of output rows */
+
+   void output4 (FILE *outfp, int thisword);
+   void output2 (FILE *outfp, int thisword);
+
+   ImageSize = chart->height * chart->rowbytes; /* in bytes */
+
+   FileSize = DataOffset + ImageSize;
+
+   /* convert dots/inch to pixels/meter */
+   dpi = chart->dpi;
+   if (dpi == 0) dpi = 96;
+   ppm = (int)((double)dpi * 100.0 / 2.54 + 0.5);
+
+   /*
+      Generate the BMP Header
+   */
+   putc ('B', outfp);
+   putc ('M', outfp);
+
+   /*
+      Calculate file size:
+
+         BMP Header + InfoHeader + Color Table + Raster Data
+   */
+   output4 (outfp, FileSize);  /* FileSize */
+   output4 (outfp, 0x0000); /* reserved */
+
+   /* Calculate DataOffset */
+   output4 (outfp, DataOffset);
+
+   /*
+      InfoHeader
+   */
+   output4 (outfp, 40);         /* Size of InfoHeader                       */
+   output4 (outfp, chart->width);  /* Width of bitmap in pixels             */
+   output4 (outfp, chart->height); /* Height of bitmap in pixels            */
+   output2 (outfp, 1);          /* Planes (1 plane)                         */
+   output2 (outfp, 1);          /* BitCount (1 = monochrome)                */
+   output4 (outfp, 0);          /* Compression (0 = none)                   */
+   output4 (outfp, ImageSize);  /* ImageSize, in bytes                      */
+   output4 (outfp, ppm);        /* XpixelsPerM (96 dpi = 3780 pixels/meter) */
+   output4 (outfp, ppm);        /* YpixelsPerM (96 dpi = 3780 pixels/meter) */
+   output4 (outfp, 2);          /* ColorsUsed (= 2)                         */
+   output4 (outfp, 2);          /* ColorsImportant (= 2)                    */
+   output4 (outfp, 0x00000000); /* black (reserved, B, G, R)                */
+   output4 (outfp, 0x00FFFFFF); /* white (reserved, B, G, R)                */
+
+   /*
+      Now write the raster image, bottom-up.
+   */
+   out = malloc (BAND_ROWS * chart->rowbytes);
+   if (out == NULL) {
+      fprintf (stderr, "ERROR: out of memory.\n\n");
+      exit (EXIT_FAILURE);
    }
+   for (band = chart->nbands - 1; band >= 0; band--) {
+      render_band (chart, band, out);
+      for (j = BAND_ROWS - 1; j >= 0; j--) {
+         fwrite (out + j * chart->rowbytes, 1, chart->rowbytes, outfp);
+      }
+   }
+   free (out);
 
-   putchar (0xFF);
-   putchar (0xFF);
-   putchar (0xFF);
-   putchar (0xFC);
-   for (j = 0; j < 256; j++) {
-      putchar ((~toprow[16 + 14][j] >> 8) & 0xFF);
-      putchar ( ~toprow[16 + 14][j]       & 0xFF);
+   return;
+}
+
+
+#ifdef HAVE_ZLIB
+/**
+   @brief Write a 4-byte integer in big-endian order, as PNG uses.
+
+   @param[out] out Where to store the 4 bytes.
+   @param[in] thisword The integer.
+*/
+void
+set_msb32 (unsigned char *out, unsigned long thisword)
+{
+   out[0] = (thisword >> 24) & 0xFF;
+   out[1] = (thisword >> 16) & 0xFF;
+   out[2] = (thisword >>  8) & 0xFF;
+   out[3] =  thisword        & 0xFF;
+
+   return;
+}
+
+
+/**
+   @brief Write one PNG chunk.
+
+   @param[in] outfp The output file.
+   @param[in] type The 4-letter chunk type.
+   @param[in] data The chunk data.
+   @param[in] len The number of bytes of data.
+*/
+void
+png_chunk (FILE *outfp, const char *type, const unsigned char *data,
+           unsigned long len)
+{
+   unsigned char word[4];
+   unsigned long crc;
+
+   set_msb32 (word, len);
+   fwrite (word, 1, 4, outfp);
+   fwrite (type, 1, 4, outfp);
+   fwrite (data, 1, len, outfp);
+   crc = crc32 (0L, (const Bytef *)type, 4);
+   if (len > 0)
+      crc = crc32 (crc, data, len);
+   set_msb32 (word, crc);
+   fwrite (word, 1, 4, outfp);
+
+   return;
+}
+
+
+/**
+   @brief Start writing a grayscale PNG image.
+
+   @param[out] png The PNG image being written.
+   @param[in] outfp The output file.
+   @param[in] width The image width in pixels.
+   @param[in] height The image height in pixels.
+   @param[in] depth Bits per pixel, 1 or 8.
+   @param[in] dpi Dots per inch.
+*/
+void
+png_open (struct Png *png, FILE *outfp, int width, int height, int depth,
+          int dpi)
+{
+   unsigned char chunk[13];    /* IHDR or pHYs chunk data */
+   int ppm;                    /* integer pixels per meter */
+
+   /* convert dots/inch to pixels/meter */
+   if (dpi == 0) dpi = 96;
+   ppm = (int)((double)dpi * 100.0 / 2.54 + 0.5);
+
+   fwrite ("\211PNG\r\n\032\n", 1, 8, outfp);
+   set_msb32 (chunk,     width);
+   set_msb32 (chunk + 4, height);
+   chunk[ 8] = depth;  /* bit depth     */
+   chunk[ 9] = 0;  /* grayscale        */
+   chunk[10] = 0;  /* deflate          */
+   chunk[11] = 0;  /* adaptive filters */
+   chunk[12] = 0;  /* not interlaced   */
+   png_chunk (outfp, "IHDR", chunk, 13);
+   set_msb32 (chunk,     ppm);
+   set_msb32 (chunk + 4, ppm);
+   chunk[8] = 1;   /* pixels per meter */
+   png_chunk (outfp, "pHYs", chunk, 9);
+
+   png->outfp     = outfp;
+   png->linebytes = 1 + (width * depth + 7) / 8;
+   png->line      = malloc (png->linebytes);
+   memset ((void *)&png->zs, 0, sizeof (png->zs));
+   if (png->line == NULL ||
+       deflateInit (&png->zs, Z_DEFAULT_COMPRESSION) != Z_OK) {
+      fprintf (stderr, "ERROR: out of memory.\n\n");
+      exit (EXIT_FAILURE);
    }
+   png->zs.next_out  = png->idat;
+   png->zs.avail_out = sizeof (png->idat);
+   png->line[0] = 0;  /* no filter */
+
+   return;
+}
+
+
+/**
+   @brief Compress PNG image data, writing IDAT chunks as they fill.
 
-   for (i = 16 + 13; i >= 0; i--) {
-      if (i >= 8) { /* make vertical stroke on right */
-         putchar (0xFF);
-         putchar (0xFF);
-         putchar (0xFF);
-         putchar (0xFD);
+   @param[in,out] png The PNG image being written.
+   @param[in] flush Z_NO_FLUSH, or Z_FINISH after the last row.
+*/
+void
+png_deflate (struct Png *png, int flush)
+{
+   int status;
+
+   do {
+      status = deflate (&png->zs, flush);
+      if (png->zs.avail_out == 0 || status == Z_STREAM_END) {
+         png_chunk (png->outfp, "IDAT", png->idat,
+                    sizeof (png->idat) - png->zs.avail_out);
+         png->zs.next_out  = png->idat;
+         png->zs.avail_out = sizeof (png->idat);
       }
-      else { /* all white */
-         putchar (0xFF);
-         putchar (0xFF);
-         putchar (0xFF);
-         putchar (0xFF);
+   } while (png->zs.avail_in > 0 ||
+            (flush == Z_FINISH && status != Z_STREAM_END));
+
+   return;
+}
+
+
+/**
+   @brief Add the next pixel row, top-down, to a PNG image.
+
+   @param[in,out] png The PNG image being written.
+   @param[in] row The pixel row.
+*/
+void
+png_row (struct Png *png, const unsigned char *row)
+{
+   void png_deflate (struct Png *png, int flush);
+
+   memcpy (png->line + 1, row, png->linebytes - 1);
+   png->zs.next_in  = png->line;
+   png->zs.avail_in = png->linebytes;
+   png_deflate (png, Z_NO_FLUSH);
+
+   return;
+}
+
+
+/**
+   @brief Finish writing a PNG image.
+
+   @param[in,out] png The PNG image being written.
+*/
+void
+png_close (struct Png *png)
+{
+   void png_deflate (struct Png *png, int flush);
+
+   png_deflate (png, Z_FINISH);
+   deflateEnd (&png->zs);
+   png_chunk (png->outfp, "IEND", NULL, 0);
+   free (png->line);
+
+   return;
+}
+
+
+/**
+   @brief Write a chart as a 1-bit grayscale PNG file.
+
+   The bands are drawn top-down and compressed with zlib as they
+   are drawn, so only one band of the image is in memory at a time.
+
+   @param[in] chart The chart.
+   @param[in] outfp The output file.
+*/
+void
+write_png (struct Chart *chart, FILE *outfp)
+{
+   unsigned char *out;         /* one band of output rows */
+   struct Png png;             /* the image being written */
+   int band, j;
+
+   void png_open  (struct Png *png, FILE *outfp, int width, int height,
+                   int depth, int dpi);
+   void png_row   (struct Png *png, const unsigned char *row);
+   void png_close (struct Png *png);
+
+   out = malloc (BAND_ROWS * chart->rowbytes);
+   if (out == NULL) {
+      fprintf (stderr, "ERROR: out of memory.\n\n");
+      exit (EXIT_FAILURE);
+   }
+   png_open (&png, outfp, chart->width, chart->height, 1, chart->dpi);
+   for (band = 0; band < chart->nbands; band++) {
+      render_band (chart, band, out);
+      for (j = 0; j < BAND_ROWS; j++) {
+         png_row (&png, out + j * chart->rowbytes);
       }
-      for (j = 0; j < 256; j++) {
-         putchar ((~toprow[i][j] >> 8) & 0xFF);
-         putchar ( ~toprow[i][j]       & 0xFF);
+   }
+   png_close (&png);
+   free (out);
+
+   return;
+}
+
+
+/**
+   @brief Get the number of the full-size level of a tile pyramid.
+
+   Level 0 is one pixel; each level above it is twice as wide and
+   tall, up to the full-size image.
+
+   @param[in] chart The chart, after init_chart.
+   @return The top level.
+*/
+int
+top_level (struct Chart *chart)
+{
+   int level;
+
+   for (level = 0; (1 << level) < chart->width ||
+                   (1 << level) < chart->height; level++);
+
+   return level;
+}
+
+
+/**
+   @brief Get the number of stripes a chart's tile pyramid is drawn in.
+
+   Each stripe is TILE_STRIPE rows of full-size tiles, and is drawn
+   separately; one more pass draws the smaller levels.
+
+   @param[in] chart The chart, after init_chart.
+   @return The number of stripes.
+*/
+int
+tile_stripes (struct Chart *chart)
+{
+   return (chart->height + TILE_STRIPE * TILE_SIZE - 1) /
+          (TILE_STRIPE * TILE_SIZE);
+}
+
+
+/**
+   @brief Write one row of tiles of a pyramid level as PNG files.
+
+   @param[in] pyramid The pyramid being drawn.
+   @param[in] k The level.
+*/
+void
+write_tiles (struct Pyramid *pyramid, int k)
+{
+   struct Level *level = &pyramid->level[k];
+   char tilename[MAXSTRING];  /* name of a tile's PNG file */
+   FILE *tilefp;              /* a tile's PNG file */
+   struct Png png;            /* the tile being written */
+   int col, width, j;
+
+   void png_open  (struct Png *png, FILE *outfp, int width, int height,
+                   int depth, int dpi);
+   void png_row   (struct Png *png, const unsigned char *row);
+   void png_close (struct Png *png);
+
+   for (col = 0; col * TILE_SIZE < level->width; col++) {
+      width = level->width - col * TILE_SIZE;
+      if (width > TILE_SIZE) width = TILE_SIZE;
+      snprintf (tilename, MAXSTRING, "%s_files/%d/%d_%d.png", pyramid->name,
+                k, col, level->stripy / TILE_SIZE);
+      if ((tilefp = fopen (tilename, "wb")) == NULL) {
+         fprintf (stderr, "ERROR: can't open %s for output.\n\n", tilename);
+         exit (EXIT_FAILURE);
+      }
+      png_open (&png, tilefp, width, level->nrows, level->depth,
+                pyramid->dpi);
+      for (j = 0; j < level->nrows; j++) {
+         png_row (&png, level->strip + j * level->rowbytes +
+                        col * TILE_SIZE * level->depth / 8);
+      }
+      png_close (&png);
+      if (fclose (tilefp) != 0) {
+         fprintf (stderr, "ERROR: can't write %s.\n\n", tilename);
+         exit (EXIT_FAILURE);
       }
    }
 
-   /*
-      Write the header.
-   */
+   return;
+}
 
-   /* 8 completely white rows */
-   for (i = 7; i >= 0; i--) {
-      for (j = 0; j < 258; j++) {
-         putchar (0xFF);
-         putchar (0xFF);
+
+/**
+   @brief Add the next pixel row to a level of a tile pyramid.
+
+   Every second row, the row and the one before it are scaled down
+   to make the next row of the level below, averaging each square
+   of 4 pixels into one gray pixel.  When the level has a full row
+   of tiles, or reaches its bottom, the tiles are written.
+
+   @param[in,out] pyramid The pyramid being drawn.
+   @param[in] k The level.
+   @param[in] row The pixel row.
+*/
+void
+add_row (struct Pyramid *pyramid, int k, const unsigned char *row)
+{
+   struct Level *level = &pyramid->level[k];
+   const unsigned char *above;  /* a row of this level */
+   int y;         /* image row being added */
+   int x, dx, dy; /* pixel in the level below, and in this level */
+   int sum, n;    /* sum and number of pixels averaged */
+
+   void write_tiles (struct Pyramid *pyramid, int k);
+
+   memcpy (level->strip + level->nrows * level->rowbytes, row,
+           level->rowbytes);
+   level->nrows++;
+   y = level->stripy + level->nrows - 1;
+
+   if (k > pyramid->minlevel && ((y & 1) || y == level->height - 1)) {
+      for (x = 0; x < pyramid->level[k - 1].width; x++) {
+         sum = n = 0;
+         for (dy = (y & 1) ? 1 : 0; dy >= 0; dy--) {
+            above = level->strip + (level->nrows - 1 - dy) * level->rowbytes;
+            for (dx = 0; dx < 2 && 2 * x + dx < level->width; dx++) {
+               if (level->depth == 1)
+                  sum += ((above[(2 * x + dx) >> 3] >>
+                           (7 - ((2 * x + dx) & 7))) & 1) ? 255 : 0;
+               else
+                  sum += above[2 * x + dx];
+               n++;
+            }
+         }
+         pyramid->down[x] = (sum + n / 2) / n;
       }
+      add_row (pyramid, k - 1, pyramid->down);
    }
 
-   for (i = 15; i >= 0; i--) {
-      /* left-hand legend */
-      putchar (0xFF);
-      putchar (0xFF);
-      putchar (0xFF);
-      putchar (0xFF);
-      /* header glyph */
-      for (j = 0; j < 256; j++) {
-         bytesout = ~header[i][j] & 0xFFFF;
-         putchar ((bytesout >> 8) & 0xFF);
-         putchar ( bytesout       & 0xFF);
+   if (level->nrows == TILE_SIZE || y == level->height - 1) {
+      if (k <= pyramid->maxwrite)
+         write_tiles (pyramid, k);
+      level->stripy += level->nrows;
+      level->nrows = 0;
+   }
+
+   return;
+}
+
+
+/**
+   @brief Draw part of a chart as a deep zoom tile pyramid.
+
+   The pyramid is in the layout used by Deep Zoom and OpenSeadragon:
+   name.dzi describes the image, and name_files/level/column_row.png
+   are the tiles.  Stripe s of tile_stripes (chart) draws the tiles
+   of the two largest levels for TILE_STRIPE rows of full-size tiles;
+   stripe tile_stripes (chart) draws all the smaller levels.  The
+   directories and name.dzi must already have been made.
+
+   @param[in] chart The chart, after init_chart.
+   @param[in] name The pyramid name.
+   @param[in] stripe The stripe to draw.
+*/
+void
+write_tiles_stripe (struct Chart *chart, char *name, int stripe)
+{
+   struct Pyramid pyramid;     /* the pyramid being drawn */
+   unsigned char *out;         /* one band of output rows */
+   int top;                    /* the full-size level */
+   int firstband, lastband;    /* the bands to draw */
+   int band, j, k;
+
+   void add_row (struct Pyramid *pyramid, int k, const unsigned char *row);
+
+   top = top_level (chart);
+   pyramid.name = name;
+   pyramid.dpi  = chart->dpi;
+   if (stripe < tile_stripes (chart)) {
+      firstband = stripe * TILE_STRIPE * TILE_SIZE / BAND_ROWS;
+      lastband  = firstband + TILE_STRIPE * TILE_SIZE / BAND_ROWS;
+      if (lastband > chart->nbands) lastband = chart->nbands;
+      pyramid.minlevel = top - 1;
+      pyramid.maxwrite = top;
+   }
+   else {
+      firstband = 0;
+      lastband  = chart->nbands;
+      pyramid.minlevel = 0;
+      pyramid.maxwrite = top - 2;
+   }
+
+   for (k = top; k >= pyramid.minlevel; k--) {
+      if (k == top) {
+         pyramid.level[k].width  = chart->width;
+         pyramid.level[k].height = chart->height;
+         pyramid.level[k].depth  = 1;
+         pyramid.level[k].rowbytes = chart->rowbytes;
+      }
+      else {
+         pyramid.level[k].width  = (pyramid.level[k + 1].width  + 1) / 2;
+         pyramid.level[k].height = (pyramid.level[k + 1].height + 1) / 2;
+         pyramid.level[k].depth  = 8;
+         pyramid.level[k].rowbytes = pyramid.level[k].width;
       }
+      pyramid.level[k].stripy = (firstband * BAND_ROWS) >> (top - k);
+      pyramid.level[k].nrows  = 0;
+      pyramid.level[k].strip  = malloc (TILE_SIZE * pyramid.level[k].rowbytes);
+      if (pyramid.level[k].strip == NULL) {
+         fprintf (stderr, "ERROR: out of memory.\n\n");
+         exit (EXIT_FAILURE);
+      }
+   }
+   pyramid.down = malloc (pyramid.level[top].width / 2 + 1);
+   out = malloc (BAND_ROWS * chart->rowbytes);
+   if (pyramid.down == NULL || out == NULL) {
+      fprintf (stderr, "ERROR: out of memory.\n\n");
+      exit (EXIT_FAILURE);
    }
 
-   /* 8 completely white rows at very top */
-   for (i = 7; i >= 0; i--) {
-      for (j = 0; j < 258; j++) {
-      putchar (0xFF);
-      putchar (0xFF);
+   for (band = firstband; band < lastband; band++) {
+      render_band (chart, band, out);
+      for (j = 0; j < BAND_ROWS; j++) {
+         add_row (&pyramid, top, out + j * chart->rowbytes);
       }
    }
 
+   for (k = top; k >= pyramid.minlevel; k--) {
+      free (pyramid.level[k].strip);
+   }
+   free (pyramid.down);
+   free (out);
+
    return;
 }
 
+
+/**
+   @brief Make the directories and descriptor of a tile pyramid.
+
+   @param[in] chart The chart, after init_chart.
+   @param[in] name The pyramid name.
+   @return 0 on success, or 1 on failure.
+*/
+int
+start_tiles (struct Chart *chart, char *name)
+{
+   char dirname[MAXSTRING];  /* a directory to make */
+   FILE *dzifp;              /* the .dzi descriptor */
+   int k;
+
+   snprintf (dirname, MAXSTRING, "%s_files", name);
+   if (mkdir (dirname, 0777) != 0 && errno != EEXIST) {
+      fprintf (stderr, "ERROR: can't make directory %s.\n\n", dirname);
+      return 1;
+   }
+   for (k = 0; k <= top_level (chart); k++) {
+      snprintf (dirname, MAXSTRING, "%s_files/%d", name, k);
+      if (mkdir (dirname, 0777) != 0 && errno != EEXIST) {
+         fprintf (stderr, "ERROR: can't make directory %s.\n\n", dirname);
+         return 1;
+      }
+   }
+
+   snprintf (dirname, MAXSTRING, "%s.dzi", name);
+   if ((dzifp = fopen (dirname, "w")) == NULL) {
+      fprintf (stderr, "ERROR: can't open %s for output.\n\n", dirname);
+      return 1;
+   }
+   fprintf (dzifp, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+   fprintf (dzifp, "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\"\n");
+   fprintf (dzifp, "       TileSize=\"%d\" Overlap=\"0\" Format=\"png\">\n",
+            TILE_SIZE);
+   fprintf (dzifp, "  <Size Width=\"%d\" Height=\"%d\"/>\n",
+            chart->width, chart->height);
+   fprintf (dzifp, "</Image>\n");
+   if (fclose (dzifp) != 0) {
+      fprintf (stderr, "ERROR: can't write %s.\n\n", dirname);
+      return 1;
+   }
+
+   return 0;
+}
+#else
+/**
+   @brief Write a chart as a PNG file; not available without zlib.
+
+   @param[in] chart The chart.
+   @param[in] outfp The output file.
+*/
+void
+write_png (struct Chart *chart, FILE *outfp)
+{
+   return;
+}
+
+
+/**
+   @brief Get the number of stripes of a tile pyramid; no tiles without zlib.
+
+   @param[in] chart The chart.
+   @return 0.
+*/
+int
+tile_stripes (struct Chart *chart)
+{
+   return 0;
+}
+
+
+/**
+   @brief Draw part of a tile pyramid; not available without zlib.
+
+   @param[in] chart The chart.
+   @param[in] name The pyramid name.
+   @param[in] stripe The stripe to draw.
+*/
+void
+write_tiles_stripe (struct Chart *chart, char *name, int stripe)
+{
+   return;
+}
+
+
+/**
+   @brief Start a tile pyramid; not available without zlib.
+
+   @param[in] chart The chart.
+   @param[in] name The pyramid name.
+   @return 1.
+*/
+int
+start_tiles (struct Chart *chart, char *name)
+{
+   return 1;
+}
+#endif
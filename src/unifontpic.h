@@ -31,6 +31,82 @@
 
 #define HEADER_STRING "GNU Unifont 15.1.05" ///< To be printed as chart title.
 
+#define CHART_PAGES 0x100  ///< Number of 256 code point pages in a plane.
+#define BAND_ROWS   16     ///< Pixel rows in a band: one row of glyphs.
+#define TILE_SIZE   256    ///< Width and height of a deep zoom tile.
+#define TILE_STRIPE 2      ///< Rows of full-size tiles drawn in one pass.
+
+
+/**
+   @brief A chart of one Unicode plane, and the glyphs to draw in it.
+
+   Glyphs are kept as 16 rows of 16 pixels each, one unsigned short
+   per row, in a pool of 256-glyph pages that are only allocated
+   if the input has glyphs in them.  If the input is a .ufb file,
+   the glyphs are instead taken from the mapped file as they are
+   drawn.  The chart is drawn one band of 16 pixel rows at a time.
+*/
+struct Chart {
+   int plane;            ///< Unicode plane, 0..17.
+   int selected;         ///< Whether this plane's chart is to be drawn.
+   unsigned long nglyphs; ///< Number of glyphs read in for this plane.
+   int wide;             ///< 1 for a 256x256 grid, 0 for a 16x4096 grid.
+   int tinynum;          ///< Whether to use tiny labels for 256x256 grid.
+   int dpi;              ///< Dots per inch, for the output file header.
+   struct Ufb *ufb;      ///< Glyph source if it is a .ufb file, or NULL.
+   unsigned short *page[CHART_PAGES]; ///< 256 x 16 glyph rows, or NULL.
+   int width;            ///< Image width in pixels.
+   int height;           ///< Image height in pixels.
+   int rowbytes;         ///< Bytes in one pixel row of the image.
+   int nbands;           ///< Number of bands in the image.
+   int topbands;         ///< Bands holding the title and top legend.
+   unsigned char *top;   ///< Image rows of the title and top legend.
+};
+
+
+#ifdef HAVE_ZLIB
+/**
+   @brief A grayscale PNG image being written one row at a time.
+*/
+struct Png {
+   FILE *outfp;              ///< The output file.
+   z_stream zs;              ///< The compressor.
+   unsigned char idat[65536]; ///< Compressed data for the next IDAT chunk.
+   unsigned char *line;      ///< One scanline: filter byte, then pixels.
+   int linebytes;            ///< Bytes in line.
+};
+#endif
+
+
+/**
+   @brief One level of a deep zoom tile pyramid, as it is being drawn.
+
+   Each level is half the width and height of the one above it, and
+   holds one row of tiles, TILE_SIZE pixel rows, at a time.
+*/
+struct Level {
+   int width;            ///< Width of the level's image in pixels.
+   int height;           ///< Height of the level's image in pixels.
+   int depth;            ///< Bits per pixel: 1 at full size, else 8.
+   int rowbytes;         ///< Bytes in one pixel row.
+   int stripy;           ///< Image row of the first row in strip.
+   int nrows;            ///< Number of rows now in strip.
+   unsigned char *strip; ///< The current row of tiles.
+};
+
+
+/**
+   @brief A deep zoom tile pyramid, or part of one, being drawn.
+*/
+struct Pyramid {
+   char *name;           ///< Name of the .dzi file, without ".dzi".
+   int dpi;              ///< Dots per inch, for the tile headers.
+   int minlevel;         ///< Smallest level drawn.
+   int maxwrite;         ///< Largest level whose tiles are written.
+   struct Level level[32]; ///< The levels, by number.
+   unsigned char *down;  ///< A row scaled down for the next level.
+};
+
 /**
    @brief Array of Unifont ASCII glyphs for chart row & column headings.
 
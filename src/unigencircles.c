@@ -7,6 +7,11 @@
    @author Paul Hardy
 
    @copyright Copyright (C) 2013, Paul Hardy.
+
+   The glyphs on stdin can be a .hex file or a binary glyph store
+   made by hex2ufb; the output is always a .hex file.  The .hex input
+   and the combining and nonprinting files can be gzip or zstd
+   compressed.
 */
 /*
    LICENSE:
@@ -59,6 +64,9 @@
 #include <string.h>
 #include <ctype.h>
 
+#include "ufb.h"
+#include "unizio.h"
+
 #define MAXSTRING	256   ///< Maximum input line length - 1.
 
 
@@ -85,6 +93,7 @@ main (int argc, char **argv)
    void add_double_circle(char *, int); /* add a double-width dashed circle */
 
    FILE *infilefp;
+   struct Ufb *ufb;             /* stdin, if it is a .ufb file */
 
    /*
       if (argc != 3) {
@@ -101,7 +110,7 @@ main (int argc, char **argv)
    memset (combining, 0, 0x110000 * sizeof (char));
    memset (x_offset , 0, 0x110000 * sizeof (char));
 
-   if ((infilefp = fopen (argv[1],"r")) == NULL) {
+   if ((infilefp = zio_open (argv[1],"r")) == NULL) {
       fprintf (stderr,"ERROR - combining characters file %s not found.\n\n",
               argv[1]);
       exit (EXIT_FAILURE);
@@ -123,7 +132,7 @@ main (int argc, char **argv)
    fclose (infilefp); /* all done reading combining.txt */
 
    /* Now read the non-printing glyphs; they never have dashed circles */
-   if ((infilefp = fopen (argv[2],"r")) == NULL) {
+   if ((infilefp = zio_open (argv[2],"r")) == NULL) {
       fprintf (stderr,"ERROR - nonprinting characters file %s not found.\n\n",
               argv[1]);
       exit (EXIT_FAILURE);
@@ -138,7 +147,10 @@ main (int argc, char **argv)
       Read the hex glyphs.
    */
    teststring[MAXSTRING - 1] = '\0';   /* so there's no chance we leave array  */
-   while (fgets (teststring, MAXSTRING-1, stdin) != NULL) {
+   infilefp = zio_wrap (stdin, "stdin");
+   ufb = ufb_fdopen (fileno (infilefp), "stdin");
+   while (ufb != NULL ? ufb_gets (ufb, teststring, MAXSTRING-1)
+                      : fgets (teststring, MAXSTRING-1, infilefp) != NULL) {
       sscanf (teststring, "%X", &loc);     /* loc == the Uniocde code point    */
       gstart = strchr (teststring,':') + 1; /* start of glyph bitmap            */
       if (combining[loc]) {                /* if a combining character         */
@@ -11,6 +11,10 @@
    All glyphs are treated as 16 pixels high, and can be
    8, 16, 24, or 32 pixels wide (resulting in widths of
    1, 2, 3, or 4, respectively).
+
+   The glyph file can be a .hex file or a binary glyph store made
+   by hex2ufb.  The .hex and combining files can be gzip or zstd
+   compressed.
 */
 /*
    LICENSE:
@@ -43,6 +47,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "ufb.h"
+#include "unizio.h"
+
 #define MAXSTRING	256   ///< Maximum input line length - 1.
 
 /* Definitions for Pikto in Plane 15 */
@@ -73,6 +80,9 @@ main (int argc, char **argv)
    char pikto_width[PIKTO_SIZE];
 
    FILE *infilefp;
+   struct Ufb *ufb;    /* glyph file, if it is a .ufb file */
+   unsigned long next; /* next code point to look for in ufb */
+   int  digits;        /* hexadecimal digits in a .ufb glyph */
 
    if (argc != 3) {
       fprintf (stderr, "\n\nUsage: %s <unifont.hex> <combining.txt>\n\n", argv[0]);
@@ -82,7 +92,7 @@ main (int argc, char **argv)
    /*
       Read the collection of hex glyphs.
    */
-   if ((infilefp = fopen (argv[1],"r")) == NULL) {
+   if ((infilefp = zio_open (argv[1],"r")) == NULL) {
       fprintf (stderr,"ERROR - hex input file %s not found.\n\n", argv[1]);
       exit (EXIT_FAILURE);
    }
@@ -92,19 +102,33 @@ main (int argc, char **argv)
    memset (pikto_width, -1, (PIKTO_SIZE) * sizeof (char));
 
    teststring[MAXSTRING-1] = '\0';
-   while (fgets (teststring, MAXSTRING-1, infilefp) != NULL) {
-      sscanf (teststring, "%X:%*s", &loc);
-      if (loc < 0x20000) {
-         gstart = strchr (teststring,':') + 1;
-         /*
-            16 rows per glyph, 2 ASCII hexadecimal digits per byte,
-            so divide number of digits by 32 (shift right 5 bits).
-         */
-         glyph_width[loc] = (strlen (gstart) - 1) >> 5;
+   if ((ufb = ufb_fdopen (fileno (infilefp), argv[1])) != NULL) {
+      /* Binary glyph store: widths come straight from the digit counts. */
+      for (next = ufb_next (ufb, 0); next < UFB_END;
+           next = ufb_next (ufb, next + 1)) {
+         if (ufb_glyph (ufb, next, &digits) == NULL) continue;
+         if (next < 0x20000)
+            glyph_width[next] = digits >> 5;
+         else if ((next >= PIKTO_START) && (next <= PIKTO_END))
+            pikto_width[next - PIKTO_START] = digits <= 33 ? 1 : 2;
       }
-      else if ((loc >= PIKTO_START) && (loc <= PIKTO_END)) {
-         gstart = strchr (teststring,':') + 1;
-         pikto_width[loc - PIKTO_START] = strlen (gstart) <= 34 ? 1 : 2;
+      ufb_close (ufb);
+   }
+   else {
+      while (fgets (teststring, MAXSTRING-1, infilefp) != NULL) {
+         sscanf (teststring, "%X:%*s", &loc);
+         if (loc < 0x20000) {
+            gstart = strchr (teststring,':') + 1;
+            /*
+               16 rows per glyph, 2 ASCII hexadecimal digits per byte,
+               so divide number of digits by 32 (shift right 5 bits).
+            */
+            glyph_width[loc] = (strlen (gstart) - 1) >> 5;
+         }
+         else if ((loc >= PIKTO_START) && (loc <= PIKTO_END)) {
+            gstart = strchr (teststring,':') + 1;
+            pikto_width[loc - PIKTO_START] = strlen (gstart) <= 34 ? 1 : 2;
+         }
       }
    }
 
@@ -113,7 +137,7 @@ main (int argc, char **argv)
    /*
       Now read the combining character code points.  These have width of 0.
    */
-   if ((infilefp = fopen (argv[2],"r")) == NULL) {
+   if ((infilefp = zio_open (argv[2],"r")) == NULL) {
       fprintf (stderr,"ERROR - combining characters file %s not found.\n\n", argv[2]);
       exit (EXIT_FAILURE);
    }
@@ -0,0 +1,181 @@
+/**
+   @file unihex-support.c
+
+   @brief Read .hex files into memory and index their glyphs.
+
+   @author Paul Hardy
+
+   @copyright Copyright (C) 2023 Paul Hardy
+*/
+/*
+   LICENSE:
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 2 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "unihex.h"
+
+
+/**
+   @brief Read all input files into one block of memory.
+
+   A newline is added after each file, so that a last line without
+   one does not run into the next file.
+
+   @param[in] progname The program name, for error messages.
+   @param[in] names The input file names; none means stdin.
+   @param[in] nnames The number of input file names.
+   @param[out] textlen The number of bytes read.
+   @return The input text.
+*/
+char *
+read_input (const char *progname, char **names, int nnames, size_t *textlen)
+{
+   char  *text = NULL;
+   size_t room = 0;
+   size_t got;
+   FILE  *fp;
+   int    i;
+
+   *textlen = 0;
+   for (i = 0; i < (nnames > 0 ? nnames : 1); i++) {
+      if (nnames == 0 || strcmp (names[i], "-") == 0)
+         fp = stdin;
+      else if ((fp = fopen (names[i], "r")) == NULL) {
+         fprintf (stderr, "%s: can't open %s for input.\n",
+                  progname, names[i]);
+         exit (EXIT_FAILURE);
+      }
+      do {
+         if (room - *textlen < 2) {
+            room = room ? 2 * room : 1 << 22;
+            text = realloc (text, room);
+            if (text == NULL) {
+               fprintf (stderr, "%s: out of memory.\n", progname);
+               exit (EXIT_FAILURE);
+            }
+         }
+         got = fread (text + *textlen, 1, room - *textlen - 1, fp);
+         *textlen += got;
+      } while (got > 0);
+      if (ferror (fp)) {
+         fprintf (stderr, "%s: read error.\n", progname);
+         exit (EXIT_FAILURE);
+      }
+      if (fp != stdin)
+         fclose (fp);
+      text[(*textlen)++] = '\n';
+   }
+   return text;
+}
+
+
+/**
+   @brief Find the glyphs in the input, in ascending code point order.
+
+   A line holds a glyph if it starts with hexadecimal digits, a colon,
+   and more hexadecimal digits; other lines are skipped.  If the
+   glyphs are not already in order, they are sorted with a stable
+   radix sort.  Of several glyphs with the same code point, only the
+   last one read is kept.
+
+   @param[in] progname The program name, for error messages.
+   @param[in] text The input text.
+   @param[in] textlen The number of bytes in text.
+   @param[out] nglyphs The number of glyphs found.
+   @return Array of glyphs found.
+*/
+struct Glyph *
+index_glyphs (const char *progname, char *text, size_t textlen,
+              unsigned long *nglyphs)
+{
+   struct Glyph *glyphs, *sorted, *tmp;
+   unsigned long room = 4096;
+   unsigned long n = 0;
+   unsigned long count[257];
+   unsigned long i, kept;
+   int   in_order = 1;
+   int   shift, digit;
+   char *p = text, *end = text + textlen, *q;
+   unsigned long codept;
+
+   glyphs = malloc (room * sizeof (struct Glyph));
+   while (glyphs != NULL && p < end) {
+      codept = 0;
+      for (q = p; q < end && isxdigit ((unsigned char)*q) && q - p < 8; q++)
+         codept = (codept << 4) |
+                  (isdigit ((unsigned char)*q) ? *q - '0' :
+                   toupper ((unsigned char)*q) - 'A' + 10);
+      if (q > p && q < end && *q == ':' &&
+          q + 1 < end && isxdigit ((unsigned char)q[1])) {
+         if (n == room) {
+            room *= 2;
+            glyphs = realloc (glyphs, room * sizeof (struct Glyph));
+            if (glyphs == NULL) break;
+         }
+         glyphs[n].codept = codept;
+         glyphs[n].key    = p;
+         glyphs[n].keylen = q - p;
+         glyphs[n].bitmap = ++q;
+         while (q < end && isxdigit ((unsigned char)*q)) q++;
+         glyphs[n].bitlen = q - glyphs[n].bitmap;
+         if (n > 0 && codept < glyphs[n - 1].codept) in_order = 0;
+         n++;
+      }
+      p = memchr (p, '\n', end - p);
+      if (p == NULL) break;
+      p++;
+   }
+   if (glyphs == NULL) {
+      fprintf (stderr, "%s: out of memory.\n", progname);
+      exit (EXIT_FAILURE);
+   }
+
+   if (!in_order) {
+      sorted = malloc ((n + 1) * sizeof (struct Glyph));
+      if (sorted == NULL) {
+         fprintf (stderr, "%s: out of memory.\n", progname);
+         exit (EXIT_FAILURE);
+      }
+      for (shift = 0; shift < 32; shift += 8) {
+         memset (count, 0, sizeof (count));
+         for (i = 0; i < n; i++)
+            count[((glyphs[i].codept >> shift) & 0xFF) + 1]++;
+         for (digit = 1; digit <= 256 && count[digit] != n; digit++);
+         if (digit <= 256) continue;  /* all glyphs share this digit */
+         for (digit = 1; digit <= 256; digit++)
+            count[digit] += count[digit - 1];
+         for (i = 0; i < n; i++)
+            sorted[count[(glyphs[i].codept >> shift) & 0xFF]++] = glyphs[i];
+         tmp = glyphs; glyphs = sorted; sorted = tmp;
+      }
+      free (sorted);
+   }
+
+   /* Keep the last of each run of glyphs with the same code point. */
+   kept = 0;
+   for (i = 0; i < n; i++) {
+      if (kept > 0 && glyphs[kept - 1].codept == glyphs[i].codept)
+         glyphs[kept - 1] = glyphs[i];
+      else
+         glyphs[kept++] = glyphs[i];
+   }
+   *nglyphs = kept;
+   return glyphs;
+}
@@ -0,0 +1,54 @@
+/**
+   @file unihex.h
+
+   @brief Define the in-memory index of glyphs read from .hex files.
+
+   @author Paul Hardy
+
+   @copyright Copyright (C) 2023 Paul Hardy
+
+   The converters from .hex to other font formats (hex2bdf, hex2pcf)
+   read all of their input into memory and index it with the
+   functions in unihex-support.c.
+*/
+/*
+   LICENSE:
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 2 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _UNIHEX_H_
+#define _UNIHEX_H_
+
+#include <stdlib.h>
+
+
+/**
+   @brief One glyph, pointing into the input text.
+*/
+struct Glyph {
+   unsigned long codept;   ///< Code point of the glyph.
+   char *key;              ///< Code point as written in the input.
+   int   keylen;           ///< Number of characters in key.
+   char *bitmap;           ///< Hexadecimal bitmap as written in the input.
+   int   bitlen;           ///< Number of characters in bitmap.
+};
+
+
+char *read_input (const char *progname, char **names, int nnames,
+                  size_t *textlen);
+struct Glyph *index_glyphs (const char *progname, char *text, size_t textlen,
+                            unsigned long *nglyphs);
+
+#endif
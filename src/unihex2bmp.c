@@ -10,10 +10,19 @@
 
    This program reads in a GNU Unifont .hex file, extracts a range of
    256 code points, and converts it a Microsoft Bitmap (.bmp) or Wireless
-   Bitmap file.
+   Bitmap file.  The input can also be a binary glyph store made by
+   hex2ufb.  If the input file has an up to date .hexidx index from
+   hexindex, only the lines of the page are read.  The input can be
+   gzip or zstd compressed, and the output is compressed if its name
+   ends in ".gz" or ".zst".
+
+   With -d, the input is read once and every page that has a glyph is
+   written to its own file in the given directory, several pages at a
+   time in child processes.
 
    Synopsis: unihex2bmp [-iin_file.hex] [-oout_file.bmp]
                 [-f] [-phex_page_num] [-w]
+             unihex2bmp [-iin_file.hex] -dout_dir [-jjobs] [-f] [-w]
 */
 /*
    LICENSE:
@@ -46,9 +55,33 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "ufb.h"
+#include "hexidx.h"
+#include "unizio.h"
 
 #define MAXBUF 256
 
+/**
+   Value of hexadecimal digit c; c must be one of 0-9, A-F, or a-f.
+*/
+#define HEXVAL(c) ((c) <= '9' ? (c) - '0' : ((c) & 0x7) + 9)
+
+
+/**
+   @brief The glyphs of one page, for writing all pages with -d.
+*/
+struct Page {
+   unsigned char present[256];      ///< 1 if the code point has a glyph.
+   unsigned char rows[256][16][4];  ///< Rows 8..23 of each glyph's bitmap.
+};
+
 
 /**
    @brief GNU Unifont bitmaps for hexadecimal digits.
@@ -93,23 +126,18 @@ int flip=1;           ///< Transpose entire matrix as in Unicode book.
 
    @param[in] argc The count of command line arguments.
    @param[in] argv Pointer to array of command line arguments.
-   @return This program exits with status 0.
+   @return This program exits with status 0, or 1 if a page in a
+           directory of pages could not be written.
 */
 int
 main (int argc, char *argv[])
 {
 
-   int i, j;                  /* loop variables                    */
+   int i;                     /* loop variable                     */
    unsigned k0;               /* temp Unicode char variable        */
-   unsigned swap;             /* temp variable for swapping values */
    char inbuf[256];           /* input buffer                      */
-   unsigned filesize;         /* size of file in bytes             */
-   unsigned bitmapsize;       /* size of bitmap image in bytes     */
-   unsigned thischar;         /* the current character             */
-   unsigned char thischarbyte; /* unsigned char lowest byte of Unicode char */
-   int thischarrow;           /* row 0..15 where this character belongs  */
-   int thiscol;               /* column 0..15 where this character belongs */
-   int toppixelrow;           /* pixel row, 0..16*32-1               */
+   unsigned long thischar;    /* the current character             */
+   char *colon;               /* end of the code point in inbuf    */
    unsigned lastpage=0;       /* the last Unicode page read in font file */
    int wbmp=0;                /* set to 1 if writing .wbmp format file */
 
@@ -117,7 +145,18 @@ main (int argc, char *argv[])
    unsigned char charbits[32][4];  /* bitmap for one character, 4 bytes/row */
 
    char *infile="", *outfile="";  /* names of input and output files */
+   char *outdir="";         /* directory for all pages, with -d        */
    FILE *infp, *outfp;      /* file pointers of input and output files */
+   struct Ufb *ufb;         /* input, if it is a .ufb file             */
+   long endpos;             /* where the page ends, if indexed; or -1  */
+
+   static struct Page *pages[UFB_PAGES]; /* glyphs of each page, with -d */
+   unsigned page;           /* page number, with -d                    */
+   int jobs;                /* most pages written at once, with -d     */
+   int running = 0;         /* child processes writing pages           */
+   int status;              /* exit status of a child process          */
+   int failed = 0;          /* 1 if a page could not be written        */
+   pid_t pid;
 
    /* initializes bitmap row/col labeling, &c. */
    int init (unsigned char bitmap[17*32][18*4]);
@@ -125,18 +164,38 @@ main (int argc, char *argv[])
    /* convert hex string --> bitmap */
    int hex2bit (char *instring, unsigned char character[32][4]);
 
-   bitmapsize = 17*32*18*4;  /* 17 rows by 18 cols, each 4 bytes */
+   /* copy one glyph bitmap into its cell of the page bitmap */
+   void place_glyph (unsigned char bitmap[17*32][18*4], unsigned thischarbyte,
+                     unsigned char charbits[32][4]);
+
+   /* write the page bitmap as a .bmp or .wbmp file */
+   int write_bitmap (FILE *outfp, unsigned char bitmap[17*32][18*4],
+                     int wbmp);
+
+   /* write one page of a directory of pages */
+   int write_page (struct Page *glyphs, unsigned page, char *outdir,
+                   int wbmp);
+
+   jobs = (int)sysconf (_SC_NPROCESSORS_ONLN);
+   if (jobs < 1) jobs = 1;
 
    if (argc > 1) {
       for (i = 1; i < argc; i++) {
          if (argv[i][0] == '-') {  /* this is an option argument */
             switch (argv[i][1]) {
+               case 'd':  /* directory for every page in the input */
+                  outdir = &argv[i][2];
+                  break;
                case 'f':  /* flip (transpose) glyphs in bitmap as in standard */
                   flip = !flip;
                   break;
                case 'i':  /* name of input file */
                   infile = &argv[i][2];
                   break;
+               case 'j':  /* most pages written at once with -d */
+                  jobs = atoi (&argv[i][2]);
+                  if (jobs < 1) jobs = 1;
+                  break;
                case 'o':  /* name of output file */
                   outfile = &argv[i][2];
                   break;
@@ -149,12 +208,16 @@ main (int argc, char *argv[])
                default:   /* if unrecognized option, print list and exit */
                   fprintf (stderr, "\nSyntax:\n\n");
                   fprintf (stderr, "   %s -p<Unicode_Page> ", argv[0]);
-                  fprintf (stderr, "-i<Input_File> -o<Output_File> -w\n\n");
+                  fprintf (stderr, "-i<Input_File> -o<Output_File> -w\n");
+                  fprintf (stderr, "   %s -i<Input_File> ", argv[0]);
+                  fprintf (stderr, "-d<Output_Dir> -j<Jobs> -w\n\n");
                   fprintf (stderr, "   -w specifies .wbmp output instead of ");
                   fprintf (stderr, "default Windows .bmp output.\n\n");
                   fprintf (stderr, "   -p is followed by 1 to 6 ");
                   fprintf (stderr, "Unicode page hex digits ");
                   fprintf (stderr, "(default is Page 0).\n\n");
+                  fprintf (stderr, "   -d writes every page with glyphs ");
+                  fprintf (stderr, "to the directory, as uniXXXX.bmp.\n\n");
                   fprintf (stderr, "\nExample:\n\n");
                   fprintf (stderr, "   %s -p83 -iunifont.hex -ou83.bmp\n\n\n",
                          argv[0]);
@@ -163,21 +226,90 @@ main (int argc, char *argv[])
          }
       }
    }
+   if (strlen (outdir) > 0 && strlen (outfile) > 0) {
+      fprintf (stderr, "Error: -o and -d can't be used together.\n");
+      exit (1);
+   }
    /*
       Make sure we can open any I/O files that were specified before
       doing anything else.
    */
    if (strlen (infile) > 0) {
-      if ((infp = fopen (infile, "r")) == NULL) {
+      if ((infp = zio_open (infile, "r")) == NULL) {
          fprintf (stderr, "Error: can't open %s for input.\n", infile);
          exit (1);
       }
    }
    else {
-      infp = stdin;
+      infp = zio_wrap (stdin, "stdin");
+   }
+   ufb = ufb_fdopen (fileno (infp), strlen (infile) == 0 ? "stdin" : infile);
+
+   if (strlen (outdir) > 0) {
+      if (mkdir (outdir, 0777) != 0 && errno != EEXIST) {
+         fprintf (stderr, "Error: can't make directory %s.\n", outdir);
+         exit (1);
+      }
+      /*
+         Read the whole input once, keeping each glyph's bitmap with
+         the other glyphs of its page.
+      */
+      while (ufb != NULL ? ufb_gets (ufb, inbuf, MAXBUF-1)
+                         : fgets (inbuf, MAXBUF-1, infp) != NULL) {
+         thischar = strtoul (inbuf, &colon, 16);
+         if (*colon != ':' || thischar >= UFB_END)
+            continue;
+         page = thischar >> 8;
+         if (pages[page] == NULL &&
+             (pages[page] = calloc (1, sizeof (struct Page))) == NULL) {
+            fprintf (stderr, "Error: out of memory.\n");
+            exit (1);
+         }
+         hex2bit (colon + 1, charbits);
+         pages[page]->present[thischar & 0xff] = 1;
+         memcpy (pages[page]->rows[thischar & 0xff], charbits[8], 16*4);
+      }
+      /*
+         Write each page in a child process, with at most "jobs"
+         running at once.  The children share the glyphs read above
+         with this process.
+      */
+      fflush (stdout);
+      fflush (stderr);
+      for (page = 0; page < UFB_PAGES; page++) {
+         if (pages[page] == NULL)
+            continue;
+         if (jobs == 1) {
+            failed |= write_page (pages[page], page, outdir, wbmp);
+            continue;
+         }
+         if (running == jobs) {
+            if (wait (&status) < 0 || !WIFEXITED (status) ||
+                WEXITSTATUS (status) != EXIT_SUCCESS)
+               failed = 1;
+            running--;
+         }
+         pid = fork ();
+         if (pid == 0) {
+            exit (write_page (pages[page], page, outdir, wbmp) ?
+                  EXIT_FAILURE : EXIT_SUCCESS);
+         }
+         else if (pid < 0)
+            failed |= write_page (pages[page], page, outdir, wbmp);
+         else
+            running++;
+      }
+      while (running > 0) {
+         if (wait (&status) < 0 || !WIFEXITED (status) ||
+             WEXITSTATUS (status) != EXIT_SUCCESS)
+            failed = 1;
+         running--;
+      }
+      exit (failed ? EXIT_FAILURE : EXIT_SUCCESS);
    }
+
    if (strlen (outfile) > 0) {
-      if ((outfp = fopen (outfile, "w")) == NULL) {
+      if ((outfp = zio_open (outfile, "w")) == NULL) {
          fprintf (stderr, "Error: can't open %s for output.\n", outfile);
          exit (1);
       }
@@ -189,65 +321,178 @@ main (int argc, char *argv[])
    (void)init(bitmap); /* initialize bitmap with row/column headers, etc. */
 
    /*
-      Read in the characters in the page
+      Read in the characters in the page.  A binary glyph store from
+      hex2ufb is indexed, as is a .hex file with a .hexidx file from
+      hexindex, so go straight to the page.
    */
-   while (lastpage <= unipage && fgets (inbuf, MAXBUF-1, infp) != NULL) {
-      sscanf (inbuf, "%x", &thischar);
+   endpos = -1;
+   if (ufb != NULL) ufb_seek (ufb, (unsigned long)unipage << 8);
+   else if (strlen (infile) > 0) hexidx_seek (infp, infile, unipage, unipage, &endpos);
+   while (lastpage <= unipage &&
+          (ufb != NULL ? ufb_gets (ufb, inbuf, MAXBUF-1)
+                       : (endpos < 0 || ftell (infp) < endpos) &&
+                         fgets (inbuf, MAXBUF-1, infp) != NULL)) {
+      thischar = strtoul (inbuf, &colon, 16);
       lastpage = thischar >> 8; /* keep Unicode page to see if we can stop */
       if (lastpage == unipage) {
-         thischarbyte = (unsigned char)(thischar & 0xff);
          for (k0=0; inbuf[k0] != ':'; k0++);
          k0++;
          hex2bit (&inbuf[k0], charbits);  /* convert hex string to 32*4 bitmap */
+         place_glyph (bitmap, (unsigned)(thischar & 0xff), charbits);
+      }
+   }
+   write_bitmap (outfp, bitmap, wbmp);
+   fclose (outfp);  /* completes a compressed output file */
+   exit (0);
+}
 
-         /*
-            Now write character bitmap upside-down in page array, to match
-            .bmp file order.  In the .wbmp` and .bmp files, white is a '1'
-            bit and black is a '0' bit, so complement charbits[][].
-         */
-
-         thiscol = (thischarbyte & 0xf) + 2;  /* column number will be 1..16  */
-         thischarrow = thischarbyte >> 4;     /* charcter row number, 0..15   */
-         if (flip) {  /* swap row and column placement */
-            swap = thiscol;
-            thiscol = thischarrow;
-            thischarrow = swap;
-            thiscol += 2;       /* column index starts at 1 */
-            thischarrow -= 2;   /* row index starts at 0    */
-         }
-         toppixelrow = 32 * (thischarrow + 1) - 1; /* from bottom to top    */
-   
-         /*
-            Copy the center of charbits[][] because hex characters only
-            occupy rows 8 to 23 and column byte 2 (and for 16 bit wide
-            characters, byte 3).  The charbits[][] array was given 32 rows
-            and 4 column bytes for completeness in the beginning.
-         */
-         for (i=8; i<24; i++) {
-            bitmap[toppixelrow + i][(thiscol << 2) | 0] =
-               ~charbits[i][0] & 0xff;
-            bitmap[toppixelrow + i][(thiscol << 2) | 1] =
-               ~charbits[i][1] & 0xff;
-            bitmap[toppixelrow + i][(thiscol << 2) | 2] =
-               ~charbits[i][2] & 0xff;
-            /* Only use first 31 bits; leave vertical rule in 32nd column */
-            bitmap[toppixelrow + i][(thiscol << 2) | 3] =
-               ~charbits[i][3] & 0xfe;
-         }
-         /*
-            Leave white space in 32nd column of rows 8, 14, 15, and 23
-            to leave 16 pixel height upper, middle, and lower guides.
-         */
-         bitmap[toppixelrow +  8][(thiscol << 2) | 3] |= 1;
-         bitmap[toppixelrow + 14][(thiscol << 2) | 3] |= 1;
-         bitmap[toppixelrow + 15][(thiscol << 2) | 3] |= 1;
-         bitmap[toppixelrow + 23][(thiscol << 2) | 3] |= 1;
+
+/**
+   @brief Write one page of a directory of pages.
+
+   The page is written to the file uniXXXX.bmp, or uniXXXX.wbmp,
+   in the output directory, where XXXX is the page number in
+   hexadecimal.
+
+   @param[in] glyphs The glyphs in the page.
+   @param[in] page The page number, 0x0000..0x10FF.
+   @param[in] outdir The output directory.
+   @param[in] wbmp 1 to write a .wbmp file, 0 to write a .bmp file.
+   @return 0 if the page was written, or 1 on error.
+*/
+int
+write_page (struct Page *glyphs, unsigned page, char *outdir, int wbmp)
+{
+   int i;
+   unsigned char bitmap[17*32][18*4]; /* final bitmap */
+   unsigned char charbits[32][4];  /* bitmap for one character, 4 bytes/row */
+   char *outname;
+   FILE *outfp;
+   int failed;
+
+   int init (unsigned char bitmap[17*32][18*4]);
+   void place_glyph (unsigned char bitmap[17*32][18*4], unsigned thischarbyte,
+                     unsigned char charbits[32][4]);
+   int write_bitmap (FILE *outfp, unsigned char bitmap[17*32][18*4],
+                     int wbmp);
+
+   outname = malloc (strlen (outdir) + 16);
+   if (outname == NULL) {
+      fprintf (stderr, "Error: out of memory.\n");
+      return 1;
+   }
+   sprintf (outname, "%s/uni%04X.%s", outdir, page, wbmp ? "wbmp" : "bmp");
+   if ((outfp = fopen (outname, "wb")) == NULL) {
+      fprintf (stderr, "Error: can't open %s for output.\n", outname);
+      free (outname);
+      return 1;
+   }
+
+   unipage = page;
+   (void)init (bitmap);
+   memset (charbits, 0, sizeof (charbits));
+   for (i = 0; i < 256; i++) {
+      if (glyphs->present[i]) {
+         memcpy (charbits[8], glyphs->rows[i], 16*4);
+         place_glyph (bitmap, i, charbits);
       }
    }
+
+   failed = write_bitmap (outfp, bitmap, wbmp);
+   if (fclose (outfp) != 0 || failed) {
+      fprintf (stderr, "Error: can't write %s.\n", outname);
+      failed = 1;
+   }
+   free (outname);
+   return failed;
+}
+
+
+/**
+   @brief Copy a glyph into its cell in the page bitmap.
+
+   @param[in,out] bitmap The page bitmap, from init.
+   @param[in] thischarbyte The low 8 bits of the glyph's code point.
+   @param[in] charbits The glyph bitmap, from hex2bit.
+*/
+void
+place_glyph (unsigned char bitmap[17*32][18*4], unsigned thischarbyte,
+             unsigned char charbits[32][4])
+{
+   int i;
+   unsigned swap;             /* temp variable for swapping values */
+   int thischarrow;           /* row 0..15 where this character belongs  */
+   int thiscol;               /* column 0..15 where this character belongs */
+   int toppixelrow;           /* pixel row, 0..16*32-1               */
+
+   /*
+      Now write character bitmap upside-down in page array, to match
+      .bmp file order.  In the .wbmp` and .bmp files, white is a '1'
+      bit and black is a '0' bit, so complement charbits[][].
+   */
+
+   thiscol = (thischarbyte & 0xf) + 2;  /* column number will be 1..16  */
+   thischarrow = thischarbyte >> 4;     /* charcter row number, 0..15   */
+   if (flip) {  /* swap row and column placement */
+      swap = thiscol;
+      thiscol = thischarrow;
+      thischarrow = swap;
+      thiscol += 2;       /* column index starts at 1 */
+      thischarrow -= 2;   /* row index starts at 0    */
+   }
+   toppixelrow = 32 * (thischarrow + 1) - 1; /* from bottom to top    */
+
    /*
-      Now write the appropriate bitmap file format, either
-      Wireless Bitmap or Microsoft Windows bitmap.
+      Copy the center of charbits[][] because hex characters only
+      occupy rows 8 to 23 and column byte 2 (and for 16 bit wide
+      characters, byte 3).  The charbits[][] array was given 32 rows
+      and 4 column bytes for completeness in the beginning.
    */
+   for (i=8; i<24; i++) {
+      bitmap[toppixelrow + i][(thiscol << 2) | 0] =
+         ~charbits[i][0] & 0xff;
+      bitmap[toppixelrow + i][(thiscol << 2) | 1] =
+         ~charbits[i][1] & 0xff;
+      bitmap[toppixelrow + i][(thiscol << 2) | 2] =
+         ~charbits[i][2] & 0xff;
+      /* Only use first 31 bits; leave vertical rule in 32nd column */
+      bitmap[toppixelrow + i][(thiscol << 2) | 3] =
+         ~charbits[i][3] & 0xfe;
+   }
+   /*
+      Leave white space in 32nd column of rows 8, 14, 15, and 23
+      to leave 16 pixel height upper, middle, and lower guides.
+   */
+   bitmap[toppixelrow +  8][(thiscol << 2) | 3] |= 1;
+   bitmap[toppixelrow + 14][(thiscol << 2) | 3] |= 1;
+   bitmap[toppixelrow + 15][(thiscol << 2) | 3] |= 1;
+   bitmap[toppixelrow + 23][(thiscol << 2) | 3] |= 1;
+
+   return;
+}
+
+
+/**
+   @brief Write the page bitmap as a bitmap graphics file.
+
+   Write the appropriate bitmap file format, either Wireless Bitmap
+   or Microsoft Windows bitmap.  Each pixel row of the bitmap is
+   written with one fwrite.
+
+   @param[in] outfp The output file.
+   @param[in] bitmap The page bitmap.
+   @param[in] wbmp 1 to write a .wbmp file, 0 to write a .bmp file.
+   @return 0 if the file was written, or 1 on a write error.
+*/
+int
+write_bitmap (FILE *outfp, unsigned char bitmap[17*32][18*4], int wbmp)
+{
+   unsigned filesize;         /* size of file in bytes             */
+   unsigned bitmapsize;       /* size of bitmap image in bytes     */
+   int toppixelrow;           /* pixel row, 0..16*32-1             */
+
+   bitmapsize = 17*32*18*4;  /* 17 rows by 18 cols, each 4 bytes */
+
    if (wbmp) {  /* Write a Wireless Bitmap .wbmp format file */
       /*
          Write WBMP header
@@ -259,14 +504,8 @@ main (int argc, char *argv[])
       /*
          Write bitmap image
       */
-      for (toppixelrow=0; toppixelrow <= 17*32-1; toppixelrow++) {
-         for (j=0; j<18; j++) {
-            fprintf (outfp, "%c", bitmap[toppixelrow][(j<<2)    ]);
-            fprintf (outfp, "%c", bitmap[toppixelrow][(j<<2) | 1]);
-            fprintf (outfp, "%c", bitmap[toppixelrow][(j<<2) | 2]);
-            fprintf (outfp, "%c", bitmap[toppixelrow][(j<<2) | 3]);
-         }
-      }
+      for (toppixelrow=0; toppixelrow <= 17*32-1; toppixelrow++)
+         fwrite (bitmap[toppixelrow], 1, 18*4, outfp);
    }
    else {  /* otherwise, write a Microsoft Windows .bmp format file */
       /*
@@ -336,17 +575,11 @@ main (int argc, char *argv[])
          left-hand corner of the image to the upper right-hand corner
          of the image.
       */
-      for (toppixelrow=17*32-1; toppixelrow >= 0; toppixelrow--) {
-         for (j=0; j<18; j++) {
-            fprintf (outfp, "%c", bitmap[toppixelrow][(j<<2)    ]);
-            fprintf (outfp, "%c", bitmap[toppixelrow][(j<<2) | 1]);
-            fprintf (outfp, "%c", bitmap[toppixelrow][(j<<2) | 2]);
-
-            fprintf (outfp, "%c", bitmap[toppixelrow][(j<<2) | 3]);
-         }
-      }
+      for (toppixelrow=17*32-1; toppixelrow >= 0; toppixelrow--)
+         fwrite (bitmap[toppixelrow], 1, 18*4, outfp);
    }
-   exit (0);
+
+   return (ferror (outfp) ? 1 : 0);
 }
 
 
@@ -355,12 +588,12 @@ main (int argc, char *argv[])
 
    Convert the portion of a hex string after the ':' into a character bitmap.
 
-   If string is >= 128 characters, it will fill all 4 bytes per row.
-   If string is >= 64 characters and < 128, it will fill 2 bytes per row.
-   Otherwise, it will fill 1 byte per row.
+   The glyph width comes from the number of hexadecimal digits: 32 digits
+   fill 1 byte per row, 64 fill 2, 96 fill 3, and 128 fill all 4 bytes
+   per row.  Pairs of digits are decoded straight into bytes.
 
    @param[in] instring The character array containing the glyph bitmap.
-   @param[out] character Glyph bitmap, 8, 16, or 32 columns by 16 rows tall.
+   @param[out] character Glyph bitmap, 8, 16, 24, or 32 columns by 16 rows tall.
    @return Always returns 0.
 */
 int
@@ -368,39 +601,32 @@ hex2bit (char *instring, unsigned char character[32][4])
 {
 
    int i;  /* current row in bitmap character */
-   int j;  /* current character in input string */
-   int k;  /* current byte in bitmap character */
-   int width;  /* number of output bytes to fill - 1: 0, 1, 2, or 3 */
+   int j;  /* current byte in this row */
+   int k;  /* first byte of each row to fill */
+   int ndigits;  /* number of hexadecimal digits in instring */
+   int nbytes;   /* number of bytes per row to fill: 1, 2, 3, or 4 */
+   int nrows;    /* number of rows to fill, 16 unless instring is short */
+   unsigned char *digit;  /* next hexadecimal digit pair in instring */
 
    for (i=0; i<32; i++)  /* erase previous character */
       character[i][0] = character[i][1] = character[i][2] = character[i][3] = 0; 
-   j=0;  /* current location is at beginning of instring */
-
-   if (strlen (instring) <= 34)  /* 32 + possible '\r', '\n' */
-      width = 0;
-   else if (strlen (instring) <= 66)  /* 64 + possible '\r', '\n' */
-      width = 1;
-   else if (strlen (instring) <= 98)  /* 96 + possible '\r', '\n' */
-      width = 3;
-   else  /* the maximum allowed is quadruple-width */
-      width = 4;
-
-   k = (width > 1) ? 0 : 1; /* if width > double, start at index 1 else at 0 */
-
-   for (i=8; i<24; i++) {  /* 16 rows per input character, rows 8..23 */
-      sscanf (&instring[j], "%2hhx", &character[i][k]);
-      j += 2;
-      if (width > 0) { /* add next pair of hex digits to this row */
-         sscanf (&instring[j], "%2hhx", &character[i][k+1]);
-         j += 2;
-         if (width > 1) { /* add next pair of hex digits to this row */
-            sscanf (&instring[j], "%2hhx", &character[i][k+2]);
-            j += 2;
-            if (width > 2) {  /* quadruple-width is maximum width */
-               sscanf (&instring[j], "%2hhx", &character[i][k+3]);
-               j += 2;
-            }
-         }
+
+   for (ndigits = 0; isxdigit ((unsigned char)instring[ndigits]); ndigits++);
+
+   nbytes = ndigits / 32;
+   if (nbytes < 1) nbytes = 1;
+   else if (nbytes > 4) nbytes = 4;  /* the maximum allowed is quadruple-width */
+
+   nrows = ndigits / (2 * nbytes);
+   if (nrows > 16) nrows = 16;
+
+   k = (nbytes > 2) ? 0 : 1; /* if width > double, start at index 0 else at 1 */
+
+   digit = (unsigned char *)instring;
+   for (i=8; i<8+nrows; i++) {  /* 16 rows per input character, rows 8..23 */
+      for (j=k; j<k+nbytes; j++) {
+         character[i][j] = (HEXVAL (digit[0]) << 4) | HEXVAL (digit[1]);
+         digit += 2;
       }
    }
 
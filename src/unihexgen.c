@@ -24,6 +24,12 @@
 
        This generates the Private Use Area glyph file.
 
+   The glyph rows of every pair of digits (for four-digit code points)
+   and every triple of digits (for six-digit code points) are rendered
+   as hexadecimal text once, at the start, so each glyph line is put
+   together from a template with two copies and written out in large
+   blocks.
+
    This utility program works in Roman Czyborra's unifont.hex file
    format, the basis of the GNU Unifont package.
 */
@@ -49,6 +55,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#define LINE4 (5 + 64 + 1)  ///< Bytes in a "XXXX:..." glyph line.
+#define LINE6 (7 + 64 + 1)  ///< Bytes in a "XXXXXX:..." glyph line.
+#define BLOCK_LINES 4096    ///< Glyph lines written with one fwrite.
 
 
 /**
@@ -77,9 +88,9 @@
    (binary 1111, or 0xF) to form white digits on a black background.
 
 
-   Functions hexprint4 and hexprint6 share the hexdigit array;
-   they print four-digit and six-digit hexadecimal code points
-   in a single glyph, respectively.
+   Function init_rows renders the hexdigit array into the
+   pair_rows and triple_rows tables, for four-digit and six-digit
+   hexadecimal code points in a single glyph, respectively.
 */
 char hexdigit[16][5] = {
    {0x6,0x9,0x9,0x9,0x6},  /* 0x0 */
@@ -101,6 +112,25 @@ char hexdigit[16][5] = {
 };
 
 
+/**
+   Glyph rows 2..6 or 9..13 of a four-digit code point glyph, as 20
+   hexadecimal digits, for each pair of code point digits.
+*/
+char pair_rows[0x100][20];
+
+/**
+   Glyph rows 2..6 or 9..13 of a six-digit code point glyph, as 20
+   hexadecimal digits, for each triple of code point digits.
+*/
+char triple_rows[0x1000][20];
+
+char line4[LINE4];  ///< A four-digit code point glyph line, without digits.
+char line6[LINE6];  ///< A six-digit code point glyph line, without digits.
+
+/** Hexadecimal digits for printing. */
+const char hexchars[] = "0123456789ABCDEF";
+
+
 /**
    @brief The main function.
 
@@ -113,8 +143,12 @@ main (int argc, char *argv[])
 {
 
    int startcp, endcp, thiscp;
-   void hexprint4(int); /* function to print one 4-digit unifont.hex code point */
-   void hexprint6(int); /* function to print one 6-digit unifont.hex code point */
+   char *block;     /* glyph lines waiting to be written */
+   char *out;       /* next glyph line in block          */
+   int nlines;      /* glyph lines in block              */
+   int i;
+
+   void init_rows (void); /* render the digit rows of each glyph */
 
    if (argc != 3) {
       fprintf (stderr,"\n%s - generate unifont.hex code points as\n", argv[0]);
@@ -133,148 +167,106 @@ main (int argc, char *argv[])
    startcp &= 0xFFFFFF; /* limit to 6 hex digits */
    endcp   &= 0xFFFFFF; /* limit to 6 hex digits */
 
+   init_rows ();
+   if ((block = malloc (BLOCK_LINES * LINE6)) == NULL) {
+      fprintf (stderr, "%s: out of memory.\n", argv[0]);
+      exit (EXIT_FAILURE);
+   }
+
    /*
-      For each code point in the desired range, generate a glyph.
+      For each code point in the desired range, generate a glyph:
+      digits 2/line, 2 lines for a four-digit code point, or digits
+      3/line, 2 lines for a six-digit code point.  Rows 2..6 of the
+      glyph are characters 8..27 of its bitmap string, and rows 9..13
+      are characters 36..55.
    */
+   out = block;
+   nlines = 0;
    for (thiscp = startcp; thiscp <= endcp; thiscp++) {
       if (thiscp <= 0xFFFF) {
-         hexprint4 (thiscp); /* print digits 2/line, 2 lines */
+         memcpy (out, line4, LINE4);
+         for (i = 0; i < 4; i++)
+            out[i] = hexchars[(thiscp >> (12 - 4 * i)) & 0xF];
+         memcpy (&out[5 +  8], pair_rows[thiscp >> 8],   20);
+         memcpy (&out[5 + 36], pair_rows[thiscp & 0xFF], 20);
+         out += LINE4;
       }
       else {
-         hexprint6 (thiscp); /* print digits 3/line, 2 lines */
+         memcpy (out, line6, LINE6);
+         for (i = 0; i < 6; i++)
+            out[i] = hexchars[(thiscp >> (20 - 4 * i)) & 0xF];
+         memcpy (&out[7 +  8], triple_rows[thiscp >> 12],   20);
+         memcpy (&out[7 + 36], triple_rows[thiscp & 0xFFF], 20);
+         out += LINE6;
+      }
+      if (++nlines == BLOCK_LINES) {
+         fwrite (block, 1, out - block, stdout);
+         out = block;
+         nlines = 0;
       }
    }
-   exit (EXIT_SUCCESS);
-}
-
-
-/**
-   @brief Generate a bitmap containing a 4-digit Unicode code point.
-
-   Takes a 4-digit Unicode code point as an argument
-   and prints a unifont.hex string for it to stdout.
-
-   @param[in] thiscp The current code point for which to generate a glyph.
-*/
-void
-hexprint4 (int thiscp)
-{
-
-   int grid[16]; /* the glyph grid we'll build */
-
-   int row;      /* row number in current glyph */
-   int digitrow; /* row number in current hex digit being rendered */
-   int rowbits;  /* 1 & 0 bits to draw current glyph row */
-
-   int d1, d2, d3, d4; /* four hexadecimal digits of each code point */
-
-   d1 = (thiscp >> 12) & 0xF;
-   d2 = (thiscp >>  8) & 0xF;
-   d3 = (thiscp >>  4) & 0xF;
-   d4 = (thiscp      ) & 0xF;
-
-   /* top and bottom rows are white */
-   grid[0] = grid[15] = 0x0000;
-
-   /* 14 inner rows are 14-pixel wide black lines, centered */
-   for (row = 1; row < 15; row++) grid[row] = 0x7FFE;
-
-   printf ("%04X:", thiscp);
-
-   /*
-      Render the first row of 2 hexadecimal digits
-   */
-   digitrow = 0; /* start at top of first row of digits to render */
-   for (row = 2; row < 7; row++) {
-      rowbits = (hexdigit[d1][digitrow] << 9) |
-                (hexdigit[d2][digitrow] << 3);
-      grid[row] ^= rowbits; /* digits appear as white on black background */
-      digitrow++;
-   }
+   fwrite (block, 1, out - block, stdout);
 
-   /*
-      Render the second row of 2 hexadecimal digits
-   */
-   digitrow = 0; /* start at top of first row of digits to render */
-   for (row = 9; row < 14; row++) {
-      rowbits = (hexdigit[d3][digitrow] << 9) |
-                (hexdigit[d4][digitrow] << 3);
-      grid[row] ^= rowbits; /* digits appear as white on black background */
-      digitrow++;
+   if (fflush (stdout) != 0) {
+      fprintf (stderr, "%s: write error.\n", argv[0]);
+      exit (EXIT_FAILURE);
    }
-
-   for (row = 0; row < 16; row++) printf ("%04X", grid[row] & 0xFFFF);
-
-   putchar ('\n');
-
-   return;
+   exit (EXIT_SUCCESS);
 }
 
 
 /**
-   @brief Generate a bitmap containing a 6-digit Unicode code point.
+   @brief Render the digit rows of every glyph.
 
-   Takes a 6-digit Unicode code point as an argument
-   and prints a unifont.hex string for it to stdout.
+   Fill in pair_rows[] and triple_rows[] from hexdigit[][], and the
+   line4 and line6 templates with the rows that have no digits.
 
-   @param[in] thiscp The current code point for which to generate a glyph.
+   A four-digit glyph has its 14 inner rows as 14-pixel wide black
+   lines, centered, with 2 digits shifted left by 9 and 3 bits.  A
+   six-digit glyph has its 14 inner rows as 16-pixel wide black lines,
+   with 3 digits shifted left by 11, 6, and 1 bits.  Digits appear as
+   white on the black background.  The top and bottom rows are white.
 */
 void
-hexprint6 (int thiscp)
+init_rows (void)
 {
-
-   int grid[16]; /* the glyph grid we'll build */
-
-   int row;      /* row number in current glyph */
-   int digitrow; /* row number in current hex digit being rendered */
-   int rowbits;  /* 1 & 0 bits to draw current glyph row */
-
-   int d1, d2, d3, d4, d5, d6; /* six hexadecimal digits of each code point */
-
-   d1 = (thiscp >> 20) & 0xF;
-   d2 = (thiscp >> 16) & 0xF;
-   d3 = (thiscp >> 12) & 0xF;
-   d4 = (thiscp >>  8) & 0xF;
-   d5 = (thiscp >>  4) & 0xF;
-   d6 = (thiscp      ) & 0xF;
-
-   /* top and bottom rows are white */
-   grid[0] = grid[15] = 0x0000;
-
-   /* 14 inner rows are 16-pixel wide black lines, centered */
-   for (row = 1; row < 15; row++) grid[row] = 0xFFFF;
-
-
-   printf ("%06X:", thiscp);
-
-   /*
-      Render the first row of 3 hexadecimal digits
-   */
-   digitrow = 0; /* start at top of first row of digits to render */
-   for (row = 2; row < 7; row++) {
-      rowbits = (hexdigit[d1][digitrow] << 11) |
-                (hexdigit[d2][digitrow] <<  6) |
-                (hexdigit[d3][digitrow] <<  1);
-      grid[row] ^= rowbits; /* digits appear as white on black background */
-      digitrow++;
+   int i;         /* pair or triple of digits */
+   int digitrow;  /* row number in current hex digit being rendered */
+   int rowbits;   /* 1 & 0 bits to draw current glyph row */
+   int k;
+
+   for (i = 0; i < 0x100; i++) {
+      for (digitrow = 0; digitrow < 5; digitrow++) {
+         rowbits = 0x7FFE ^
+                   ((hexdigit[(i >> 4) & 0xF][digitrow] << 9) |
+                    (hexdigit[ i       & 0xF][digitrow] << 3));
+         for (k = 0; k < 4; k++)
+            pair_rows[i][4 * digitrow + k] =
+               hexchars[(rowbits >> (12 - 4 * k)) & 0xF];
+      }
    }
 
-   /*
-      Render the second row of 3 hexadecimal digits
-   */
-   digitrow = 0; /* start at top of first row of digits to render */
-   for (row = 9; row < 14; row++) {
-      rowbits = (hexdigit[d4][digitrow] << 11) |
-                (hexdigit[d5][digitrow] <<  6) |
-                (hexdigit[d6][digitrow] <<  1);
-      grid[row] ^= rowbits; /* digits appear as white on black background */
-      digitrow++;
+   for (i = 0; i < 0x1000; i++) {
+      for (digitrow = 0; digitrow < 5; digitrow++) {
+         rowbits = 0xFFFF ^
+                   ((hexdigit[(i >> 8) & 0xF][digitrow] << 11) |
+                    (hexdigit[(i >> 4) & 0xF][digitrow] <<  6) |
+                    (hexdigit[ i       & 0xF][digitrow] <<  1));
+         for (k = 0; k < 4; k++)
+            triple_rows[i][4 * digitrow + k] =
+               hexchars[(rowbits >> (12 - 4 * k)) & 0xF];
+      }
    }
 
-   for (row = 0; row < 16; row++) printf ("%04X", grid[row] & 0xFFFF);
-
-   putchar ('\n');
+   /* top and bottom rows are white; the rest start as black lines */
+   memcpy (line4, "XXXX:0000", 9);
+   memcpy (line6, "XXXXXX:0000", 11);
+   for (k = 1; k < 15; k++) {
+      memcpy (&line4[5 + 4 * k], "7FFE", 4);
+      memcpy (&line6[7 + 4 * k], "FFFF", 4);
+   }
+   memcpy (&line4[5 + 60], "0000\n", 5);
+   memcpy (&line6[7 + 60], "0000\n", 5);
 
    return;
 }
-
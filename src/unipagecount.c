@@ -10,7 +10,11 @@
 
    This program counts the number of glyphs that are defined in each
    "page" of 256 code points, and prints the counts in an 8 x 8 grid.
-   Input is from stdin.  Output is to stdout.
+   Input is from stdin or the file named with -i, either a .hex file
+   or a binary glyph store made by hex2ufb.  Output is to stdout.
+   If a .hex file named with -i has an up to date .hexidx index from
+   hexindex, only the lines of the page or plane counted are read.
+   A .hex input file can be gzip or zstd compressed.
 
    The background color of each cell in a 16-by-16 grid of 256 code points
    is shaded to indicate percentage coverage.  Red indicates 0% coverage,
@@ -27,6 +31,7 @@
              unipagecount -h < font_file.hex              -- HTML table
              unipagecount -P1 -h < font.hex > count.html  -- Plane 1, HTML out
              unipagecount -l < font_file.hex              -- linked HTML table
+             unipagecount -P1 -ifont_file.hex             -- read named file
 */
 /*
    LICENSE:
@@ -56,6 +61,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "ufb.h"
+#include "hexidx.h"
+#include "unizio.h"
+
 #define MAXBUF 256 ///< Maximum input line size - 1.
 
 
@@ -80,6 +89,11 @@ main (int argc, char *argv[])
    int pageno=0; /* page number selected if only examining one page */
    int html=0;   /* =0: print plain text; =1: print HTML */
    int links=0;  /* =1: print HTML links; =0: don't print links */
+   unsigned long nextchar=0; /* where to look for the next .ufb glyph */
+   char *infile=NULL; /* input file name; NULL for stdin */
+   FILE *infp;   /* input file pointer */
+   struct Ufb *ufb; /* input, if it is a .ufb file */
+   long endpos=-1;  /* where the pages wanted end, if indexed; or -1 */
 
    /* make (print) flipped HTML table */
    void mkftable (unsigned plane, int pagecount[256], int links);
@@ -94,6 +108,9 @@ main (int argc, char *argv[])
                sscanf (&argv[1][2], "%x", &pageno);
                if (pageno >= 0 && pageno <= 255) onepage = 1;
                break;
+            case 'i':  /* read the named file instead of stdin */
+               infile = &argv[i][2];
+               break;
             case 'h':  /* print HTML table instead of text table */
                html = 1;
                break;
@@ -125,8 +142,31 @@ main (int argc, char *argv[])
       top to bottom.  The character is assumed to be 16 rows of variable
       width.
    */
-   while (fgets (inbuf, MAXBUF-1, stdin) != NULL) {
-      sscanf (inbuf, "%X", &unichar);
+   if (infile == NULL) {
+      infp = zio_wrap (stdin, "stdin");
+   }
+   else if ((infp = zio_open (infile, "r")) == NULL) {
+      fprintf (stderr, "Error: can't open %s for input.\n", infile);
+      exit (EXIT_FAILURE);
+   }
+   ufb = ufb_fdopen (fileno (infp), infile == NULL ? "stdin" : infile);
+   if (ufb == NULL && infile != NULL) {
+      /* Only read the page or plane being counted, if indexed. */
+      if (onepage)
+         hexidx_seek (infp, infile, pageno, pageno, &endpos);
+      else
+         hexidx_seek (infp, infile, plane << 8, (plane << 8) | 0xFF, &endpos);
+   }
+   for (;;) {
+      if (ufb != NULL) {  /* binary glyph store: no lines to parse */
+         if ((nextchar = ufb_next (ufb, nextchar)) == UFB_END) break;
+         unichar = nextchar++;
+      }
+      else {
+         if (endpos >= 0 && ftell (infp) >= endpos) break;
+         if (fgets (inbuf, MAXBUF-1, infp) == NULL) break;
+         sscanf (inbuf, "%X", &unichar);
+      }
       page = unichar >> 8;
       if (onepage) { /* only increment counter if this is page we want */
          if (page == pageno) { /* character is in the page we want */
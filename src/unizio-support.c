@@ -0,0 +1,559 @@
+/**
+   @file unizio-support.c
+
+   @brief Read and write gzip and zstd compressed files as plain streams.
+
+   @author Paul Hardy
+
+   @copyright Copyright (C) 2023 Paul Hardy
+
+   See unizio.h for how this is used.
+*/
+/*
+   LICENSE:
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 2 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE   /* for fopencookie */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "unizio.h"
+
+#if defined (__GLIBC__) || defined (__CYGWIN__) || defined (__linux__)
+#define ZIO_FOPENCOOKIE   ///< Make streams with fopencookie.
+#elif defined (__APPLE__) || defined (__FreeBSD__) || defined (__NetBSD__) \
+   || defined (__OpenBSD__) || defined (__DragonFly__)
+#define ZIO_FUNOPEN       ///< Make streams with funopen.
+#endif
+
+#define ZIO_BUFSIZE (1 << 16)   ///< Size of the compressed data buffer.
+
+#define ZIO_GZIP  1  ///< The stream is gzip compressed.
+#define ZIO_ZSTD  2  ///< The stream is zstd compressed.
+#define ZIO_PLAIN 3  ///< The stream is not compressed; see zio_wrap.
+
+#define ZIO_MAGIC 4  ///< The most bytes in a magic number.
+
+
+/**
+   @brief The state of a compressed stream.
+*/
+struct Zio {
+   FILE *fp;                 ///< The underlying compressed file.
+   const char *filename;     ///< The file name, for error messages.
+   int   kind;               ///< ZIO_GZIP, ZIO_ZSTD, or ZIO_PLAIN.
+   int   writing;            ///< 1 if compressing, 0 if decompressing.
+   int   ended;              ///< 1 if the last frame read was complete.
+   size_t held;              ///< ZIO_PLAIN: bytes looked at, in buf.
+   size_t used;              ///< ZIO_PLAIN: held bytes already read.
+   unsigned char buf[ZIO_BUFSIZE];   ///< Compressed data.
+#ifdef HAVE_ZLIB
+   z_stream z;               ///< zlib state.
+#endif
+#ifdef HAVE_ZSTD
+   ZSTD_DCtx *dctx;          ///< zstd decompression state.
+   ZSTD_CCtx *cctx;          ///< zstd compression state.
+   ZSTD_inBuffer in;         ///< zstd input not yet decompressed.
+#endif
+};
+
+
+/**
+   @brief Report a problem with a compressed file and exit.
+
+   @param[in] zio The stream.
+   @param[in] problem What went wrong.
+*/
+static void
+zio_fail (struct Zio *zio, const char *problem)
+{
+   fprintf (stderr, "%s: %s\n", zio->filename, problem);
+   exit (EXIT_FAILURE);
+}
+
+
+#if defined (HAVE_ZLIB) || defined (HAVE_ZSTD)
+
+
+/**
+   @brief Fill the compressed data buffer from the underlying file.
+
+   @param[in] zio The stream.
+   @return The number of bytes read; 0 at the end of the file.
+*/
+static size_t
+zio_fill (struct Zio *zio)
+{
+   size_t got;
+
+   got = fread (zio->buf, 1, ZIO_BUFSIZE, zio->fp);
+   if (got == 0 && ferror (zio->fp))
+      zio_fail (zio, "read error.");
+   if (got == 0 && !zio->ended)
+      zio_fail (zio, "compressed data ends too soon.");
+   return got;
+}
+
+
+/**
+   @brief Write the compressed data buffer to the underlying file.
+
+   @param[in] zio The stream.
+   @param[in] len The number of bytes in the buffer.
+*/
+static void
+zio_flush (struct Zio *zio, size_t len)
+{
+   if (len > 0 && fwrite (zio->buf, 1, len, zio->fp) != len)
+      zio_fail (zio, "write error.");
+}
+
+#endif
+
+
+/**
+   @brief Decompress up to size bytes.
+
+   @param[in] zio The stream.
+   @param[out] data Where to put the bytes.
+   @param[in] size The most bytes wanted.
+   @return The number of bytes decompressed; 0 at the end of the file.
+*/
+static size_t
+zio_read (struct Zio *zio, char *data, size_t size)
+{
+   if (zio->kind == ZIO_PLAIN) {
+      size_t got;
+
+      if (zio->used < zio->held) {
+         got = zio->held - zio->used;
+         if (got > size)
+            got = size;
+         memcpy (data, &zio->buf[zio->used], got);
+         zio->used += got;
+         return got;
+      }
+      got = fread (data, 1, size, zio->fp);
+      if (got == 0 && ferror (zio->fp))
+         zio_fail (zio, "read error.");
+      return got;
+   }
+#ifdef HAVE_ZLIB
+   if (zio->kind == ZIO_GZIP) {
+      int ret;
+
+      zio->z.next_out  = (unsigned char *)data;
+      zio->z.avail_out = size;
+      while (zio->z.avail_out == size) {
+         if (zio->z.avail_in == 0) {
+            zio->z.next_in  = zio->buf;
+            zio->z.avail_in = zio_fill (zio);
+            if (zio->z.avail_in == 0)
+               break;
+         }
+         ret = inflate (&zio->z, Z_NO_FLUSH);
+         if (ret == Z_STREAM_END) {
+            /* Another gzip member may follow, as from "cat a.gz b.gz". */
+            zio->ended = 1;
+            inflateReset (&zio->z);
+         }
+         else if (ret == Z_OK)
+            zio->ended = 0;
+         else
+            zio_fail (zio, "invalid gzip data.");
+      }
+      return size - zio->z.avail_out;
+   }
+#endif
+#ifdef HAVE_ZSTD
+   if (zio->kind == ZIO_ZSTD) {
+      ZSTD_outBuffer out;
+      size_t ret;
+
+      out.dst  = data;
+      out.size = size;
+      out.pos  = 0;
+      while (out.pos == 0) {
+         if (zio->in.pos == zio->in.size) {
+            zio->in.size = zio_fill (zio);
+            zio->in.pos  = 0;
+            if (zio->in.size == 0)
+               break;
+         }
+         ret = ZSTD_decompressStream (zio->dctx, &out, &zio->in);
+         if (ZSTD_isError (ret))
+            zio_fail (zio, "invalid zstd data.");
+         zio->ended = (ret == 0);
+      }
+      return out.pos;
+   }
+#endif
+   return 0;
+}
+
+
+/**
+   @brief Compress size bytes.
+
+   @param[in] zio The stream.
+   @param[in] data The bytes to compress.
+   @param[in] size The number of bytes.
+*/
+static void
+zio_write (struct Zio *zio, const char *data, size_t size)
+{
+#ifdef HAVE_ZLIB
+   if (zio->kind == ZIO_GZIP) {
+      zio->z.next_in  = (unsigned char *)data;
+      zio->z.avail_in = size;
+      while (zio->z.avail_in > 0) {
+         zio->z.next_out  = zio->buf;
+         zio->z.avail_out = ZIO_BUFSIZE;
+         if (deflate (&zio->z, Z_NO_FLUSH) == Z_STREAM_ERROR)
+            zio_fail (zio, "gzip compression failed.");
+         zio_flush (zio, ZIO_BUFSIZE - zio->z.avail_out);
+      }
+   }
+#endif
+#ifdef HAVE_ZSTD
+   if (zio->kind == ZIO_ZSTD) {
+      ZSTD_inBuffer  in;
+      ZSTD_outBuffer out;
+
+      in.src  = data;
+      in.size = size;
+      in.pos  = 0;
+      while (in.pos < in.size) {
+         out.dst  = zio->buf;
+         out.size = ZIO_BUFSIZE;
+         out.pos  = 0;
+         if (ZSTD_isError (ZSTD_compressStream2 (zio->cctx, &out, &in,
+                                                 ZSTD_e_continue)))
+            zio_fail (zio, "zstd compression failed.");
+         zio_flush (zio, out.pos);
+      }
+   }
+#endif
+}
+
+
+/**
+   @brief Finish a stream and close the underlying file.
+
+   @param[in] zio The stream.
+   @return 0 on success, EOF if closing the file failed.
+*/
+static int
+zio_close (struct Zio *zio)
+{
+   int ret;
+
+#ifdef HAVE_ZLIB
+   if (zio->kind == ZIO_GZIP) {
+      if (zio->writing) {
+         zio->z.avail_in = 0;
+         do {
+            zio->z.next_out  = zio->buf;
+            zio->z.avail_out = ZIO_BUFSIZE;
+            ret = deflate (&zio->z, Z_FINISH);
+            if (ret == Z_STREAM_ERROR)
+               zio_fail (zio, "gzip compression failed.");
+            zio_flush (zio, ZIO_BUFSIZE - zio->z.avail_out);
+         } while (ret != Z_STREAM_END);
+         deflateEnd (&zio->z);
+      }
+      else
+         inflateEnd (&zio->z);
+   }
+#endif
+#ifdef HAVE_ZSTD
+   if (zio->kind == ZIO_ZSTD) {
+      if (zio->writing) {
+         ZSTD_inBuffer  in;
+         ZSTD_outBuffer out;
+         size_t left;
+
+         in.src  = NULL;
+         in.size = 0;
+         in.pos  = 0;
+         do {
+            out.dst  = zio->buf;
+            out.size = ZIO_BUFSIZE;
+            out.pos  = 0;
+            left = ZSTD_compressStream2 (zio->cctx, &out, &in, ZSTD_e_end);
+            if (ZSTD_isError (left))
+               zio_fail (zio, "zstd compression failed.");
+            zio_flush (zio, out.pos);
+         } while (left != 0);
+         ZSTD_freeCCtx (zio->cctx);
+      }
+      else
+         ZSTD_freeDCtx (zio->dctx);
+   }
+#endif
+   ret = fclose (zio->fp);
+   free (zio);
+   return ret;
+}
+
+
+/*
+   Adapters from the C library's stream hooks to the functions above.
+*/
+#if defined (ZIO_FOPENCOOKIE)
+
+static ssize_t
+zio_cookie_read (void *cookie, char *data, size_t size)
+{
+   return zio_read (cookie, data, size);
+}
+
+static ssize_t
+zio_cookie_write (void *cookie, const char *data, size_t size)
+{
+   zio_write (cookie, data, size);
+   return size;
+}
+
+static int
+zio_cookie_close (void *cookie)
+{
+   return zio_close (cookie);
+}
+
+#elif defined (ZIO_FUNOPEN)
+
+static int
+zio_cookie_read (void *cookie, char *data, int size)
+{
+   return zio_read (cookie, data, size);
+}
+
+static int
+zio_cookie_write (void *cookie, const char *data, int size)
+{
+   zio_write (cookie, data, size);
+   return size;
+}
+
+static int
+zio_cookie_close (void *cookie)
+{
+   return zio_close (cookie);
+}
+
+#endif
+
+
+/**
+   @brief Make a stream that compresses or decompresses a file.
+
+   @param[in] fp The underlying file.
+   @param[in] filename The file name, for error messages.
+   @param[in] kind ZIO_GZIP, ZIO_ZSTD, or ZIO_PLAIN.
+   @param[in] writing 1 to compress, 0 to decompress.
+   @param[in] held Bytes already read from fp, to be read first.
+   @param[in] nheld The number of held bytes, at most ZIO_MAGIC.
+   @return The new stream.
+*/
+static FILE *
+zio_stream (FILE *fp, const char *filename, int kind, int writing,
+            const unsigned char *held, size_t nheld)
+{
+   struct Zio *zio;
+   FILE *stream = NULL;
+   const char *name = kind == ZIO_GZIP ? "gzip" :
+                      kind == ZIO_ZSTD ? "zstd" : "uncompressed";
+   int   ok = 0;
+
+   zio = calloc (1, sizeof (struct Zio));
+   if (zio == NULL) {
+      fprintf (stderr, "%s: out of memory.\n", filename);
+      exit (EXIT_FAILURE);
+   }
+   zio->fp       = fp;
+   zio->filename = filename;
+   zio->kind     = kind;
+   zio->writing  = writing;
+   zio->ended    = 0;
+   zio->held     = nheld;
+   zio->used     = 0;
+   if (nheld > 0)
+      memcpy (zio->buf, held, nheld);
+
+   if (kind == ZIO_PLAIN)
+      ok = 1;
+
+#ifdef HAVE_ZLIB
+   if (kind == ZIO_GZIP) {
+      /* 15 + 16 writes a gzip header; 15 + 32 reads gzip or zlib. */
+      if (writing)
+         ok = deflateInit2 (&zio->z, 9, Z_DEFLATED, 15 + 16, 8,
+                            Z_DEFAULT_STRATEGY) == Z_OK;
+      else {
+         ok = inflateInit2 (&zio->z, 15 + 32) == Z_OK;
+         zio->z.next_in  = zio->buf;
+         zio->z.avail_in = nheld;
+      }
+   }
+#endif
+#ifdef HAVE_ZSTD
+   if (kind == ZIO_ZSTD) {
+      if (writing) {
+         zio->cctx = ZSTD_createCCtx ();
+         ok = zio->cctx != NULL &&
+              !ZSTD_isError (ZSTD_CCtx_setParameter (zio->cctx,
+                                ZSTD_c_compressionLevel, 19));
+      }
+      else {
+         zio->dctx = ZSTD_createDCtx ();
+         zio->in.src  = zio->buf;
+         zio->in.size = nheld;
+         zio->in.pos  = 0;
+         ok = zio->dctx != NULL;
+      }
+   }
+#endif
+   if (!ok) {
+      fprintf (stderr, "%s: %s support is not available.\n", filename, name);
+      exit (EXIT_FAILURE);
+   }
+
+#if defined (ZIO_FOPENCOOKIE)
+   {
+      cookie_io_functions_t io;
+
+      io.read  = zio_cookie_read;
+      io.write = zio_cookie_write;
+      io.seek  = NULL;
+      io.close = zio_cookie_close;
+      stream = fopencookie (zio, writing ? "w" : "r", io);
+   }
+#elif defined (ZIO_FUNOPEN)
+   stream = funopen (zio, writing ? NULL : zio_cookie_read,
+                     writing ? zio_cookie_write : NULL, NULL,
+                     zio_cookie_close);
+#endif
+   if (stream == NULL) {
+      fprintf (stderr, "%s: can't make a %s stream on this system.\n",
+               filename, name);
+      exit (EXIT_FAILURE);
+   }
+   return stream;
+}
+
+
+/**
+   @brief Decompress an open file as it is read, if it is compressed.
+
+   A file is compressed if it starts with the whole magic number of
+   a gzip stream (1F 8B) or a zstd frame (28 B5 2F FD).  The bytes
+   looked at are put back: with ungetc if there is only one, or else
+   by seeking back.  An uncompressed pipe, which can't seek, is read
+   through a stream that gives the bytes looked at first.
+
+   @param[in] fp The open file.
+   @param[in] filename The file name, for error messages.
+   @return fp if it is not compressed, or else a new stream
+           that reads the decompressed (or replayed) data and
+           closes fp when it is closed.
+*/
+FILE *
+zio_wrap (FILE *fp, const char *filename)
+{
+   static const unsigned char gzip_magic[] = {0x1F, 0x8B};
+   static const unsigned char zstd_magic[] = {0x28, 0xB5, 0x2F, 0xFD};
+   const unsigned char *magic;
+   unsigned char held[ZIO_MAGIC];  /* the bytes looked at */
+   size_t magiclen, n;
+   int kind;
+   int c;
+
+   c = getc (fp);
+   if (c == EOF)
+      return fp;
+   if (c == gzip_magic[0]) {
+      magic    = gzip_magic;
+      magiclen = sizeof (gzip_magic);
+      kind     = ZIO_GZIP;
+   }
+   else if (c == zstd_magic[0]) {
+      magic    = zstd_magic;
+      magiclen = sizeof (zstd_magic);
+      kind     = ZIO_ZSTD;
+   }
+   else {
+      ungetc (c, fp);
+      return fp;
+   }
+
+   /* Read on until the magic number is complete or a byte differs. */
+   held[0] = c;
+   n = 1;
+   while (n < magiclen && held[n - 1] == magic[n - 1] &&
+          (c = getc (fp)) != EOF)
+      held[n++] = c;
+   if (n == magiclen && memcmp (held, magic, magiclen) == 0)
+      return zio_stream (fp, filename, kind, 0, held, n);
+
+   if (n == 1) {
+      ungetc (held[0], fp);
+      return fp;
+   }
+   if (fseek (fp, -(long)n, SEEK_CUR) == 0)
+      return fp;
+   clearerr (fp);
+   return zio_stream (fp, filename, ZIO_PLAIN, 0, held, n);
+}
+
+
+/**
+   @brief Open a file that may be compressed.
+
+   A file opened for reading is decompressed if it is compressed.
+   A file opened for writing is compressed if its name ends in
+   ".gz" or ".zst".
+
+   @param[in] filename The file name.
+   @param[in] mode The fopen mode: "r", "rb", "w", or "wb".
+   @return The stream, or NULL if the file can't be opened.
+*/
+FILE *
+zio_open (const char *filename, const char *mode)
+{
+   FILE  *fp;
+   size_t len = strlen (filename);
+
+   if ((fp = fopen (filename, mode)) == NULL)
+      return NULL;
+   if (mode[0] == 'r')
+      return zio_wrap (fp, filename);
+   if (len > 3 && strcmp (filename + len - 3, ".gz") == 0)
+      return zio_stream (fp, filename, ZIO_GZIP, 1, NULL, 0);
+   if (len > 4 && strcmp (filename + len - 4, ".zst") == 0)
+      return zio_stream (fp, filename, ZIO_ZSTD, 1, NULL, 0);
+   return fp;
+}
@@ -0,0 +1,58 @@
+/**
+   @file unizio.h
+
+   @brief Read and write gzip and zstd compressed files as plain streams.
+
+   @author Paul Hardy
+
+   @copyright Copyright (C) 2023 Paul Hardy
+
+   zio_open and zio_wrap return an ordinary FILE pointer.  When the
+   file is compressed, the stream decompresses or compresses as it
+   goes, so a program can use fgets, fscanf, fwrite, and the rest
+   on it unchanged and no separate gzip or zstd process is needed.
+
+   Input is recognized as compressed by its whole magic number:
+   1F 8B starts a gzip stream and 28 B5 2F FD a zstd frame.  Any
+   other input is returned as the original, uncompressed stream, so
+   it can still be mapped or seeked; only an uncompressed pipe whose
+   first bytes look like the start of a magic number is read through
+   a stream that gives those bytes back first.  Output is compressed if the file name ends in
+   ".gz" or ".zst".
+
+   gzip support needs zlib and is built if HAVE_ZLIB is defined;
+   zstd support needs libzstd and is built if HAVE_ZSTD is defined.
+   A compressed stream is made with fopencookie on GNU and Cygwin
+   systems and funopen on BSD and macOS.  Opening a compressed file
+   without the support needed is an error.
+
+   The stream must be closed with fclose, even at the end of a
+   program, so that compressed output is completed.
+*/
+/*
+   LICENSE:
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 2 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _UNIZIO_H_
+#define _UNIZIO_H_
+
+#include <stdio.h>
+
+
+FILE *zio_open (const char *filename, const char *mode);
+FILE *zio_wrap (FILE *fp, const char *filename);
+
+#endif